@@ -2140,7 +2140,7 @@ printf("\n");
 
       if (operand_size != SIZE_NONE)
       {
-        printf("Error: %s doesn't take a size attribute at %s:%d\n",
+        fprintf(asm_context->messages, "Error: %s doesn't take a size attribute at %s:%d\n",
           instr,
           asm_context->tokens.filename,
           asm_context->tokens.line);
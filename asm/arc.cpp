@@ -1106,7 +1106,7 @@ for (n = 0; n < operand_count; n++)
       }
       default:
       {
-printf("%d %d\n", table_arc_load_store[n].type, OP_A_PAREN_B_S9);
+fprintf(asm_context->messages, "%d %d\n", table_arc_load_store[n].type, OP_A_PAREN_B_S9);
         print_error_internal(asm_context, __FILE__, __LINE__);
         return -1;
       }
@@ -131,7 +131,7 @@ static int imm_shift_to_immediate(
 {
   if (operands[pos].value >= 256 || (int32_t)operands[pos].value < 0)
   {
-    printf("Error: Immediate out of range for #imm, shift at %s:%d\n",
+    fprintf(asm_context->messages, "Error: Immediate out of range for #imm, shift at %s:%d\n",
       asm_context->tokens.filename,
       asm_context->tokens.line);
 
@@ -141,7 +141,7 @@ static int imm_shift_to_immediate(
   if ((operands[pos+1].value&1) == 1 || (operands[pos+1].sub_type != 3) ||
        operands[pos+1].value > 30 || (int32_t)operands[pos+1].value < 0)
   {
-    printf("Error: Bad shift value for #imm, shift at %s:%d\n",
+    fprintf(asm_context->messages, "Error: Bad shift value for #imm, shift at %s:%d\n",
       asm_context->tokens.filename,
       asm_context->tokens.line);
 
@@ -797,7 +797,7 @@ static int parse_msr(
       int source_operand = compute_immediate(operands[1].value);
       if (source_operand == -1)
       {
-        printf("Error: Can't create a constant for immediate value %d at %s:%d\n", operands[1].value, asm_context->tokens.filename, asm_context->tokens.line);
+        fprintf(asm_context->messages, "Error: Can't create a constant for immediate value %d at %s:%d\n", operands[1].value, asm_context->tokens.filename, asm_context->tokens.line);
         return -1;
       }
 
@@ -17,10 +17,14 @@
 #include "asm/arm64.h"
 #include "asm/common.h"
 #include "common/assembler.h"
+#include "common/TableIndex.h"
 #include "common/tokens.h"
 #include "common/eval_expression.h"
 #include "table/arm64.h"
 
+static TableIndex table_arm64_index;
+static TableIndex table_arm64_simd_copy_index;
+
 #define MAX_OPERANDS 4
 
 enum
@@ -2188,7 +2192,10 @@ int parse_instruction_arm64(AsmContext *asm_context, char *instr)
 
   if (operand_count == 2)
   {
-    for (n = 0; table_arm64_simd_copy[n].instr != NULL; n++)
+    for (n = table_arm64_simd_copy_index.find(
+           table_arm64_simd_copy, &_table_arm64_simd_copy::instr, instr_case);
+         n != -1;
+         n = table_arm64_simd_copy_index.next(n))
     {
       if (strcmp(table_arm64_simd_copy[n].instr, instr_case) != 0) { continue; }
 
@@ -2283,7 +2290,10 @@ int parse_instruction_arm64(AsmContext *asm_context, char *instr)
     }
   }
 
-  for (n = 0; table_arm64[n].instr != NULL; n++)
+  for (n = table_arm64_index.find(
+         table_arm64, &_table_arm64::instr, instr_case);
+       n != -1;
+       n = table_arm64_index.next(n))
   {
     if (strcmp(table_arm64[n].instr, instr_case) == 0)
     {
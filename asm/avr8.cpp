@@ -104,7 +104,7 @@ int parse_instruction_avr8(AsmContext *asm_context, char *instr)
 
   if ((asm_context->address & 1) == 1)
   {
-    printf("Warning: address 0x%04x not on 16 bit boundary\n", asm_context->address);
+    fprintf(asm_context->messages, "Warning: address 0x%04x not on 16 bit boundary\n", asm_context->address);
     asm_context->address++;
   }
 
@@ -430,7 +430,7 @@ int parse_instruction_avr8(AsmContext *asm_context, char *instr)
             if (operands[0].value < 24 || operands[0].value > 30 ||
                (operands[0].value & 0x1) == 1)
             {
-              printf("Error: Register must be r24,r26,r28,r30 for '%s' at %s:%d.\n", instr, asm_context->tokens.filename, asm_context->tokens.line);
+              fprintf(asm_context->messages, "Error: Register must be r24,r26,r28,r30 for '%s' at %s:%d.\n", instr, asm_context->tokens.filename, asm_context->tokens.line);
               return -1;
             }
 
@@ -528,7 +528,7 @@ int parse_instruction_avr8(AsmContext *asm_context, char *instr)
             if ((operands[0].value & 0x1) != 0 &&
                 (operands[1].value & 0x1) != 0)
             {
-              printf("Error: Register must be even for '%s' at %s:%d.\n", instr, asm_context->tokens.filename, asm_context->tokens.line);
+              fprintf(asm_context->messages, "Error: Register must be even for '%s' at %s:%d.\n", instr, asm_context->tokens.filename, asm_context->tokens.line);
               return -1;
             }
             rd = (operands[0].value >> 1) << 4;
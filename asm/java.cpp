@@ -365,7 +365,7 @@ int parse_instruction_java(AsmContext *asm_context, char *instr)
           add_bin8(asm_context, n, IS_OPCODE);
           return parse_offset(asm_context, instr, 1);
         case JAVA_OP_WARN:
-          printf("Warning: %s is reserved  %s:%d.\n",
+          fprintf(asm_context->messages, "Warning: %s is reserved  %s:%d.\n",
             instr, asm_context->tokens.filename, asm_context->tokens.line);
           add_bin8(asm_context, n, IS_OPCODE);
           return 1;
@@ -17,11 +17,24 @@
 #include "asm/common.h"
 #include "asm/mips.h"
 #include "common/assembler.h"
+#include "common/TableIndex.h"
 #include "common/tokens.h"
 #include "common/eval_expression.h"
 #include "common/imports_obj.h"
 #include "table/mips.h"
 
+static TableIndex mips_r_table_index;
+static TableIndex mips_i_table_index;
+static TableIndex mips_branch_table_index;
+static TableIndex mips_special_table_index;
+static TableIndex mips_other_index;
+static TableIndex mips_branch_alias_index;
+static TableIndex mips_ee_index;
+static TableIndex mips_four_reg_index;
+static TableIndex mips_msa_index;
+static TableIndex mips_ee_vector_index;
+static TableIndex mips_rsp_vector_index;
+
 enum
 {
   OPERAND_TREG,
@@ -199,7 +212,9 @@ static int check_element(
 {
   if (element < 0 || element > element_max)
   {
-    printf("Warning: Vector element %d out of range (%d, %d) at %s:%d.\n",
+    asm_context->warning_count++;
+
+    fprintf(asm_context->messages, "Warning: Vector element %d out of range (%d, %d) at %s:%d.\n",
       element,
       0,
       element_max,
@@ -337,7 +352,10 @@ static int add_offset(
 
 static uint32_t find_opcode(const char *instr_case)
 {
-  for (int n = 0; mips_i_table[n].instr != NULL; n++)
+  for (int n = mips_i_table_index.find(
+         mips_i_table, &_mips_instr::instr, instr_case);
+       n != -1;
+       n = mips_i_table_index.next(n))
   {
     if (strcmp(instr_case, mips_i_table[n].instr) == 0)
     {
@@ -607,7 +625,10 @@ static int check_for_pseudo_branch(
   const char *instr)
 {
 
-  for (int n = 0; mips_branch_alias[n].instr != NULL; n++)
+  for (int n = mips_branch_alias_index.find(
+         mips_branch_alias, &_mips_branch_alias::instr, instr_case);
+       n != -1;
+       n = mips_branch_alias_index.next(n))
   {
     if (strcmp(instr_case, mips_branch_alias[n].instr) == 0)
     {
@@ -1101,7 +1122,9 @@ static int check_ee_instruction(
 {
   int n, r;
 
-  for (n = 0; mips_ee[n].instr != NULL; n++)
+  for (n = mips_ee_index.find(mips_ee, &_mips_other::instr, instr_case);
+       n != -1;
+       n = mips_ee_index.next(n))
   {
     // Check of this specific MIPS chip uses this instruction.
     if ((mips_ee[n].version & asm_context->flags) == 0)
@@ -1366,7 +1389,9 @@ static int check_other_instruction(
 {
   int n, r;
 
-  for (n = 0; mips_other[n].instr != NULL; n++)
+  for (n = mips_other_index.find(mips_other, &_mips_other::instr, instr_case);
+       n != -1;
+       n = mips_other_index.next(n))
   {
     // Check of this specific MIPS chip uses this instruction.
     if ((mips_other[n].version & asm_context->flags) == 0) { continue; }
@@ -1685,7 +1710,10 @@ int parse_instruction_mips(AsmContext *asm_context, char *instr)
   }
 
   // R-Type Instruction [ op 6, rs 5, rt 5, rd 5, sa 5, function 6 ]
-  for (n = 0; mips_r_table[n].instr != NULL; n++)
+  for (n = mips_r_table_index.find(
+         mips_r_table, &_mips_instr::instr, instr_case);
+       n != -1;
+       n = mips_r_table_index.next(n))
   {
     // Check of this specific MIPS chip uses this instruction.
     if ((mips_r_table[n].version & asm_context->flags) == 0)
@@ -1723,7 +1751,7 @@ int parse_instruction_mips(AsmContext *asm_context, char *instr)
         {
           if (operands[r].type != OPERAND_IMMEDIATE)
           {
-            printf("Error: '%s' expects registers at %s:%d\n", instr, asm_context->tokens.filename, asm_context->tokens.line);
+            fprintf(asm_context->messages, "Error: '%s' expects registers at %s:%d\n", instr, asm_context->tokens.filename, asm_context->tokens.line);
             return -1;
           }
         }
@@ -1731,7 +1759,7 @@ int parse_instruction_mips(AsmContext *asm_context, char *instr)
         {
           if (operands[r].type != OPERAND_TREG)
           {
-            printf("Error: '%s' expects registers at %s:%d\n", instr, asm_context->tokens.filename, asm_context->tokens.line);
+            fprintf(asm_context->messages, "Error: '%s' expects registers at %s:%d\n", instr, asm_context->tokens.filename, asm_context->tokens.line);
             return -1;
           }
         }
@@ -1755,7 +1783,7 @@ int parse_instruction_mips(AsmContext *asm_context, char *instr)
 
     if (operands[0].type != OPERAND_IMMEDIATE)
     {
-      printf("Error: Expecting address for '%s' at %s:%d\n",
+      fprintf(asm_context->messages, "Error: Expecting address for '%s' at %s:%d\n",
         instr, asm_context->tokens.filename, asm_context->tokens.line);
       return -1;
     }
@@ -1765,7 +1793,7 @@ int parse_instruction_mips(AsmContext *asm_context, char *instr)
 
     if ((address & 0xf0000000) != (operands[0].value & 0xf0000000))
     {
-      printf("Error: Jump address on wrong page at %s:%d\n",
+      fprintf(asm_context->messages, "Error: Jump address on wrong page at %s:%d\n",
         asm_context->tokens.filename, asm_context->tokens.line);
       return -1;
     }
@@ -1787,7 +1815,10 @@ int parse_instruction_mips(AsmContext *asm_context, char *instr)
   }
 
   // I-Type?  [ op 6, rs 5, rt 5, imm 16 ]
-  for (n = 0; mips_i_table[n].instr != NULL; n++)
+  for (n = mips_i_table_index.find(
+         mips_i_table, &_mips_instr::instr, instr_case);
+       n != -1;
+       n = mips_i_table_index.next(n))
   {
     // Check of this specific MIPS chip uses this instruction.
     if ((mips_i_table[n].version & asm_context->flags) == 0)
@@ -1883,7 +1914,10 @@ int parse_instruction_mips(AsmContext *asm_context, char *instr)
     }
   }
 
-  for (n = 0; mips_branch_table[n].instr != NULL; n++)
+  for (n = mips_branch_table_index.find(
+         mips_branch_table, &_mips_branch::instr, instr_case);
+       n != -1;
+       n = mips_branch_table_index.next(n))
   {
     // Check of this specific MIPS chip uses this instruction.
     if ((mips_branch_table[n].version & asm_context->flags) == 0)
@@ -1954,7 +1988,10 @@ int parse_instruction_mips(AsmContext *asm_context, char *instr)
   }
 
   // Special2 / Special3 type
-  for (n = 0; mips_special_table[n].instr != NULL; n++)
+  for (n = mips_special_table_index.find(
+         mips_special_table, &_mips_special_instr::instr, instr_case);
+       n != -1;
+       n = mips_special_table_index.next(n))
   {
     // Check of this specific MIPS chip uses this instruction.
     if ((mips_special_table[n].version & asm_context->flags) == 0) { continue; }
@@ -2009,7 +2046,7 @@ int parse_instruction_mips(AsmContext *asm_context, char *instr)
           {
             if (operands[operand_index].type != OPERAND_TREG)
             {
-              printf("Error: '%s' expects registers at %s:%d\n",
+              fprintf(asm_context->messages, "Error: '%s' expects registers at %s:%d\n",
                 instr, asm_context->tokens.filename, asm_context->tokens.line);
               return -1;
             }
@@ -2019,7 +2056,7 @@ int parse_instruction_mips(AsmContext *asm_context, char *instr)
             // SPECIAL_TYPE_SA and SPECIAL_TYPE_BITS
             if (operands[operand_index].type != OPERAND_IMMEDIATE)
             {
-              printf("Error: '%s' expects immediate %s:%d\n",
+              fprintf(asm_context->messages, "Error: '%s' expects immediate %s:%d\n",
                 instr, asm_context->tokens.filename, asm_context->tokens.line);
               return -1;
             }
@@ -2081,7 +2118,10 @@ int parse_instruction_mips(AsmContext *asm_context, char *instr)
   }
 
   // Some MIPS instructions seem to have 4 registers.
-  for (n = 0; mips_four_reg[n].instr != NULL; n++)
+  for (n = mips_four_reg_index.find(
+         mips_four_reg, &_mips_four_reg::instr, instr_case);
+       n != -1;
+       n = mips_four_reg_index.next(n))
   {
     // Check of this specific MIPS chip uses this instruction.
     if ((mips_four_reg[n].version & asm_context->flags) == 0) { continue; }
@@ -2138,7 +2178,9 @@ int parse_instruction_mips(AsmContext *asm_context, char *instr)
 
   if ((asm_context->flags & MIPS_MSA) != 0)
   {
-    for (n = 0; mips_msa[n].instr != NULL; n++)
+    for (n = mips_msa_index.find(mips_msa, &_mips_other::instr, instr_case);
+         n != -1;
+         n = mips_msa_index.next(n))
     {
       if (strcmp(instr_case, mips_msa[n].instr) == 0)
       {
@@ -2203,7 +2245,10 @@ int parse_instruction_mips(AsmContext *asm_context, char *instr)
 
     get_dest(instr_case, &dest);
 
-    for (n = 0; mips_ee_vector[n].instr != NULL; n++)
+    for (n = mips_ee_vector_index.find(
+           mips_ee_vector, &_mips_ee_vector::instr, instr_case);
+         n != -1;
+         n = mips_ee_vector_index.next(n))
     {
       if (strcmp(instr_case, mips_ee_vector[n].instr) == 0)
       {
@@ -2529,7 +2574,10 @@ int parse_instruction_mips(AsmContext *asm_context, char *instr)
 
   if ((asm_context->flags & MIPS_RSP) != 0)
   {
-    for (n = 0; mips_rsp_vector[n].instr != NULL; n++)
+    for (n = mips_rsp_vector_index.find(
+           mips_rsp_vector, &_mips_rsp_vector::instr, instr_case);
+         n != -1;
+         n = mips_rsp_vector_index.next(n))
     {
       if (strcmp(instr_case, mips_rsp_vector[n].instr) != 0) { continue; }
 
@@ -2789,7 +2837,7 @@ int link_function_mips(
 
       if (symbol == NULL)
       {
-        printf("Error: Couldn't find symbol name from offset.\n");
+        fprintf(asm_context->messages, "Error: Couldn't find symbol name from offset.\n");
         return -1;
       }
 
@@ -2799,7 +2847,7 @@ int link_function_mips(
       {
         if (asm_context->linker->search_code_from_symbol(symbol) == 0)
         {
-          printf("Error: Symbol not found %s\n", symbol);
+          fprintf(asm_context->messages, "Error: Symbol not found %s\n", symbol);
           return -1;
         }
       }
@@ -2809,7 +2857,7 @@ int link_function_mips(
 
         if (asm_context->symbols.lookup(symbol, &address) != 0)
         {
-          printf("Error: Symbol not found %s\n", symbol);
+          fprintf(asm_context->messages, "Error: Symbol not found %s\n", symbol);
           return -1;
         }
 
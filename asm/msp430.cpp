@@ -381,7 +381,7 @@ int parse_instruction_msp430(AsmContext *asm_context, char *instr)
   {
     if (asm_context->pass == 2)
     {
-      printf("Warning: Instruction doesn't start on 16 bit boundary at %s:%d.  Padding with a 0.\n", asm_context->tokens.filename, asm_context->tokens.line);
+      fprintf(asm_context->messages, "Warning: Instruction doesn't start on 16 bit boundary at %s:%d.  Padding with a 0.\n", asm_context->tokens.filename, asm_context->tokens.line);
     }
 
     asm_context->memory_write_inc(0, DL_NO_CG);
@@ -778,7 +778,7 @@ int parse_instruction_msp430(AsmContext *asm_context, char *instr)
           {
             if (size != 0 && size != 16)
             {
-              printf("Error: Instruction '%s' can't be used with .b at %s:%d\n",
+              fprintf(asm_context->messages, "Error: Instruction '%s' can't be used with .b at %s:%d\n",
                 instr, asm_context->tokens.filename, asm_context->tokens.line);
               return -1;
             }
@@ -788,7 +788,7 @@ int parse_instruction_msp430(AsmContext *asm_context, char *instr)
           {
             if (size != 0)
             {
-              printf("Error: Instruction '%s' can't be used with .b/w at %s:%d\n",
+              fprintf(asm_context->messages, "Error: Instruction '%s' can't be used with .b/w at %s:%d\n",
                  instr, asm_context->tokens.filename, asm_context->tokens.line);
               return -1;
             }
@@ -1404,7 +1404,7 @@ int parse_instruction_msp430(AsmContext *asm_context, char *instr)
           {
             if (size != 0 && size != 16)
             {
-              printf("Error: Instruction '%s' can't be used with .b at %s:%d\n",
+              fprintf(asm_context->messages, "Error: Instruction '%s' can't be used with .b at %s:%d\n",
                 instr, asm_context->tokens.filename, asm_context->tokens.line);
               return -1;
             }
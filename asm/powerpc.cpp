@@ -17,10 +17,13 @@
 #include "asm/common.h"
 #include "asm/powerpc.h"
 #include "common/assembler.h"
+#include "common/TableIndex.h"
 #include "common/tokens.h"
 #include "common/eval_expression.h"
 #include "table/powerpc.h"
 
+static TableIndex table_powerpc_index;
+
 #define MAX_OPERANDS 5
 
 enum
@@ -353,7 +356,10 @@ int parse_instruction_powerpc(AsmContext *asm_context, char *instr)
 
   if (operand_count < 0) { return -1; }
 
-  for (n = 0; table_powerpc[n].instr != NULL; n++)
+  for (n = table_powerpc_index.find(
+         table_powerpc, &_table_powerpc::instr, instr_case);
+       n != -1;
+       n = table_powerpc_index.next(n))
   {
     if (strcmp(table_powerpc[n].instr, instr_case) == 0)
     {
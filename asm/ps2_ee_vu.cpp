@@ -160,7 +160,7 @@ static int get_field_bits(
     else if (c == 'w') { *dest |= FIELD_W; }
     else
     {
-      printf("Error: Unknown component '%c' at %s:%d\n",
+      fprintf(asm_context->messages, "Error: Unknown component '%c' at %s:%d\n",
         token[n],
         asm_context->tokens.filename,
         asm_context->tokens.line);
@@ -237,7 +237,7 @@ int get_base(
 
     if (! is_only_one_dest(operand->field_mask))
     {
-      printf("Error: Only 1 dest field allowed at %s:%d\n",
+      fprintf(asm_context->messages, "Error: Only 1 dest field allowed at %s:%d\n",
         asm_context->tokens.filename,
         asm_context->tokens.line);
       return -1;
@@ -298,7 +298,7 @@ static int get_operands(
         else if (c == 't') { *iemdt_bits |= 1; }
         else
         {
-          printf("Error: Unknown flag '%c' at %s:%d\n",
+          fprintf(asm_context->messages, "Error: Unknown flag '%c' at %s:%d\n",
             token[n],
             asm_context->tokens.filename,
             asm_context->tokens.line);
@@ -452,7 +452,7 @@ static int get_operands(
 
             if (modifier != 0)
             {
-              printf("Error: Instruction cannot have modifier at %s:%d\n",
+              fprintf(asm_context->messages, "Error: Instruction cannot have modifier at %s:%d\n",
                 asm_context->tokens.filename,
                 asm_context->tokens.line);
             }
@@ -550,7 +550,7 @@ static uint32_t get_opcode(
       if (asm_context->flags == PS2_EE_VU0 &&
          (table_ps2_ee_vu[n].flags & FLAG_VU1_ONLY))
       {
-        printf("Error: Instruction only valid in VU1 at %s:%d\n",
+        fprintf(asm_context->messages, "Error: Instruction only valid in VU1 at %s:%d\n",
                asm_context->tokens.filename, asm_context->tokens.line);
         return UNKNOWN_OPCODE;
       }
@@ -885,7 +885,7 @@ static uint32_t get_opcode(
 
       if (is_lower == 1 && iemdt_bits != 0)
       {
-        printf("Error: Cannot set IEMDT bits in lower instruction at %s:%d\n",
+        fprintf(asm_context->messages, "Error: Cannot set IEMDT bits in lower instruction at %s:%d\n",
           asm_context->tokens.filename,
           asm_context->tokens.line);
         return UNKNOWN_OPCODE;
@@ -897,7 +897,7 @@ static uint32_t get_opcode(
 
   if (wrong_operand_count == 0)
   {
-    printf("Error: Unknown %s instruction '%s' at %s:%d\n",
+    fprintf(asm_context->messages, "Error: Unknown %s instruction '%s' at %s:%d\n",
            is_lower ? "lower" : "upper",
            instr,
            asm_context->tokens.filename,
@@ -905,7 +905,7 @@ static uint32_t get_opcode(
   }
     else
   {
-    printf("Error: Wrong operand count for %s instruction '%s' at %s:%d\n",
+    fprintf(asm_context->messages, "Error: Wrong operand count for %s instruction '%s' at %s:%d\n",
            is_lower ? "lower" : "upper",
            instr,
            asm_context->tokens.filename,
@@ -17,10 +17,14 @@
 #include "asm/common.h"
 #include "asm/riscv.h"
 #include "common/assembler.h"
+#include "common/TableIndex.h"
 #include "common/tokens.h"
 #include "common/eval_expression.h"
 #include "table/riscv.h"
 
+static TableIndex table_riscv_index;
+static TableIndex table_riscv_comp_index;
+
 #define MAX_OPERANDS 6
 
 enum
@@ -265,7 +269,10 @@ static uint32_t find_opcode(const char *instr_case)
 {
   int n;
 
-  for (n = 0; table_riscv[n].instr != NULL; n++)
+  for (n = table_riscv_index.find(
+         table_riscv, &_table_riscv::instr, instr_case);
+       n != -1;
+       n = table_riscv_index.next(n))
   {
     if (strcmp(instr_case, table_riscv[n].instr) == 0)
     {
@@ -941,7 +948,10 @@ int parse_instruction_riscv(AsmContext *asm_context, char *instr)
   }
 #endif
 
-  for (n = 0; table_riscv[n].instr != NULL; n++)
+  for (n = table_riscv_index.find(
+         table_riscv, &_table_riscv::instr, instr_case);
+       n != -1;
+       n = table_riscv_index.next(n))
   {
     if (strcmp(table_riscv[n].instr, instr_case) == 0)
     {
@@ -2174,7 +2184,10 @@ int parse_instruction_riscv(AsmContext *asm_context, char *instr)
     }
   }
 
-  for (n = 0; table_riscv_comp[n].instr != NULL; n++)
+  for (n = table_riscv_comp_index.find(
+         table_riscv_comp, &_table_riscv_comp::instr, instr_case);
+       n != -1;
+       n = table_riscv_comp_index.next(n))
   {
     if (strcmp(table_riscv_comp[n].instr, instr_case) == 0)
     {
@@ -1183,7 +1183,7 @@ int parse_instruction_stm8(AsmContext *asm_context, char *instr)
           break;
         }
         default:
-          printf("Internal error %s:%d\n", __FILE__, __LINE__);
+          fprintf(asm_context->messages, "Internal error %s:%d\n", __FILE__, __LINE__);
           return -1;
           break;
       }
@@ -251,7 +251,7 @@ int parse_instruction_super_fx(AsmContext *asm_context, char *instr)
 
             if (((1 << operands[0].value) & table_super_fx[n].reg_mask) == 0)
             {
-              printf("Error: Cannot use r%d with this instruction.\n", operands[0].value);
+              fprintf(asm_context->messages, "Error: Cannot use r%d with this instruction.\n", operands[0].value);
               return -1;
             }
           }
@@ -349,7 +349,7 @@ int parse_instruction_super_fx(AsmContext *asm_context, char *instr)
               needed_type = OPERAND_AT_ADDRESS;
               if ((value & 1) == 1)
               {
-                printf("Error: Short address must be even at %s:%d.\n", asm_context->tokens.filename, asm_context->tokens.line);
+                fprintf(asm_context->messages, "Error: Short address must be even at %s:%d.\n", asm_context->tokens.filename, asm_context->tokens.line);
                 return -1;
               }
               break;
@@ -366,7 +366,7 @@ int parse_instruction_super_fx(AsmContext *asm_context, char *instr)
               type = operands[0].type;
               if ((value & 1) == 1)
               {
-                printf("Error: Short address must be even at %s:%d.\n", asm_context->tokens.filename, asm_context->tokens.line);
+                fprintf(asm_context->messages, "Error: Short address must be even at %s:%d.\n", asm_context->tokens.filename, asm_context->tokens.line);
                 return -1;
               }
               break;
@@ -383,7 +383,7 @@ int parse_instruction_super_fx(AsmContext *asm_context, char *instr)
 
           if (((1 << reg) & table_super_fx[n].reg_mask) == 0)
           {
-            printf("Error: Cannot use r%d with this instruction.\n", operands[0].value);
+            fprintf(asm_context->messages, "Error: Cannot use r%d with this instruction.\n", operands[0].value);
             return -1;
           }
 
@@ -227,7 +227,7 @@ int parse_cps(AsmContext *asm_context, int disable)
     }
     else
     {
-      printf("Error: Unknown flag '%c'\n", token[n]);
+      fprintf(asm_context->messages, "Error: Unknown flag '%c'\n", token[n]);
       return -1;
     }
 
@@ -856,7 +856,7 @@ int parse_instruction_thumb(AsmContext *asm_context, char *instr)
             if (check_range(asm_context, "Offset", offset, 0, 1020) == -1) { return -1; }
             if (is_4_byte_aligned(asm_context, offset) == -1)
             {
-              printf("       %s address: %d, data address: %d, offset: %d\n",
+              fprintf(asm_context->messages, "       %s address: %d, data address: %d, offset: %d\n",
                 instr, asm_context->address, operands[1].value, offset);
               return -1;
             }
@@ -164,7 +164,7 @@ int parse_instruction_tms9900(AsmContext *asm_context, char *instr)
           }
           if (n == 0)
           {
-            printf("Error: r0 cannot be used in a table at %s:%d.\n", asm_context->tokens.filename, asm_context->tokens.line);
+            fprintf(asm_context->messages, "Error: r0 cannot be used in a table at %s:%d.\n", asm_context->tokens.filename, asm_context->tokens.line);
             return -1;
           }
           if (expect_token_s(asm_context,")") != 0) { return -1; }
@@ -138,7 +138,7 @@ static int check_immediate(AsmContext *asm_context, int *immediate, int shift)
   {
     if ((*immediate & 0x3) != 0)
     {
-      printf("Error: Immediate must be a multiple of %d at %s:%d\n",
+      fprintf(asm_context->messages, "Error: Immediate must be a multiple of %d at %s:%d\n",
         1 << shift,
         asm_context->tokens.filename,
         asm_context->tokens.line);
@@ -154,7 +154,7 @@ static int check_immediate(AsmContext *asm_context, int *immediate, int shift)
 
   if ((*immediate & mask) != 0)
   {
-    printf("Error: Immediate must be a multiple of %d at %s:%d\n",
+    fprintf(asm_context->messages, "Error: Immediate must be a multiple of %d at %s:%d\n",
       1 << shift,
       asm_context->tokens.filename,
       asm_context->tokens.line);
@@ -196,7 +196,7 @@ static int check_immediate_n(AsmContext *asm_context, int *immediate, int shift)
 
   if ((*immediate & mask) != 0)
   {
-    printf("Error: Immediate must be a multiple of %d at %s:%d\n",
+    fprintf(asm_context->messages, "Error: Immediate must be a multiple of %d at %s:%d\n",
       1 << shift,
       asm_context->tokens.filename,
       asm_context->tokens.line);
@@ -588,7 +588,7 @@ int parse_instruction_xtensa(AsmContext *asm_context, char *instr)
 
           if ((operands[2].value & 0xff) != 0)
           {
-            printf("Error: Constant cannot be shifted by 8 at %s:%d\n",
+            fprintf(asm_context->messages, "Error: Constant cannot be shifted by 8 at %s:%d\n",
               asm_context->tokens.filename,
               asm_context->tokens.line);
             return -1;
@@ -696,7 +696,7 @@ int parse_instruction_xtensa(AsmContext *asm_context, char *instr)
           {
             if ((operands[1].value & 0x3) != 0)
             {
-              printf("Error: Source register must be {b0,b4,b8,b12} at %s:%d\n",
+              fprintf(asm_context->messages, "Error: Source register must be {b0,b4,b8,b12} at %s:%d\n",
                 asm_context->tokens.filename, asm_context->tokens.line);
               return -1;
             }
@@ -705,7 +705,7 @@ int parse_instruction_xtensa(AsmContext *asm_context, char *instr)
           {
             if ((operands[1].value & 0x7) != 0)
             {
-              printf("Error: Source register must be {b0,b8} at %s:%d\n",
+              fprintf(asm_context->messages, "Error: Source register must be {b0,b8} at %s:%d\n",
                 asm_context->tokens.filename, asm_context->tokens.line);
               return -1;
             }
@@ -830,7 +830,7 @@ int parse_instruction_xtensa(AsmContext *asm_context, char *instr)
 
           if (i == 16)
           {
-            printf("Error: Constant must be { -1, 1, 2, 3, 4, 5, 6, 7, 8, 10, 12, 16, 32, 64, 128, 256} at %s:%d\n",
+            fprintf(asm_context->messages, "Error: Constant must be { -1, 1, 2, 3, 4, 5, 6, 7, 8, 10, 12, 16, 32, 64, 128, 256} at %s:%d\n",
               asm_context->tokens.filename, asm_context->tokens.line);
             return -1;
           }
@@ -1163,7 +1163,7 @@ int parse_instruction_xtensa(AsmContext *asm_context, char *instr)
           {
             if ((immediate & 0x3) != 0)
             {
-              printf("Error: Immediate must be a multiple of 4 at %s:%d\n",
+              fprintf(asm_context->messages, "Error: Immediate must be a multiple of 4 at %s:%d\n",
                 asm_context->tokens.filename, asm_context->tokens.line);
               return -1;
             }
@@ -1174,7 +1174,7 @@ int parse_instruction_xtensa(AsmContext *asm_context, char *instr)
           {
             if ((immediate & 0x3) != 0)
             {
-              printf("Error: Immediate must be a multiple of 16 at %s:%d\n",
+              fprintf(asm_context->messages, "Error: Immediate must be a multiple of 16 at %s:%d\n",
                 asm_context->tokens.filename, asm_context->tokens.line);
               return -1;
             }
@@ -1218,7 +1218,7 @@ int parse_instruction_xtensa(AsmContext *asm_context, char *instr)
 
             if ((immediate & 0x7) != 0)
             {
-              printf("Error: Immediate must be a multiple of 4 at %s:%d\n",
+              fprintf(asm_context->messages, "Error: Immediate must be a multiple of 4 at %s:%d\n",
                 asm_context->tokens.filename, asm_context->tokens.line);
               return -1;
             }
@@ -1429,7 +1429,7 @@ int parse_instruction_xtensa(AsmContext *asm_context, char *instr)
 
           if ((offset & 0x3) != 0)
           {
-            printf("Error: Offset must be a multiple of 4 at %s:%d\n",
+            fprintf(asm_context->messages, "Error: Offset must be a multiple of 4 at %s:%d\n",
               asm_context->tokens.filename,
               asm_context->tokens.line);
             return -1;
@@ -0,0 +1,188 @@
+/**
+ *  naken_asm assembler.
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: https://www.mikekohn.net/
+ * License: GPLv3
+ *
+ * Copyright 2010-2025 by Michael Kohn
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "common/ExpressionCache.h"
+#include "common/MemoryPool.h"
+
+ExpressionCache::ExpressionCache() :
+  last_pool    (NULL),
+  last_entry   (NULL),
+  cursor       (NULL),
+  buckets      (NULL),
+  bucket_shift (32),
+  source_end   (NULL),
+  source_count (0),
+  hits         (0),
+  misses       (0),
+  count        (0)
+{
+  heap.memory_pool = NULL;
+}
+
+ExpressionCache::~ExpressionCache()
+{
+  reset();
+}
+
+void ExpressionCache::reset()
+{
+  memory_pool_free(heap.memory_pool);
+  free(buckets);
+  free(source_end);
+
+  heap.memory_pool = NULL;
+  last_pool = NULL;
+  last_entry = NULL;
+  cursor = NULL;
+  buckets = NULL;
+  bucket_shift = 32;
+  source_end = NULL;
+  source_count = 0;
+  hits = 0;
+  misses = 0;
+  count = 0;
+}
+
+// Make the hash table 4 times bigger (starting with 4096 buckets) so
+// there are at most 2 entries per bucket.
+void ExpressionCache::grow()
+{
+  const int old_count = bucket_shift == 32 ? 0 : 1 << (32 - bucket_shift);
+  const int new_count = old_count == 0 ? 4096 : old_count * 4;
+  ExpressionCacheEntry **old_buckets = buckets;
+
+  buckets = (ExpressionCacheEntry **)calloc(new_count, sizeof(*buckets));
+  bucket_shift = 32 - __builtin_ctz(new_count);
+
+  for (int n = 0; n < old_count; n++)
+  {
+    ExpressionCacheEntry *entry = old_buckets[n];
+
+    while (entry != NULL)
+    {
+      ExpressionCacheEntry *next = entry->next;
+      const int b = bucket(entry->source, entry->offset);
+
+      entry->next = buckets[b];
+      buckets[b] = entry;
+      entry = next;
+    }
+  }
+
+  free(old_buckets);
+}
+
+void ExpressionCache::add(
+  int source,
+  uint32_t offset,
+  uint32_t consumed,
+  int lines,
+  int flags,
+  const uint8_t *key,
+  int key_length,
+  const uint8_t *code,
+  int length)
+{
+  const int size = entry_size(key_length + length);
+
+  if (size > EXPRESSION_CACHE_HEAP_SIZE) { return; }
+
+  if (last_pool == NULL || last_pool->ptr + size > last_pool->len)
+  {
+    last_pool = memory_pool_add(&heap, EXPRESSION_CACHE_HEAP_SIZE);
+  }
+
+  if (count >= (bucket_shift == 32 ? 0 : 2 << (32 - bucket_shift)))
+  {
+    grow();
+  }
+
+  ExpressionCacheEntry *entry =
+    (ExpressionCacheEntry *)(last_pool->buffer + last_pool->ptr);
+
+  const int n = bucket(source, offset);
+
+  entry->next = buckets[n];
+  entry->following = NULL;
+  entry->source = source;
+  entry->offset = offset;
+  entry->consumed = consumed;
+  entry->lines = lines;
+  entry->key_length = key_length;
+  entry->length = length;
+  entry->flags = flags;
+  memcpy(entry->data, key, key_length);
+  memcpy(entry->data + key_length, code, length);
+
+  if (last_entry != NULL) { last_entry->following = entry; }
+
+  // Pass 1 reads a file from start to end, so most lookups are past
+  // anything added for that file and don't need the hash table.
+  if (source >= source_count)
+  {
+    const int new_count = source + 1;
+
+    source_end =
+      (uint32_t *)realloc(source_end, new_count * sizeof(uint32_t));
+    memset(source_end + source_count, 0,
+      (new_count - source_count) * sizeof(uint32_t));
+    source_count = new_count;
+  }
+
+  if (offset >= source_end[source]) { source_end[source] = offset + 1; }
+
+  buckets[n] = entry;
+  last_entry = entry;
+  last_pool->ptr += size;
+  count++;
+}
+
+const ExpressionCacheEntry *ExpressionCache::find(
+  int source,
+  uint32_t offset,
+  const uint8_t *key,
+  int key_length)
+{
+  ExpressionCacheEntry *entry = cursor;
+
+  if (source >= source_count || offset >= source_end[source])
+  {
+    entry = NULL;
+  }
+    else
+  if (entry == NULL || !matches(entry, source, offset, key, key_length))
+  {
+    entry = buckets[bucket(source, offset)];
+
+    while (entry != NULL &&
+           !matches(entry, source, offset, key, key_length))
+    {
+      entry = entry->next;
+    }
+  }
+
+  if (entry == NULL)
+  {
+    misses++;
+    return NULL;
+  }
+
+  cursor = entry->following;
+  hits++;
+
+  return entry;
+}
+
@@ -0,0 +1,118 @@
+/**
+ *  naken_asm assembler.
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: https://www.mikekohn.net/
+ * License: GPLv3
+ *
+ * Copyright 2010-2025 by Michael Kohn
+ *
+ */
+
+#ifndef NAKEN_ASM_EXPRESSION_CACHE_H
+#define NAKEN_ASM_EXPRESSION_CACHE_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "common/MemoryPool.h"
+
+#define EXPRESSION_CACHE_HEAP_SIZE (1 << 20)
+
+// An expression from a source file compiled by eval_expression() into
+// RPN code (see EvalExpression::Compiler).  The text it came from is
+// consumed bytes long and ends where the token after the expression
+// starts.  Tokens that were pushed back before the expression was read
+// are part of it, so they are saved in key and have to match too.
+struct ExpressionCacheEntry
+{
+  ExpressionCacheEntry *next;       // in the same bucket
+  ExpressionCacheEntry *following;  // added after this one
+  int source;
+  uint32_t offset;
+  uint32_t consumed;
+  int32_t lines;
+  uint16_t key_length;
+  uint16_t length;
+  uint8_t flags;    // lexer settings the expression was read with
+  uint8_t data[];   // key followed by the code
+
+  const uint8_t *get_code() const { return data + key_length; }
+};
+
+// Expressions are kept by where they start in a source file, so the
+// second time the same text is evaluated (pass 2, or a file that's
+// included twice) its code is run instead of reading the tokens again.
+// Pass 2 mostly asks for them in the order they were added, so the one
+// after the last one found is checked before the hash table.
+class ExpressionCache
+{
+public:
+  ExpressionCache();
+  ~ExpressionCache();
+
+  void reset();
+
+  void add(
+    int source,
+    uint32_t offset,
+    uint32_t consumed,
+    int lines,
+    int flags,
+    const uint8_t *key,
+    int key_length,
+    const uint8_t *code,
+    int length);
+
+  const ExpressionCacheEntry *find(
+    int source,
+    uint32_t offset,
+    const uint8_t *key,
+    int key_length);
+
+  int get_hits()   { return hits; }
+  int get_misses() { return misses; }
+  int get_count()  { return count; }
+
+private:
+  int bucket(int source, uint32_t offset)
+  {
+    return ((offset + (source << 24)) * 0x9e3779b1) >> bucket_shift;
+  }
+
+  void grow();
+
+  static bool matches(
+    const ExpressionCacheEntry *entry,
+    int source,
+    uint32_t offset,
+    const uint8_t *key,
+    int key_length)
+  {
+    return
+      entry->offset == offset &&
+      entry->source == source &&
+      entry->key_length == key_length &&
+      memcmp(entry->data, key, key_length) == 0;
+  }
+
+  static int entry_size(int length)
+  {
+    return (sizeof(ExpressionCacheEntry) + length + 7) & ~7;
+  }
+
+  NakenHeap heap;
+  MemoryPool *last_pool;
+  ExpressionCacheEntry *last_entry;
+  ExpressionCacheEntry *cursor;
+  ExpressionCacheEntry **buckets;
+  int bucket_shift;
+  uint32_t *source_end;
+  int source_count;
+  int hits;
+  int misses;
+  int count;
+};
+
+#endif
+
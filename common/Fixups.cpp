@@ -0,0 +1,107 @@
+/**
+ *  naken_asm assembler.
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: https://www.mikekohn.net/
+ * License: GPLv3
+ *
+ * Copyright 2010-2025 by Michael Kohn
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "common/Fixups.h"
+
+Fixups::Fixups() :
+  buffer      (NULL),
+  ptr         (0),
+  alloc       (0),
+  current     (-1),
+  fixup_count (0)
+{
+}
+
+Fixups::~Fixups()
+{
+  free(buffer);
+}
+
+void Fixups::reset()
+{
+  ptr = 0;
+  current = -1;
+  fixup_count = 0;
+
+  undefined.clear();
+}
+
+void Fixups::grow(int size)
+{
+  while (ptr + size > alloc)
+  {
+    alloc = alloc == 0 ? 65536 : alloc * 2;
+  }
+
+  buffer = (uint8_t *)realloc(buffer, alloc);
+}
+
+// Start recording a statement.  Returns the mark to pass to end().
+int Fixups::begin(const Fixup &fixup, const char *filename)
+{
+  // A statement that holds other statements (.include, .if, .repeat)
+  // can't be assembled again by itself, so what it recorded is dropped.
+  if (current != -1) { ptr = current; }
+
+  int filename_length = strlen(filename);
+
+  if (filename_length > 0xffff) { filename_length = 0xffff; }
+
+  const int size = sizeof(Fixup) + align(filename_length + 1);
+
+  if (ptr + size > alloc) { grow(size); }
+
+  Fixup *header = (Fixup *)(buffer + ptr);
+
+  memcpy(header, &fixup, sizeof(Fixup));
+  header->filename_length = filename_length;
+
+  char *name = (char *)(header + 1);
+
+  memcpy(name, filename, filename_length);
+  name[filename_length] = 0;
+
+  current = ptr;
+  ptr += size;
+
+  return current;
+}
+
+// Finish the statement started at mark.  If keep is set the statement is
+// added to the list to be assembled again, otherwise it's thrown away.
+// Returns -1 if it needs to be kept but other statements inside it
+// already took its place.
+int Fixups::end(int mark, bool keep, int kind, uint32_t end_address)
+{
+  if (current != mark) { return keep ? -1 : 0; }
+
+  current = -1;
+
+  if (!keep)
+  {
+    ptr = mark;
+    return 0;
+  }
+
+  Fixup *fixup = (Fixup *)(buffer + mark);
+
+  fixup->size = ptr - mark;
+  fixup->kind = kind;
+  fixup->end_address = end_address;
+  fixup_count++;
+
+  return 0;
+}
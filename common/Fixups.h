@@ -0,0 +1,176 @@
+/**
+ *  naken_asm assembler.
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: https://www.mikekohn.net/
+ * License: GPLv3
+ *
+ * Copyright 2010-2025 by Michael Kohn
+ *
+ */
+
+#ifndef NAKEN_ASM_FIXUPS_H
+#define NAKEN_ASM_FIXUPS_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "common/cpu_list.h"
+#include "common/StringHeap.h"
+
+enum
+{
+  FIXUP_NONE,
+  FIXUP_INSTRUCTION,
+  FIXUP_DATA,
+  FIXUP_DIRECTIVE
+};
+
+// What's needed to assemble a statement again at the same place: the
+// address it started at and the CPU settings it was assembled with.
+// The filename and the statement's tokens follow this in the log.
+// low_address / high_address are the memory range from before the
+// statement was assembled.
+struct Fixup
+{
+  uint32_t size;
+  uint32_t address;
+  uint32_t end_address;
+  uint32_t low_address;
+  uint32_t high_address;
+  uint32_t scope;
+  uint32_t flags;
+  int line;
+  int cpu_list_index;
+  parse_directive_t parse_directive;
+  uint16_t filename_length;
+  uint8_t kind;
+  uint8_t endian;
+  uint8_t segment;
+};
+
+struct FixupToken
+{
+  int64_t value;
+  uint16_t length;
+  int8_t type;
+  bool has_value;
+  char text[];
+};
+
+// With -single_pass every statement's tokens are recorded as they are
+// read.  A statement that used a symbol that wasn't defined yet is kept
+// (everything else is thrown away) so it can be assembled again at the
+// end once all the labels are known.
+class Fixups
+{
+public:
+  Fixups();
+  ~Fixups();
+
+  void reset();
+
+  int begin(const Fixup &fixup, const char *filename);
+  int end(int mark, bool keep, int kind, uint32_t end_address);
+  bool is_recording() { return current != -1; }
+  bool is_current(int mark) { return current == mark; }
+
+  void record(
+    int type,
+    const char *text,
+    int length,
+    bool has_value,
+    int64_t value)
+  {
+    const int size = token_size(length);
+
+    if (ptr + size > alloc) { grow(size); }
+
+    FixupToken *token = (FixupToken *)(buffer + ptr);
+
+    token->value = value;
+    token->length = length;
+    token->type = type;
+    token->has_value = has_value;
+    memcpy(token->text, text, length);
+    token->text[length] = 0;
+
+    ptr += size;
+  }
+
+  int count() { return fixup_count; }
+
+  // The first token of the statement being recorded (mark from begin()).
+  const FixupToken *first_token(int mark)
+  {
+    const uint8_t *token_ptr = get_tokens((const Fixup *)(buffer + mark));
+
+    return next_token(token_ptr, buffer + ptr);
+  }
+
+  // Where the tokens recorded so far end.
+  const uint8_t *get_end() { return buffer + ptr; }
+
+  void cancel()
+  {
+    if (current != -1) { ptr = current; }
+    current = -1;
+  }
+
+  // Walk the kept statements: pass 0 as offset to get the first one.
+  const Fixup *get(int offset)
+  {
+    return offset < ptr ? (const Fixup *)(buffer + offset) : NULL;
+  }
+
+  static const char *get_filename(const Fixup *fixup)
+  {
+    return (const char *)fixup + sizeof(Fixup);
+  }
+
+  static const uint8_t *get_tokens(const Fixup *fixup)
+  {
+    return (const uint8_t *)fixup + sizeof(Fixup) +
+      align(fixup->filename_length + 1);
+  }
+
+  static const FixupToken *next_token(
+    const uint8_t *&token_ptr,
+    const uint8_t *end)
+  {
+    if (token_ptr >= end) { return NULL; }
+
+    const FixupToken *token = (const FixupToken *)token_ptr;
+    token_ptr += token_size(token->length);
+
+    return token;
+  }
+
+  // Names .ifdef / defined() looked for that weren't labels yet.  If one
+  // of these is defined later the source can't be done in one pass.
+  void add_undefined(const char *name)
+  {
+    if (undefined.find(name) == -1) { undefined.append(name); }
+  }
+
+  StringHeap undefined;
+
+  static int token_size(int length)
+  {
+    return align(sizeof(FixupToken) + length + 1);
+  }
+
+private:
+  static int align(int size) { return (size + 7) & ~7; }
+
+  void grow(int size);
+
+  uint8_t *buffer;
+  int ptr;
+  int alloc;
+  int current;
+  int fixup_count;
+};
+
+#endif
+
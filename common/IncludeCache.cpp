@@ -0,0 +1,304 @@
+/**
+ *  naken_asm assembler.
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: https://www.mikekohn.net/
+ * License: GPLv3
+ *
+ * Copyright 2010-2025 by Michael Kohn
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "common/IncludeCache.h"
+
+#define INCLUDE_CACHE_MAGIC "NAKENINC"
+
+static void cache_filename(
+  char *filename,
+  int len,
+  const char *dir,
+  const Hash128 &key)
+{
+  snprintf(filename, len, "%s/%016" PRIx64 "%016" PRIx64 ".include",
+    dir, key.a, key.b);
+}
+
+IncludeCache::IncludeCache() :
+  buffer       (NULL),
+  buffer_len   (0),
+  buffer_alloc (0),
+  hits         (0),
+  misses       (0),
+  recording    (false),
+  cacheable    (false)
+{
+}
+
+IncludeCache::~IncludeCache()
+{
+  reset();
+  free(buffer);
+}
+
+void IncludeCache::reset()
+{
+  for (int n = 0; n < entries.count(); n++)
+  {
+    free(entries[n].data);
+  }
+
+  entries.clear();
+
+  buffer_len = 0;
+  hits = 0;
+  misses = 0;
+  recording = false;
+  cacheable = false;
+}
+
+// Returns 0 with data and length set if there is a recording for key,
+// 1 if the file is known to not be cacheable, or -1 if the file hasn't
+// been seen yet.  If dir isn't NULL, recordings saved there by an
+// earlier run are looked for too.
+int IncludeCache::find(
+  const Hash128 &key,
+  const char *dir,
+  const uint8_t **data,
+  int *length)
+{
+  Entry *entry = lookup(key);
+
+  if (entry == NULL && dir != NULL)
+  {
+    char filename[1024];
+    int file_length;
+
+    cache_filename(filename, sizeof(filename), dir, key);
+
+    uint8_t *file_data = load(filename, &file_length);
+
+    if (file_data != NULL)
+    {
+      add(key, file_data, file_length);
+      entry = &entries.last();
+    }
+  }
+
+  if (entry == NULL)
+  {
+    misses++;
+    return -1;
+  }
+
+  if (entry->data == NULL) { return 1; }
+
+  *data = entry->data;
+  *length = entry->length;
+
+  hits++;
+
+  return 0;
+}
+
+void IncludeCache::begin()
+{
+  buffer_len = 0;
+  recording = true;
+  cacheable = true;
+}
+
+void IncludeCache::record(const char *name, const char *value, int param_count)
+{
+  if (!recording) { return; }
+
+  const int name_len = strlen(name) + 1;
+  const int value_len = strlen(value) + 1;
+  const int size = 4 + name_len + value_len;
+
+  if (name_len > 255 || value_len > 65535)
+  {
+    cacheable = false;
+    return;
+  }
+
+  if (buffer_len + size > buffer_alloc)
+  {
+    while (buffer_len + size > buffer_alloc)
+    {
+      buffer_alloc = buffer_alloc == 0 ? 65536 : buffer_alloc * 2;
+    }
+
+    buffer = (uint8_t *)realloc(buffer, buffer_alloc);
+  }
+
+  uint8_t *s = buffer + buffer_len;
+
+  s[0] = param_count;
+  s[1] = name_len;
+  s[2] = value_len & 0xff;
+  s[3] = value_len >> 8;
+  memcpy(s + 4, name, name_len);
+  memcpy(s + 4 + name_len, value, value_len);
+
+  buffer_len += size;
+}
+
+// Stop recording.  If keep is set and nothing was done that depends on
+// where the file was included, the recording is kept for key (and saved
+// in dir if it's not NULL).
+void IncludeCache::end(const Hash128 &key, const char *dir, bool keep)
+{
+  recording = false;
+
+  if (!keep || lookup(key) != NULL) { return; }
+
+  if (!cacheable)
+  {
+    add(key, NULL, 0);
+    return;
+  }
+
+  uint8_t *data = (uint8_t *)malloc(buffer_len + 1);
+  memcpy(data, buffer, buffer_len);
+
+  add(key, data, buffer_len);
+
+  if (dir != NULL) { save(dir, key, data, buffer_len); }
+}
+
+// Get the macro at ptr in a recording and move ptr past it.  Returns -1
+// at the end of the recording or if what's there doesn't make sense (a
+// file from -cache_dir that was changed by something else).
+int IncludeCache::get_macro(
+  const uint8_t *data,
+  int length,
+  int *ptr,
+  const char **name,
+  const char **value,
+  int *param_count)
+{
+  const uint8_t *s = data + *ptr;
+
+  if (*ptr + 4 > length) { return -1; }
+
+  const int name_len = s[1];
+  const int value_len = s[2] | (s[3] << 8);
+
+  if (name_len == 0 || value_len == 0 ||
+      *ptr + 4 + name_len + value_len > length ||
+      s[4 + name_len - 1] != 0 ||
+      s[4 + name_len + value_len - 1] != 0)
+  {
+    return -1;
+  }
+
+  *param_count = s[0];
+  *name = (const char *)s + 4;
+  *value = (const char *)s + 4 + name_len;
+  *ptr += 4 + name_len + value_len;
+
+  return 0;
+}
+
+IncludeCache::Entry *IncludeCache::lookup(const Hash128 &key)
+{
+  for (int n = 0; n < entries.count(); n++)
+  {
+    if (entries[n].key.a == key.a && entries[n].key.b == key.b)
+    {
+      return &entries[n];
+    }
+  }
+
+  return NULL;
+}
+
+void IncludeCache::add(const Hash128 &key, uint8_t *data, int length)
+{
+  Entry entry;
+
+  entry.key = key;
+  entry.data = data;
+  entry.length = length;
+
+  entries.append(entry);
+}
+
+// A file is the magic number, the length of the recording, and then the
+// recording.  Returns NULL if the file isn't there or is cut short.
+uint8_t *IncludeCache::load(const char *filename, int *length)
+{
+  FILE *in = fopen(filename, "rb");
+
+  if (in == NULL) { return NULL; }
+
+  uint8_t header[12];
+  uint8_t *data = NULL;
+
+  if (fread(header, 1, sizeof(header), in) == sizeof(header) &&
+      memcmp(header, INCLUDE_CACHE_MAGIC, 8) == 0)
+  {
+    *length =
+      header[8] | (header[9] << 8) | (header[10] << 16) | (header[11] << 24);
+
+    data = (uint8_t *)malloc(*length + 1);
+
+    if ((int)fread(data, 1, *length, in) != *length)
+    {
+      free(data);
+      data = NULL;
+    }
+  }
+
+  fclose(in);
+
+  return data;
+}
+
+// Written to a temp file and renamed so another naken_asm running at the
+// same time never reads half of one.
+void IncludeCache::save(
+  const char *dir,
+  const Hash128 &key,
+  const uint8_t *data,
+  int length)
+{
+  char filename[1024];
+  char temp[1100];
+
+#ifdef WINDOWS
+  mkdir(dir);
+#else
+  mkdir(dir, 0777);
+#endif
+
+  cache_filename(filename, sizeof(filename), dir, key);
+  snprintf(temp, sizeof(temp), "%s.%d.%p", filename, (int)getpid(), data);
+
+  FILE *out = fopen(temp, "wb");
+
+  if (out == NULL) { return; }
+
+  uint8_t header[12];
+
+  memcpy(header, INCLUDE_CACHE_MAGIC, 8);
+  header[8] = length & 0xff;
+  header[9] = (length >> 8) & 0xff;
+  header[10] = (length >> 16) & 0xff;
+  header[11] = (length >> 24) & 0xff;
+
+  fwrite(header, 1, sizeof(header), out);
+  fwrite(data, 1, length, out);
+
+  if (fclose(out) != 0 || rename(temp, filename) != 0) { unlink(temp); }
+}
+
@@ -0,0 +1,98 @@
+/**
+ *  naken_asm assembler.
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: https://www.mikekohn.net/
+ * License: GPLv3
+ *
+ * Copyright 2010-2025 by Michael Kohn
+ *
+ */
+
+#ifndef NAKEN_ASM_INCLUDE_CACHE_H
+#define NAKEN_ASM_INCLUDE_CACHE_H
+
+#include <stdint.h>
+
+#include "common/hash.h"
+#include "common/Vector.h"
+
+// Most include files (the register definitions under include/) are
+// nothing but .define and equ lines.  The first time one is included the
+// macros it defines are recorded, and every time after that (pass 2,
+// another .include of the same file, or with -cache_dir another run) the
+// macros are added straight from the recording instead of parsing the
+// file again.  A file that does anything else (labels, instructions,
+// .if, .include, etc) depends on where it's included so it's parsed
+// normally.
+//
+// A recording is a list of:
+//
+//   uint8_t param_count;
+//   uint8_t name_len;     // with the 0 at the end
+//   uint16_t value_len;   // with the 0 at the end
+//   char name[name_len];
+//   char value[value_len];
+class IncludeCache
+{
+public:
+  IncludeCache();
+  ~IncludeCache();
+
+  void reset();
+
+  int find(
+    const Hash128 &key,
+    const char *dir,
+    const uint8_t **data,
+    int *length);
+
+  void begin();
+  void record(const char *name, const char *value, int param_count);
+  void end(const Hash128 &key, const char *dir, bool keep);
+
+  static int get_macro(
+    const uint8_t *data,
+    int length,
+    int *ptr,
+    const char **name,
+    const char **value,
+    int *param_count);
+
+  bool is_recording()  { return recording; }
+  void not_cacheable() { cacheable = false; }
+
+  int get_hits()   { return hits; }
+  int get_misses() { return misses; }
+  void clear_stats() { hits = 0; misses = 0; }
+
+private:
+  struct Entry
+  {
+    Hash128 key;
+    uint8_t *data;
+    int length;
+  };
+
+  Entry *lookup(const Hash128 &key);
+  void add(const Hash128 &key, uint8_t *data, int length);
+  static uint8_t *load(const char *filename, int *length);
+  static void save(
+    const char *dir,
+    const Hash128 &key,
+    const uint8_t *data,
+    int length);
+
+  // data is NULL for files that can't be cached.
+  Vector<Entry> entries;
+  uint8_t *buffer;
+  int buffer_len;
+  int buffer_alloc;
+  int hits;
+  int misses;
+  bool recording : 1;
+  bool cacheable : 1;
+};
+
+#endif
+
@@ -0,0 +1,216 @@
+/**
+ *  naken_asm assembler.
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: https://www.mikekohn.net/
+ * License: GPLv3
+ *
+ * Copyright 2010-2025 by Michael Kohn
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "common/assembler.h"
+#include "common/Fixups.h"
+#include "common/InstructionCache.h"
+#include "common/MemoryPool.h"
+
+InstructionCache::InstructionCache() :
+  last_pool    (NULL),
+  buckets      (NULL),
+  bucket_count (0),
+  count        (0),
+  buffer       (NULL),
+  ptr          (0),
+  alloc        (0),
+  operands     (0),
+  hash         (0),
+  hits         (0),
+  misses       (0)
+{
+  heap.memory_pool = NULL;
+}
+
+InstructionCache::~InstructionCache()
+{
+  clear();
+  free(buffer);
+}
+
+void InstructionCache::clear()
+{
+  memory_pool_free(heap.memory_pool);
+  free(buckets);
+
+  heap.memory_pool = NULL;
+  last_pool = NULL;
+  buckets = NULL;
+  bucket_count = 0;
+  count = 0;
+}
+
+void InstructionCache::begin(const InstructionCacheMode &mode, const char *instr)
+{
+  if (alloc == 0)
+  {
+    alloc = 1024;
+    buffer = (uint8_t *)malloc(alloc);
+  }
+
+  memcpy(buffer, &mode, sizeof(mode));
+  ptr = sizeof(mode);
+
+  record(TOKEN_STRING, instr, strlen(instr), false, 0);
+
+  operands = ptr;
+}
+
+// Tokens are kept the same way as Fixups keeps them so tokens_get()
+// can read them back.  The unused bytes are cleared so keys can be
+// compared with memcmp().
+void InstructionCache::record(
+  int type,
+  const char *text,
+  int length,
+  bool has_value,
+  int64_t value)
+{
+  const int size = Fixups::token_size(length);
+
+  while (ptr + size > alloc)
+  {
+    alloc *= 2;
+    buffer = (uint8_t *)realloc(buffer, alloc);
+  }
+
+  memset(buffer + ptr, 0, size);
+
+  FixupToken *token = (FixupToken *)(buffer + ptr);
+
+  token->value = value;
+  token->length = length;
+  token->type = type;
+  token->has_value = has_value;
+  memcpy(token->text, text, length);
+
+  ptr += size;
+}
+
+// Tokens are padded to 8 bytes so the key is hashed 8 bytes at a time.
+uint32_t InstructionCache::get_hash()
+{
+  uint64_t hash = 14695981039346656037ull;
+
+  for (int n = 0; n < ptr; n += 8)
+  {
+    uint64_t data;
+
+    memcpy(&data, buffer + n, 8);
+
+    hash = (hash ^ data) * 0x9e3779b97f4a7c15ull;
+    hash ^= hash >> 29;
+  }
+
+  return hash ^ (hash >> 32);
+}
+
+// Look up the tokens recorded since begin().
+InstructionCacheEntry *InstructionCache::find()
+{
+  hash = get_hash();
+
+  if (buckets == NULL) { return NULL; }
+
+  InstructionCacheEntry *entry = buckets[hash & (bucket_count - 1)];
+
+  while (entry != NULL)
+  {
+    if (entry->hash == hash &&
+        entry->key_length == ptr &&
+        memcmp(entry->data, buffer, ptr) == 0)
+    {
+      return entry;
+    }
+
+    entry = entry->next;
+  }
+
+  return NULL;
+}
+
+// Keep the tokens recorded since begin() (find() has to be called first)
+// with the bytes they were assembled to at address.
+void InstructionCache::add(
+  uint32_t address,
+  const uint8_t *bytes,
+  int length,
+  int ret)
+{
+  if (length > INSTRUCTION_CACHE_MAX_BYTES || ptr > 0xffff) { return; }
+
+  const int size =
+    (sizeof(InstructionCacheEntry) + ptr + length + 7) & ~7;
+
+  if (size > INSTRUCTION_CACHE_HEAP_SIZE) { return; }
+
+  if (last_pool == NULL || last_pool->ptr + size > last_pool->len)
+  {
+    last_pool = memory_pool_add(&heap, INSTRUCTION_CACHE_HEAP_SIZE);
+  }
+
+  if (count >= bucket_count)
+  {
+    grow();
+  }
+
+  InstructionCacheEntry *entry =
+    (InstructionCacheEntry *)(last_pool->buffer + last_pool->ptr);
+
+  const int n = hash & (bucket_count - 1);
+
+  entry->next = buckets[n];
+  entry->hash = hash;
+  entry->address = address;
+  entry->ret = ret;
+  entry->key_length = ptr;
+  entry->length = length;
+  entry->state = INSTRUCTION_CACHE_NEW;
+  memcpy(entry->data, buffer, ptr);
+  memcpy(entry->data + ptr, bytes, length);
+
+  buckets[n] = entry;
+  last_pool->ptr += size;
+  count++;
+}
+
+void InstructionCache::grow()
+{
+  const int old_count = bucket_count;
+  InstructionCacheEntry **old_buckets = buckets;
+
+  bucket_count = bucket_count == 0 ? 1024 : bucket_count * 4;
+  buckets =
+    (InstructionCacheEntry **)calloc(bucket_count, sizeof(*buckets));
+
+  for (int n = 0; n < old_count; n++)
+  {
+    InstructionCacheEntry *entry = old_buckets[n];
+
+    while (entry != NULL)
+    {
+      InstructionCacheEntry *next = entry->next;
+      const int b = entry->hash & (bucket_count - 1);
+
+      entry->next = buckets[b];
+      buckets[b] = entry;
+      entry = next;
+    }
+  }
+
+  free(old_buckets);
+}
+
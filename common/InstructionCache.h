@@ -0,0 +1,117 @@
+/**
+ *  naken_asm assembler.
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: https://www.mikekohn.net/
+ * License: GPLv3
+ *
+ * Copyright 2010-2025 by Michael Kohn
+ *
+ */
+
+#ifndef NAKEN_ASM_INSTRUCTION_CACHE_H
+#define NAKEN_ASM_INSTRUCTION_CACHE_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "common/MemoryPool.h"
+
+#define INSTRUCTION_CACHE_HEAP_SIZE 65536
+#define INSTRUCTION_CACHE_MAX_BYTES 64
+
+enum
+{
+  INSTRUCTION_CACHE_NEW,
+  INSTRUCTION_CACHE_SAME,
+  INSTRUCTION_CACHE_ADDRESS
+};
+
+// An instruction's tokens (the key) and the bytes it was assembled to.
+// Only an instruction that came out the same at two different addresses
+// (INSTRUCTION_CACHE_SAME) is reused.  One that didn't depends on where
+// it is (a branch to a number for example) and is always assembled.
+struct InstructionCacheEntry
+{
+  InstructionCacheEntry *next;
+  uint32_t hash;
+  uint32_t address;
+  int ret;
+  uint16_t key_length;
+  uint8_t length;
+  uint8_t state;
+  uint8_t data[];   // key followed by the bytes
+
+  const uint8_t *get_bytes() const { return data + key_length; }
+};
+
+// The CPU settings an instruction was assembled with.  This is the start
+// of every key so the same text with another CPU or mode is another entry.
+struct InstructionCacheMode
+{
+  int cpu_list_index;
+  uint32_t flags;
+  int extra_context;
+  uint8_t pass;
+  uint8_t endian;
+  uint8_t segment;
+  uint8_t optimize;
+};
+
+// Instructions that come out of a macro with the same text, for example
+// in unrolled loops, are assembled once and the bytes are copied after
+// that.  The mode, the instruction name and the operand tokens are
+// recorded into a buffer that is the key, and on a miss the operands are
+// what parse_instruction() reads through tokens.replay_ptr.  Entries only
+// last for one pass.
+class InstructionCache
+{
+public:
+  InstructionCache();
+  ~InstructionCache();
+
+  void clear();
+  void clear_stats() { hits = 0; misses = 0; }
+
+  void begin(const InstructionCacheMode &mode, const char *instr);
+
+  void record(
+    int type,
+    const char *text,
+    int length,
+    bool has_value,
+    int64_t value);
+
+  const uint8_t *get_tokens() { return buffer + operands; }
+  const uint8_t *get_end()    { return buffer + ptr; }
+
+  InstructionCacheEntry *find();
+
+  void add(uint32_t address, const uint8_t *bytes, int length, int ret);
+
+  void hit()  { hits++; }
+  void miss() { misses++; }
+
+  int get_hits()   { return hits; }
+  int get_misses() { return misses; }
+
+private:
+  uint32_t get_hash();
+  void grow();
+
+  NakenHeap heap;
+  MemoryPool *last_pool;
+  InstructionCacheEntry **buckets;
+  int bucket_count;
+  int count;
+  uint8_t *buffer;
+  int ptr;
+  int alloc;
+  int operands;
+  uint32_t hash;
+  int hits;
+  int misses;
+};
+
+#endif
+
@@ -16,14 +16,22 @@
 #include "common/assembler.h"
 #include "common/Macros.h"
 #include "common/MemoryPool.h"
+#include "common/hash.h"
 #include "common/tokens.h"
+#include "common/Vector.h"
 
 Macros::Macros() :
   memory_pool (NULL),
   locked      (0),
-  stack_ptr   (0)
+  stack_ptr   (0),
+  hash_table  (NULL),
+  hash_size   (0),
+  entry_count (0),
+  arena       (NULL),
+  arena_pool  (NULL)
 {
   memset(stack, 0, sizeof(stack));
+  memset(arena_mark, 0, sizeof(arena_mark));
 }
 
 Macros::~Macros()
@@ -36,6 +44,137 @@ void Macros::reset()
   memory_pool_free(memory_pool);
   memory_pool = NULL;
   stack_ptr = 0;
+
+  free(hash_table);
+  hash_table = NULL;
+  hash_size = 0;
+  entry_count = 0;
+
+  memory_pool_free(arena);
+  arena = NULL;
+  arena_pool = NULL;
+  memset(arena_mark, 0, sizeof(arena_mark));
+}
+
+MacroData *Macros::find(const char *name)
+{
+  if (hash_table == NULL) { return NULL; }
+
+  uint32_t hash = hash_string(name);
+  uint32_t mask = hash_size - 1;
+  uint32_t index = hash & mask;
+
+  while (hash_table[index] != NULL)
+  {
+    MacroData *macro_data = hash_table[index];
+
+    if (macro_data->hash == hash && strcmp(macro_data->data, name) == 0)
+    {
+      return macro_data;
+    }
+
+    index = (index + 1) & mask;
+  }
+
+  return NULL;
+}
+
+void Macros::hash_insert(MacroData *macro_data)
+{
+  uint32_t mask = hash_size - 1;
+  uint32_t index = macro_data->hash & mask;
+
+  while (hash_table[index] != NULL)
+  {
+    index = (index + 1) & mask;
+  }
+
+  hash_table[index] = macro_data;
+}
+
+// Returns -1 and leaves the old index in place if there's no memory.
+int Macros::hash_resize(int size)
+{
+  MacroData **new_table = (MacroData **)calloc(size, sizeof(MacroData *));
+
+  if (new_table == NULL) { return -1; }
+
+  MacroData **old_table = hash_table;
+  int old_size = hash_size;
+
+  hash_table = new_table;
+  hash_size = size;
+
+  for (int i = 0; i < old_size; i++)
+  {
+    if (old_table[i] != NULL) { hash_insert(old_table[i]); }
+  }
+
+  free(old_table);
+
+  return 0;
+}
+
+// Get length bytes from the arena for the next macro pushed on the stack.
+// Returns NULL if the stack is full.
+char *Macros::expand_alloc(int length)
+{
+  if (stack_ptr >= MAX_NESTED_MACROS) { return NULL; }
+
+  ArenaMark &mark = arena_mark[stack_ptr];
+
+  mark.pool = arena_pool;
+  mark.ptr = arena_pool == NULL ? 0 : arena_pool->ptr;
+  mark.used = true;
+
+  if (arena_pool == NULL || arena_pool->ptr + length > arena_pool->len)
+  {
+    MemoryPool *next = arena_pool == NULL ? arena : arena_pool->next;
+
+    // Pools after the current one are free to use again.  If the next
+    // one is too small a bigger one is put in front of it.
+    if (next == NULL || next->len < length)
+    {
+      NakenHeap heap = { NULL };
+      MemoryPool *memory_pool = memory_pool_add(&heap,
+        length > MACROS_ARENA_SIZE ? length : MACROS_ARENA_SIZE);
+
+      memory_pool->next = next;
+
+      if (arena_pool == NULL)
+      {
+        arena = memory_pool;
+      }
+        else
+      {
+        arena_pool->next = memory_pool;
+      }
+
+      next = memory_pool;
+    }
+
+    next->ptr = 0;
+    arena_pool = next;
+  }
+
+  char *buffer = (char *)arena_pool->buffer + arena_pool->ptr;
+  arena_pool->ptr += length;
+
+  return buffer;
+}
+
+void Macros::pop()
+{
+  stack_ptr--;
+
+  ArenaMark &mark = arena_mark[stack_ptr];
+
+  if (mark.used)
+  {
+    arena_pool = mark.pool;
+    if (arena_pool != NULL) { arena_pool->ptr = mark.ptr; }
+    mark.used = false;
+  }
 }
 
 static int get_param_index(char *params, char *name)
@@ -173,16 +312,15 @@ int macros_append(
   Macros *macros = &asm_context->macros;
   MemoryPool *memory_pool = macros->memory_pool;
   uint32_t address;
-  int param_count_temp;
   int name_len;
   int value_len;
 
   if (macros->is_locked()) { return 0; }
 
-  if (macros_lookup(macros, name, &param_count_temp) != NULL ||
+  if (macros->find(name) != NULL ||
       asm_context->symbols.lookup(name, &address) == 0)
   {
-    printf("Error: Macro '%s' already defined.\n", name);
+    fprintf(asm_context->messages, "Error: Macro '%s' already defined.\n", name);
     return -1;
   }
 
@@ -192,35 +330,44 @@ int macros_append(
   // The name of the macro can only be 255 chars
   if (name_len > 255)
   {
-    printf("Error: Macro name '%s' is too big.\n", name);
+    fprintf(asm_context->messages, "Error: Macro name '%s' is too big.\n", name);
     return -1;
   }
 
-  // Check the size of the new macro against the size of a pool.
-  if (name_len + value_len + sizeof(MacroData) > MACROS_HEAP_SIZE)
+  // Keep the index at most half full so probe chains stay short.  If it
+  // can't grow, the old one is used as long as it has an empty slot left.
+  if ((macros->entry_count + 1) * 2 > macros->hash_size &&
+      macros->hash_resize(macros->hash_size == 0 ?
+        MACROS_HASH_START : macros->hash_size * 2) != 0 &&
+      macros->entry_count + 1 >= macros->hash_size)
   {
-    printf("Error: Macro '%s' is too big.\n", name);
+    fprintf(asm_context->messages, "Error: Out of memory for macro '%s'.\n", name);
     return -1;
   }
 
+  const int size = name_len + value_len + sizeof(MacroData);
+
+  // A macro bigger than a pool gets a pool of its own.
+  const int pool_size = size < MACROS_HEAP_SIZE ? MACROS_HEAP_SIZE : size + 1;
+
   // If there is no pool, add one.
   if (memory_pool == NULL)
   {
-    memory_pool = memory_pool_add((NakenHeap *)macros, MACROS_HEAP_SIZE);
+    memory_pool = memory_pool_add((NakenHeap *)macros, pool_size);
   }
 
   // Find a pool that has enough area at the end to add this macro.
   // If none can be found, alloc a new one.
   while (true)
   {
-     if (memory_pool->ptr + name_len + value_len + (int)sizeof(MacroData) < memory_pool->len)
+     if (memory_pool->ptr + size < memory_pool->len)
      {
        break;
      }
 
      if (memory_pool->next == NULL)
      {
-       memory_pool->next = memory_pool_add((NakenHeap *)macros, MACROS_HEAP_SIZE);
+       memory_pool->next = memory_pool_add((NakenHeap *)macros, pool_size);
      }
 
      memory_pool = memory_pool->next;
@@ -233,45 +380,33 @@ int macros_append(
   macro_data->name_len = name_len;
   macro_data->value_len = value_len;
   memcpy(macro_data->data, name, name_len);
+  macro_data->hash = hash_string(name);
   memcpy(macro_data->data + name_len, value, value_len);
-  memory_pool->ptr += name_len + value_len + sizeof(MacroData);
+  memory_pool->ptr += size;
+
+  macros->hash_insert(macro_data);
+  macros->entry_count++;
+
+  asm_context->include_cache.record(name, value, param_count);
 
   return 0;
 }
 
 char *macros_lookup(Macros *macros, char *name, int *param_count)
 {
-  MemoryPool *memory_pool = macros->memory_pool;
-  char *value;
-  int ptr;
-
-  while (memory_pool != NULL)
-  {
-    ptr = 0;
-    while (ptr < memory_pool->ptr)
-    {
-      MacroData *macro_data = (MacroData *)(memory_pool->buffer + ptr);
-      //name_len = strlen((char *)memory_pool->buffer+ptr) + 1;
-      //value_len = strlen((char *)memory_pool->buffer + ptr + name_len) + 1;
-
-      if (strcmp(macro_data->data, name) == 0)
-      {
-        value = macro_data->data + macro_data->name_len;
-        *param_count = macro_data->param_count;
-        return value;
-      }
+  MacroData *macro_data = macros->find(name);
 
-      ptr += macro_data->name_len + macro_data->value_len + sizeof(MacroData);
-    }
+  if (macro_data == NULL) { return NULL; }
 
-    memory_pool = memory_pool->next;
-  }
+  *param_count = macro_data->param_count;
 
-  return NULL;
+  return macro_data->data + macro_data->name_len;
 }
 
-int macros_push_define(Macros *macros, char *define)
+int macros_push_define(AsmContext *asm_context, char *define)
 {
+  Macros *macros = &asm_context->macros;
+
 #ifdef DEBUG
 printf("debug> macros_push_define(), define=%s macros->stack_ptr=%d\n",
   define,
@@ -280,7 +415,7 @@ printf("debug> macros_push_define(), define=%s macros->stack_ptr=%d\n",
 
   if (macros->stack_ptr >= MAX_NESTED_MACROS)
   {
-    printf("Internal Error: defines heap stack exhausted.\n");
+    fprintf(asm_context->messages, "Internal Error: defines heap stack exhausted.\n");
     return -1;
   }
 
@@ -310,21 +445,7 @@ int macros_get_char(AsmContext *asm_context)
     if (ch != 0) { break; }
 
     // drop the #define stack by 1 level
-    if (macros->stack[stack_ptr] >= asm_context->def_param_stack_data &&
-        macros->stack[stack_ptr] < asm_context->def_param_stack_data + PARAM_STACK_LEN)
-    {
-      asm_context->def_param_stack_count--;
-      if (asm_context->def_param_stack_count < 0)
-      {
-        print_error_internal(NULL, __FILE__, __LINE__);
-        exit(1);
-      }
-#ifdef DEBUG
-printf("debug> macros_get_char() asm_context->def_param_stack_count=%d\n",
-  asm_context->def_param_stack_count);
-#endif
-    }
-    macros->stack_ptr--;
+    macros->pop();
     asm_context->tokens.unget_stack_ptr--;
 
     // Check if something need to be ungetted
@@ -363,9 +484,10 @@ int macros_parse(AsmContext *asm_context, int macro_type)
 {
   char name[128];
   char token[TOKENLEN];
-  char params[1024];
-  char *name_test;
-  char macro[MAX_MACRO_LEN];
+  Vector<char> params(1024);
+  char *macro;
+  int macro_len = 1024;
+  int name_test;
   int ptr = 0;
   int token_type;
   int ch;
@@ -381,8 +503,6 @@ printf("debug> macros_parse() name=%s parens_flag=%d\n", name, parens);
 #endif
 
   // Now pull any params out.
-  ptr = 0;
-
   if (parens != 0)
   {
     while (true)
@@ -393,7 +513,7 @@ printf("debug> macros_parse() param %s\n", token);
 #endif
       if (token_type != TOKEN_STRING)
       {
-        printf("Error: Expected a param name but got '%s' at %s:%d.\n", token,
+        fprintf(asm_context->messages, "Error: Expected a param name but got '%s' at %s:%d.\n", token,
           asm_context->tokens.filename, asm_context->tokens.line);
         return -1;
       }
@@ -406,16 +526,8 @@ printf("debug> macros_parse() param %s\n", token);
         return -1;
       }
 
-      int len = strlen(token);
-
-      if (ptr + len + 2 > 1024)
-      {
-        print_error(asm_context, "Error: Macro with too long parameter list");
-        return -1;
-      }
-
-      strcpy(params + ptr, token);
-      ptr = ptr + len + 1;
+      for (int n = 0; token[n] != 0; n++) { params.append(token[n]); }
+      params.append(0);
 
       token_type = tokens_get(asm_context, token, TOKENLEN);
 
@@ -434,7 +546,7 @@ printf("debug> macros_parse() param %s\n", token);
     }
   }
 
-  params[ptr] = 0;
+  params.append(0);
 
   if (macro_type != IS_DEFINE)
   {
@@ -456,8 +568,9 @@ printf("debug> macros_parse() param count=%d\n", param_count);
 #endif
 
   // Now macro time.
+  macro = (char *)malloc(macro_len);
   ptr = 0;
-  name_test = NULL;
+  name_test = -1;
 
   while (true)
   {
@@ -466,36 +579,36 @@ printf("debug> macros_parse() param count=%d\n", param_count);
     // Tabs :(.
     if (ch == '\t') { ch = ' '; }
 
-    if (name_test == NULL)
+    if (name_test == -1)
     {
       if (Macros::is_letter(ch))
       {
-        name_test = macro + ptr;
+        name_test = ptr;
       }
     }
       else
     if (!(Macros::is_letter(ch) || Macros::is_digit(ch) || ch == '_'))
     {
-      if (name_test != NULL)
+      if (name_test != -1)
       {
         macro[ptr] = 0;
 
-        int index = get_param_index(params,name_test);
+        int index = get_param_index(&params[0], macro + name_test);
 
 #ifdef DEBUG
-printf("debug> macros_parse() name_test='%s' %d\n", name_test, index);
+printf("debug> macros_parse() name_test='%s' %d\n", macro + name_test, index);
 #endif
 
         if (index != 0)
         {
-          ptr = name_test - macro;
+          ptr = name_test;
 
           // A paramter in the macro text is chr(1), index
           macro[ptr++] = 1;
           macro[ptr++] = index;
         }
 
-        name_test = NULL;
+        name_test = -1;
       }
     }
 
@@ -503,7 +616,7 @@ printf("debug> macros_parse() name_test='%s' %d\n", name_test, index);
     // of the line.
     if (ch == ';' || (ptr > 0 && ch == '/' && macro[ptr-1] == '/'))
     {
-      if (macro[ptr-1] == '/') { ptr--; }
+      if (ptr > 0 && macro[ptr-1] == '/') { ptr--; }
 
       while (true)
       {
@@ -535,6 +648,7 @@ printf("debug> macros_parse() name_test='%s' %d\n", name_test, index);
         if (ch != '\n')
         {
           print_error(asm_context, "Error: Expected end-of_line");
+          free(macro);
           return -1;
         }
 
@@ -568,13 +682,10 @@ printf("debug> macros_parse() name_test='%s' %d\n", name_test, index);
 
     macro[ptr++] = ch;
 
-    if (ptr >= MAX_MACRO_LEN - 2)
+    if (ptr >= macro_len - 2)
     {
-      printf("Internal error: macro longer than %d bytes on line %d\n",
-        MAX_MACRO_LEN,
-        asm_context->tokens.line);
-
-      return -1;
+      macro_len *= 2;
+      macro = (char *)realloc(macro, macro_len);
     }
   }
 
@@ -591,18 +702,23 @@ printf("debug> Adding macro '%s'\n", macro);
 
   macros_append(asm_context, name, macro, param_count);
 
+  free(macro);
+
   return 0;
 }
 
+// Read the params of a macro from the source and return the macro with
+// them put in.  The text of the macro is copied in spans between params
+// into space from the arena, which is given back when macros_get_char()
+// is done with it.
 char *macros_expand_params(
   AsmContext *asm_context,
   char *define,
   int param_count)
 {
   int ch;
-  char params[1024];
-  int params_ptr[256];
-  int count, ptr;
+  Vector<char> params(1024);
+  Vector<int> params_ptr;
   uint8_t in_string = 0;
   uint8_t in_ticks = 0;
   uint8_t open_parens = 0;
@@ -622,9 +738,7 @@ char *macros_expand_params(
     return NULL;
   }
 
-  count = 0;
-  ptr = 0;
-  params_ptr[count] = ptr;
+  params_ptr.append(0);
 
   while (true)
   {
@@ -634,13 +748,14 @@ char *macros_expand_params(
     if (ch == '\r') { continue; }
 
     // skip whitespace immediately after opening parenthesis or a comma
-    if ((ch == ' ' || ch == '\t') && (ptr == 0 || params[ptr - 1] == 0)) { continue; }
+    if ((ch == ' ' || ch == '\t') &&
+        (params.empty() || params.last() == 0)) { continue; }
 
     if (ch == '\\' && (in_string || in_ticks))
     {
-      params[ptr++] = ch;
+      params.append(ch);
       ch = tokens_get_char(asm_context);
-      params[ptr++] = ch;
+      params.append(ch);
       continue;
     }
 
@@ -660,23 +775,24 @@ char *macros_expand_params(
 
     if (ch == ',' && !in_string && !in_ticks && open_parens == 0)
     {
-      params[ptr++] = 0;
-      params_ptr[++count] = ptr;
+      params.append(0);
+      params_ptr.append(params.count());
       continue;
     }
 
     if (ch == '(' && !in_string && !in_ticks) { open_parens++; }
     if (ch == ')' && !in_string && !in_ticks) { open_parens--; }
 
-    params[ptr++] = ch;
+    params.append(ch);
   }
 
-  params[ptr++] = 0;
-  count++;
+  params.append(0);
+
+  const int count = params_ptr.count();
 
   if (count != param_count)
   {
-    printf("Error: Macro expects %d params, but got only %d at %s:%d.\n",
+    fprintf(asm_context->messages, "Error: Macro expects %d params, but got only %d at %s:%d.\n",
       param_count, count, asm_context->tokens.filename, asm_context->tokens.line);
     return NULL;
   }
@@ -687,51 +803,66 @@ printf("debug> macros_expand_params() with params: pass=%d\n",
 
 for (int n = 0; n < count; n++)
 {
-  printf("debug>   %s\n", params + params_ptr[n]);
+  printf("debug>   %s\n", &params[params_ptr[n]]);
 }
 #endif
 
-  ptr = asm_context->def_param_stack_ptr[asm_context->def_param_stack_count];
+  int params_len[256];
 
-  while (*define != 0)
+  for (int n = 0; n < count; n++)
   {
-    if (*define == 1)
-    {
-      define++;
+    params_len[n] = strlen(&params[params_ptr[n]]);
+  }
 
-      strcpy(asm_context->def_param_stack_data + ptr, params + params_ptr[((int)*define) - 1]);
+  // Find out how big the expanded macro will be.
+  int length = 1;
+  const char *s = define;
 
-      while (*(asm_context->def_param_stack_data + ptr) != 0) { ptr++; }
-    }
-    else
-    {
-      asm_context->def_param_stack_data[ptr++] = *define;
-    }
+  while (true)
+  {
+    const char *slot = strchr(s, 1);
 
-    if (ptr >= PARAM_STACK_LEN)
-    {
-      print_error_internal(NULL, __FILE__, __LINE__);
-      exit(1);
-    }
+    if (slot == NULL) { length += strlen(s); break; }
 
-    define++;
+    length += (slot - s) + params_len[(uint8_t)slot[1] - 1];
+    s = slot + 2;
   }
 
-#ifdef DEBUG
-printf("debug>   ptr=%d\n", ptr);
-#endif
+  char *expanded = asm_context->macros.expand_alloc(length);
+
+  if (expanded == NULL)
+  {
+    fprintf(asm_context->messages, "Internal Error: defines heap stack exhausted.\n");
+    return NULL;
+  }
+
+  char *out = expanded;
+  s = define;
+
+  while (true)
+  {
+    const char *slot = strchr(s, 1);
+    const int len = slot == NULL ? strlen(s) : slot - s;
+
+    memcpy(out, s, len);
+    out += len;
+
+    if (slot == NULL) { break; }
+
+    const int index = (uint8_t)slot[1] - 1;
 
-  asm_context->def_param_stack_data[ptr++] = 0;
+    memcpy(out, &params[params_ptr[index]], params_len[index]);
+    out += params_len[index];
+    s = slot + 2;
+  }
+
+  *out = 0;
 
 #ifdef DEBUG
-printf("debug> Expanded macro becomes: %s\n",
-  asm_context->def_param_stack_data + asm_context->def_param_stack_ptr[asm_context->def_param_stack_count]);
+printf("debug> Expanded macro becomes: %s\n", expanded);
 #endif
 
-  asm_context->def_param_stack_ptr[++asm_context->def_param_stack_count] = ptr;
-
-  return asm_context->def_param_stack_data +
-         asm_context->def_param_stack_ptr[asm_context->def_param_stack_count - 1];
+  return expanded;
 }
 
 void macros_strip_comment(AsmContext *asm_context)
@@ -775,7 +906,10 @@ int MacrosIter::next()
       return 0;
     }
 
+    // ptr is an offset into the current pool, so start over at the
+    // beginning of the next one.
     memory_pool = memory_pool->next;
+    ptr = 0;
   }
 
   is_done = true;
@@ -815,7 +949,7 @@ int Macros::dump(FILE *out)
       if (*value == 1)
       {
         value++;
-        fprintf(out, "{%d}", *value);
+        fprintf(out, "{%d}", (uint8_t)*value);
       }
       else
       {
@@ -20,9 +20,9 @@
 //struct AsmContext;
 
 #define MAX_NESTED_MACROS 128
-#define MAX_MACRO_LEN 1024
 #define MACROS_HEAP_SIZE 32768
-#define MAX_MACRO_LEN 1024
+#define MACROS_ARENA_SIZE 16384
+#define MACROS_HASH_START 1024
 #define CHAR_EOF -1
 #define IS_DEFINE 1
 #define IS_MACRO 0
@@ -32,16 +32,17 @@
   struct
   {
     char name[];
-    unsigned char value[];  // params are binary 0x01 to 0x09
+    unsigned char value[];  // a param is binary 0x01 followed by its index
     int param_count;
   };
 */
 
 struct MacroData
 {
-  int8_t param_count; // number of macro parameters
-  int8_t name_len;    // length of the macro name
-  int16_t value_len;  // length of the macro
+  uint8_t param_count; // number of macro parameters
+  uint8_t name_len;    // length of the macro name
+  int32_t value_len;   // length of the macro
+  uint32_t hash;      // hash_string() of name
   char data[];        // name[], value[]
 };
 
@@ -58,6 +59,13 @@ public:
 
   int dump(FILE *out);
 
+  MacroData *find(const char *name);
+  void hash_insert(MacroData *macro_data);
+  int hash_resize(int size);
+
+  char *expand_alloc(int length);
+  void pop();
+
 //private:
   static bool is_letter(char ch)
   {
@@ -85,10 +93,32 @@ public:
     return ch;
   }
 
+  // memory_pool must be first since this is passed as a NakenHeap.
   MemoryPool *memory_pool;
   int locked;
   int stack_ptr;
   char *stack[MAX_NESTED_MACROS];
+
+  // Open addressed index by name into the MacroData records in
+  // memory_pool.  MacrosIter still walks memory_pool in order.
+  MacroData **hash_table;
+  int hash_size;
+  int entry_count;
+
+  // A macro with params is expanded into arena.  Expansions are pushed
+  // and popped in stack order, so each level remembers where the arena
+  // was before its expansion and popping it gives the space back.  Once
+  // a line is done with its macros the arena is empty again.
+  struct ArenaMark
+  {
+    MemoryPool *pool;
+    int ptr;
+    bool used;
+  };
+
+  MemoryPool *arena;
+  MemoryPool *arena_pool;
+  ArenaMark arena_mark[MAX_NESTED_MACROS];
 };
 
 class MacrosIter
@@ -120,7 +150,7 @@ public:
 int macros_append(AsmContext *asm_context, char *name, char *value, int param_count);
 char *macros_lookup(Macros *macros, char *name, int *param_count);
 //int macros_iterate(Macros *macros, MacrosIter *iter);
-int macros_push_define(Macros *macros, char *define);
+int macros_push_define(AsmContext *asm_context, char *define);
 int macros_get_char(AsmContext *asm_context);
 void macros_strip(char *macro);
 int macros_parse(AsmContext *asm_context, int is_define);
@@ -21,8 +21,12 @@ Memory::Memory() :
   low_address  (0xffffffff),
   high_address (0),
   entry_point  (0xffffffff),
-  endian       (ENDIAN_LITTLE)
+  endian       (ENDIAN_LITTLE),
+  debug_lines  (false),
+  pages_last   (NULL),
+  last_page    (NULL)
 {
+  memset(directory, 0, sizeof(directory));
 }
 
 Memory::~Memory()
@@ -37,51 +41,40 @@ Memory::~Memory()
   }
 
   pages = NULL;
-}
-
-void Memory::clear()
-{
-  MemoryPage *page = pages;
 
-  while (page != NULL)
+  for (int n = 0; n < PAGE_DIRECTORY_SIZE; n++)
   {
-    MemoryPage *next = page->next;
-    memset(page->bin, 0, PAGE_SIZE);
-    page->offset_min = PAGE_SIZE;
-    page->offset_max = 0;
-    page = next;
+    free(directory[n]);
   }
 }
 
-bool Memory::in_use(uint32_t address)
+void Memory::clear()
 {
   MemoryPage *page = pages;
 
   while (page != NULL)
   {
-    if (address >= page->address && address < page->address + PAGE_SIZE)
-    {
-      return true;
-    }
-
+    page->clear();
     page = page->next;
   }
 
-  return false;
+  low_address = 0xffffffff;
+  high_address = 0;
+  entry_point = 0xffffffff;
+}
+
+bool Memory::in_use(uint32_t address)
+{
+  return find_page(address) != NULL;
 }
 
 uint32_t Memory::get_page_address_min(uint32_t address)
 {
-  MemoryPage *page = pages;
+  MemoryPage *page = find_page(address);
 
-  while (page != NULL)
+  if (page != NULL)
   {
-    if (address >= page->address && address < page->address + PAGE_SIZE)
-    {
-      return page->address + page->offset_min;
-    }
-
-    page = page->next;
+    return page->address + page->offset_min;
   }
 
   print_error_internal(NULL, __FILE__, __LINE__);
@@ -91,16 +84,11 @@ uint32_t Memory::get_page_address_min(uint32_t address)
 
 uint32_t Memory::get_page_address_max(uint32_t address)
 {
-  MemoryPage *page = pages;
+  MemoryPage *page = find_page(address);
 
-  while (page != NULL)
+  if (page != NULL)
   {
-    if (address >= page->address && address < page->address + PAGE_SIZE)
-    {
-      return page->address + page->offset_max;
-    }
-
-    page = page->next;
+    return page->address + page->offset_max;
   }
 
   print_error_internal(NULL, __FILE__, __LINE__);
@@ -110,23 +98,32 @@ uint32_t Memory::get_page_address_max(uint32_t address)
 
 uint8_t Memory::read8(uint32_t address)
 {
-  MemoryPage *page = pages;
+  MemoryPage *page = find_page(address);
 
-  while (page != NULL)
-  {
-    if (address >= page->address && address < page->address + PAGE_SIZE)
-    {
-      return page->bin[address-page->address];
-    }
+  if (page == NULL) { return 0; }
 
-    page = page->next;
-  }
-
-  return 0;
+  return page->bin[address - page->address];
 }
 
 uint16_t Memory::read16(uint32_t address)
 {
+  MemoryPage *page = find_page(address);
+
+  // Fast path if both bytes are in the same page.
+  if (page != NULL && address - page->address <= PAGE_SIZE - 2)
+  {
+    const uint8_t *bin = page->bin + (address - page->address);
+
+    if (endian == ENDIAN_LITTLE)
+    {
+      return bin[0] | (bin[1] << 8);
+    }
+      else
+    {
+      return (bin[0] << 8) | bin[1];
+    }
+  }
+
   if (endian == ENDIAN_LITTLE)
   {
     return read8(address) | (read8(address + 1) << 8);
@@ -139,6 +136,23 @@ uint16_t Memory::read16(uint32_t address)
 
 uint32_t Memory::read32(uint32_t address)
 {
+  MemoryPage *page = find_page(address);
+
+  // Fast path if all 4 bytes are in the same page.
+  if (page != NULL && address - page->address <= PAGE_SIZE - 4)
+  {
+    const uint8_t *bin = page->bin + (address - page->address);
+
+    if (endian == ENDIAN_LITTLE)
+    {
+      return bin[0] | (bin[1] << 8) | (bin[2] << 16) | ((uint32_t)bin[3] << 24);
+    }
+      else
+    {
+      return ((uint32_t)bin[0] << 24) | (bin[1] << 16) | (bin[2] << 8) | bin[3];
+    }
+  }
+
   if (endian == ENDIAN_LITTLE)
   {
     return read8(address) |
@@ -157,37 +171,40 @@ uint32_t Memory::read32(uint32_t address)
 
 void Memory::write8(uint32_t address, uint8_t data)
 {
-  if (pages == NULL)
-  {
-    pages = new MemoryPage(address);
-  }
+  MemoryPage *page = get_page(address);
 
-  MemoryPage *page = pages;
+  update_range(address, address);
 
-  while (page != NULL)
+  page->set_data(address, data);
+}
+
+void Memory::write16(uint32_t address, uint16_t data)
+{
+  uint32_t offset = address % PAGE_SIZE;
+
+  // Fast path if both bytes are in the same page.
+  if (offset <= PAGE_SIZE - 2)
   {
-    if (address >= page->address &&
-        address < (uint64_t)page->address + PAGE_SIZE)
+    MemoryPage *page = get_page(address);
+    uint8_t *bin = page->bin + offset;
+
+    update_range(address, address + 1);
+    page->update_offsets(offset, offset + 1);
+
+    if (endian == ENDIAN_LITTLE)
     {
-      break;
+      bin[0] = data & 0xff;
+      bin[1] = data >> 8;
     }
-
-    if (page->next == NULL)
+      else
     {
-      page->next = new MemoryPage(address);
+      bin[0] = data >> 8;
+      bin[1] = data & 0xff;
     }
 
-    page = page->next;
+    return;
   }
 
-  if (low_address  > address) { low_address  = address; }
-  if (high_address < address) { high_address = address; }
-
-  page->set_data(address, data);
-}
-
-void Memory::write16(uint32_t address, uint16_t data)
-{
   if (endian == ENDIAN_LITTLE)
   {
     write8(address + 0, data & 0xff);
@@ -202,6 +219,35 @@ void Memory::write16(uint32_t address, uint16_t data)
 
 void Memory::write32(uint32_t address, uint32_t data)
 {
+  uint32_t offset = address % PAGE_SIZE;
+
+  // Fast path if all 4 bytes are in the same page.
+  if (offset <= PAGE_SIZE - 4)
+  {
+    MemoryPage *page = get_page(address);
+    uint8_t *bin = page->bin + offset;
+
+    update_range(address, address + 3);
+    page->update_offsets(offset, offset + 3);
+
+    if (endian == ENDIAN_LITTLE)
+    {
+      bin[0] = data & 0xff;
+      bin[1] = (data >> 8) & 0xff;
+      bin[2] = (data >> 16) & 0xff;
+      bin[3] = (data >> 24) & 0xff;
+    }
+      else
+    {
+      bin[0] = (data >> 24) & 0xff;
+      bin[1] = (data >> 16) & 0xff;
+      bin[2] = (data >> 8) & 0xff;
+      bin[3] = data & 0xff;
+    }
+
+    return;
+  }
+
   if (endian == ENDIAN_LITTLE)
   {
     write8(address + 0, data & 0xff);
@@ -218,79 +264,231 @@ void Memory::write32(uint32_t address, uint32_t data)
   }
 }
 
-int Memory::read_debug(uint32_t address)
+void Memory::read_block(uint32_t address, uint8_t *data, uint32_t length)
 {
-  MemoryPage *page = pages;
-
-  while (page != NULL)
+  while (length > 0)
   {
-    if (address >= page->address && address < page->address + PAGE_SIZE)
+    uint32_t offset = address % PAGE_SIZE;
+    uint32_t count = PAGE_SIZE - offset;
+
+    if (count > length) { count = length; }
+
+    MemoryPage *page = find_page(address);
+
+    if (page == NULL)
+    {
+      memset(data, 0, count);
+    }
+      else
     {
-      return page->debug_line[address-page->address];
+      memcpy(data, page->bin + offset, count);
     }
 
-    page = page->next;
+    address += count;
+    data += count;
+    length -= count;
   }
+}
 
-  return -1;
+void Memory::write_block(uint32_t address, const uint8_t *data, uint32_t length)
+{
+  while (length > 0)
+  {
+    uint32_t offset = address % PAGE_SIZE;
+    uint32_t count = PAGE_SIZE - offset;
+
+    if (count > length) { count = length; }
+
+    MemoryPage *page = get_page(address);
+
+    memcpy(page->bin + offset, data, count);
+    page->update_offsets(offset, offset + count - 1);
+    update_range(address, address + count - 1);
+
+    address += count;
+    data += count;
+    length -= count;
+  }
 }
 
-void Memory::write_debug(uint32_t address, int line)
+void Memory::write_block(
+  uint32_t address,
+  const uint8_t *data,
+  uint32_t length,
+  int line)
 {
-  if (pages == NULL)
+  while (length > 0)
   {
-    pages = new MemoryPage(address);
+    uint32_t offset = address % PAGE_SIZE;
+    uint32_t count = PAGE_SIZE - offset;
+
+    if (count > length) { count = length; }
+
+    MemoryPage *page = get_page(address);
+
+    memcpy(page->bin + offset, data, count);
+    page->set_debug_range(offset, count, line, debug_lines);
+    update_range(address, address + count - 1);
+
+    address += count;
+    data += count;
+    length -= count;
   }
+}
 
-  MemoryPage *page = pages;
+void Memory::fill(uint32_t address, uint8_t value, uint32_t length, int line)
+{
+  while (length > 0)
+  {
+    uint32_t offset = address % PAGE_SIZE;
+    uint32_t count = PAGE_SIZE - offset;
 
-  while (page != NULL)
+    if (count > length) { count = length; }
+
+    MemoryPage *page = get_page(address);
+
+    memset(page->bin + offset, value, count);
+    page->set_debug_range(offset, count, line, debug_lines);
+    update_range(address, address + count - 1);
+
+    address += count;
+    length -= count;
+  }
+}
+
+void Memory::erase(uint32_t address, uint32_t length)
+{
+  while (length > 0)
   {
-    if (address >= page->address && address < page->address + PAGE_SIZE)
-    {
-      break;
-    }
+    uint32_t offset = address % PAGE_SIZE;
+    uint32_t count = PAGE_SIZE - offset;
+
+    if (count > length) { count = length; }
+
+    MemoryPage *page = find_page(address);
 
-    if (page->next == NULL)
+    if (page != NULL)
     {
-      page->next = new MemoryPage(address);
+      memset(page->bin + offset, 0, count);
+      page->set_debug_range(offset, count, DL_EMPTY);
     }
 
-    page = page->next;
+    address += count;
+    length -= count;
   }
-
-  page->set_debug(address, line);
 }
 
-void Memory::write(uint32_t address, uint8_t data, int line)
+int Memory::next_span(MemorySpan *span)
 {
-  if (pages == NULL)
-  {
-    pages = new MemoryPage(address);
-  }
+  if (span->end_flag) { return -1; }
 
-  MemoryPage *page = pages;
+  uint64_t address = (uint64_t)span->address + span->length;
 
-  while (page != NULL)
+  while (address <= 0xffffffff)
   {
-    if (address >= page->address && address < page->address + PAGE_SIZE)
+    MemoryPage *page = next_page(address);
+
+    if (page == NULL) { break; }
+
+    if (page->address > address) { address = page->address; }
+
+    uint32_t start, length;
+
+    if (!page->find_used(address - page->address, &start, &length))
     {
-      break;
+      address = (uint64_t)page->address + PAGE_SIZE;
+      continue;
     }
 
-    if (page->next == NULL)
+    uint64_t end = (uint64_t)page->address + start + length;
+
+    span->address = page->address + start;
+
+    // If the run goes to the end of the page, keep going into the
+    // next page.
+    while (end == (uint64_t)page->address + PAGE_SIZE && end <= 0xffffffff)
     {
-      page->next = new MemoryPage(address);
+      page = find_page(end);
+
+      if (page == NULL || !page->find_used(0, &start, &length) || start != 0)
+      {
+        break;
+      }
+
+      end += length;
     }
 
-    page = page->next;
+    if (end - span->address > 0xffffffff) { end = span->address + 0xffffffffULL; }
+
+    span->length = end - span->address;
+
+    return 0;
   }
 
-  if (low_address  > address) { low_address  = address; }
-  if (high_address < address) { high_address = address; }
+  span->end_flag = true;
+
+  return -1;
+}
+
+int Memory::read_debug(uint32_t address)
+{
+  MemoryPage *page = find_page(address);
+
+  if (page == NULL) { return DL_EMPTY; }
+
+  return page->get_debug(address);
+}
+
+void Memory::write_debug(uint32_t address, int line)
+{
+  MemoryPage *page = get_page(address);
+
+  page->set_debug(address, line, debug_lines);
+}
+
+void Memory::write(uint32_t address, uint8_t data, int line)
+{
+  MemoryPage *page = get_page(address);
+
+  update_range(address, address);
 
   page->set_data(address, data);
-  page->set_debug(address, line);
+  page->set_debug(address, line, debug_lines);
+}
+
+MemoryPage *Memory::get_page(uint32_t address)
+{
+  MemoryPage *page = find_page(address);
+
+  if (page != NULL) { return page; }
+
+  const uint32_t index = address / PAGE_SIZE;
+  MemoryPage **table = directory[index / PAGE_TABLE_SIZE];
+
+  if (table == NULL)
+  {
+    table = (MemoryPage **)calloc(PAGE_TABLE_SIZE, sizeof(MemoryPage *));
+    directory[index / PAGE_TABLE_SIZE] = table;
+  }
+
+  page = new MemoryPage(address);
+  table[index % PAGE_TABLE_SIZE] = page;
+
+  // Append to the end of the list to keep the same order as before.
+  if (pages == NULL)
+  {
+    pages = page;
+  }
+    else
+  {
+    pages_last->next = page;
+  }
+
+  pages_last = page;
+
+  last_page = page;
+
+  return page;
 }
 
 #if 0
@@ -327,3 +525,256 @@ void Memory::dump()
   }
 }
 
+MemoryPage *Memory::next_page(uint32_t address)
+{
+  uint64_t index = address / PAGE_SIZE;
+
+  while (index < PAGE_COUNT)
+  {
+    MemoryPage **table = directory[index / PAGE_TABLE_SIZE];
+
+    if (table == NULL)
+    {
+      index = (index / PAGE_TABLE_SIZE + 1) * PAGE_TABLE_SIZE;
+      continue;
+    }
+
+    if (table[index % PAGE_TABLE_SIZE] != NULL)
+    {
+      return table[index % PAGE_TABLE_SIZE];
+    }
+
+    index++;
+  }
+
+  return NULL;
+}
+
+bool MemoryPage::find_used(uint32_t offset, uint32_t *start, uint32_t *length)
+{
+  uint64_t word;
+
+  // Skip unused bytes, 64 at a time when possible.
+  while (offset < PAGE_SIZE)
+  {
+    if ((offset & 63) == 0)
+    {
+      memcpy(&word, used + (offset >> 3), sizeof(word));
+      if (word == 0) { offset += 64; continue; }
+    }
+
+    if (is_used(offset)) { break; }
+
+    offset++;
+  }
+
+  if (offset >= PAGE_SIZE) { return false; }
+
+  uint32_t end = offset;
+
+  while (end < PAGE_SIZE)
+  {
+    if ((end & 63) == 0)
+    {
+      memcpy(&word, used + (end >> 3), sizeof(word));
+      if (word == 0xffffffffffffffffULL) { end += 64; continue; }
+    }
+
+    if (!is_used(end)) { break; }
+
+    end++;
+  }
+
+  *start = offset;
+  *length = end - offset;
+
+  return true;
+}
+
+void MemoryPage::set_lines(uint32_t offset, uint32_t length, int line)
+{
+  // Fast path when this goes after everything else in the page.
+  uint32_t end = 0;
+
+  if (run_count != 0)
+  {
+    end = runs[run_count - 1].offset + runs[run_count - 1].length;
+  }
+
+  if (run_count == 0 || offset >= end)
+  {
+    if (run_count != 0 && offset == end && runs[run_count - 1].line == line)
+    {
+      runs[run_count - 1].length += length;
+    }
+      else
+    {
+      insert_run(run_count, offset, length, line);
+    }
+
+    return;
+  }
+
+  for (uint32_t n = 0; n < length; n++)
+  {
+    set_line(offset + n, line);
+  }
+}
+
+void MemoryPage::set_line(uint32_t offset, int line)
+{
+  // Most writes are in order so they extend or follow the last run.
+  if (run_count == 0)
+  {
+    insert_run(0, offset, 1, line);
+    return;
+  }
+
+  DebugRun *last = &runs[run_count - 1];
+  uint32_t end = last->offset + last->length;
+
+  if (offset == end && last->line == line)
+  {
+    last->length++;
+    return;
+  }
+
+  if (offset >= end)
+  {
+    insert_run(run_count, offset, 1, line);
+    return;
+  }
+
+  // This is overwriting or filling in an earlier part of the page
+  // (pass 2 will rewrite everything pass 1 wrote).
+  int index = find_run(offset);
+  DebugRun *run = &runs[index];
+
+  if (offset < run->offset)
+  {
+    // Offset is in the gap before this run.
+    insert_run(index, offset, 1, line);
+    merge_runs(index);
+    return;
+  }
+
+  if (run->line == line) { return; }
+
+  if (run->length == 1)
+  {
+    run->line = line;
+    merge_runs(index);
+    return;
+  }
+
+  if (offset == run->offset)
+  {
+    run->offset++;
+    run->length--;
+
+    insert_run(index, offset, 1, line);
+    merge_runs(index);
+    return;
+  }
+
+  if (offset == run->offset + run->length - 1)
+  {
+    run->length--;
+
+    insert_run(index + 1, offset, 1, line);
+    merge_runs(index + 1);
+    return;
+  }
+
+  // Split the run in 3.
+  uint32_t run_end = run->offset + run->length;
+  int run_line = run->line;
+
+  run->length = offset - run->offset;
+
+  insert_run(index + 1, offset, 1, line);
+  insert_run(index + 2, offset + 1, run_end - (offset + 1), run_line);
+}
+
+int MemoryPage::get_line(uint32_t offset)
+{
+  if (run_count == 0) { return DL_NO_CG; }
+
+  int index = find_run(offset);
+
+  if (index == run_count || offset < runs[index].offset) { return DL_NO_CG; }
+
+  return runs[index].line;
+}
+
+int MemoryPage::find_run(uint32_t offset)
+{
+  // Binary search for the first run that ends after offset.
+  int low = 0;
+  int high = run_count;
+
+  while (low < high)
+  {
+    int mid = (low + high) / 2;
+
+    if (runs[mid].offset + runs[mid].length <= offset)
+    {
+      low = mid + 1;
+    }
+      else
+    {
+      high = mid;
+    }
+  }
+
+  return low;
+}
+
+void MemoryPage::insert_run(int index, uint32_t offset, uint32_t length, int line)
+{
+  if (run_count == run_alloc)
+  {
+    run_alloc = run_alloc == 0 ? 64 : run_alloc * 2;
+    runs = (DebugRun *)realloc(runs, run_alloc * sizeof(DebugRun));
+  }
+
+  memmove(runs + index + 1, runs + index, (run_count - index) * sizeof(DebugRun));
+
+  runs[index].offset = offset;
+  runs[index].length = length;
+  runs[index].line = line;
+
+  run_count++;
+}
+
+void MemoryPage::merge_runs(int index)
+{
+  // Merge with the run after this one.
+  if (index + 1 < run_count)
+  {
+    DebugRun *run = &runs[index];
+    DebugRun *next = &runs[index + 1];
+
+    if (run->offset + run->length == next->offset && run->line == next->line)
+    {
+      run->length += next->length;
+      run_count--;
+      memmove(next, next + 1, (run_count - (index + 1)) * sizeof(DebugRun));
+    }
+  }
+
+  // Merge with the run before this one.
+  if (index > 0)
+  {
+    DebugRun *prev = &runs[index - 1];
+    DebugRun *run = &runs[index];
+
+    if (prev->offset + prev->length == run->offset && prev->line == run->line)
+    {
+      prev->length += run->length;
+      run_count--;
+      memmove(run, run + 1, (run_count - index) * sizeof(DebugRun));
+    }
+  }
+}
+
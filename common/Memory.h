@@ -19,9 +19,23 @@
 #define ENDIAN_LITTLE 0
 #define ENDIAN_BIG 1
 
-#define DL_EMPTY -1
-#define DL_DATA -2
-#define DL_NO_CG -3
+// Pages are found through a two level directory indexed by
+// address / PAGE_SIZE so a lookup doesn't depend on how many pages exist.
+#define PAGE_COUNT (0x100000000ULL / PAGE_SIZE)
+#define PAGE_DIRECTORY_SIZE 256
+#define PAGE_TABLE_SIZE (PAGE_COUNT / PAGE_DIRECTORY_SIZE)
+
+// Set of contiguous used (written with a line / DL_ value) addresses.
+// Start with a default MemorySpan and call Memory::next_span() until it
+// returns -1.
+struct MemorySpan
+{
+  MemorySpan() : address (0), length (0), end_flag (false) { }
+
+  uint32_t address;
+  uint32_t length;
+  bool end_flag;
+};
 
 class Memory
 {
@@ -42,17 +56,77 @@ public:
   void write16(uint32_t address, uint16_t data);
   void write32(uint32_t address, uint32_t data);
 
+  void read_block(uint32_t address, uint8_t *data, uint32_t length);
+  void write_block(uint32_t address, const uint8_t *data, uint32_t length);
+  void write_block(
+    uint32_t address,
+    const uint8_t *data,
+    uint32_t length,
+    int line);
+  void fill(uint32_t address, uint8_t value, uint32_t length, int line);
+
+  // Set length bytes back to 0 and mark them as not used.
+  void erase(uint32_t address, uint32_t length);
+
+  // Find the next run of used bytes after the span passed in.
+  int next_span(MemorySpan *span);
+
   int read_debug(uint32_t address);
   void write_debug(uint32_t address, int line);
   void write(uint32_t address, uint8_t data, int line);
 
+  // Without this read_debug() only reports if an address is used
+  // (DL_NO_CG) or not (DL_EMPTY).  Line numbers and DL_DATA are needed
+  // by the listing file.
+  void keep_debug_lines() { debug_lines = true; }
+
   void dump();
 
+  // Pages are kept in the order they were created for clean up.
   MemoryPage *pages;
   uint32_t low_address;
   uint32_t high_address;
   uint32_t entry_point;
   int endian;
+  bool debug_lines;
+
+private:
+  MemoryPage *find_page(uint32_t address)
+  {
+    // Most accesses land in the same page as the one before.  The output
+    // files can be written on threads that all read the same Memory, so
+    // last_page is only a hint that's checked before it's used.
+    MemoryPage *page = __atomic_load_n(&last_page, __ATOMIC_RELAXED);
+
+    if (page != NULL && address - page->address < PAGE_SIZE)
+    {
+      return page;
+    }
+
+    const uint32_t index = address / PAGE_SIZE;
+    MemoryPage **table = directory[index / PAGE_TABLE_SIZE];
+
+    if (table == NULL) { return NULL; }
+
+    page = table[index % PAGE_TABLE_SIZE];
+
+    if (page != NULL) { __atomic_store_n(&last_page, page, __ATOMIC_RELAXED); }
+
+    return page;
+  }
+
+  MemoryPage *get_page(uint32_t address);
+  MemoryPage *next_page(uint32_t address);
+
+  void update_range(uint32_t address_min, uint32_t address_max)
+  {
+    if (low_address  > address_min) { low_address  = address_min; }
+    if (high_address < address_max) { high_address = address_max; }
+  }
+
+  MemoryPage **directory[PAGE_DIRECTORY_SIZE];
+  MemoryPage *pages_last;
+  MemoryPage *last_page;
 };
 
 class AsmContext;
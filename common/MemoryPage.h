@@ -31,6 +31,18 @@
 #define PAGE_SIZE (64 * 1024)
 //#define PAGE_SIZE 2097152
 
+#define DL_EMPTY -1
+#define DL_DATA -2
+#define DL_NO_CG -3
+
+// A run of bytes in a page that came from the same line of source.
+struct DebugRun
+{
+  uint32_t offset;
+  uint32_t length;
+  int line;
+};
+
 class MemoryPage
 {
 public:
@@ -38,56 +50,164 @@ public:
     address    (address),
     offset_min (PAGE_SIZE),
     offset_max (0),
-    next       (NULL)
+    next       (NULL),
+    runs       (NULL),
+    run_count  (0),
+    run_alloc  (0)
   {
-    memset(bin, 0, sizeof(bin));
-    memset(debug_line, -1, sizeof(debug_line));
+    // calloc() so untouched parts of the page never have to be written.
+    bin = (uint8_t *)calloc(PAGE_SIZE + PAGE_SIZE / 8, 1);
+    used = bin + PAGE_SIZE;
 
     this->address = (this->address / PAGE_SIZE) * PAGE_SIZE;
   }
 
   ~MemoryPage()
   {
+    free(bin);
+    free(runs);
+  }
+
+  void clear()
+  {
+    memset(bin, 0, PAGE_SIZE + PAGE_SIZE / 8);
+    offset_min = PAGE_SIZE;
+    offset_max = 0;
+    run_count = 0;
+  }
+
+  void update_offsets(uint32_t min, uint32_t max)
+  {
+    if (min < offset_min) { offset_min = min; }
+    if (max > offset_max) { offset_max = max; }
   }
 
   void set_data(uint32_t address, uint8_t data)
   {
     uint32_t offset = address - this->address;
 
-    if (offset < offset_min) { offset_min = offset; }
-    if (offset > offset_max) { offset_max = offset; }
+    update_offsets(offset, offset);
 
     bin[offset] = data;
   }
 
-  void set_debug(uint32_t address, int value)
+  // If keep_line is false only the fact that the byte is in use is kept.
+  void set_debug(uint32_t address, int value, bool keep_line = true)
+  {
+    uint32_t offset = address - this->address;
+
+    update_offsets(offset, offset);
+
+    if (value == DL_EMPTY)
+    {
+      used[offset >> 3] &= ~(1 << (offset & 7));
+      return;
+    }
+
+    used[offset >> 3] |= 1 << (offset & 7);
+
+    if (keep_line) { set_line(offset, value); }
+  }
+
+  // Same as set_debug() for length bytes starting at offset.
+  void set_debug_range(
+    uint32_t offset,
+    uint32_t length,
+    int value,
+    bool keep_line = true)
+  {
+    update_offsets(offset, offset + length - 1);
+
+    if (value == DL_EMPTY)
+    {
+      for (uint32_t n = offset; n < offset + length; n++)
+      {
+        used[n >> 3] &= ~(1 << (n & 7));
+      }
+
+      return;
+    }
+
+    set_used(offset, length);
+
+    if (keep_line) { set_lines(offset, length, value); }
+  }
+
+  int get_debug(uint32_t address)
   {
     uint32_t offset = address - this->address;
 
-    if (offset < offset_min) { offset_min = offset; }
-    if (offset > offset_max) { offset_max = offset; }
+    if (!is_used(offset)) { return DL_EMPTY; }
 
-    debug_line[offset] = value;
+    return get_line(offset);
   }
 
+  bool is_used(uint32_t offset)
+  {
+    return (used[offset >> 3] & (1 << (offset & 7))) != 0;
+  }
+
+  void set_used(uint32_t offset, uint32_t length)
+  {
+    uint32_t end = offset + length;
+
+    while (offset < end && (offset & 7) != 0)
+    {
+      used[offset >> 3] |= 1 << (offset & 7);
+      offset++;
+    }
+
+    if (end - offset >= 8)
+    {
+      memset(used + (offset >> 3), 0xff, (end - offset) >> 3);
+      offset += (end - offset) & ~7;
+    }
+
+    while (offset < end)
+    {
+      used[offset >> 3] |= 1 << (offset & 7);
+      offset++;
+    }
+  }
+
+  // Find the next used byte at or after offset and how many used bytes
+  // follow it.  Returns false if the rest of the page is unused.
+  bool find_used(uint32_t offset, uint32_t *start, uint32_t *length);
+
   void dump()
   {
     printf("-- MemoryPage --\n");
     printf("     address: 0x%08x\n", address);
     printf("  offset_min: 0x%08x\n", offset_min);
     printf("  offset_max: 0x%08x\n", offset_max);
+    printf("   run_count: %d\n", run_count);
     printf("        next: %p\n", next);
   }
 
   uint32_t address;
   uint32_t offset_min, offset_max;
   MemoryPage *next;
-  uint8_t bin[PAGE_SIZE];
+  uint8_t *bin;
+
+  // One bit per byte of bin[] marking which memory locations have been
+  // written to so the hexfiles only save data for memory locations
+  // that are full.
+  uint8_t *used;
+
+private:
+  void set_line(uint32_t offset, int line);
+  void set_lines(uint32_t offset, uint32_t length, int line);
+  int get_line(uint32_t offset);
+  int find_run(uint32_t offset);
+  void insert_run(int index, uint32_t offset, uint32_t length, int line);
+  void merge_runs(int index);
 
   // debug_line was used to associate a line of code with an address.
-  // It's also used to know which memory locations have been written to
-  // so the hexfiles only save data for memory locations that are full.
-  int debug_line[PAGE_SIZE];
+  // It's now kept as sorted runs of bytes from the same line and only
+  // allocated if Memory was asked to keep line numbers (listing file).
+  DebugRun *runs;
+  int run_count;
+  int run_alloc;
 };
 
 #endif
@@ -16,9 +16,13 @@
 
 #include "common/MemoryPool.h"
 #include "common/Symbols.h"
+#include "common/hash.h"
 
 Symbols::Symbols() :
   memory_pool   (NULL),
+  hash_table    (NULL),
+  hash_size     (0),
+  entry_count   (0),
   locked        (false),
   in_scope      (false),
   debug         (false),
@@ -29,66 +33,50 @@ Symbols::Symbols() :
 Symbols::~Symbols()
 {
   memory_pool_free(memory_pool);
+  free(hash_table);
+}
+
+void Symbols::reset()
+{
+  memory_pool_free(memory_pool);
+  free(hash_table);
+
+  memory_pool = NULL;
+  hash_table = NULL;
+  hash_size = 0;
+  entry_count = 0;
+  locked = false;
+  in_scope = false;
+  current_scope = 0;
+}
+
+// Go back into a scope (0 for global) that was started before.
+void Symbols::set_scope(uint32_t scope)
+{
+  in_scope = scope != 0;
+
+  if (scope != 0) { current_scope = scope; }
 }
 
 Symbols::Entry *Symbols::find(const char *name)
 {
-  MemoryPool *memory_pool = this->memory_pool;
-  int ptr;
+  uint32_t hash = hash_string(name);
+  Entry *entry;
 
   // Check local scope.
   if (in_scope)
   {
-    while (memory_pool != NULL)
-    {
-      ptr = 0;
+    entry = hash_find(name, hash, current_scope);
 
-      while (ptr < memory_pool->ptr)
-      {
-        Entry *entry = (Entry *)(memory_pool->buffer + ptr);
-
-        if (current_scope == entry->scope &&
-            strcmp(entry->name, name) == 0)
-        {
-          return entry;
-        }
-
-        ptr += entry->len + sizeof(Entry);
-      }
-
-      memory_pool = memory_pool->next;
-    }
-
-    memory_pool = this->memory_pool;
+    if (entry != NULL) { return entry; }
   }
 
   // Check global scope.
-  while (memory_pool != NULL)
-  {
-    ptr = 0;
-
-    while (ptr < memory_pool->ptr)
-    {
-      Entry *entry = (Entry *)(memory_pool->buffer + ptr);
-
-      if (entry->scope == 0 && strcmp(entry->name, name) == 0)
-      {
-        return entry;
-      }
-
-      ptr += entry->len + sizeof(Entry);
-    }
-
-    memory_pool = memory_pool->next;
-  }
-
-  return NULL;
+  return hash_find(name, hash, 0);
 }
 
 int Symbols::append(const char *name, uint32_t address)
 {
-  int token_len;
-  MemoryPool *memory_pool = this->memory_pool;
   Entry *entry;
 
 #ifdef DEBUG
@@ -110,57 +98,16 @@ int Symbols::append(const char *name, uint32_t address)
 
     if (in_scope == false || entry->scope == current_scope)
     {
-      printf("Error: Label '%s' already defined.\n", name);
       return -1;
     }
   }
 
-  token_len = strlen(name) + 1;
-
-  // Check if size of new label is bigger than 255.
-  if (token_len > 255)
-  {
-    printf("Error: Label '%s' is too big.\n", name);
-    return -1;
-  }
-
-  // If there is no pool, add one.
-  if (memory_pool == NULL)
-  {
-    memory_pool = memory_pool_add((NakenHeap *)this, SYMBOLS_HEAP_SIZE);
-  }
-
-  // Find a pool that has enough area at the end to add this address.
-  // If none can be found, alloc a new one.
-  while (true)
-  {
-     if (memory_pool->ptr + token_len + (int)sizeof(Entry) < memory_pool->len)
-     {
-       break;
-     }
-
-     if (memory_pool->next == NULL)
-     {
-       memory_pool->next = memory_pool_add((NakenHeap *)this, SYMBOLS_HEAP_SIZE);
-     }
-
-     memory_pool = memory_pool->next;
-  }
-
   // Divide by bytes_per_address (for AVR8 and dsPIC).
   //address = address / asm_context->bytes_per_address;
 
-  // Set the new label/address entry.
-  entry = (Entry *)(memory_pool->buffer + memory_pool->ptr);
-
-  memcpy(entry->name, name, token_len);
-  entry->len = token_len;
-  entry->flag_rw = false;
-  entry->flag_export = false;
-  entry->address = address;
-  entry->scope = in_scope ? current_scope : 0;
+  entry = insert(name, address, in_scope ? current_scope : 0);
 
-  memory_pool->ptr += token_len + sizeof(Entry);
+  if (entry == NULL) { return -2; }
 
   return 0;
 }
@@ -173,13 +120,12 @@ int Symbols::set(const char *name, uint32_t address)
 
   if (entry == NULL)
   {
-    if (append(name, address) != 0)
-    {
-      return -1;
-    }
+    if (locked) { return 0; }
+
+    entry = insert(name, address, 0);
+
+    if (entry == NULL) { return -2; }
 
-    entry = find(name);
-    entry->scope = 0;
     entry->flag_rw = true;
   }
     else
@@ -201,11 +147,7 @@ int Symbols::export_symbol(const char *name)
 
   if (entry == NULL) { return -1; }
 
-  if (entry->scope != 0)
-  {
-    printf("Error: Cannot export local variable '%s'\n", name);
-    return -1;
-  }
+  if (entry->scope != 0) { return -1; }
 
   entry->flag_export = true;
 
@@ -229,8 +171,6 @@ int Symbols::lookup(const char *name, uint32_t *address)
 
 int Symbols::iterate(SymbolsIter *iter)
 {
-  MemoryPool *memory_pool = this->memory_pool;
-
   if (iter->end_flag == 1) { return -1; }
   if (iter->memory_pool == NULL)
   {
@@ -238,6 +178,8 @@ int Symbols::iterate(SymbolsIter *iter)
     iter->ptr = 0;
   }
 
+  MemoryPool *memory_pool = iter->memory_pool;
+
   while (memory_pool != NULL)
   {
     if (iter->ptr < memory_pool->ptr)
@@ -254,7 +196,11 @@ int Symbols::iterate(SymbolsIter *iter)
       return 0;
     }
 
+    // iter->ptr is an offset into the current pool, so start over at
+    // the beginning of the next one.
     memory_pool = memory_pool->next;
+    iter->memory_pool = memory_pool;
+    iter->ptr = 0;
   }
 
   iter->end_flag = 1;
@@ -285,6 +231,11 @@ int Symbols::print(FILE *out)
 }
 
 int Symbols::count()
+{
+  return entry_count;
+}
+
+int Symbols::export_count()
 {
   MemoryPool *memory_pool = this->memory_pool;
   int ptr;
@@ -297,7 +248,7 @@ int Symbols::count()
     {
       Entry *entry = (Entry *)(memory_pool->buffer + ptr);
       ptr += entry->len + sizeof(Entry);
-      count++;
+      if (entry->flag_export) { count++; }
     }
 
     memory_pool = memory_pool->next;
@@ -306,37 +257,141 @@ int Symbols::count()
   return count;
 }
 
-int Symbols::export_count()
+int Symbols::scope_start()
+{
+  if (in_scope)
+  {
+    return -1;
+  }
+
+  in_scope = true;
+  current_scope++;
+
+  return 0;
+}
+
+Symbols::Entry *Symbols::insert(
+  const char *name,
+  uint32_t address,
+  uint32_t scope)
 {
   MemoryPool *memory_pool = this->memory_pool;
-  int ptr;
-  int count = 0;
+  Entry *entry;
+  int token_len = strlen(name) + 1;
 
-  while (memory_pool != NULL)
+  // Check if size of new label is bigger than 255.
+  if (token_len > 255) { return NULL; }
+
+  // Keep the index at most half full so probe chains stay short.  If it
+  // can't grow, the old one is used as long as it has an empty slot left.
+  if ((entry_count + 1) * 2 > hash_size &&
+      hash_resize(hash_size == 0 ? SYMBOLS_HASH_START : hash_size * 2) != 0 &&
+      entry_count + 1 >= hash_size)
   {
-    ptr = 0;
-    while (ptr < memory_pool->ptr)
+    return NULL;
+  }
+
+  // If there is no pool, add one.
+  if (memory_pool == NULL)
+  {
+    memory_pool = memory_pool_add((NakenHeap *)this, SYMBOLS_HEAP_SIZE);
+  }
+
+  // Find a pool that has enough area at the end to add this address.
+  // If none can be found, alloc a new one.
+  while (true)
+  {
+     if (memory_pool->ptr + token_len + (int)sizeof(Entry) < memory_pool->len)
+     {
+       break;
+     }
+
+     if (memory_pool->next == NULL)
+     {
+       memory_pool->next = memory_pool_add((NakenHeap *)this, SYMBOLS_HEAP_SIZE);
+     }
+
+     memory_pool = memory_pool->next;
+  }
+
+  // Set the new label/address entry.
+  entry = (Entry *)(memory_pool->buffer + memory_pool->ptr);
+
+  memcpy(entry->name, name, token_len);
+  entry->len = token_len;
+  entry->flag_rw = false;
+  entry->flag_export = false;
+  entry->address = address;
+  entry->scope = scope;
+  entry->hash = hash_string(name);
+
+  memory_pool->ptr += token_len + sizeof(Entry);
+
+  hash_insert(entry);
+  entry_count++;
+
+  return entry;
+}
+
+Symbols::Entry *Symbols::hash_find(
+  const char *name,
+  uint32_t hash,
+  uint32_t scope)
+{
+  if (hash_table == NULL) { return NULL; }
+
+  uint32_t mask = hash_size - 1;
+  uint32_t index = hash_mix(hash, scope) & mask;
+
+  while (hash_table[index] != NULL)
+  {
+    Entry *entry = hash_table[index];
+
+    if (entry->hash == hash &&
+        entry->scope == scope &&
+        strcmp(entry->name, name) == 0)
     {
-      Entry *entry = (Entry *)(memory_pool->buffer + ptr);
-      ptr += entry->len + sizeof(Entry);
-      if (entry->flag_export) { count++; }
+      return entry;
     }
 
-    memory_pool = memory_pool->next;
+    index = (index + 1) & mask;
   }
 
-  return count;
+  return NULL;
 }
 
-int Symbols::scope_start()
+void Symbols::hash_insert(Entry *entry)
 {
-  if (in_scope)
+  uint32_t mask = hash_size - 1;
+  uint32_t index = hash_mix(entry->hash, entry->scope) & mask;
+
+  while (hash_table[index] != NULL)
   {
-    return -1;
+    index = (index + 1) & mask;
   }
 
-  in_scope = true;
-  current_scope++;
+  hash_table[index] = entry;
+}
+
+// Returns -1 and leaves the old index in place if there's no memory.
+int Symbols::hash_resize(int size)
+{
+  Entry **new_table = (Entry **)calloc(size, sizeof(Entry *));
+
+  if (new_table == NULL) { return -1; }
+
+  Entry **old_table = hash_table;
+  int old_size = hash_size;
+
+  hash_table = new_table;
+  hash_size = size;
+
+  for (int i = 0; i < old_size; i++)
+  {
+    if (old_table[i] != NULL) { hash_insert(old_table[i]); }
+  }
+
+  free(old_table);
 
   return 0;
 }
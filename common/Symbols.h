@@ -17,6 +17,7 @@
 #include "MemoryPool.h"
 
 #define SYMBOLS_HEAP_SIZE 32768
+#define SYMBOLS_HASH_START 1024
 
 struct SymbolsIter
 {
@@ -67,9 +68,14 @@ public:
     bool flag_export : 1;    // ELF will export symbol
     uint16_t scope;          // Up to 65535 local scopes.  0 = global.
     uint32_t address;        // address for this name
+    uint32_t hash;           // hash_string() of name
     char name[];             // null terminated name of label:
   };
 
+  // append(), set() and export_symbol() don't print anything.  append()
+  // and set() return -1 if the name is already defined (read only for
+  // set()) and -2 if the name is too long.  export_symbol() returns -1
+  // if the name isn't defined or is a local label.
   Entry *find(const char *name);
   int append(const char *name, uint32_t address);
   int set(const char *name, uint32_t address);
@@ -82,12 +88,29 @@ public:
   int scope_start();
   void scope_reset() { current_scope = 0; }
   void scope_end()   { in_scope = false; }
+  uint32_t get_scope() { return in_scope ? current_scope : 0; }
+  void set_scope(uint32_t scope);
+  void reset();
   void lock()        { locked = true; }
   bool is_locked()   { return locked; }
   void set_debug()   { debug = true; }
 
 private:
+  Entry *insert(const char *name, uint32_t address, uint32_t scope);
+  Entry *hash_find(const char *name, uint32_t hash, uint32_t scope);
+  void hash_insert(Entry *entry);
+  int hash_resize(int size);
+
+  // memory_pool must be first since this is passed as a NakenHeap.
   MemoryPool *memory_pool;
+
+  // Open addressed index into the entries in memory_pool keyed on
+  // (scope, name).  Entries are never moved or deleted so the memory_pool
+  // order (used by iterate()) isn't affected by the index.
+  Entry **hash_table;
+  int hash_size;
+  int entry_count;
+
   bool locked   : 1;
   bool in_scope : 1;
   bool debug    : 1;
@@ -0,0 +1,107 @@
+/**
+ *  naken_asm assembler.
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: https://www.mikekohn.net/
+ * License: GPLv3
+ *
+ * Copyright 2010-2025 by Michael Kohn
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "common/TableIndex.h"
+#include "common/hash.h"
+
+TableIndex::~TableIndex()
+{
+  if (data != NULL)
+  {
+    free(data->names);
+    free(data);
+  }
+}
+
+// Build the index from names[] (which the index takes ownership of) and
+// make it the one used by find().  If another thread got there first its
+// index is used and this one is thrown away.
+const TableIndex::Data *TableIndex::create(const char **names, int count)
+{
+  uint32_t size = 16;
+
+  while (size < (uint32_t)count * 2) { size = size * 2; }
+
+  Data *index = (Data *)malloc(
+    sizeof(Data) + (size * sizeof(int)) + (count * sizeof(int)));
+
+  index->mask = size - 1;
+  index->buckets = (int *)(index + 1);
+  index->next_row = index->buckets + size;
+  index->names = names;
+
+  int *last_row = (int *)malloc(count * sizeof(int));
+
+  memset(index->buckets, 0xff, size * sizeof(int));
+
+  for (int n = 0; n < count; n++)
+  {
+    uint32_t bucket = hash_string(names[n]) & index->mask;
+
+    index->next_row[n] = -1;
+
+    while (true)
+    {
+      const int row = index->buckets[bucket];
+
+      if (row == -1)
+      {
+        index->buckets[bucket] = n;
+        last_row[n] = n;
+        break;
+      }
+
+      if (strcmp(names[row], names[n]) == 0)
+      {
+        index->next_row[last_row[row]] = n;
+        last_row[row] = n;
+        break;
+      }
+
+      bucket = (bucket + 1) & index->mask;
+    }
+  }
+
+  free(last_row);
+
+  Data *expected = NULL;
+
+  if (!__atomic_compare_exchange_n(
+        &data, &expected, index, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+  {
+    free(index->names);
+    free(index);
+    return expected;
+  }
+
+  return index;
+}
+
+int TableIndex::lookup(const Data *index, const char *name)
+{
+  uint32_t bucket = hash_string(name) & index->mask;
+
+  while (true)
+  {
+    const int row = index->buckets[bucket];
+
+    if (row == -1) { return -1; }
+
+    if (strcmp(index->names[row], name) == 0) { return row; }
+
+    bucket = (bucket + 1) & index->mask;
+  }
+}
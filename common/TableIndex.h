@@ -0,0 +1,73 @@
+/**
+ *  naken_asm assembler.
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: https://www.mikekohn.net/
+ * License: GPLv3
+ *
+ * Copyright 2010-2025 by Michael Kohn
+ *
+ */
+
+#ifndef NAKEN_ASM_TABLE_INDEX_H
+#define NAKEN_ASM_TABLE_INDEX_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+// Hash index over the name column of an instruction (or directive) table
+// that ends with a NULL name.  Instead of strcmp()ing every row, a parser
+// asks for the first row with a name and follows next() through the other
+// rows with the same name, in the same order they are in the table:
+//
+//   for (n = index.find(table, &Instr::instr, name); n != -1; n = index.next(n))
+//
+// The index is built the first time it's used.
+
+class TableIndex
+{
+public:
+  TableIndex() : data (NULL) { }
+  ~TableIndex();
+
+  template <typename T>
+  int find(const T *table, const char * const T::*name_field, const char *name)
+  {
+    const Data *index = __atomic_load_n(&data, __ATOMIC_ACQUIRE);
+
+    if (index == NULL)
+    {
+      int count = 0;
+
+      while (table[count].*name_field != NULL) { count++; }
+
+      const char **names =
+        (const char **)malloc(sizeof(const char *) * (count + 1));
+
+      for (int n = 0; n < count; n++) { names[n] = table[n].*name_field; }
+
+      index = create(names, count);
+    }
+
+    return lookup(index, name);
+  }
+
+  int next(int row) const { return data->next_row[row]; }
+
+private:
+  struct Data
+  {
+    uint32_t mask;
+    int *buckets;
+    int *next_row;
+    const char **names;
+  };
+
+  const Data *create(const char **names, int count);
+  static int lookup(const Data *index, const char *name);
+
+  Data *data;
+};
+
+#endif
+
@@ -0,0 +1,269 @@
+/**
+ *  naken_asm assembler.
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: https://www.mikekohn.net/
+ * License: GPLv3
+ *
+ * Copyright 2010-2025 by Michael Kohn
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "common/MemoryPool.h"
+#include "common/TokenCache.h"
+#include "common/hash.h"
+
+TokenCache::TokenCache() :
+  sources      (NULL),
+  source_count (0),
+  source_alloc (0),
+  hits         (0),
+  misses       (0),
+  file_reads   (0),
+  file_hits    (0),
+  file_missing (0)
+{
+}
+
+TokenCache::~TokenCache()
+{
+  reset();
+}
+
+void TokenCache::reset()
+{
+  for (int n = 0; n < source_count; n++)
+  {
+    memory_pool_free(sources[n].heap.memory_pool);
+    free(sources[n].filename);
+    free(sources[n].code);
+  }
+
+  free(sources);
+
+  sources = NULL;
+  source_count = 0;
+  source_alloc = 0;
+  hits = 0;
+  misses = 0;
+  file_reads = 0;
+  file_hits = 0;
+  file_missing = 0;
+}
+
+// Read every file again before another run with the same cache.  Files
+// that didn't change keep their tokens and are marked warm so pass 1 can
+// use them too.  The rest start over as if they were never opened.
+void TokenCache::refresh()
+{
+  for (int n = 0; n < source_count; n++)
+  {
+    Source *source = &sources[n];
+    char *code = load_file(source->filename);
+
+    if (code != NULL && source->code != NULL &&
+        strcmp(code, source->code) == 0)
+    {
+      free(code);
+      source->warm = source->next_offset != 0;
+      continue;
+    }
+
+    memory_pool_free(source->heap.memory_pool);
+    free(source->code);
+
+    source->heap.memory_pool = NULL;
+    source->last_pool = NULL;
+    source->code = code;
+    source->next_offset = 0;
+    source->warm = false;
+  }
+
+  hits = 0;
+  misses = 0;
+  file_reads = 0;
+  file_hits = 0;
+  file_missing = 0;
+}
+
+// Returns the source number (starting at 1) for filename, reading the
+// file if this is the first time it's been opened, or 0 if the file
+// can't be read.
+int TokenCache::open(const char *filename)
+{
+  const uint32_t hash = hash_string(filename);
+
+  for (int n = 0; n < source_count; n++)
+  {
+    if (sources[n].hash == hash && strcmp(sources[n].filename, filename) == 0)
+    {
+      file_hits++;
+      return sources[n].code == NULL ? 0 : n + 1;
+    }
+  }
+
+  char *code = load_file(filename);
+
+  if (code == NULL) { file_missing++; }
+  else { file_reads++; }
+
+  if (source_count == source_alloc)
+  {
+    source_alloc = source_alloc == 0 ? 16 : source_alloc * 2;
+    sources = (Source *)realloc(sources, source_alloc * sizeof(Source));
+  }
+
+  Source *source = &sources[source_count++];
+
+  source->heap.memory_pool = NULL;
+  source->last_pool = NULL;
+  source->filename = strdup(filename);
+  source->code = code;
+  source->hash = hash;
+  source->next_offset = 0;
+  source->warm = false;
+
+  return code == NULL ? 0 : source_count;
+}
+
+// Read the whole file into memory with the carriage returns taken out
+// so the lexer only has to walk a buffer.
+char *TokenCache::load_file(const char *filename)
+{
+  FILE *in = fopen(filename, "rb");
+
+  if (in == NULL) { return NULL; }
+
+  long size = 0;
+
+  if (fseek(in, 0, SEEK_END) == 0)
+  {
+    size = ftell(in);
+    fseek(in, 0, SEEK_SET);
+  }
+
+  if (size < 0) { size = 0; }
+
+  // If the size can't be found (a pipe for example) grow as needed.
+  long alloc = size + 1 + (size == 0 ? 65536 : 0);
+  long length = 0;
+  char *buffer = (char *)malloc(alloc);
+
+  while (true)
+  {
+    length += fread(buffer + length, 1, alloc - length - 1, in);
+
+    if (length < alloc - 1) { break; }
+
+    alloc = alloc * 2;
+    buffer = (char *)realloc(buffer, alloc);
+  }
+
+  fclose(in);
+
+  char *s = (char *)memchr(buffer, '\r', length);
+
+  if (s != NULL)
+  {
+    char *end = buffer + length;
+    char *d = s;
+
+    for ( ; s < end; s++)
+    {
+      if (*s != '\r') { *d++ = *s; }
+    }
+
+    length = d - buffer;
+  }
+
+  buffer[length] = 0;
+
+  return buffer;
+}
+
+void TokenCache::record(
+  int source,
+  uint32_t offset,
+  uint32_t consumed,
+  int lines,
+  int type,
+  int flags,
+  const char *text,
+  int length)
+{
+  Source *s = &sources[source - 1];
+
+  // A file that is included twice was already recorded the first time.
+  if (offset < s->next_offset) { return; }
+
+  const int size = entry_size(length);
+  MemoryPool *memory_pool = s->last_pool;
+
+  if (memory_pool == NULL || memory_pool->ptr + size > memory_pool->len)
+  {
+    memory_pool = memory_pool_add(&s->heap, TOKEN_CACHE_HEAP_SIZE);
+    s->last_pool = memory_pool;
+  }
+
+  TokenCacheEntry *entry =
+    (TokenCacheEntry *)(memory_pool->buffer + memory_pool->ptr);
+
+  entry->offset = offset;
+  entry->consumed = consumed;
+  entry->lines = lines;
+  entry->length = length;
+  entry->type = type;
+  entry->flags = flags;
+  memcpy(entry->text, text, length);
+  entry->text[length] = 0;
+
+  memory_pool->ptr += size;
+  s->next_offset = offset + (consumed == 0 ? 1 : consumed);
+}
+
+// Entries in a source are in offset order, so the cursor only moves
+// forward as the file is read again.
+const TokenCacheEntry *TokenCache::find(
+  int source,
+  TokenCacheCursor &cursor,
+  uint32_t offset)
+{
+  // A cursor of { NULL, 0 } hasn't started yet, { NULL, -1 } is at the end.
+  if (cursor.memory_pool == NULL && cursor.ptr == 0)
+  {
+    cursor.memory_pool = sources[source - 1].heap.memory_pool;
+  }
+
+  while (cursor.memory_pool != NULL)
+  {
+    if (cursor.ptr >= cursor.memory_pool->ptr)
+    {
+      cursor.memory_pool = cursor.memory_pool->next;
+      cursor.ptr = cursor.memory_pool == NULL ? -1 : 0;
+      continue;
+    }
+
+    TokenCacheEntry *entry =
+      (TokenCacheEntry *)(cursor.memory_pool->buffer + cursor.ptr);
+
+    if (entry->offset > offset) { break; }
+
+    if (entry->offset == offset)
+    {
+      hits++;
+      return entry;
+    }
+
+    cursor.ptr += entry_size(entry->length);
+  }
+
+  misses++;
+
+  return NULL;
+}
+
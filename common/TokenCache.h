@@ -0,0 +1,111 @@
+/**
+ *  naken_asm assembler.
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: https://www.mikekohn.net/
+ * License: GPLv3
+ *
+ * Copyright 2010-2025 by Michael Kohn
+ *
+ */
+
+#ifndef NAKEN_ASM_TOKEN_CACHE_H
+#define NAKEN_ASM_TOKEN_CACHE_H
+
+#include <stdint.h>
+
+#include "common/MemoryPool.h"
+
+#define TOKEN_CACHE_HEAP_SIZE 65536
+
+// One token as it came out of the lexer on pass 1, before symbols, macros
+// and number conversions were applied.
+struct TokenCacheEntry
+{
+  uint32_t offset;   // byte offset of the token in its source file
+  uint32_t consumed; // source bytes the lexer read for this token
+  int32_t lines;     // lines skipped inside the token (/* */ comments)
+  uint16_t length;
+  int8_t type;
+  uint8_t flags;     // lexer settings from the CPU the token was read with
+  char text[];
+};
+
+// Where the replay of a source file currently is.  Each include of a
+// file gets its own cursor since the same file can be included twice.
+struct TokenCacheCursor
+{
+  MemoryPool *memory_pool;
+  int ptr;
+};
+
+// Source files are read once per run and kept here along with the
+// tokens lexed from them on pass 1.  Files that couldn't be opened are
+// remembered too so include path searches don't retry them.  With
+// naken_asm -server the cache is kept between runs and refresh() drops
+// whatever changed on disk.
+class TokenCache
+{
+public:
+  TokenCache();
+  ~TokenCache();
+
+  void reset();
+  void refresh();
+
+  int open(const char *filename);
+  const char *get_code(int source) { return sources[source - 1].code; }
+  bool is_warm(int source) { return sources[source - 1].warm; }
+
+  void record(
+    int source,
+    uint32_t offset,
+    uint32_t consumed,
+    int lines,
+    int type,
+    int flags,
+    const char *text,
+    int length);
+
+  const TokenCacheEntry *find(
+    int source,
+    TokenCacheCursor &cursor,
+    uint32_t offset);
+
+  int get_hits()         { return hits; }
+  int get_misses()       { return misses; }
+  int get_file_reads()   { return file_reads; }
+  int get_file_hits()    { return file_hits; }
+  int get_file_missing() { return file_missing; }
+
+private:
+  struct Source
+  {
+    NakenHeap heap;
+    MemoryPool *last_pool;
+    char *filename;
+    char *code;
+    uint32_t hash;
+    uint32_t next_offset;
+    bool warm;
+  };
+
+  static char *load_file(const char *filename);
+
+  static int entry_size(int length)
+  {
+    return (sizeof(TokenCacheEntry) + length + 1 + 3) & ~3;
+  }
+
+  Source *sources;
+  int source_count;
+  int source_alloc;
+  int hits;
+  int misses;
+  int file_reads;
+  int file_hits;
+  int file_missing;
+};
+
+#endif
+
@@ -50,17 +50,32 @@ void add_bin16(AsmContext *asm_context, uint16_t b, int flags)
     return;
   }
 
+  uint8_t data[2];
+  int line_offset;
+
   if (asm_context->memory.endian == ENDIAN_LITTLE)
   {
     // 1 little, 2 little, 3 little endian
-    asm_context->memory_write_inc(b & 0xff, line);
-    asm_context->memory_write_inc(b >> 8, DL_NO_CG);
+    data[0] = b & 0xff;
+    data[1] = b >> 8;
+    line_offset = 0;
   }
     else
   {
-    asm_context->memory_write_inc(b >> 8, DL_NO_CG);
-    asm_context->memory_write_inc(b & 0xff, line);
+    data[0] = b >> 8;
+    data[1] = b & 0xff;
+    line_offset = 1;
+  }
+
+  // Only the low byte gets the line number.
+  asm_context->memory.write_block(asm_context->address, data, 2, DL_NO_CG);
+
+  if (line != DL_NO_CG)
+  {
+    asm_context->write_debug(asm_context->address + line_offset, line);
   }
+
+  asm_context->address += 2;
 }
 
 void add_bin32(AsmContext *asm_context, uint32_t b, int flags)
@@ -73,20 +88,24 @@ void add_bin32(AsmContext *asm_context, uint32_t b, int flags)
     return;
   }
 
+  uint8_t data[4];
+
   if (asm_context->memory.endian == ENDIAN_LITTLE)
   {
-    asm_context->memory_write_inc(b & 0xff, line);
-    asm_context->memory_write_inc((b >> 8) & 0xff, line);
-    asm_context->memory_write_inc((b >> 16) & 0xff, line);
-    asm_context->memory_write_inc((b >> 24) & 0xff, line);
+    data[0] = b & 0xff;
+    data[1] = (b >> 8) & 0xff;
+    data[2] = (b >> 16) & 0xff;
+    data[3] = (b >> 24) & 0xff;
   }
     else
   {
-    asm_context->memory_write_inc((b >> 24) & 0xff, line);
-    asm_context->memory_write_inc((b >> 16) & 0xff, line);
-    asm_context->memory_write_inc((b >> 8) & 0xff, line);
-    asm_context->memory_write_inc(b & 0xff, line);
+    data[0] = (b >> 24) & 0xff;
+    data[1] = (b >> 16) & 0xff;
+    data[2] = (b >> 8) & 0xff;
+    data[3] = b & 0xff;
   }
+
+  asm_context->memory_write_block_inc(data, 4, line);
 }
 
 int add_bin_varuint(AsmContext *asm_context, uint64_t b, int fixed_size)
@@ -97,7 +116,7 @@ int add_bin_varuint(AsmContext *asm_context, uint64_t b, int fixed_size)
 
   if (asm_context->memory.endian == ENDIAN_BIG)
   {
-    printf("Warning: varuint only works with little endian at %s:%d\n",
+    fprintf(asm_context->messages, "Warning: varuint only works with little endian at %s:%d\n",
       asm_context->tokens.filename,
       asm_context->tokens.line);
   }
@@ -132,7 +151,7 @@ int add_bin_varint(AsmContext *asm_context, uint64_t b, int fixed_size)
 
   if (asm_context->memory.endian == ENDIAN_BIG)
   {
-    printf("Warning: varint only works with little endian at %s:%d\n",
+    fprintf(asm_context->messages, "Warning: varint only works with little endian at %s:%d\n",
       asm_context->tokens.filename,
       asm_context->tokens.line);
   }
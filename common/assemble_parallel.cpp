@@ -0,0 +1,318 @@
+/**
+ *  naken_asm assembler.
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: https://www.mikekohn.net/
+ * License: GPLv3
+ *
+ * Copyright 2010-2025 by Michael Kohn
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#ifdef PTHREADS
+#include <pthread.h>
+#endif
+
+#include "common/assemble_parallel.h"
+#include "common/assembler.h"
+#include "common/tokens.h"
+
+// Instructions are handed out to the threads this many at a time.
+#define PARALLEL_BLOCK 256
+
+struct ParallelPass
+{
+  AsmContext *asm_context;
+  const Fixup **fixups;
+  uint32_t *offsets;
+  uint8_t *data;
+  uint8_t *used;
+  int count;
+  int next;
+  int failed;
+};
+
+struct ParallelThread
+{
+  ParallelPass *parallel;
+  AsmContext *asm_context;
+};
+
+static int assemble_instruction(
+  AsmContext *asm_context,
+  const Fixup *fixup,
+  uint8_t *data,
+  uint8_t *used)
+{
+  const uint32_t length = fixup->end_address - fixup->address;
+  Tokens &tokens = asm_context->tokens;
+  char instr[TOKENLEN];
+
+  asm_context->set_cpu(fixup->cpu_list_index);
+  asm_context->parse_directive = fixup->parse_directive;
+  asm_context->flags = fixup->flags;
+  asm_context->memory.endian = fixup->endian;
+  asm_context->segment = fixup->segment;
+  asm_context->address = fixup->address;
+
+  tokens.line = fixup->line;
+  tokens.filename = Fixups::get_filename(fixup);
+  tokens.replay_ptr = Fixups::get_tokens(fixup);
+  tokens.replay_end = (const uint8_t *)fixup + fixup->size;
+  tokens.pushback[0] = 0;
+  tokens.pushback2[0] = 0;
+
+  // Some CPUs look at what pass 1 left in memory (riscv and mips li
+  // for example), so this thread's memory starts out with those bytes
+  // marked as not used.
+  asm_context->memory.erase(fixup->address, length);
+  asm_context->memory.write_block(fixup->address, data, length);
+
+  tokens_get(asm_context, instr, TOKENLEN);
+
+  if (asm_context->parse_instruction(asm_context, instr) < 0 ||
+      asm_context->error_count != 0 ||
+      (uint32_t)asm_context->address != fixup->end_address)
+  {
+    return -1;
+  }
+
+  asm_context->memory.read_block(fixup->address, data, length);
+
+  for (uint32_t n = 0; n < length; n++)
+  {
+    used[n] = asm_context->read_debug(fixup->address + n) != DL_EMPTY;
+  }
+
+  return 0;
+}
+
+static void *assemble_thread(void *arg)
+{
+  ParallelThread *thread = (ParallelThread *)arg;
+  ParallelPass *parallel = thread->parallel;
+
+  while (__atomic_load_n(&parallel->failed, __ATOMIC_RELAXED) == 0)
+  {
+    const int start =
+      __atomic_fetch_add(&parallel->next, PARALLEL_BLOCK, __ATOMIC_RELAXED);
+
+    if (start >= parallel->count) { break; }
+
+    int end = start + PARALLEL_BLOCK;
+
+    if (end > parallel->count) { end = parallel->count; }
+
+    for (int n = start; n < end; n++)
+    {
+      const uint32_t offset = parallel->offsets[n];
+
+      if (assemble_instruction(
+            thread->asm_context,
+            parallel->fixups[n],
+            parallel->data + offset,
+            parallel->used + offset) != 0)
+      {
+        __atomic_store_n(&parallel->failed, 1, __ATOMIC_RELAXED);
+        break;
+      }
+    }
+  }
+
+  return NULL;
+}
+
+// Each thread's messages go to its own temp file.  Anything a thread
+// prints (an error or a warning) would come out in the wrong order, so
+// if anything was printed this returns -1 and pass 2 is done again one
+// instruction at a time.
+static int run_threads(ParallelThread *threads, int count)
+{
+  int ret = 0;
+  int n;
+
+  for (n = 0; n < count; n++)
+  {
+    threads[n].asm_context->messages = tmpfile();
+
+    if (threads[n].asm_context->messages == NULL) { ret = -1; }
+  }
+
+  if (ret == 0)
+  {
+#ifdef PTHREADS
+    pthread_t *ids = (pthread_t *)malloc(sizeof(pthread_t) * count);
+    int started = 0;
+
+    for (n = 1; n < count; n++)
+    {
+      if (pthread_create(&ids[n], NULL, assemble_thread, &threads[n]) != 0)
+      {
+        break;
+      }
+
+      started = n;
+    }
+
+    assemble_thread(&threads[0]);
+
+    for (n = 1; n <= started; n++)
+    {
+      pthread_join(ids[n], NULL);
+    }
+
+    free(ids);
+#else
+    assemble_thread(&threads[0]);
+#endif
+  }
+
+  for (n = 0; n < count; n++)
+  {
+    FILE *messages = threads[n].asm_context->messages;
+
+    if (messages == NULL) { continue; }
+
+    if (ftell(messages) != 0) { ret = -1; }
+
+    fclose(messages);
+    threads[n].asm_context->messages = stdout;
+  }
+
+  return ret;
+}
+
+// Pass 2 with the instructions assembled on threads.  Everything except
+// instructions is done in order by assemble() while the instructions
+// (on CPUs marked parallel in cpu_list) are only recorded.  The threads
+// then assemble them in their own AsmContext and the bytes are copied
+// into memory.  asm_context->line_map from pass 1 has to be filled in.
+// Returns -1 if pass 2 has to be done the normal way (an error, or an
+// instruction that didn't come out the same size as on pass 1).
+int assemble_parallel(AsmContext *asm_context, int threads)
+{
+  asm_context->pass = 2;
+  asm_context->init();
+  asm_context->fixups.reset();
+  asm_context->line_map_index = 0;
+  asm_context->defer_instructions = 1;
+
+  int ret = assemble(asm_context);
+
+  asm_context->defer_instructions = 0;
+  asm_context->fixups.cancel();
+
+  if (ret != 0 || asm_context->error_count != 0) { return -1; }
+
+  ParallelPass parallel;
+
+  parallel.asm_context = asm_context;
+  parallel.count = asm_context->fixups.count();
+  parallel.next = 0;
+  parallel.failed = 0;
+  parallel.fixups =
+    (const Fixup **)malloc(sizeof(Fixup *) * (parallel.count + 1));
+  parallel.offsets =
+    (uint32_t *)malloc(sizeof(uint32_t) * (parallel.count + 1));
+
+  const Fixup *fixup;
+  uint32_t length = 0;
+  int offset = 0;
+  int n = 0;
+
+  while ((fixup = asm_context->fixups.get(offset)) != NULL)
+  {
+    parallel.fixups[n] = fixup;
+    parallel.offsets[n] = length;
+    length += fixup->end_address - fixup->address;
+    offset += fixup->size;
+    n++;
+  }
+
+  parallel.data = (uint8_t *)malloc(length + 1);
+  parallel.used = (uint8_t *)malloc(length + 1);
+
+  for (n = 0; n < parallel.count; n++)
+  {
+    fixup = parallel.fixups[n];
+
+    asm_context->memory.read_block(
+      fixup->address,
+      parallel.data + parallel.offsets[n],
+      fixup->end_address - fixup->address);
+  }
+
+  if (threads > parallel.count / PARALLEL_BLOCK + 1)
+  {
+    threads = parallel.count / PARALLEL_BLOCK + 1;
+  }
+
+  if (threads < 1) { threads = 1; }
+
+  AsmContext *contexts = new AsmContext[threads];
+  ParallelThread *thread_list =
+    (ParallelThread *)malloc(sizeof(ParallelThread) * threads);
+
+  for (n = 0; n < threads; n++)
+  {
+    contexts[n].pass = 2;
+    contexts[n].optimize = asm_context->optimize;
+    contexts[n].msp430_cpu4 = asm_context->msp430_cpu4;
+    contexts[n].extra_context = asm_context->extra_context;
+
+    thread_list[n].parallel = &parallel;
+    thread_list[n].asm_context = &contexts[n];
+  }
+
+  ret = run_threads(thread_list, threads);
+
+  if (ret == 0 && parallel.failed != 0) { ret = -1; }
+
+  if (ret == 0)
+  {
+    for (n = 0; n < parallel.count; n++)
+    {
+      fixup = parallel.fixups[n];
+
+      const uint8_t *data = parallel.data + parallel.offsets[n];
+      const uint8_t *used = parallel.used + parallel.offsets[n];
+      const uint32_t count = fixup->end_address - fixup->address;
+      uint32_t start = 0;
+
+      // Copy over each run of bytes the instruction wrote.
+      while (start < count)
+      {
+        if (!used[start]) { start++; continue; }
+
+        uint32_t end = start + 1;
+
+        while (end < count && used[end]) { end++; }
+
+        asm_context->memory.write_block(
+          fixup->address + start,
+          data + start,
+          end - start,
+          fixup->line);
+
+        start = end;
+      }
+    }
+  }
+
+  delete[] contexts;
+  free(thread_list);
+  free(parallel.data);
+  free(parallel.used);
+  free(parallel.offsets);
+  free(parallel.fixups);
+
+  asm_context->fixups.reset();
+
+  return ret;
+}
+
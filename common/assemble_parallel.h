@@ -0,0 +1,32 @@
+/**
+ *  naken_asm assembler.
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: https://www.mikekohn.net/
+ * License: GPLv3
+ *
+ * Copyright 2010-2025 by Michael Kohn
+ *
+ */
+
+#ifndef NAKEN_ASM_ASSEMBLE_PARALLEL_H
+#define NAKEN_ASM_ASSEMBLE_PARALLEL_H
+
+#include <stdint.h>
+
+class AsmContext;
+
+// Where each instruction ended up on pass 1, in the order they were
+// assembled.  Pass 2 uses this to know how much space an instruction
+// takes without having to assemble it right away.
+struct LineAddress
+{
+  int line;
+  uint32_t address;
+  uint32_t end_address;
+};
+
+int assemble_parallel(AsmContext *asm_context, int threads);
+
+#endif
+
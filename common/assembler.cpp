@@ -25,6 +25,7 @@
 #include "common/tokens.h"
 #include "common/ifdef_expression.h"
 #include "common/Macros.h"
+#include "common/TableIndex.h"
 #include "common/print_error.h"
 #include "disasm/msp430.h"
 
@@ -34,6 +35,8 @@ AsmContext::AsmContext() :
   link_function          (NULL),
   list_output            (NULL),
   list                   (NULL),
+  messages               (stdout),
+  cache_dir              (NULL),
   address                (0),
   segment                (0),
   pass                   (1),
@@ -41,10 +44,11 @@ AsmContext::AsmContext() :
   data_count             (0),
   code_count             (0),
   error_count            (0),
+  warning_count          (0),
   ifdef_count            (0),
   parsing_ifdef          (0),
+  line_map_index         (0),
   linker                 (NULL),
-  def_param_stack_count  (0),
   cpu_list_index         (0),
   cpu_type               (0),
   bytes_per_address      (1),
@@ -62,16 +66,20 @@ AsmContext::AsmContext() :
   dump_symbols           (false),
   dump_macros            (false),
   optimize               (false),
+  no_instruction_cache   (false),
+  verbose                (false),
   ignore_number_postfix  (false),
   in_repeat              (false),
+  single_pass            (false),
+  forward_reference      (false),
+  record_line_map        (false),
+  defer_instructions     (false),
   flags                  (0),
   extra_context          (0)
 {
   memset(&tokens,  0, sizeof(tokens));
   //memset(&macros,  0, sizeof(macros));
 
-  memset(def_param_stack_data, 0, sizeof(def_param_stack_data));
-  memset(def_param_stack_ptr, 0, sizeof(def_param_stack_ptr));
   memset(include_path, 0, sizeof(include_path));
 }
 
@@ -102,7 +110,78 @@ void AsmContext::init()
   in_repeat = 0;
 
   macros.reset();
-  def_param_stack_count = 0;
+  instruction_cache.clear();
+}
+
+// Put everything back the way the constructor left it so another file
+// can be assembled (naken_asm -server).  Memory pages and the source
+// files in token_cache and the include files in include_cache are kept.
+void AsmContext::reset()
+{
+  memory.clear();
+  memory.endian = ENDIAN_LITTLE;
+  memory.debug_lines = false;
+  memset(&tokens, 0, sizeof(tokens));
+  symbols.reset();
+  macros.reset();
+  token_cache.refresh();
+  include_cache.clear_stats();
+  instruction_cache.clear_stats();
+  expression_cache.reset();
+  fixups.reset();
+  dependencies.clear();
+  line_map.clear();
+
+  delete linker;
+
+  parse_instruction = NULL;
+  parse_directive = NULL;
+  link_function = NULL;
+  list_output = NULL;
+  list = NULL;
+  messages = stdout;
+  cache_dir = NULL;
+  address = 0;
+  segment = 0;
+  pass = 1;
+  instruction_count = 0;
+  data_count = 0;
+  code_count = 0;
+  error_count = 0;
+  warning_count = 0;
+  ifdef_count = 0;
+  parsing_ifdef = 0;
+  line_map_index = 0;
+  linker = NULL;
+  cpu_list_index = 0;
+  cpu_type = 0;
+  bytes_per_address = 1;
+  is_dollar_hex = false;
+  strings_have_dots = false;
+  strings_have_slashes = false;
+  can_tick_end_string = false;
+  numbers_dont_have_dots = false;
+  quiet_output = false;
+  error = false;
+  msp430_cpu4 = false;
+  ignore_symbols = false;
+  pass_1_write_disable = false;
+  write_list_file = false;
+  dump_symbols = false;
+  dump_macros = false;
+  optimize = false;
+  no_instruction_cache = false;
+  verbose = false;
+  ignore_number_postfix = false;
+  in_repeat = false;
+  single_pass = false;
+  forward_reference = false;
+  record_line_map = false;
+  defer_instructions = false;
+  flags = 0;
+  extra_context = 0;
+
+  memset(include_path, 0, sizeof(include_path));
 }
 
 void AsmContext::print_info(FILE *out)
@@ -111,7 +190,7 @@ void AsmContext::print_info(FILE *out)
 
   fprintf(out, "\nProgram Info:\n");
 
-  if (dump_symbols == 1 || out != stdout)
+  if (dump_symbols == 1 || out == list)
   {
     symbols.print(out);
   }
@@ -162,6 +241,27 @@ void AsmContext::print_info(FILE *out)
     data_count,
     low_address, low_address,
     high_address, high_address);
+
+  if (verbose)
+  {
+    fprintf(out,
+      " Source Files: %d read, %d reused, %d not found\n"
+      "  Token Cache: %d hits, %d misses\n"
+      "Include Cache: %d hits, %d misses\n"
+      "  Expressions: %d compiled, %d reused\n"
+      " Instr. Cache: %d hits, %d misses\n\n",
+      token_cache.get_file_reads(),
+      token_cache.get_file_hits(),
+      token_cache.get_file_missing(),
+      token_cache.get_hits(),
+      token_cache.get_misses(),
+      include_cache.get_hits(),
+      include_cache.get_misses(),
+      expression_cache.get_count(),
+      expression_cache.get_hits(),
+      instruction_cache.get_hits(),
+      instruction_cache.get_misses());
+  }
 }
 
 void AsmContext::set_cpu(int index)
@@ -291,88 +391,490 @@ int assembler_link(AsmContext *asm_context)
   return 0;
 }
 
+enum
+{
+  DIRECTIVE_ORG,
+  DIRECTIVE_DB,
+  DIRECTIVE_ASCIIZ,
+  DIRECTIVE_DC16,
+  DIRECTIVE_DC32,
+  DIRECTIVE_DC64,
+  DIRECTIVE_VARUINT,
+  DIRECTIVE_VARUINT32,
+  DIRECTIVE_RESB,
+  DIRECTIVE_RESW,
+  DIRECTIVE_END
+};
+
+static const DirectiveName directive_names[] =
+{
+  { "org",       DIRECTIVE_ORG },
+  { "db",        DIRECTIVE_DB },
+  { "dc8",       DIRECTIVE_DB },
+  { "ascii",     DIRECTIVE_DB },
+  { "asciiz",    DIRECTIVE_ASCIIZ },
+  { "dw",        DIRECTIVE_DC16 },
+  { "dc16",      DIRECTIVE_DC16 },
+  { "dl",        DIRECTIVE_DC32 },
+  { "dc32",      DIRECTIVE_DC32 },
+  { "dd",        DIRECTIVE_DC32 },
+  { "dc64",      DIRECTIVE_DC64 },
+  { "dq",        DIRECTIVE_DC64 },
+  { "varuint",   DIRECTIVE_VARUINT },
+  { "varuint32", DIRECTIVE_VARUINT32 },
+  { "resb",      DIRECTIVE_RESB },
+  { "resw",      DIRECTIVE_RESW },
+  { "end",       DIRECTIVE_END },
+  { NULL,        0 }
+};
+
+static TableIndex directive_index;
+
 int assembler_directive(AsmContext *asm_context, char *token)
 {
-  if (strcasecmp(token, "org") == 0)
+  // Every instruction goes through here before the CPU's parser so this
+  // is a hash lookup instead of a string compare per directive.
+  switch (directive_find(directive_index, directive_names, token))
   {
-    if (parse_org(asm_context) != 0) { return -1; }
-    return 1;
+    case DIRECTIVE_ORG:
+      if (parse_org(asm_context) != 0) { return -1; }
+      return 1;
+    case DIRECTIVE_DB:
+      if (parse_db(asm_context, 0) != 0) { return -1; }
+      return 1;
+    case DIRECTIVE_ASCIIZ:
+      if (parse_db(asm_context, 1) != 0) { return -1; }
+      return 1;
+#if 0
+    case DIRECTIVE_DC:
+      if (parse_dc(asm_context) != 0) { return -1; }
+      return 1;
+#endif
+    case DIRECTIVE_DC16:
+      if (parse_dc16(asm_context) != 0) { return -1; }
+      return 1;
+    case DIRECTIVE_DC32:
+      if (parse_dc32(asm_context) != 0) { return -1; }
+      return 1;
+    case DIRECTIVE_DC64:
+      if (parse_dc64(asm_context) != 0) { return -1; }
+      return 1;
+    case DIRECTIVE_VARUINT:
+      if (parse_varuint(asm_context, 0) != 0) { return -1; }
+      return 1;
+    case DIRECTIVE_VARUINT32:
+      if (parse_varuint(asm_context, 5) != 0) { return -1; }
+      return 1;
+    case DIRECTIVE_RESB:
+      if (parse_resb(asm_context, 1) != 0) { return -1; }
+      return 1;
+    case DIRECTIVE_RESW:
+      if (parse_resb(asm_context, 2) != 0) { return -1; }
+      return 1;
+    case DIRECTIVE_END:
+      // This is breaking webasm which has an "end" instruction.
+      if (asm_context->cpu_type != CPU_TYPE_WEBASM) { return 2; }
+      return 0;
+    default:
+      return 0;
   }
-    else
-  if (strcasecmp(token, "db") == 0 ||
-      strcasecmp(token, "dc8") == 0 ||
-      strcasecmp(token, "ascii") == 0)
+}
+
+static bool single_pass_cpu(AsmContext *asm_context)
+{
+  return asm_context->cpu_list_index != -1 &&
+         cpu_list[asm_context->cpu_list_index].single_pass;
+}
+
+// With -single_pass each statement is recorded as it's assembled (see
+// Fixups.h).  word is the first token of the statement if it was already
+// read.  Returns the mark for fixup_end() or -1 if the source can't be
+// assembled in one pass.
+static int fixup_begin(AsmContext *asm_context, const char *word)
+{
+  // A statement that holds other statements (.include, .if, .repeat) and
+  // already used an undefined label can't be assembled again.
+  if (asm_context->fixups.is_recording() && asm_context->forward_reference)
   {
-    if (parse_db(asm_context, 0) != 0) { return -1; }
-    return 1;
+    return -1;
   }
-    else
-  if (strcasecmp(token, "asciiz") == 0)
+
+  Fixup fixup;
+
+  memset(&fixup, 0, sizeof(fixup));
+  fixup.address = asm_context->address;
+  fixup.scope = asm_context->symbols.get_scope();
+  fixup.flags = asm_context->flags;
+  fixup.line = asm_context->tokens.line;
+  fixup.cpu_list_index = asm_context->cpu_list_index;
+  fixup.parse_directive = asm_context->parse_directive;
+  fixup.endian = asm_context->memory.endian;
+  fixup.segment = asm_context->segment;
+  fixup.low_address = asm_context->memory.low_address;
+  fixup.high_address = asm_context->memory.high_address;
+
+  asm_context->forward_reference = 0;
+
+  int mark = asm_context->fixups.begin(fixup, asm_context->tokens.filename);
+
+  if (word != NULL)
   {
-    if (parse_db(asm_context, 1) != 0) { return -1; }
-    return 1;
+    asm_context->fixups.record(TOKEN_STRING, word, strlen(word), false, 0);
   }
-    else
-#if 0
-  if (strcasecmp(token, "dc") == 0)
+
+  return mark;
+}
+
+static bool fixup_can_replay(AsmContext *asm_context, int mark, int kind)
+{
+  if (!asm_context->fixups.is_current(mark)) { return false; }
+  if (asm_context->cpu_list_index == -1) { return false; }
+
+  switch (kind)
   {
-    if (parse_dc(asm_context) != 0) { return -1; }
-    return 1;
+    case FIXUP_INSTRUCTION:
+    case FIXUP_DATA:
+      return true;
+    case FIXUP_DIRECTIVE:
+    {
+      // Only data directives (.db, .dw, etc), .entry_point and .export
+      // can be done again.
+      const FixupToken *token = asm_context->fixups.first_token(mark);
+
+      if (token == NULL || asm_context->parse_directive != NULL)
+      {
+        return false;
+      }
+
+      if (strcasecmp(token->text, "entry_point") == 0 ||
+          strcasecmp(token->text, "export") == 0)
+      {
+        return true;
+      }
+
+      const int id = directive_find(directive_index, directive_names, token->text);
+
+      return id != -1 && id != DIRECTIVE_END;
+    }
+    default:
+      return false;
   }
-    else
-#endif
-  if (strcasecmp(token, "dw") == 0 || strcasecmp(token, "dc16") == 0)
+}
+
+// Assemble a recorded statement from its tokens (tokens.replay_ptr).
+static int fixup_assemble(AsmContext *asm_context, int kind)
+{
+  char word[TOKENLEN];
+  int ret;
+
+  switch (kind)
   {
-    if (parse_dc16(asm_context) != 0) { return -1; }
-    return 1;
+    case FIXUP_INSTRUCTION:
+      tokens_get(asm_context, word, TOKENLEN);
+      ret = asm_context->parse_instruction(asm_context, word);
+      break;
+    case FIXUP_DATA:
+      tokens_get(asm_context, word, TOKENLEN);
+      ret = assembler_directive(asm_context, word) == 1 ? 0 : -1;
+      break;
+    case FIXUP_DIRECTIVE:
+      ret = parse_directives(asm_context);
+      break;
+    default:
+      ret = -1;
+      break;
   }
-    else
-  if (strcasecmp(token, "dl") == 0 ||
-      strcasecmp(token, "dc32") == 0 ||
-      strcasecmp(token, "dd") == 0)
+
+  asm_context->tokens.pushback[0] = 0;
+  asm_context->tokens.pushback2[0] = 0;
+
+  return ret < 0 || asm_context->error_count != 0 ? -1 : 0;
+}
+
+// The statement at mark was assembled with a placeholder for a label
+// that isn't defined yet.  Do it again the way pass 1 would have so it
+// takes the same amount of space (and leaves the same markers in memory
+// for pass 2) as it would with two passes.
+static int fixup_redo(AsmContext *asm_context, int mark, int kind)
+{
+  const Fixup *fixup = asm_context->fixups.get(mark);
+  const Tokens tokens = asm_context->tokens;
+  const int data_count = asm_context->data_count;
+
+  if ((uint32_t)asm_context->address > fixup->address)
   {
-    if (parse_dc32(asm_context) != 0) { return -1; }
-    return 1;
+    asm_context->memory.erase(
+      fixup->address,
+      asm_context->address - fixup->address);
   }
-    else
-  if (strcasecmp(token, "dc64") == 0 ||
-      strcasecmp(token, "dq") == 0)
+
+  asm_context->memory.low_address = fixup->low_address;
+  asm_context->memory.high_address = fixup->high_address;
+  asm_context->address = fixup->address;
+  asm_context->pass = 1;
+
+  asm_context->tokens.pushback[0] = 0;
+  asm_context->tokens.pushback2[0] = 0;
+  asm_context->tokens.replay_ptr = Fixups::get_tokens(fixup);
+  asm_context->tokens.replay_end = asm_context->fixups.get_end();
+
+  int ret = fixup_assemble(asm_context, kind);
+
+  asm_context->pass = 2;
+  asm_context->tokens = tokens;
+  asm_context->data_count = data_count;
+
+  return ret;
+}
+
+// Returns -1 if the statement used a label that isn't defined yet and
+// can't be assembled again later.
+static int fixup_end(AsmContext *asm_context, int mark, int kind)
+{
+  const bool keep = asm_context->forward_reference;
+
+  asm_context->forward_reference = 0;
+
+  if (keep)
   {
-    if (parse_dc64(asm_context) != 0) { return -1; }
-    return 1;
+    if (!fixup_can_replay(asm_context, mark, kind)) { return -1; }
+    if (fixup_redo(asm_context, mark, kind) != 0) { return -1; }
   }
-    else
-  if (strcasecmp(token, "varuint") == 0)
+
+  return asm_context->fixups.end(mark, keep, kind, asm_context->address);
+}
+
+// With -threads, pass 2 keeps the tokens of an instruction for
+// assemble_parallel() instead of assembling it.  Pass 1's line map says
+// how much space the instruction takes so the statements after it still
+// get the right address.  Returns 1 if the instruction was kept, 0 if
+// it has to be assembled now.
+static int defer_instruction(AsmContext *asm_context, const char *instr)
+{
+  Tokens &tokens = asm_context->tokens;
+
+  if (asm_context->cpu_list_index == -1 ||
+      !cpu_list[asm_context->cpu_list_index].parallel ||
+      asm_context->line_map_index >= asm_context->line_map.count())
   {
-    if (parse_varuint(asm_context, 0) != 0) { return -1; }
-    return 1;
+    asm_context->line_map_index++;
+    return 0;
   }
-    else
-  if (strcasecmp(token, "varuint32") == 0)
+
+  const LineAddress &line_address =
+    asm_context->line_map[asm_context->line_map_index++];
+
+  // If pass 2 took a different path than pass 1 (an .if on a label that
+  // wasn't known yet on pass 1) the rest can't be trusted.
+  if (line_address.line != tokens.line ||
+      line_address.address != (uint32_t)asm_context->address)
   {
-    if (parse_varuint(asm_context, 5) != 0) { return -1; }
-    return 1;
+    asm_context->defer_instructions = 0;
+    return 0;
   }
-    else
-  if (strcasecmp(token, "resb") == 0)
+
+  Fixup fixup;
+
+  memset(&fixup, 0, sizeof(fixup));
+  fixup.address = asm_context->address;
+  fixup.flags = asm_context->flags;
+  fixup.line = tokens.line;
+  fixup.cpu_list_index = asm_context->cpu_list_index;
+  fixup.parse_directive = asm_context->parse_directive;
+  fixup.endian = asm_context->memory.endian;
+  fixup.segment = asm_context->segment;
+
+  int mark = asm_context->fixups.begin(fixup, tokens.filename);
+
+  asm_context->fixups.record(TOKEN_STRING, instr, strlen(instr), false, 0);
+
+  // The token after the instruction was pushed back by assemble() so it
+  // isn't recorded by tokens_get().
+  int token_type = tokens.pushback_type;
+
+  asm_context->fixups.record(
+    token_type,
+    tokens.pushback,
+    tokens.pushback_length,
+    tokens.pushback_has_value,
+    tokens.pushback_value);
+
+  if (token_type != TOKEN_EOF) { tokens.pushback[0] = 0; }
+
+  while (token_type != TOKEN_EOL && token_type != TOKEN_EOF)
+  {
+    char token[TOKENLEN];
+
+    token_type = tokens_get(asm_context, token, TOKENLEN);
+
+    if (token_type == TOKEN_EOF) { tokens_push(asm_context, token, token_type); }
+  }
+
+  asm_context->fixups.end(
+    mark,
+    true,
+    FIXUP_INSTRUCTION,
+    line_address.end_address);
+
+  asm_context->address = line_address.end_address;
+
+  return 1;
+}
+
+// Instructions for CPUs that can be assembled on threads only depend on
+// their tokens and the CPU settings, so when the same statement comes up
+// again (an unrolled loop or a macro used over and over) the bytes from
+// the first time are copied instead (see InstructionCache.h).  Only
+// statements that come out of a macro are looked up.  A statement read
+// straight from the source is almost never the same as another one, and
+// reading it ahead would only lose the token and expression caches.
+static bool instruction_cache_cpu(AsmContext *asm_context)
+{
+  return asm_context->cpu_list_index != -1 &&
+         cpu_list[asm_context->cpu_list_index].parallel &&
+         !asm_context->no_instruction_cache &&
+         !asm_context->single_pass &&
+         !asm_context->defer_instructions &&
+         !asm_context->memory.debug_lines &&
+         asm_context->list == NULL &&
+         asm_context->linker == NULL &&
+         asm_context->tokens.replay_ptr == NULL &&
+         tokens_source_offset(asm_context) == -1;
+}
+
+static int parse_instruction_cached(AsmContext *asm_context, char *instr)
+{
+  InstructionCache &instruction_cache = asm_context->instruction_cache;
+  Tokens &tokens = asm_context->tokens;
+  InstructionCacheMode mode;
+  char text[TOKENLEN];
+  char first_text[TOKENLEN];
+  Token token;
+  Token first;
+  int token_type;
+  bool cacheable = true;
+
+  memset(&mode, 0, sizeof(mode));
+  mode.cpu_list_index = asm_context->cpu_list_index;
+  mode.flags = asm_context->flags;
+  mode.extra_context = asm_context->extra_context;
+  mode.pass = asm_context->pass;
+  mode.endian = asm_context->memory.endian;
+  mode.segment = asm_context->segment;
+  mode.optimize = asm_context->optimize;
+
+  instruction_cache.begin(mode, instr);
+
+  const int error_count = asm_context->error_count;
+  const bool error = asm_context->error;
+
+  // The first operand was already read by assemble() and pushed back
+  // with any label turned into its value, so it's in the key as a
+  // number.  A label or $ anywhere else means the statement isn't
+  // likely to come up again the same way.
+  token_type = tokens_get(asm_context, first, first_text, TOKENLEN);
+
+  instruction_cache.record(
+    token_type,
+    first_text,
+    first.length,
+    first.has_value,
+    first.value);
+
+  while (token_type != TOKEN_EOL && token_type != TOKEN_EOF)
+  {
+    token_type = tokens_get(asm_context, token, text, TOKENLEN);
+
+    if (token.is_symbol || IS_TOKEN(text, '$')) { cacheable = false; }
+
+    instruction_cache.record(
+      token_type,
+      text,
+      token.length,
+      token.has_value,
+      token.value);
+  }
+
+  InstructionCacheEntry *entry =
+    cacheable ? instruction_cache.find() : NULL;
+
+  const uint32_t start_address = asm_context->address;
+
+  if (entry != NULL && entry->state == INSTRUCTION_CACHE_SAME)
+  {
+    if (asm_context->pass == 1 && asm_context->pass_1_write_disable == 1)
+    {
+      asm_context->address += entry->length;
+    }
+      else
+    {
+      asm_context->memory_write_block_inc(
+        entry->get_bytes(),
+        entry->length,
+        tokens.line);
+    }
+
+    if (token_type == TOKEN_EOF) { tokens_push(asm_context, text, token_type); }
+
+    instruction_cache.hit();
+
+    return entry->ret;
+  }
+
+  const int warning_count = asm_context->warning_count;
+
+  tokens.replay_ptr = instruction_cache.get_tokens();
+  tokens.replay_end = instruction_cache.get_end();
+
+  const int ret = asm_context->parse_instruction(asm_context, instr);
+
+  tokens.replay_ptr = NULL;
+  tokens.replay_end = NULL;
+
+  if (token_type == TOKEN_EOF) { tokens_push(asm_context, text, token_type); }
+
+  if (!cacheable) { return ret; }
+
+  instruction_cache.miss();
+
+  const int length = asm_context->address - start_address;
+
+  if (ret < 0 ||
+      length <= 0 ||
+      length > INSTRUCTION_CACHE_MAX_BYTES ||
+      asm_context->error_count != error_count ||
+      asm_context->warning_count != warning_count ||
+      asm_context->error != error)
+  {
+    return ret;
+  }
+
+  uint8_t bytes[INSTRUCTION_CACHE_MAX_BYTES];
+
+  if (asm_context->pass == 1 && asm_context->pass_1_write_disable == 1)
   {
-    if (parse_resb(asm_context, 1) != 0) { return -1; }
-    return 1;
+    memset(bytes, 0, length);
   }
     else
-  if (strcasecmp(token, "resw") == 0)
   {
-    if (parse_resb(asm_context, 2) != 0) { return -1; }
-    return 1;
+    asm_context->memory.read_block(start_address, bytes, length);
+  }
+
+  if (entry == NULL)
+  {
+    instruction_cache.add(start_address, bytes, length, ret);
   }
     else
-  if (asm_context->cpu_type != CPU_TYPE_WEBASM && strcasecmp(token, "end") == 0)
+  if (entry->state == INSTRUCTION_CACHE_NEW && entry->address != start_address)
   {
-    // This is breaking webasm which has an "end" instruction.
-    return 2;
+    entry->state =
+      entry->ret == ret &&
+      entry->length == length &&
+      memcmp(entry->get_bytes(), bytes, length) == 0 ?
+        INSTRUCTION_CACHE_SAME : INSTRUCTION_CACHE_ADDRESS;
   }
 
-  return 0;
+  return ret;
 }
 
 int assemble(AsmContext *asm_context)
@@ -402,6 +904,8 @@ int assemble(AsmContext *asm_context)
       else
     if (token_type == TOKEN_LABEL)
     {
+      asm_context->include_cache.not_cacheable();
+
       int param_count_temp;
       if (macros_lookup(&asm_context->macros, token, &param_count_temp) != NULL)
       {
@@ -409,16 +913,41 @@ int assemble(AsmContext *asm_context)
         return -1;
       }
 
-      if (asm_context->symbols.append(token, asm_context->address / asm_context->bytes_per_address) == -1)
+      // With -single_pass, uses of this name earlier in the scope were
+      // already given the global label's value.
+      if (asm_context->single_pass &&
+          asm_context->symbols.get_scope() != 0 &&
+          asm_context->symbols.find(token) != NULL)
       {
         return -1;
       }
+
+      int ret = asm_context->symbols.append(token, asm_context->address / asm_context->bytes_per_address);
+
+      if (ret != 0)
+      {
+        print_error_label(asm_context, token, ret);
+        return -1;
+      }
     }
       else
     if (token_type == TOKEN_POUND || IS_TOKEN(token,'.'))
     {
+      int mark = -1;
+
+      if (asm_context->single_pass)
+      {
+        mark = fixup_begin(asm_context, NULL);
+        if (mark < 0) { return -1; }
+      }
+
       int n = parse_directives(asm_context);
 
+      if (mark >= 0 && fixup_end(asm_context, mark, FIXUP_DIRECTIVE) != 0)
+      {
+        return -1;
+      }
+
       // If n is 3, then this is ending a .repeat directive.
       if (n == 3) { return 3; }
 
@@ -431,8 +960,23 @@ int assemble(AsmContext *asm_context)
       else
     if (token_type == TOKEN_STRING)
     {
+      int mark = -1;
+
+      if (asm_context->single_pass)
+      {
+        mark = fixup_begin(asm_context, token);
+        if (mark < 0) { return -1; }
+      }
+
       int ret = assembler_directive(asm_context, token);
 
+      if (mark >= 0 && ret != 0 &&
+          fixup_end(asm_context, mark, ret == 1 ? FIXUP_DATA : FIXUP_NONE) != 0)
+      {
+        return -1;
+      }
+
+      if (ret != 0) { asm_context->include_cache.not_cacheable(); }
       if (ret == 2) { break; }
       if (ret == -1) { return -1; }
 
@@ -466,7 +1010,7 @@ int assemble(AsmContext *asm_context)
 
             if (ptr == TOKENLEN - 1)
             {
-              printf("Internal Error: token overflow at %s:%d.\n",
+              fprintf(asm_context->messages, "Internal Error: token overflow at %s:%d.\n",
                 __FILE__, __LINE__);
               return -1;
             }
@@ -476,12 +1020,51 @@ int assemble(AsmContext *asm_context)
           tokens_unget_char(asm_context, ch);
           macros_strip(token2);
           macros_append(asm_context, token, token2, 0);
+
+          if (mark >= 0 && fixup_end(asm_context, mark, FIXUP_NONE) != 0)
+          {
+            return -1;
+          }
         }
           else
         {
+          asm_context->include_cache.not_cacheable();
+
           tokens_push(asm_context, token2, token_type2);
 
-          ret = asm_context->parse_instruction(asm_context, token);
+          // Only CPUs where a label's value can't change the size of an
+          // instruction can be assembled in one pass.
+          if (mark >= 0 && !single_pass_cpu(asm_context)) { return -1; }
+
+          const int line = asm_context->tokens.line;
+
+          ret = asm_context->defer_instructions ?
+            defer_instruction(asm_context, token) : 0;
+
+          if (ret == 0)
+          {
+            ret = instruction_cache_cpu(asm_context) ?
+              parse_instruction_cached(asm_context, token) :
+              asm_context->parse_instruction(asm_context, token);
+          }
+
+          if (mark >= 0 && ret >= 0 &&
+              fixup_end(asm_context, mark, FIXUP_INSTRUCTION) != 0)
+          {
+            return -1;
+          }
+
+          if (asm_context->pass == 1 && asm_context->record_line_map &&
+              ret >= 0)
+          {
+            LineAddress line_address;
+
+            line_address.line = line;
+            line_address.address = start_address;
+            line_address.end_address = asm_context->address;
+
+            asm_context->line_map.append(line_address);
+          }
 
           if (asm_context->list != NULL && asm_context->write_list_file == 1)
           {
@@ -517,3 +1100,117 @@ int assemble(AsmContext *asm_context)
   return 0;
 }
 
+
+// Assemble the statements that used labels before they were defined
+// again, now that every label is known.
+static int assemble_fixups(AsmContext *asm_context)
+{
+  // A name .ifdef didn't find that turned out to be a label after all.
+  for (auto name : asm_context->fixups.undefined)
+  {
+    if (asm_context->symbols.find(name) != NULL) { return -1; }
+  }
+
+  Tokens &tokens = asm_context->tokens;
+  const int address = asm_context->address;
+  const int line = tokens.line;
+  const char *filename = tokens.filename;
+  const int cpu_list_index = asm_context->cpu_list_index;
+  const parse_directive_t parse_directive = asm_context->parse_directive;
+  const uint32_t flags = asm_context->flags;
+  const int endian = asm_context->memory.endian;
+  const int segment = asm_context->segment;
+  const int data_count = asm_context->data_count;
+  int ret = 0;
+
+  const Fixup *fixup;
+  int offset = 0;
+
+  while ((fixup = asm_context->fixups.get(offset)) != NULL)
+  {
+    asm_context->set_cpu(fixup->cpu_list_index);
+    asm_context->parse_directive = fixup->parse_directive;
+    asm_context->flags = fixup->flags;
+    asm_context->memory.endian = fixup->endian;
+    asm_context->segment = fixup->segment;
+    asm_context->symbols.set_scope(fixup->scope);
+    asm_context->address = fixup->address;
+
+    tokens.line = fixup->line;
+    tokens.filename = Fixups::get_filename(fixup);
+    tokens.replay_ptr = Fixups::get_tokens(fixup);
+    tokens.replay_end = (const uint8_t *)fixup + fixup->size;
+
+    ret = fixup_assemble(asm_context, fixup->kind);
+
+    // The statement has to come out the same size as it did the first
+    // time since the labels after it were already given addresses.
+    if (ret != 0 || (uint32_t)asm_context->address != fixup->end_address)
+    {
+      ret = -1;
+      break;
+    }
+
+    offset += fixup->size;
+  }
+
+  tokens.replay_ptr = NULL;
+  tokens.replay_end = NULL;
+  tokens.line = line;
+  tokens.filename = filename;
+
+  if (cpu_list_index != -1) { asm_context->set_cpu(cpu_list_index); }
+  asm_context->parse_directive = parse_directive;
+  asm_context->flags = flags;
+  asm_context->memory.endian = endian;
+  asm_context->segment = segment;
+  asm_context->address = address;
+  asm_context->data_count = data_count;
+
+  return ret < 0 ? -1 : 0;
+}
+
+// Assemble the source in one pass (the -single_pass option).  Statements
+// that use a label before it's defined are given a placeholder value and
+// are assembled again at the end.  If that can't be done (an error, a CPU
+// that doesn't support it, an instruction that changed size) -1 is
+// returned with asm_context put back so the normal two passes can be run.
+int assemble_single_pass(AsmContext *asm_context)
+{
+  const int endian = asm_context->memory.endian;
+  const int segment = asm_context->segment;
+  const uint32_t flags = asm_context->flags;
+  const bool msp430_cpu4 = asm_context->msp430_cpu4;
+
+  asm_context->pass = 2;
+  asm_context->single_pass = 1;
+  asm_context->forward_reference = 0;
+  asm_context->fixups.reset();
+  asm_context->init();
+
+  int ret = assemble(asm_context);
+
+  asm_context->single_pass = 0;
+  asm_context->fixups.cancel();
+
+  if (ret == 0 && asm_context->error_count == 0)
+  {
+    ret = assemble_fixups(asm_context);
+
+    if (ret == 0) { return 0; }
+  }
+
+  asm_context->fixups.reset();
+  asm_context->symbols.reset();
+  asm_context->memory.clear();
+  asm_context->memory.endian = endian;
+  asm_context->segment = segment;
+  asm_context->flags = flags;
+  asm_context->msp430_cpu4 = msp430_cpu4;
+  asm_context->error_count = 0;
+  asm_context->error = 0;
+  asm_context->pass = 1;
+  asm_context->init();
+
+  return -1;
+}
@@ -14,16 +14,23 @@
 
 #include <stdio.h>
 
+#include "common/assemble_parallel.h"
 #include "common/cpu_list.h"
+#include "common/ExpressionCache.h"
+#include "common/Fixups.h"
+#include "common/IncludeCache.h"
+#include "common/InstructionCache.h"
 #include "common/Linker.h"
 #include "common/Macros.h"
 #include "common/Memory.h"
 #include "common/print_error.h"
+#include "common/StringHeap.h"
 #include "common/Symbols.h"
+#include "common/TokenCache.h"
 #include "common/tokens.h"
+#include "common/Vector.h"
 
 //#define TOKENLEN 512
-#define PARAM_STACK_LEN 4096
 #define INCLUDE_PATH_LEN 4096
 
 //#define DL_EMPTY -1
@@ -40,6 +47,7 @@ public:
   ~AsmContext();
 
   void init();
+  void reset();
   void print_info(FILE *out);
   void set_cpu(int index);
   int set_cpu(const char *name);
@@ -75,15 +83,30 @@ public:
     memory.write(address++, data, line);
   }
 
+  void memory_write_block_inc(const uint8_t *data, int length, int line)
+  {
+    memory.write_block(address, data, length, line);
+    address += length;
+  }
+
   Memory memory;
   Tokens tokens;
   Symbols symbols;
   Macros macros;
+  TokenCache token_cache;
+  IncludeCache include_cache;
+  InstructionCache instruction_cache;
+  ExpressionCache expression_cache;
+  Fixups fixups;
+  StringHeap dependencies;
+  Vector<LineAddress> line_map;
   parse_instruction_t parse_instruction;
   parse_directive_t parse_directive;
   link_function_t link_function;
   list_output_t list_output;
   FILE *list;
+  FILE *messages;
+  const char *cache_dir;
   int address;
   int segment;
   int pass;
@@ -91,12 +114,11 @@ public:
   int data_count;
   int code_count;
   int error_count;
+  int warning_count;
   int ifdef_count;
   int parsing_ifdef;
+  int line_map_index;
   Linker *linker;
-  char def_param_stack_data[PARAM_STACK_LEN];
-  int def_param_stack_ptr[MAX_NESTED_MACROS + 1];
-  int def_param_stack_count;
   char include_path[INCLUDE_PATH_LEN];
   int cpu_list_index;
   uint8_t cpu_type;
@@ -115,8 +137,14 @@ public:
   bool dump_symbols           : 1;
   bool dump_macros            : 1;
   bool optimize               : 1;
+  bool no_instruction_cache   : 1;
+  bool verbose                : 1;
   bool ignore_number_postfix  : 1;
   bool in_repeat              : 1;
+  bool single_pass            : 1;
+  bool forward_reference      : 1;
+  bool record_line_map        : 1;
+  bool defer_instructions     : 1;
   uint32_t flags;
   uint32_t extra_context;
 };
@@ -125,6 +153,7 @@ int assembler_directive(AsmContext *asm_context, char *token);
 int assembler_link_file(AsmContext *asm_context, const char *filename);
 int assembler_link(AsmContext *asm_context);
 int assemble(AsmContext *asm_context);
+int assemble_single_pass(AsmContext *asm_context);
 
 #endif
 
@@ -156,7 +156,7 @@ int link_not_supported(
   uint8_t *obj_file,
   uint32_t obj_size)
 {
-  printf("Error: This platform doesn't support linking.\n");
+  fprintf(asm_context->messages, "Error: This platform doesn't support linking.\n");
   return -1;
 }
 
@@ -176,6 +176,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_16,
     parse_instruction_msp430,
     NULL,
@@ -198,6 +200,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_24,
     parse_instruction_msp430,
     NULL,
@@ -222,6 +226,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_16,
     parse_instruction_1802,
     NULL,
@@ -246,6 +252,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_16,
     parse_instruction_4004,
     NULL,
@@ -270,6 +278,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_16,
     parse_instruction_6502,
     NULL,
@@ -294,6 +304,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_16,
     parse_instruction_65816,
     NULL,
@@ -318,6 +330,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_16,
     parse_instruction_65816,
     NULL,
@@ -342,6 +356,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_16,
     parse_instruction_6800,
     NULL,
@@ -366,6 +382,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_16,
     parse_instruction_6809,
     NULL,
@@ -390,6 +408,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_16,
     parse_instruction_68hc08,
     NULL,
@@ -414,6 +434,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_32,
     parse_instruction_68000,
     NULL,
@@ -438,6 +460,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_16,
     parse_instruction_8008,
     NULL,
@@ -462,6 +486,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_16,
     parse_instruction_8048,
     NULL,
@@ -484,6 +510,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_16,
     parse_instruction_8048,
     NULL,
@@ -508,6 +536,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_16,
     parse_instruction_8051,
     NULL,
@@ -532,6 +562,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_16,
     parse_instruction_86000,
     NULL,
@@ -556,6 +588,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_16,
     parse_instruction_agc,
     NULL,
@@ -580,6 +614,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_32,
     parse_instruction_arc,
     NULL,
@@ -604,6 +640,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    1,
+    1,
     SREC_32,
     parse_instruction_arm,
     NULL,
@@ -628,6 +666,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    1,
+    1,
     SREC_32,
     parse_instruction_arm64,
     NULL,
@@ -652,6 +692,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_16,
     parse_instruction_avr8,
     NULL,
@@ -676,6 +718,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_32,
     parse_instruction_cell,
     NULL,
@@ -700,6 +744,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_16,
     parse_instruction_copper,
     NULL,
@@ -724,6 +770,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_16,
     parse_instruction_cp1610,
     NULL,
@@ -748,6 +796,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_16,
     parse_instruction_dotnet,
     NULL,
@@ -772,6 +822,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_16,
     parse_instruction_dspic,
     NULL,
@@ -796,6 +848,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_32,
     parse_instruction_ebpf,
     NULL,
@@ -820,6 +874,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_32,
     parse_instruction_epiphany,
     NULL,
@@ -844,6 +900,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_16,
     parse_instruction_f100_l,
     NULL,
@@ -868,6 +926,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_16,
     parse_instruction_f8,
     NULL,
@@ -892,6 +952,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_16,
     parse_instruction_java,
     NULL,
@@ -916,6 +978,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_16,
     parse_instruction_lc3,
     NULL,
@@ -940,6 +1004,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_16,
     parse_instruction_m8c,
     NULL,
@@ -964,6 +1030,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    1,
+    1,
     SREC_32,
     parse_instruction_mips,
     NULL,
@@ -986,6 +1054,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    1,
+    1,
     SREC_32,
     parse_instruction_mips,
     NULL,
@@ -1008,6 +1078,8 @@ struct _cpu_list cpu_list[] =
     0,
     1,
     0,
+    0,
+    0,
     SREC_32,
     parse_instruction_mips,
     NULL,
@@ -1030,6 +1102,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    1,
+    1,
     SREC_32,
     parse_instruction_mips,
     NULL,
@@ -1052,6 +1126,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_32,
     parse_instruction_mips,
     NULL,
@@ -1076,6 +1152,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_16,
     parse_instruction_pdp8,
     NULL,
@@ -1100,6 +1178,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_16,
     parse_instruction_pdp11,
     NULL,
@@ -1124,6 +1204,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     1,
+    0,
+    0,
     SREC_16,
     parse_instruction_pdk13,
     NULL,
@@ -1146,6 +1228,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     1,
+    0,
+    0,
     SREC_16,
     parse_instruction_pdk14,
     NULL,
@@ -1168,6 +1252,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     1,
+    0,
+    0,
     SREC_16,
     parse_instruction_pdk15,
     NULL,
@@ -1190,6 +1276,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     1,
+    0,
+    0,
     SREC_16,
     parse_instruction_pdk16,
     NULL,
@@ -1214,6 +1302,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_16,
     parse_instruction_pic14,
     NULL,
@@ -1238,6 +1328,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_16,
     parse_instruction_pic18,
     NULL,
@@ -1262,6 +1354,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_24,
     parse_instruction_dspic,
     NULL,
@@ -1286,6 +1380,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    1,
+    1,
     SREC_32,
     parse_instruction_powerpc,
     NULL,
@@ -1310,6 +1406,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_16,
     parse_instruction_propeller,
     NULL,
@@ -1334,6 +1432,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_16,
     parse_instruction_propeller2,
     NULL,
@@ -1358,6 +1458,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_32,
     parse_instruction_ps2_ee_vu,
     NULL,
@@ -1380,6 +1482,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_32,
     parse_instruction_ps2_ee_vu,
     NULL,
@@ -1404,6 +1508,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_32,
     parse_instruction_rv32em,
     NULL,
@@ -1428,6 +1534,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    1,
+    1,
     SREC_32,
     parse_instruction_riscv,
     NULL,
@@ -1450,6 +1558,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    1,
+    1,
     SREC_32,
     parse_instruction_riscv,
     NULL,
@@ -1474,6 +1584,8 @@ struct _cpu_list cpu_list[] =
     1,
     0,
     0,
+    0,
+    0,
     SREC_16,
     parse_instruction_sh4,
     NULL,
@@ -1498,6 +1610,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_32,
     parse_instruction_sparc,
     NULL,
@@ -1522,6 +1636,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_16,
     parse_instruction_stm8,
     NULL,
@@ -1546,6 +1662,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_16,
     parse_instruction_super_fx,
     NULL,
@@ -1570,6 +1688,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_16,
     parse_instruction_sweet16,
     NULL,
@@ -1594,6 +1714,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_32,
     parse_instruction_thumb,
     NULL,
@@ -1618,6 +1740,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_16,
     parse_instruction_tms340,
     NULL,
@@ -1642,6 +1766,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_16,
     parse_instruction_tms1000,
     NULL,
@@ -1664,6 +1790,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_16,
     parse_instruction_tms1100,
     NULL,
@@ -1688,6 +1816,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_16,
     parse_instruction_tms9900,
     NULL,
@@ -1712,6 +1842,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_16,
     parse_instruction_unsp,
     NULL,
@@ -1736,6 +1868,8 @@ struct _cpu_list cpu_list[] =
     1,
     0,
     0,
+    0,
+    0,
     SREC_16,
     parse_instruction_webasm,
     NULL,
@@ -1760,6 +1894,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_16,
     parse_instruction_xtensa,
     NULL,
@@ -1784,6 +1920,8 @@ struct _cpu_list cpu_list[] =
     0,
     0,
     0,
+    0,
+    0,
     SREC_16,
     parse_instruction_z80,
     NULL,
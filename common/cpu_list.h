@@ -118,6 +118,10 @@ enum
 // is_dollar_hex: Some old CPU's have assemblers that represent hex as $100 ..
 //                even if this is set, naken_asm will still allow 0x100
 // can_tick_end_string: Some wierd z80 syntax
+// single_pass: The size of an instruction doesn't depend on the value of
+//              a label so -single_pass can be used.
+// parallel: parse_instruction() only uses asm_context and only writes the
+//           instruction's own bytes, so pass 2 can be done on threads.
 // srec_size: size of data in an srec file
 // parse_instruction: function name to assemble the next instruction.
 // parse_directive: extra function for special directives
@@ -141,6 +145,8 @@ typedef struct _cpu_list
   uint8_t strings_have_slashes   : 1;
   uint8_t ignore_number_postfix  : 1;
   uint8_t numbers_dont_have_dots : 1;
+  uint8_t single_pass            : 1;
+  uint8_t parallel               : 1;
   uint8_t srec_size              : 2;
   parse_instruction_t parse_instruction;
   parse_directive_t parse_directive;
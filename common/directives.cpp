@@ -12,15 +12,18 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 
 #include "asm/common.h"
 #include "common/add_bin.h"
 #include "common/assembler.h"
 #include "common/cpu_list.h"
 #include "common/eval_expression.h"
+#include "common/directives.h"
 #include "common/directives_data.h"
 #include "common/directives_if.h"
 #include "common/directives_include.h"
+#include "common/TableIndex.h"
 
 int parse_org(AsmContext *asm_context)
 {
@@ -195,9 +198,26 @@ static int parse_export(AsmContext *asm_context)
 
   if (asm_context->pass == 2)
   {
+    // With -single_pass the label can still be defined later.
+    if (asm_context->single_pass &&
+        asm_context->symbols.find(token) == NULL)
+    {
+      asm_context->forward_reference = 1;
+      return 0;
+    }
+
     if (asm_context->symbols.export_symbol(token) != 0)
     {
-      print_not_defined(asm_context, token);
+      if (asm_context->symbols.find(token) != NULL)
+      {
+        fprintf(asm_context->messages,
+          "Error: Cannot export local variable '%s'\n", token);
+      }
+        else
+      {
+        print_not_defined(asm_context, token);
+      }
+
       return -1;
     }
   }
@@ -245,8 +265,9 @@ static int parse_equ(AsmContext *asm_context)
 int parse_repeat(AsmContext *asm_context)
 {
   char token[TOKENLEN];
-  int token_type = tokens_get(asm_context, token, TOKENLEN);
-  int count = atoi(token);
+  Token next;
+  int token_type = tokens_get(asm_context, next, token, TOKENLEN);
+  int count = (int)next.value;
 
   if (token_type != TOKEN_NUMBER || count <= 0)
   {
@@ -267,16 +288,26 @@ int parse_repeat(AsmContext *asm_context)
   asm_context->in_repeat = 0;
 
   uint32_t address_end = asm_context->address;
-  uint32_t r;
+  uint32_t length = address_end - address_start;
   int n;
 
-  for (n = 0; n < count - 1; n++)
+  if (asm_context->pass == 1 && asm_context->pass_1_write_disable == 1)
   {
-    for (r = address_start; r < address_end; r++)
+    asm_context->address += length * (count - 1);
+  }
+    else
+  if (length != 0 && count > 1)
+  {
+    uint8_t *data = (uint8_t *)malloc(length);
+
+    asm_context->memory.read_block(address_start, data, length);
+
+    for (n = 0; n < count - 1; n++)
     {
-      uint8_t data = asm_context->memory_read(r);
-      add_bin8(asm_context, data, 0);
+      asm_context->memory_write_block_inc(data, length, DL_NO_CG);
     }
+
+    free(data);
   }
 
   if (asm_context->list != NULL && asm_context->write_list_file == 1)
@@ -288,6 +319,106 @@ int parse_repeat(AsmContext *asm_context)
   return 0;
 }
 
+// Look up a directive name (in any case) in a NULL terminated table and
+// return its id or -1 if it's not there.
+int directive_find(
+  TableIndex &index,
+  const DirectiveName *table,
+  const char *token)
+{
+  char name[16];
+  int n;
+
+  for (n = 0; token[n] != 0; n++)
+  {
+    if (n == sizeof(name) - 1) { return -1; }
+    name[n] = tolower(token[n]);
+  }
+
+  name[n] = 0;
+
+  n = index.find(table, &DirectiveName::name, name);
+
+  return n == -1 ? -1 : table[n].id;
+}
+
+enum
+{
+  DIRECTIVE_DEFINE,
+  DIRECTIVE_IFDEF,
+  DIRECTIVE_IFNDEF,
+  DIRECTIVE_IF,
+  DIRECTIVE_ENDIF,
+  DIRECTIVE_ELSE,
+  DIRECTIVE_REPEAT,
+  DIRECTIVE_ENDR,
+  DIRECTIVE_INCLUDE,
+  DIRECTIVE_BINFILE,
+  DIRECTIVE_CODE,
+  DIRECTIVE_BSS,
+  DIRECTIVE_MSP430_CPU4,
+  DIRECTIVE_MACRO,
+  DIRECTIVE_PRAGMA,
+  DIRECTIVE_DEVICE,
+  DIRECTIVE_SET,
+  DIRECTIVE_EXPORT,
+  DIRECTIVE_ENTRY_POINT,
+  DIRECTIVE_ALIGN_BITS,
+  DIRECTIVE_ALIGN_BYTES,
+  DIRECTIVE_EQU,
+  DIRECTIVE_SCOPE,
+  DIRECTIVE_ENDS,
+  DIRECTIVE_FUNC,
+  DIRECTIVE_ENDF,
+  DIRECTIVE_LOW_ADDRESS,
+  DIRECTIVE_HIGH_ADDRESS,
+  DIRECTIVE_BIG_ENDIAN,
+  DIRECTIVE_LITTLE_ENDIAN,
+  DIRECTIVE_LIST,
+  DIRECTIVE_DATA_FILL
+};
+
+static const DirectiveName directive_names[] =
+{
+  { "define", DIRECTIVE_DEFINE },
+  { "ifdef", DIRECTIVE_IFDEF },
+  { "ifndef", DIRECTIVE_IFNDEF },
+  { "if", DIRECTIVE_IF },
+  { "endif", DIRECTIVE_ENDIF },
+  { "else", DIRECTIVE_ELSE },
+  { "repeat", DIRECTIVE_REPEAT },
+  { "endr", DIRECTIVE_ENDR },
+  { "include", DIRECTIVE_INCLUDE },
+  { "binfile", DIRECTIVE_BINFILE },
+  { "code", DIRECTIVE_CODE },
+  { "bss", DIRECTIVE_BSS },
+  { "msp430_cpu4", DIRECTIVE_MSP430_CPU4 },
+  { "macro", DIRECTIVE_MACRO },
+  { "pragma", DIRECTIVE_PRAGMA },
+  { "device", DIRECTIVE_DEVICE },
+  { "set", DIRECTIVE_SET },
+  { "export", DIRECTIVE_EXPORT },
+  { "entry_point", DIRECTIVE_ENTRY_POINT },
+  { "align", DIRECTIVE_ALIGN_BITS },
+  { "align_bits", DIRECTIVE_ALIGN_BITS },
+  { "align_bytes", DIRECTIVE_ALIGN_BYTES },
+  { "equ", DIRECTIVE_EQU },
+  { "def", DIRECTIVE_EQU },
+  { "scope", DIRECTIVE_SCOPE },
+  { "ends", DIRECTIVE_ENDS },
+  { "func", DIRECTIVE_FUNC },
+  { "endf", DIRECTIVE_ENDF },
+  { "low_address", DIRECTIVE_LOW_ADDRESS },
+  { "high_address", DIRECTIVE_HIGH_ADDRESS },
+  { "big_endian", DIRECTIVE_BIG_ENDIAN },
+  { "little_endian", DIRECTIVE_LITTLE_ENDIAN },
+  { "list", DIRECTIVE_LIST },
+  { "data_fill", DIRECTIVE_DATA_FILL },
+  { NULL, 0 }
+};
+
+static TableIndex directive_index;
+
 int parse_directives(AsmContext *asm_context)
 {
   char token[TOKENLEN];
@@ -305,269 +436,318 @@ int parse_directives(AsmContext *asm_context)
     return -1;
   }
 
-  if (strcasecmp(token, "define") == 0)
-  {
-    if (macros_parse(asm_context, IS_DEFINE) != 0) { return -1; }
-  }
-    else
-  if (strcasecmp(token, "ifdef") == 0)
-  {
-    parse_ifdef(asm_context, 0);
-  }
-    else
-  if (strcasecmp(token, "ifndef") == 0)
-  {
-    parse_ifdef(asm_context, 1);
-  }
-    else
-  if (strcasecmp(token, "if") == 0)
+  const int directive = directive_find(directive_index, directive_names, token);
+
+  // An include file can only be replayed from include_cache if it does
+  // nothing but define macros.
+  if (directive != DIRECTIVE_DEFINE &&
+      directive != DIRECTIVE_MACRO &&
+      directive != DIRECTIVE_EQU)
   {
-    parse_if(asm_context);
+    asm_context->include_cache.not_cacheable();
   }
-    else
-  if (strcasecmp(token, "endif") == 0)
+
+  switch (directive)
   {
-    if (asm_context->ifdef_count < 1)
+    case DIRECTIVE_DEFINE:
     {
-      printf("Error: unmatched .endif at %s:%d\n",
-        asm_context->tokens.filename, asm_context->ifdef_count);
-      return -1;
+      if (macros_parse(asm_context, IS_DEFINE) != 0) { return -1; }
+      break;
     }
 
-    return 0;
-  }
-    else
-  if (strcasecmp(token, "else") == 0)
-  {
-    if (asm_context->ifdef_count < 1)
+    case DIRECTIVE_IFDEF:
     {
-      printf("Error: Unmatched .else at %s:%d\n",
-        asm_context->tokens.filename,
-        asm_context->ifdef_count);
-      return -1;
+      parse_ifdef(asm_context, 0);
+      break;
     }
 
-    return 4;
-  }
-    else
-  if (strcasecmp(token, "repeat") == 0)
-  {
-    if (asm_context->in_repeat == 1)
+    case DIRECTIVE_IFNDEF:
     {
-      print_error_unexp(asm_context, token);
-      return -1;
+      parse_ifdef(asm_context, 1);
+      break;
     }
 
-    if (parse_repeat(asm_context) == -1) { return -1; }
-  }
-    else
-  if (strcasecmp(token, "endr") == 0)
-  {
-    if (asm_context->in_repeat == 0)
+    case DIRECTIVE_IF:
     {
-      print_error_unexp(asm_context, token);
-      return -1;
+      parse_if(asm_context);
+      break;
     }
 
-    return 3;
-  }
-    else
-  if (strcasecmp(token, "include") == 0)
-  {
-    if (include_parse(asm_context) != 0) { return -1; }
-  }
-    else
-  if (strcasecmp(token, "binfile") == 0)
-  {
-    if (binfile_parse(asm_context) != 0) { return -1; }
-  }
-    else
-  if (strcasecmp(token, "code") == 0)
-  {
-    asm_context->segment = SEGMENT_CODE;
-  }
-    else
-  if (strcasecmp(token, "bss") == 0)
-  {
-    asm_context->segment = SEGMENT_BSS;
-  }
-    else
-  if (strcasecmp(token, "msp430_cpu4") == 0)
-  {
-    asm_context->msp430_cpu4 = 1;
-  }
-    else
-  if (strcasecmp(token, "macro") == 0)
-  {
-    if (macros_parse(asm_context, IS_MACRO) != 0) { return -1; }
-  }
-    else
-  if (strcasecmp(token, "pragma") == 0)
-  {
-    if (parse_pragma(asm_context) != 0) { return -1; }
-  }
-    else
-  if (strcasecmp(token, "device") == 0)
-  {
-    if (parse_device(asm_context) != 0) { return -1; }
-  }
-    else
-  if (strcasecmp(token, "set") == 0)
-  {
-    if (parse_set(asm_context) != 0) { return -1; }
-  }
-    else
-  if (strcasecmp(token, "export") == 0)
-  {
-    if (parse_export(asm_context) != 0) { return -1; }
-  }
-    else
-  if (strcasecmp(token, "entry_point") == 0)
-  {
-    if (parse_entry_point(asm_context) != 0) { return -1; }
-  }
-    else
-  if (strcasecmp(token, "align") == 0 ||
-      strcasecmp(token, "align_bits") == 0)
-  {
-    if (parse_align_bits(asm_context) != 0) { return -1; }
-  }
-    else
-  if (strcasecmp(token, "align_bytes") == 0)
-  {
-    if (parse_align_bytes(asm_context) != 0) { return -1; }
-  }
-    else
-  if (strcasecmp(token, "equ") == 0 || strcasecmp(token, "def") == 0)
-  {
-    if (parse_equ(asm_context) != 0) { return -1; }
-  }
-    else
-  if (strcasecmp(token, "scope") == 0)
-  {
-    if (asm_context->symbols.scope_start() != 0)
+    case DIRECTIVE_ENDIF:
     {
-      printf("Error: Nested scopes are not allowed. %s:%d\n",
-        asm_context->tokens.filename,
-        asm_context->tokens.line);
-      return -1;
+      if (asm_context->ifdef_count < 1)
+      {
+        fprintf(asm_context->messages, "Error: unmatched .endif at %s:%d\n",
+          asm_context->tokens.filename, asm_context->ifdef_count);
+        return -1;
+      }
+
+      return 0;
     }
-  }
-    else
-  if (strcasecmp(token, "ends") == 0)
-  {
-    asm_context->symbols.scope_end();
-  }
-    else
-  if (strcasecmp(token, "func") == 0)
-  {
-    char token[TOKENLEN];
-    //int token_type;
 
-    tokens_get(asm_context, token, TOKENLEN);
-    asm_context->symbols.append(
-      token,
-      asm_context->address / asm_context->bytes_per_address);
+    case DIRECTIVE_ELSE:
+    {
+      if (asm_context->ifdef_count < 1)
+      {
+        fprintf(asm_context->messages, "Error: Unmatched .else at %s:%d\n",
+          asm_context->tokens.filename,
+          asm_context->ifdef_count);
+        return -1;
+      }
+
+      return 4;
+    }
 
-    if (asm_context->symbols.scope_start() != 0)
+    case DIRECTIVE_REPEAT:
     {
-      printf("Error: Nested scopes are not allowed. %s:%d\n",
-        asm_context->tokens.filename,
-        asm_context->tokens.line);
-      return -1;
+      if (asm_context->in_repeat == 1)
+      {
+        print_error_unexp(asm_context, token);
+        return -1;
+      }
+
+      if (parse_repeat(asm_context) == -1) { return -1; }
+      break;
     }
-  }
-    else
-  if (strcasecmp(token, "endf") == 0)
-  {
-    asm_context->symbols.scope_end();
-  }
-    else
-  if (strcasecmp(token, "low_address") == 0)
-  {
-    if (parse_low_address(asm_context) != 0) { return -1; }
-  }
-    else
-  if (strcasecmp(token, "high_address") == 0)
-  {
-    if (parse_high_address(asm_context) != 0) { return -1; }
-  }
-    else
-  if (strcasecmp(token, "big_endian") == 0)
-  {
-    asm_context->memory.endian = ENDIAN_BIG;
-  }
-    else
-  if (strcasecmp(token, "little_endian") == 0)
-  {
-    asm_context->memory.endian = ENDIAN_LITTLE;
-  }
-    else
-  if (strcasecmp(token, "list") == 0)
-  {
-    if (asm_context->pass == 2 && asm_context->list != NULL)
+
+    case DIRECTIVE_ENDR:
     {
-      asm_context->write_list_file = 1;
-      putc('\n', asm_context->list);
+      if (asm_context->in_repeat == 0)
+      {
+        print_error_unexp(asm_context, token);
+        return -1;
+      }
+
+      return 3;
+    }
+
+    case DIRECTIVE_INCLUDE:
+    {
+      if (include_parse(asm_context) != 0) { return -1; }
+      break;
+    }
+
+    case DIRECTIVE_BINFILE:
+    {
+      if (binfile_parse(asm_context) != 0) { return -1; }
+      break;
+    }
+
+    case DIRECTIVE_CODE:
+    {
+      asm_context->segment = SEGMENT_CODE;
+      break;
+    }
+
+    case DIRECTIVE_BSS:
+    {
+      asm_context->segment = SEGMENT_BSS;
+      break;
+    }
+
+    case DIRECTIVE_MSP430_CPU4:
+    {
+      asm_context->msp430_cpu4 = 1;
+      break;
+    }
+
+    case DIRECTIVE_MACRO:
+    {
+      if (macros_parse(asm_context, IS_MACRO) != 0) { return -1; }
+      break;
+    }
+
+    case DIRECTIVE_PRAGMA:
+    {
+      if (parse_pragma(asm_context) != 0) { return -1; }
+      break;
+    }
+
+    case DIRECTIVE_DEVICE:
+    {
+      if (parse_device(asm_context) != 0) { return -1; }
+      break;
+    }
+
+    case DIRECTIVE_SET:
+    {
+      if (parse_set(asm_context) != 0) { return -1; }
+      break;
+    }
+
+    case DIRECTIVE_EXPORT:
+    {
+      if (parse_export(asm_context) != 0) { return -1; }
+      break;
+    }
+
+    case DIRECTIVE_ENTRY_POINT:
+    {
+      if (parse_entry_point(asm_context) != 0) { return -1; }
+      break;
+    }
+
+    case DIRECTIVE_ALIGN_BITS:
+    {
+      if (parse_align_bits(asm_context) != 0) { return -1; }
+      break;
+    }
+
+    case DIRECTIVE_ALIGN_BYTES:
+    {
+      if (parse_align_bytes(asm_context) != 0) { return -1; }
+      break;
+    }
+
+    case DIRECTIVE_EQU:
+    {
+      if (parse_equ(asm_context) != 0) { return -1; }
+      break;
     }
-  }
-    else
-  if (strcasecmp(token, "data_fill") == 0)
-  {
-    if (parse_data_fill(asm_context) != 0) { return -1; }
-  }
-    else
-  {
-    int ret = 0;
 
-    do
+    case DIRECTIVE_SCOPE:
     {
-      // If the assembler wants a specific directive, it can be added
-      // with this function pointer.
-      if (asm_context->parse_directive != NULL)
+      if (asm_context->symbols.scope_start() != 0)
       {
-        ret = asm_context->parse_directive(asm_context, token);
-        if (ret == 1) { break; }      // Found and used
-        if (ret == -1) { return -1; } // Found and there was a problem
+        fprintf(asm_context->messages, "Error: Nested scopes are not allowed. %s:%d\n",
+          asm_context->tokens.filename,
+          asm_context->tokens.line);
+        return -1;
       }
 
-      ret = assembler_directive(asm_context, token);
+      break;
+    }
+
+    case DIRECTIVE_ENDS:
+    {
+      asm_context->symbols.scope_end();
+      break;
+    }
+
+    case DIRECTIVE_FUNC:
+    {
+      char token[TOKENLEN];
+      //int token_type;
+
+      tokens_get(asm_context, token, TOKENLEN);
 
-      if (ret == 1 || ret == 2) { break; }
-      if (ret == -1) { return -1; }
+      int ret = asm_context->symbols.append(
+        token,
+        asm_context->address / asm_context->bytes_per_address);
 
-      int n = 0;
-      while (cpu_list[n].name != NULL)
+      if (ret != 0) { print_error_label(asm_context, token, ret); }
+
+      if (asm_context->symbols.scope_start() != 0)
       {
-        if (strcasecmp(token, cpu_list[n].name) == 0)
+        fprintf(asm_context->messages, "Error: Nested scopes are not allowed. %s:%d\n",
+          asm_context->tokens.filename,
+          asm_context->tokens.line);
+        return -1;
+      }
+
+      break;
+    }
+
+    case DIRECTIVE_ENDF:
+    {
+      asm_context->symbols.scope_end();
+      break;
+    }
+
+    case DIRECTIVE_LOW_ADDRESS:
+    {
+      if (parse_low_address(asm_context) != 0) { return -1; }
+      break;
+    }
+
+    case DIRECTIVE_HIGH_ADDRESS:
+    {
+      if (parse_high_address(asm_context) != 0) { return -1; }
+      break;
+    }
+
+    case DIRECTIVE_BIG_ENDIAN:
+    {
+      asm_context->memory.endian = ENDIAN_BIG;
+      break;
+    }
+
+    case DIRECTIVE_LITTLE_ENDIAN:
+    {
+      asm_context->memory.endian = ENDIAN_LITTLE;
+      break;
+    }
+
+    case DIRECTIVE_LIST:
+    {
+      if (asm_context->pass == 2 && asm_context->list != NULL)
+      {
+        asm_context->write_list_file = 1;
+        putc('\n', asm_context->list);
+      }
+
+      break;
+    }
+
+    case DIRECTIVE_DATA_FILL:
+    {
+      if (parse_data_fill(asm_context) != 0) { return -1; }
+      break;
+    }
+
+    default:
+    {
+      int ret = 0;
+
+      do
+      {
+        // If the assembler wants a specific directive, it can be added
+        // with this function pointer.
+        if (asm_context->parse_directive != NULL)
         {
-          asm_context->set_cpu(n);
+          ret = asm_context->parse_directive(asm_context, token);
+          if (ret == 1) { break; }      // Found and used
+          if (ret == -1) { return -1; } // Found and there was a problem
+        }
 
-#if 0
-          if (strcmp(token, "65816") == 0)
-          {
-            asm_context->parse_directive = parse_directive_65816;
-          }
-            else
-#endif
+        ret = assembler_directive(asm_context, token);
+
+        if (ret == 1 || ret == 2) { break; }
+        if (ret == -1) { return -1; }
+
+        int n = 0;
+        while (cpu_list[n].name != NULL)
+        {
+          if (strcasecmp(token, cpu_list[n].name) == 0)
           {
-            asm_context->parse_directive = NULL;
+            asm_context->set_cpu(n);
+
+  #if 0
+            if (strcmp(token, "65816") == 0)
+            {
+              asm_context->parse_directive = parse_directive_65816;
+            }
+              else
+  #endif
+            {
+              asm_context->parse_directive = NULL;
+            }
+
+            ret = 1;
+            break;
           }
 
-          ret = 1;
-          break;
+          n++;
         }
 
-        n++;
-      }
+        if (ret == 1) { break; }
 
-      if (ret == 1) { break; }
+        fprintf(asm_context->messages, "Error: Unknown directive '%s' at %s:%d.\n",
+          token, asm_context->tokens.filename, asm_context->tokens.line);
+        return -1;
 
-      printf("Error: Unknown directive '%s' at %s:%d.\n",
-        token, asm_context->tokens.filename, asm_context->tokens.line);
-      return -1;
-
-    } while (false);
+      } while (false);
+    }
   }
 
   return 0;
@@ -13,9 +13,21 @@
 #define NAKEN_ASM_DIRECTIVES_H
 
 #include "common/assembler.h"
+#include "common/TableIndex.h"
+
+struct DirectiveName
+{
+  const char *name;
+  int id;
+};
 
 int parse_org(AsmContext *asm_context);
 int parse_directives(AsmContext *asm_context);
 
+int directive_find(
+  TableIndex &index,
+  const DirectiveName *table,
+  const char *token);
+
 #endif
 
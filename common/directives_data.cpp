@@ -27,7 +27,7 @@ int parse_db(AsmContext *asm_context, int null_term_flag)
 
   if (asm_context->segment == SEGMENT_BSS)
   {
-    printf("Error: .bss segment doesn't support initialized data at %s:%d\n",
+    fprintf(asm_context->messages, "Error: .bss segment doesn't support initialized data at %s:%d\n",
       asm_context->tokens.filename,
       asm_context->tokens.line);
     return -1;
@@ -116,7 +116,7 @@ int parse_dc16(AsmContext *asm_context)
 
   if (asm_context->segment == SEGMENT_BSS)
   {
-    printf("Error: .bss segment doesn't support initialized data at %s:%d\n", asm_context->tokens.filename, asm_context->tokens.line);
+    fprintf(asm_context->messages, "Error: .bss segment doesn't support initialized data at %s:%d\n", asm_context->tokens.filename, asm_context->tokens.line);
     return -1;
   }
 
@@ -183,7 +183,7 @@ int parse_dc32(AsmContext *asm_context)
 
   if (asm_context->segment == SEGMENT_BSS)
   {
-    printf("Error: .bss segment doesn't support initialized data at %s:%d\n", asm_context->tokens.filename, asm_context->tokens.line);
+    fprintf(asm_context->messages, "Error: .bss segment doesn't support initialized data at %s:%d\n", asm_context->tokens.filename, asm_context->tokens.line);
     return -1;
   }
 
@@ -261,7 +261,7 @@ int parse_dc64(AsmContext *asm_context)
 
   if (asm_context->segment == SEGMENT_BSS)
   {
-    printf("Error: .bss segment doesn't support initialized data at %s:%d\n", asm_context->tokens.filename, asm_context->tokens.line);
+    fprintf(asm_context->messages, "Error: .bss segment doesn't support initialized data at %s:%d\n", asm_context->tokens.filename, asm_context->tokens.line);
     return -1;
   }
 
@@ -345,7 +345,7 @@ int parse_dc(AsmContext *asm_context)
 
 int parse_data_fill(AsmContext *asm_context)
 {
-  int count, value, n;
+  int count, value;
 
   if (eval_expression(asm_context, &value) == -1)
   {
@@ -380,10 +380,8 @@ int parse_data_fill(AsmContext *asm_context)
     return -1;
   }
 
-  for (n = 0; n < count; n++)
-  {
-    asm_context->memory_write_inc(value & 0xff, DL_DATA);
-  }
+  asm_context->memory.fill(asm_context->address, value & 0xff, count, DL_DATA);
+  asm_context->address += count;
 
   return 0;
 }
@@ -20,30 +20,101 @@
 #include "common/Macros.h"
 #include "common/print_error.h"
 
+// Get the next character of a section being skipped.  When it's coming
+// straight out of the file (nothing ungetted, no macro being expanded
+// and no listing being written) read the buffer directly.
+static inline int ifdef_get_char(AsmContext *asm_context)
+{
+  Tokens &tokens = asm_context->tokens;
+
+  if (tokens.unget_ptr == 0 &&
+      tokens.token_buffer.code != NULL &&
+      asm_context->macros.get_stack_ptr() == 0 &&
+      (asm_context->list == NULL || asm_context->write_list_file == 0))
+  {
+    int ch = (uint8_t)tokens.token_buffer.code[tokens.token_buffer.ptr];
+    if (ch == 0) { return EOF; }
+    tokens.token_buffer.ptr++;
+    tokens.last_char = ch;
+    return ch;
+  }
+
+  return tokens_get_char(asm_context);
+}
+
+static int ifdef_skip_to_eol(AsmContext *asm_context)
+{
+  int ch;
+
+  while (true)
+  {
+    ch = ifdef_get_char(asm_context);
+    if (ch == '\n' || ch == EOF) { break; }
+  }
+
+  return ch;
+}
+
+// Skip over a section that is being ignored because of a false .if,
+// .ifdef or .ifndef.  Only the directive at the start of each line is
+// looked at, so nothing in the section is expanded as a macro or looked
+// up as a symbol.  Comments and quoted strings are skipped so they can't
+// hide a newline or look like a directive.  Returns 0 at the matching
+// .endif or 2 at the matching .else.
 int ifdef_ignore(AsmContext *asm_context)
 {
   char token[TOKENLEN];
-  int token_type;
   int nested_if = 0;
+  bool line_start = false;
+  int ch;
 
-  while (1)
+  // Anything already pushed back is part of the line the .if was on.
+  while (asm_context->tokens.pushback[0] != 0 ||
+         asm_context->tokens.pushback2[0] != 0)
   {
-    token_type = tokens_get(asm_context, token, TOKENLEN);
+    if (tokens_get(asm_context, token, TOKENLEN) == TOKEN_EOL)
+    {
+      asm_context->tokens.line++;
+      line_start = true;
+    }
+  }
+
+  while (true)
+  {
+    ch = ifdef_get_char(asm_context);
 
-    if (token_type == TOKEN_EOF)
+    if (ch == EOF)
     {
       print_error(asm_context, "Missing endif");
       return -1;
     }
 
-    if (token_type == TOKEN_EOL)
+    if (ch == '\n')
     {
       asm_context->tokens.line++;
+      line_start = true;
+      continue;
     }
-      else
-    if (token_type == TOKEN_POUND || IS_TOKEN(token,'.'))
+
+    if (ch == ' ' || ch == '\t' || ch == '\r') { continue; }
+
+    if (line_start && (ch == '.' || ch == '#'))
     {
-      token_type = tokens_get(asm_context, token, TOKENLEN);
+      int ptr = 0;
+
+      while (true)
+      {
+        ch = ifdef_get_char(asm_context);
+
+        if (!((ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z'))) { break; }
+        if (ptr < 7) { token[ptr++] = ch; }
+        else { ptr = 8; }
+      }
+
+      tokens_unget_char(asm_context, ch);
+      token[ptr < 8 ? ptr : 0] = 0;
+      line_start = false;
+
       if (strcasecmp(token, "endif") == 0)
       {
         if (nested_if == 0) { return 0; }
@@ -55,10 +126,83 @@ int ifdef_ignore(AsmContext *asm_context)
         if (nested_if == 0) { return 2; }
       }
         else
-      if (strcasecmp(token, "if") == 0 || strcasecmp(token, "ifdef") == 0)
+      if (strcasecmp(token, "if") == 0 ||
+          strcasecmp(token, "ifdef") == 0 ||
+          strcasecmp(token, "ifndef") == 0)
       {
         nested_if++;
       }
+
+      continue;
+    }
+
+    line_start = false;
+
+    if (ch == ';')
+    {
+      if (ifdef_skip_to_eol(asm_context) == '\n')
+      {
+        tokens_unget_char(asm_context, '\n');
+      }
+    }
+      else
+    if (ch == '/')
+    {
+      ch = ifdef_get_char(asm_context);
+
+      if (ch == '/')
+      {
+        if (ifdef_skip_to_eol(asm_context) == '\n')
+        {
+          tokens_unget_char(asm_context, '\n');
+        }
+      }
+        else
+      if (ch == '*')
+      {
+        int last = 0;
+
+        while (true)
+        {
+          ch = ifdef_get_char(asm_context);
+          if (ch == EOF) { break; }
+          if (ch == '\n') { asm_context->tokens.line++; }
+          if (last == '*' && ch == '/') { break; }
+          last = ch;
+        }
+      }
+        else
+      {
+        tokens_unget_char(asm_context, ch);
+      }
+    }
+      else
+    if (ch == '"' || ch == '\'')
+    {
+      // Skip strings and character constants such as '"' up to the end
+      // of the line.  A tick can also end a name (Z80's af') so it only
+      // covers a couple of characters.
+      const int quote = ch;
+      int count = 0;
+
+      while (true)
+      {
+        ch = ifdef_get_char(asm_context);
+
+        if (ch == '\\') { ch = ifdef_get_char(asm_context); }
+          else
+        if (ch == quote) { break; }
+
+        if (ch == EOF) { break; }
+
+        if (ch == '\n')
+        {
+          tokens_unget_char(asm_context, ch);
+          break;
+        }
+
+        if (quote == '\'' && ++count == 2) { break; }
+      }
     }
   }
 }
@@ -110,6 +254,8 @@ int parse_ifdef(AsmContext *asm_context, int ifndef)
     else
   {
     if (ifndef == 0) { ignore_section = 1; }
+
+    if (asm_context->single_pass) { asm_context->fixups.add_undefined(token); }
   }
 
   parse_ifdef_ignore(asm_context, ignore_section);
@@ -17,6 +17,7 @@
 #include "common/directives_include.h"
 #include "common/tokens.h"
 #include "common/print_error.h"
+#include "common/version.h"
 
 int include_add_path(AsmContext *asm_context, const char *paths)
 {
@@ -46,18 +47,26 @@ int include_add_path(AsmContext *asm_context, const char *paths)
   return 0;
 }
 
+// Files read by .include and .binfile are kept for -MD and -cache_dir.
+static void add_dependency(AsmContext *asm_context, const char *filename)
+{
+  if (asm_context->dependencies.find(filename) == -1)
+  {
+    asm_context->dependencies.append(filename);
+  }
+}
+
 int binfile_parse(AsmContext *asm_context)
 {
   FILE *in;
   char token[TOKENLEN];
-  uint8_t buffer[8192];
+  uint8_t buffer[65536];
   //int token_type;
   int len;
-  int n;
 
   if (asm_context->segment == SEGMENT_BSS)
   {
-    printf("Error: .bss segment doesn't support initialized data at %s:%d\n",
+    fprintf(asm_context->messages, "Error: .bss segment doesn't support initialized data at %s:%d\n",
       asm_context->tokens.filename,
       asm_context->tokens.line);
 
@@ -69,7 +78,7 @@ int binfile_parse(AsmContext *asm_context)
 
   if (in == NULL)
   {
-    printf("Cannot open binfile file '%s' at %s:%d\n",
+    fprintf(asm_context->messages, "Cannot open binfile file '%s' at %s:%d\n",
       token,
       asm_context->tokens.filename,
       asm_context->tokens.line);
@@ -77,15 +86,14 @@ int binfile_parse(AsmContext *asm_context)
     return -1;
   }
 
+  add_dependency(asm_context, token);
+
   while (true)
   {
     len = fread(buffer, 1, sizeof(buffer), in);
     if (len <= 0) { break; }
 
-    for (n = 0; n < len; n++)
-    {
-      asm_context->memory_write_inc(buffer[n], DL_DATA);
-    }
+    asm_context->memory_write_block_inc(buffer, len, DL_DATA);
 
     asm_context->data_count += len;
   }
@@ -95,14 +103,107 @@ int binfile_parse(AsmContext *asm_context)
   return 0;
 }
 
+// Add the macros recorded the last time this file was included.  Returns
+// -1 if one of them is already defined (or the recording is bad) so the
+// file gets parsed and the error is printed the normal way.
+static int include_replay(
+  AsmContext *asm_context,
+  const uint8_t *data,
+  int length)
+{
+  const char *name;
+  const char *value;
+  int param_count;
+  uint32_t address;
+  int ptr = 0;
+
+  if (asm_context->macros.is_locked()) { return 0; }
+
+  while (ptr < length)
+  {
+    if (IncludeCache::get_macro(
+          data, length, &ptr, &name, &value, &param_count) != 0 ||
+        asm_context->macros.find(name) != NULL ||
+        asm_context->symbols.lookup(name, &address) == 0)
+    {
+      return -1;
+    }
+  }
+
+  ptr = 0;
+
+  while (ptr < length)
+  {
+    IncludeCache::get_macro(data, length, &ptr, &name, &value, &param_count);
+
+    if (macros_append(asm_context, (char *)name, (char *)value, param_count) != 0)
+    {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+// Assemble the include file that was just opened.  A file that only
+// defines macros is recorded the first time through and replayed from
+// include_cache after that.
+static int include_assemble(AsmContext *asm_context)
+{
+  IncludeCache *include_cache = &asm_context->include_cache;
+  const uint8_t *data;
+  int length;
+  Hash128 key;
+
+  key.update(VERSION);
+  key.update(asm_context->cpu_list_index);
+  key.update(asm_context->tokens.token_buffer.code);
+
+  int found = include_cache->find(key, asm_context->cache_dir, &data, &length);
+
+  if (found == 0 && include_replay(asm_context, data, length) == 0)
+  {
+    return 0;
+  }
+
+  // A file included from one that's being recorded makes that recording
+  // useless anyway (.include isn't a define), so it's not recorded either.
+  if (found != -1 || include_cache->is_recording())
+  {
+    return assemble(asm_context);
+  }
+
+  const int address = asm_context->address;
+  const int cpu_list_index = asm_context->cpu_list_index;
+  const int ifdef_count = asm_context->ifdef_count;
+
+  include_cache->begin();
+
+  int ret = assemble(asm_context);
+
+  include_cache->end(
+    key,
+    asm_context->cache_dir,
+    ret == 0 &&
+    asm_context->address == address &&
+    asm_context->cpu_list_index == cpu_list_index &&
+    asm_context->ifdef_count == ifdef_count);
+
+  return ret;
+}
+
 int include_parse(AsmContext *asm_context)
 {
   char token[TOKENLEN];
   //int token_type;
   const char *oldname;
   int oldline;
-  FILE *oldfp;
+  TokenBuffer oldtoken_buffer;
+  int oldlast_char;
+  int oldsource;
+  TokenCacheCursor oldcursor;
   uint8_t write_list_file;
+  bool opened;
   int ret;
 
   tokens_get(asm_context, token, TOKENLEN);
@@ -113,10 +214,17 @@ printf("including file %s.\n", token);
   write_list_file = asm_context->write_list_file;
   asm_context->write_list_file = 0;
 
-  oldfp = asm_context->tokens.in;
+  oldtoken_buffer = asm_context->tokens.token_buffer;
   oldname = asm_context->tokens.filename;
+  oldlast_char = asm_context->tokens.last_char;
+  oldsource = asm_context->tokens.cache_source;
+  oldcursor = asm_context->tokens.cache_cursor;
 
-  if (tokens_open_file(asm_context, token) != 0)
+  opened = tokens_open_file(asm_context, token) == 0;
+
+  if (opened) { add_dependency(asm_context, token); }
+
+  if (!opened)
   {
     int ptr = 0;
     char *s = asm_context->include_path;
@@ -132,7 +240,12 @@ printf("including file %s.\n", token);
 #ifdef DEBUG
         printf("Trying %s\n", filename);
 #endif
-        if (tokens_open_file(asm_context, filename) == 0) { break; }
+        if (tokens_open_file(asm_context, filename) == 0)
+        {
+          add_dependency(asm_context, filename);
+          opened = true;
+          break;
+        }
 
         if (asm_context->cpu_list_index != -1)
         {
@@ -141,7 +254,12 @@ printf("including file %s.\n", token);
 #ifdef DEBUG
           printf("Trying %s\n", filename);
 #endif
-          if (tokens_open_file(asm_context, filename) == 0) { break; }
+          if (tokens_open_file(asm_context, filename) == 0)
+          {
+            add_dependency(asm_context, filename);
+            opened = true;
+            break;
+          }
         }
       }
 
@@ -150,9 +268,9 @@ printf("including file %s.\n", token);
     }
   }
 
-  if (asm_context->tokens.in == NULL)
+  if (!opened)
   {
-    printf("Cannot open include file '%s' at %s:%d\n",
+    fprintf(asm_context->messages, "Cannot open include file '%s' at %s:%d\n",
       token, asm_context->tokens.filename, asm_context->tokens.line);
     ret = -1;
   }
@@ -163,15 +281,18 @@ printf("including file %s.\n", token);
     asm_context->tokens.filename = token;
     asm_context->tokens.line = 1;
 
-    ret = assemble(asm_context);
+    ret = include_assemble(asm_context);
 
     asm_context->tokens.line = oldline;
-  }
 
-  if (asm_context->tokens.in != NULL) { fclose(asm_context->tokens.in); }
+    tokens_close(asm_context);
+  }
 
   asm_context->tokens.filename = oldname;
-  asm_context->tokens.in = oldfp;
+  asm_context->tokens.token_buffer = oldtoken_buffer;
+  asm_context->tokens.last_char = oldlast_char;
+  asm_context->tokens.cache_source = oldsource;
+  asm_context->tokens.cache_cursor = oldcursor;
   asm_context->write_list_file = write_list_file;
 
   return ret;
@@ -18,47 +18,202 @@
 #include "common/Operator.h"
 #include "common/tokens.h"
 
+// With -single_pass a name that isn't a label (yet) is taken to be one
+// that's defined later.  It gets the current address for now and the
+// statement is assembled again once all labels are known.  When the
+// statement is redone as pass 1 would do it, the name is left unknown.
+static bool forward_reference(AsmContext *asm_context, Token &next)
+{
+  if (!asm_context->single_pass || asm_context->pass == 1) { return false; }
+
+  next.value = asm_context->address / asm_context->bytes_per_address;
+  next.has_value = true;
+  asm_context->forward_reference = 1;
+
+  return true;
+}
+
+// The node for a number in the expression being compiled.  Symbols and
+// $ are looked up again every time the compiled code is run.
+int EvalExpression::add_number(
+  Compiler *compiler,
+  Var &value,
+  const Token &next,
+  const char *token)
+{
+  if (compiler == NULL) { return -1; }
+
+  if (next.is_symbol) { return compiler->add_symbol(value, token); }
+  if (IS_TOKEN(token, '$')) { return compiler->add_address(value); }
+
+  return compiler->add_value(value);
+}
+
+// Expressions read straight from a source file are compiled the first
+// time they are seen and kept in asm_context->expression_cache by where
+// they start.  After that (pass 2 for example) the compiled code is run
+// and the lexer skips to the token after the expression.
 int EvalExpression::run(AsmContext *asm_context, Var &answer, bool is_paren)
+{
+  const int64_t offset = is_paren || !can_cache(asm_context) ?
+    -1 : tokens_source_offset(asm_context);
+
+  if (offset == -1)
+  {
+    return parse(asm_context, answer, is_paren, NULL, NULL);
+  }
+
+  Tokens &tokens = asm_context->tokens;
+  ExpressionCache &expression_cache = asm_context->expression_cache;
+  const int source = tokens.cache_source;
+  const int line = tokens.line;
+  const int flags = cache_flags(asm_context);
+  uint8_t key[EXPRESSION_MAX_KEY];
+  int pushed;
+
+  const int key_length = pushback_key(asm_context, key, &pushed);
+
+  if (key_length == -1)
+  {
+    return parse(asm_context, answer, is_paren, NULL, NULL);
+  }
+
+  const ExpressionCacheEntry *entry =
+    expression_cache.find(source, offset, key, key_length);
+
+  if (entry != NULL)
+  {
+    // If a symbol can't be found the expression is parsed again so the
+    // error (or what pass 1 does with it) is the same as always.
+    if (entry->flags == flags &&
+        execute(asm_context, entry->get_code(), entry->length, answer) == 0)
+    {
+      tokens.pushback[0] = 0;
+      tokens.pushback2[0] = 0;
+      tokens_seek(asm_context, offset + entry->consumed, entry->lines);
+      return 0;
+    }
+
+    return parse(asm_context, answer, is_paren, NULL, NULL);
+  }
+
+  Compiler compiler(pushed);
+  int node = -1;
+
+  if (parse(asm_context, answer, is_paren, &compiler, &node) != 0)
+  {
+    return -1;
+  }
+
+  if (compiler.valid && compiler.end_offset >= offset)
+  {
+    uint8_t code[EXPRESSION_MAX_CODE];
+    const int length = compiler.emit(code, sizeof(code), node);
+
+    if (length > 0)
+    {
+      expression_cache.add(
+        source,
+        offset,
+        compiler.end_offset - offset,
+        compiler.end_line - line,
+        flags,
+        key,
+        key_length,
+        code,
+        length);
+    }
+  }
+
+  return 0;
+}
+
+int EvalExpression::parse(
+  AsmContext *asm_context,
+  Var &answer,
+  bool is_paren,
+  Compiler *compiler,
+  int *node)
 {
   char token[TOKENLEN];
   int token_type;
+  Token next;
   VarStack var_stack;
   OperStack oper_stack;
   int count = 0;
 
   while (true)
   {
-    token_type = tokens_get(asm_context, token, TOKENLEN);
+    if (compiler != NULL) { compiler->mark(asm_context); }
+
+    token_type = tokens_get(asm_context, next, token, TOKENLEN);
+
+    if (compiler != NULL) { compiler->check(asm_context); }
 
     if (token_type == TOKEN_EOL || token_type == TOKEN_EOF)
     {
-      tokens_push(asm_context, token, token_type);
+      tokens_push(asm_context, next);
       break;
     }
 
     if (token_type == TOKEN_QUOTED)
     {
-      if (get_quoted_literal(asm_context, token, sizeof(token)) != 0)
+      int value;
+
+      if (get_quoted_literal(asm_context, token, &value) != 0)
       {
         return -1;
       }
 
       token_type = TOKEN_NUMBER;
+      next.value = value;
+      next.is_symbol = false;
     }
 
-    // Open and close parenthesis
+    if (token_type == TOKEN_STRING && forward_reference(asm_context, next))
+    {
+      token_type = TOKEN_NUMBER;
+    }
+
+    // Check numbers before ( and ) since the text of a character
+    // constant such as '(' is the character itself.
+    if (token_type == TOKEN_NUMBER)
+    {
+      // 0: empty
+      // 1: num
+      // 2:   oper
+      // 3: num
+      // 4:   oper
+      // 5: (num)
+
+      if (need_symbol(count) || var_stack.size() == 3)
+      {
+        print_error_unexp(asm_context, token);
+        return -1;
+      }
+
+      Var var;
+      var.set_int(next.value);
+      var_stack.push(var, add_number(compiler, var, next, token));
+      count++;
+    }
+      else
     if (IS_TOKEN(token, '('))
     {
       // This is probably the x(r12) case.. so this is actually okay.
       if (need_symbol(count))
       {
-        tokens_push(asm_context, token, token_type);
+        tokens_push(asm_context, next);
         break;
       }
 
       Var var;
-      if (run(asm_context, var, true) != 0) { return -1; }
-      var_stack.push(var);
+      int paren_node = -1;
+      if (parse(asm_context, var, true, compiler, &paren_node) != 0)
+      {
+        return -1;
+      }
+      var_stack.push(var, paren_node);
       count++;
     }
       else
@@ -68,7 +223,7 @@ int EvalExpression::run(AsmContext *asm_context, Var &answer, bool is_paren)
       {
         // This is probably the end of some instruction syntax such as
         // Z80 "and (ix+5)".
-        tokens_push(asm_context, token, token_type);
+        tokens_push(asm_context, next);
         break;
       }
 
@@ -88,29 +243,10 @@ int EvalExpression::run(AsmContext *asm_context, Var &answer, bool is_paren)
       }
 
       // End of expression
-      tokens_push(asm_context, token, token_type);
+      tokens_push(asm_context, next);
       break;
     }
       else
-    if (token_type == TOKEN_NUMBER)
-    {
-      // 0: empty
-      // 1: num
-      // 2:   oper
-      // 3: num
-      // 4:   oper
-      // 5: (num)
-
-      if (need_symbol(count) || var_stack.size() == 3)
-      {
-        print_error_unexp(asm_context, token);
-        return -1;
-      }
-
-      var_stack.push_int(token);
-      count++;
-    }
-      else
     if (token_type == TOKEN_FLOAT)
     {
       if (need_symbol(count) || var_stack.size() == 3)
@@ -119,7 +255,9 @@ int EvalExpression::run(AsmContext *asm_context, Var &answer, bool is_paren)
         return -1;
       }
 
-      var_stack.push_float(token);
+      Var var;
+      var.set_float(token);
+      var_stack.push(var, compiler == NULL ? -1 : compiler->add_value(var));
       count++;
     }
       else
@@ -135,7 +273,7 @@ int EvalExpression::run(AsmContext *asm_context, Var &answer, bool is_paren)
           // Was needed for Z80 "and (ix+5)".
           Operator oper;
           oper.set_operator("+");
-          var_stack.push_int((uint64_t)0);
+          var_stack.push(var, compiler == NULL ? -1 : compiler->add_value(var));
           oper_stack.push(oper);
           count += 2;
         }
@@ -143,18 +281,28 @@ int EvalExpression::run(AsmContext *asm_context, Var &answer, bool is_paren)
         if (IS_TOKEN(token, '-'))
         {
           // Needed for: 6 + -5.
-          parse_unary_new(asm_context, var);
+          int unary_node = -1;
+          if (parse_unary_new(asm_context, var, compiler, &unary_node) != 0)
+          {
+            unary_node = -1;
+          }
           var.negative();
-          var_stack.push(var);
+          var_stack.push(var, compiler == NULL ? -1 :
+            compiler->add_unary(var, EXPR_NEGATIVE, unary_node));
           count++;
         }
           else
         if (IS_TOKEN(token, '~'))
         {
           // Needed for: ~0xfe.
-          parse_unary_new(asm_context, var);
+          int unary_node = -1;
+          if (parse_unary_new(asm_context, var, compiler, &unary_node) != 0)
+          {
+            unary_node = -1;
+          }
           var.complement();
-          var_stack.push(var);
+          var_stack.push(var, compiler == NULL ? -1 :
+            compiler->add_unary(var, EXPR_COMPLEMENT, unary_node));
           count++;
         }
           else
@@ -167,7 +315,7 @@ int EvalExpression::run(AsmContext *asm_context, Var &answer, bool is_paren)
       {
         if (var_stack.is_empty() || need_symbol(count) == false)
         {
-          printf("Error: Unexpected operator '%s' at %s:%d\n",
+          fprintf(asm_context->messages, "Error: Unexpected operator '%s' at %s:%d\n",
             token,
             asm_context->tokens.filename,
             asm_context->tokens.line);
@@ -204,7 +352,7 @@ int EvalExpression::run(AsmContext *asm_context, Var &answer, bool is_paren)
         return -1;
       }
 
-      if (execute_stack(var_stack, oper_stack) != 0) { return  -1; }
+      if (execute_stack(var_stack, oper_stack, compiler) != 0) { return  -1; }
       count -= 2;
     }
   }
@@ -213,78 +361,112 @@ int EvalExpression::run(AsmContext *asm_context, Var &answer, bool is_paren)
 
   while (var_stack.size() > 1 && oper_stack.is_empty() == false)
   {
-    if (execute_stack(var_stack, oper_stack) != 0) { return  -1; }
+    if (execute_stack(var_stack, oper_stack, compiler) != 0) { return  -1; }
   }
 
-  answer = var_stack.pop();
+  answer = var_stack.pop(node);
 
   return 0;
 }
 
-int EvalExpression::execute_stack(VarStack &var_stack, OperStack &oper_stack)
+int EvalExpression::execute_stack(
+  VarStack &var_stack,
+  OperStack &oper_stack,
+  Compiler *compiler)
 {
   Operator oper;
   Var d;
   Var s;
+  int d_node;
+  int s_node;
 
   if (oper_stack.get_precedence_index() == 0)
   {
     oper = oper_stack.pop_first();
 
-    d = var_stack.pop_first();
-    s = var_stack.pop_first();
+    d = var_stack.pop_first(&d_node);
+    s = var_stack.pop_first(&s_node);
 
     if (oper.execute(d, s) != 0) { return -1; }
-    var_stack.push_front(d);
+    var_stack.push_front(d, compiler == NULL ? -1 :
+      compiler->add_operator(d, oper.operation, d_node, s_node));
   }
     else
   {
     oper = oper_stack.pop();
 
-    s = var_stack.pop();
-    d = var_stack.pop();
+    s = var_stack.pop(&s_node);
+    d = var_stack.pop(&d_node);
 
     if (oper.execute(d, s) != 0) { return -1; }
-    var_stack.push(d);
+    var_stack.push(d, compiler == NULL ? -1 :
+      compiler->add_operator(d, oper.operation, d_node, s_node));
   }
 
   return 0;
 }
 
-int EvalExpression::parse_unary_new(AsmContext *asm_context, Var &answer)
+int EvalExpression::parse_unary_new(
+  AsmContext *asm_context,
+  Var &answer,
+  Compiler *compiler,
+  int *node)
 {
   char token[TOKENLEN];
+  Token next;
   int token_type;
+  int unary_node = -1;
 
   answer.clear();
 
-  token_type = tokens_get(asm_context, token, TOKENLEN);
+  if (compiler != NULL) { compiler->mark(asm_context); }
+
+  token_type = tokens_get(asm_context, next, token, TOKENLEN);
+
+  if (compiler != NULL) { compiler->check(asm_context); }
+
+  if (token_type == TOKEN_STRING && forward_reference(asm_context, next))
+  {
+    token_type = TOKEN_NUMBER;
+  }
 
   if (token_type == TOKEN_NUMBER)
   {
-    answer.set_int(token);
+    answer.set_int(next.value);
+    *node = add_number(compiler, answer, next, token);
   }
     else
   if (token_type == TOKEN_FLOAT)
   {
     answer.set_float(token);
+    *node = compiler == NULL ? -1 : compiler->add_value(answer);
   }
     else
   if (IS_TOKEN(token, '('))
   {
-    if (run(asm_context, answer, true) != 0) { return -1; }
+    if (parse(asm_context, answer, true, compiler, node) != 0) { return -1; }
   }
     else
   if (IS_TOKEN(token, '~'))
   {
-    if (parse_unary_new(asm_context, answer) != 0) { return -1; }
+    if (parse_unary_new(asm_context, answer, compiler, &unary_node) != 0)
+    {
+      return -1;
+    }
     answer.complement();
+    *node = compiler == NULL ? -1 :
+      compiler->add_unary(answer, EXPR_COMPLEMENT, unary_node);
   }
     else
   if (IS_TOKEN(token, '-'))
   {
-    if (parse_unary_new(asm_context, answer) != 0) { return -1; }
+    if (parse_unary_new(asm_context, answer, compiler, &unary_node) != 0)
+    {
+      return -1;
+    }
     answer.negative();
+    *node = compiler == NULL ? -1 :
+      compiler->add_unary(answer, EXPR_NEGATIVE, unary_node);
   }
     else
   {
@@ -298,7 +480,7 @@ int EvalExpression::parse_unary_new(AsmContext *asm_context, Var &answer)
 int EvalExpression::get_quoted_literal(
   AsmContext *asm_context,
   char *token,
-  int length)
+  int *value)
 {
   if (token[0] == '\\')
   {
@@ -311,7 +493,7 @@ int EvalExpression::get_quoted_literal(
       return -1;
     }
 
-    snprintf(token, length, "%d", token[e]);
+    *value = token[e];
   }
     else
   {
@@ -321,12 +503,341 @@ int EvalExpression::get_quoted_literal(
       return -1;
     }
 
-    snprintf(token, length, "%d", token[0]);
+    *value = token[0];
+  }
+
+  return 0;
+}
+
+// Expressions can only be kept if the text they come from is always
+// read the same way.
+bool EvalExpression::can_cache(AsmContext *asm_context)
+{
+  Tokens &tokens = asm_context->tokens;
+
+  return
+    !asm_context->single_pass &&
+    asm_context->linker == NULL &&
+    asm_context->ignore_symbols == 0 &&
+    asm_context->parsing_ifdef == 0 &&
+    tokens.replay_ptr == NULL &&
+    !asm_context->fixups.is_recording() &&
+    (asm_context->list == NULL || asm_context->write_list_file == 0);
+}
+
+int EvalExpression::cache_flags(AsmContext *asm_context)
+{
+  return tokens_lex_flags(asm_context) |
+         (asm_context->ignore_number_postfix << 5);
+}
+
+// Parsers often read the first token of an expression to see what it
+// is and push it back (sometimes two of them).  Those tokens are read
+// before the source file, so they are saved as part of what the
+// expression is.  Returns the length of the key or -1 if it's too big.
+int EvalExpression::pushback_key(
+  AsmContext *asm_context,
+  uint8_t *key,
+  int *count)
+{
+  Tokens &tokens = asm_context->tokens;
+  int length = 0;
+
+  *count = 0;
+
+  for (int n = 0; n < 2; n++)
+  {
+    const bool second = n == 0;
+    const char *text = second ? tokens.pushback2 : tokens.pushback;
+
+    if (text[0] == 0) { continue; }
+
+    const int text_length =
+      second ? tokens.pushback2_length : tokens.pushback_length;
+    const int64_t value =
+      second ? tokens.pushback2_value : tokens.pushback_value;
+
+    if (length + 11 + text_length > EXPRESSION_MAX_KEY) { return -1; }
+
+    key[length++] = second ? tokens.pushback2_type : tokens.pushback_type;
+    key[length++] =
+      second ? tokens.pushback2_has_value : tokens.pushback_has_value;
+    memcpy(key + length, &value, sizeof(value));
+    length += sizeof(value);
+    key[length++] = text_length;
+    memcpy(key + length, text, text_length);
+    length += text_length;
+
+    *count += 1;
+  }
+
+  return length;
+}
+
+// Run the code from Compiler::emit().  Returns -1 if a symbol isn't
+// defined (yet).
+int EvalExpression::execute(
+  AsmContext *asm_context,
+  const uint8_t *code,
+  int length,
+  Var &answer)
+{
+  Var stack[EXPRESSION_MAX_NODES];
+  int ptr = 0;
+  int n = 0;
+
+  while (n < length)
+  {
+    switch (code[n++])
+    {
+      case EXPR_INT:
+      {
+        int64_t value;
+        memcpy(&value, code + n, sizeof(value));
+        stack[ptr++].set_int(value);
+        n += sizeof(value);
+        break;
+      }
+      case EXPR_FLOAT:
+      {
+        double value;
+        memcpy(&value, code + n, sizeof(value));
+        stack[ptr++].set_float(value);
+        n += sizeof(value);
+        break;
+      }
+      case EXPR_SYMBOL:
+      {
+        const char *name = (const char *)code + n;
+        uint32_t address;
+
+        if (asm_context->symbols.lookup(name, &address) != 0) { return -1; }
+
+        stack[ptr++].set_int((int32_t)address);
+        n += strlen(name) + 1;
+        break;
+      }
+      case EXPR_ADDRESS:
+        stack[ptr++].set_int(
+          asm_context->address / asm_context->bytes_per_address);
+        break;
+      case EXPR_NEGATIVE:
+        stack[ptr - 1].negative();
+        break;
+      case EXPR_COMPLEMENT:
+        stack[ptr - 1].complement();
+        break;
+      case EXPR_OPERATOR:
+      {
+        Operator oper;
+        oper.operation = code[n++];
+        ptr--;
+        if (oper.execute(stack[ptr - 1], stack[ptr]) != 0) { return -1; }
+        break;
+      }
+      default:
+        return -1;
+    }
   }
 
+  if (ptr != 1) { return -1; }
+
+  answer = stack[0];
+
   return 0;
 }
 
+int EvalExpression::Compiler::add(
+  Var &value,
+  int type,
+  bool is_constant,
+  int left,
+  int right)
+{
+  if (!valid || count == EXPRESSION_MAX_NODES)
+  {
+    valid = false;
+    return -1;
+  }
+
+  Node &node = nodes[count];
+
+  node.value = value;
+  node.type = type;
+  node.operation = 0;
+  node.is_constant = is_constant;
+  node.left = left;
+  node.right = right;
+  node.name = 0;
+
+  return count++;
+}
+
+// Numbers (and anything else that will always be the same) in the
+// expression.  A token pushed back in the middle of the expression or
+// that came out of a macro isn't at a place in the file, so that makes
+// the whole expression something that can't be kept.
+int EvalExpression::Compiler::add_value(Var &value)
+{
+  if (!from_source) { valid = false; }
+
+  return add(value, EXPR_INT, true, -1, -1);
+}
+
+int EvalExpression::Compiler::add_symbol(Var &value, const char *name)
+{
+  const int length = strlen(name) + 1;
+
+  if (!from_source || names_len + length > EXPRESSION_MAX_NAMES)
+  {
+    valid = false;
+    return -1;
+  }
+
+  const int node = add(value, EXPR_SYMBOL, false, -1, -1);
+
+  if (node == -1) { return -1; }
+
+  memcpy(names + names_len, name, length);
+  nodes[node].name = names_len;
+  names_len += length;
+
+  return node;
+}
+
+int EvalExpression::Compiler::add_address(Var &value)
+{
+  if (!from_source) { valid = false; }
+
+  return add(value, EXPR_ADDRESS, false, -1, -1);
+}
+
+int EvalExpression::Compiler::add_unary(Var &value, int type, int node)
+{
+  if (node == -1)
+  {
+    valid = false;
+    return -1;
+  }
+
+  return add(value, type, nodes[node].is_constant, node, -1);
+}
+
+int EvalExpression::Compiler::add_operator(
+  Var &value,
+  int operation,
+  int left,
+  int right)
+{
+  if (left == -1 || right == -1)
+  {
+    valid = false;
+    return -1;
+  }
+
+  const int node = add(
+    value,
+    EXPR_OPERATOR,
+    nodes[left].is_constant && nodes[right].is_constant,
+    left,
+    right);
+
+  if (node != -1) { nodes[node].operation = operation; }
+
+  return node;
+}
+
+// Write the code for node into code.  Returns the length or -1 if it
+// doesn't fit.
+int EvalExpression::Compiler::emit(uint8_t *code, int len, int node)
+{
+  Node &n = nodes[node];
+  int ptr = 0;
+
+  if (n.is_constant)
+  {
+    if (len < 9) { return -1; }
+
+    if (n.value.get_type() == VAR_FLOAT)
+    {
+      const double value = n.value.get_double();
+      code[0] = EXPR_FLOAT;
+      memcpy(code + 1, &value, sizeof(value));
+    }
+      else
+    {
+      const int64_t value = n.value.get_int64();
+      code[0] = EXPR_INT;
+      memcpy(code + 1, &value, sizeof(value));
+    }
+
+    return 9;
+  }
+
+  if (n.left != -1)
+  {
+    const int length = emit(code, len, n.left);
+    if (length < 0) { return -1; }
+    ptr += length;
+  }
+
+  if (n.right != -1)
+  {
+    const int length = emit(code + ptr, len - ptr, n.right);
+    if (length < 0) { return -1; }
+    ptr += length;
+  }
+
+  if (n.type == EXPR_SYMBOL)
+  {
+    const int length = strlen(names + n.name) + 1;
+
+    if (ptr + 1 + length > len) { return -1; }
+
+    code[ptr++] = EXPR_SYMBOL;
+    memcpy(code + ptr, names + n.name, length);
+
+    return ptr + length;
+  }
+
+  if (ptr + 2 > len) { return -1; }
+
+  code[ptr++] = n.type;
+
+  if (n.type == EXPR_OPERATOR) { code[ptr++] = n.operation; }
+
+  return ptr;
+}
+
+// Called before each token is read.  When the expression ends, the last
+// token read is pushed back, so this is where the expression's text
+// ends.  Tokens that were pushed back before the expression started are
+// in the key so they're fine, but they can't be where it ends.
+void EvalExpression::Compiler::mark(AsmContext *asm_context)
+{
+  Tokens &tokens = asm_context->tokens;
+
+  end_line = tokens.line;
+
+  if (tokens.pushback[0] != 0 || tokens.pushback2[0] != 0)
+  {
+    end_offset = -1;
+    from_source = prefix > 0;
+    if (prefix > 0) { prefix--; }
+    return;
+  }
+
+  end_offset = tokens_source_offset(asm_context);
+  from_source = end_offset != -1;
+}
+
+// Called after each token is read.  Macros can expand to something else
+// later so an expression that used one isn't kept.
+void EvalExpression::Compiler::check(AsmContext *asm_context)
+{
+  if (asm_context->macros.get_stack_ptr() != 0) { valid = false; }
+}
+
 int eval_expression(AsmContext *asm_context, Var &answer)
 {
   answer.clear();
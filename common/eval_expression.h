@@ -20,6 +20,11 @@
 #include "common/Operator.h"
 #include "common/Var.h"
 
+#define EXPRESSION_MAX_NODES 64
+#define EXPRESSION_MAX_NAMES 1024
+#define EXPRESSION_MAX_CODE 512
+#define EXPRESSION_MAX_KEY 128
+
 class EvalExpression
 {
 public:
@@ -37,34 +42,38 @@ private:
     {
     }
 
-    int push(Var &var)
+    // node is where the value came from in a Compiler (or -1).
+    int push(Var &var, int node = -1)
     {
       if (ptr >= 3) { return -1; }
+      nodes[ptr] = node;
       stack[ptr++] = var;
 
       return 0;
     }
 
-    int push_front(Var &var)
+    int push_front(Var &var, int node = -1)
     {
       if (ptr >= 3) { return -1; }
 
       for (int n = ptr; n > 0; n--)
       {
         stack[n] = stack[n - 1];
+        nodes[n] = nodes[n - 1];
       }
 
       stack[0] = var;
+      nodes[0] = node;
       ptr++;
 
       return 0;
     }
 
-    int push_int(uint64_t value)
+    int push_int(uint64_t value, int node = -1)
     {
       Var var;
       var.set_int(value);
-      return push(var);
+      return push(var, node);
     }
 
     int push_int(const char *token)
@@ -74,25 +83,28 @@ private:
       return push(var);
     }
 
-    int push_float(const char *token)
+    int push_float(const char *token, int node = -1)
     {
       Var var;
       var.set_float(token);
-      return push(var);
+      return push(var, node);
     }
 
     int size()      { return ptr; }
     bool is_empty() { return ptr == 0; }
 
-    Var pop_first()
+    Var pop_first(int *node = NULL)
     {
       assert(ptr > 0);
 
       Var first = stack[0];
 
+      if (node != NULL) { *node = nodes[0]; }
+
       for (int i = 0; i < ptr - 1; i++)
       {
         stack[i] = stack[i + 1];
+        nodes[i] = nodes[i + 1];
       }
 
       ptr--;
@@ -100,10 +112,12 @@ private:
       return first;
     }
 
-    Var pop()
+    Var pop(int *node = NULL)
     {
       assert(ptr > 0);
-      return stack[--ptr];
+      ptr--;
+      if (node != NULL) { *node = nodes[ptr]; }
+      return stack[ptr];
     }
 
     Var &get_first()
@@ -134,9 +148,79 @@ private:
     }
 
     Var stack[3];
+    int nodes[3];
     int ptr;
   };
 
+  // RPN code for a compiled expression.
+  enum
+  {
+    EXPR_INT,         // int64_t value follows
+    EXPR_FLOAT,       // double value follows
+    EXPR_SYMBOL,      // 0 terminated name follows
+    EXPR_ADDRESS,
+    EXPR_NEGATIVE,
+    EXPR_COMPLEMENT,
+    EXPR_OPERATOR,    // Operator::OPER_* follows
+  };
+
+  // Builds a tree of the expression as it's evaluated and turns it into
+  // RPN code for asm_context->expression_cache.  Parts of the tree that
+  // are only numbers are folded into the value they had.  Symbols and $
+  // are looked up again each time the code is run.
+  class Compiler
+  {
+  public:
+    Compiler(int prefix) :
+      count       (0),
+      names_len   (0),
+      prefix      (prefix),
+      end_offset  (-1),
+      end_line    (0),
+      valid       (true),
+      from_source (false)
+    {
+    }
+
+    int add_value(Var &value);
+    int add_symbol(Var &value, const char *name);
+    int add_address(Var &value);
+    int add_unary(Var &value, int type, int node);
+    int add_operator(Var &value, int operation, int left, int right);
+
+    int emit(uint8_t *code, int len, int node);
+
+    void mark(AsmContext *asm_context);
+    void check(AsmContext *asm_context);
+
+    void invalidate() { valid = false; }
+
+    int count;
+    int names_len;
+    int prefix;
+    int64_t end_offset;
+    int end_line;
+    bool valid;
+    bool from_source;
+
+  private:
+    struct Node
+    {
+      Var value;
+      uint8_t type;
+      uint8_t operation;
+      bool is_constant;
+      int left;
+      int right;
+      int name;
+    };
+
+    int add(Var &value, int type, bool is_constant, int left, int right);
+
+    Node nodes[EXPRESSION_MAX_NODES];
+    char names[EXPRESSION_MAX_NAMES];
+  };
+
   class OperStack
   {
   public:
@@ -203,9 +287,35 @@ private:
     return count == 0 || count == 2 || count == 4;
   }
 
-  static int execute_stack(VarStack &var_stack, OperStack &oper_stack);
-  static int parse_unary_new(AsmContext *asm_context, Var &answer);
-  static int get_quoted_literal(AsmContext *asm_context, char *token, int length);
+  static int parse(
+    AsmContext *asm_context,
+    Var &answer,
+    bool is_paren,
+    Compiler *compiler,
+    int *node);
+
+  static int execute_stack(
+    VarStack &var_stack,
+    OperStack &oper_stack,
+    Compiler *compiler);
+
+  static int parse_unary_new(
+    AsmContext *asm_context,
+    Var &answer,
+    Compiler *compiler,
+    int *node);
+
+  static int add_number(
+    Compiler *compiler,
+    Var &value,
+    const Token &next,
+    const char *token);
+
+  static int get_quoted_literal(AsmContext *asm_context, char *token, int *value);
+  static bool can_cache(AsmContext *asm_context);
+  static int cache_flags(AsmContext *asm_context);
+  static int pushback_key(AsmContext *asm_context, uint8_t *key, int *count);
+  static int execute(AsmContext *asm_context, const uint8_t *code, int length, Var &answer);
 
 };
 
@@ -0,0 +1,77 @@
+/**
+ *  naken_asm assembler.
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: https://www.mikekohn.net/
+ * License: GPLv3
+ *
+ * Copyright 2010-2025 by Michael Kohn
+ *
+ */
+
+#ifndef NAKEN_ASM_HASH_H
+#define NAKEN_ASM_HASH_H
+
+#include <stdint.h>
+#include <string.h>
+
+// FNV-1a over a null terminated string.  Used to index the symbol and
+// macro tables so lookups don't have to strcmp() every entry.
+static inline uint32_t hash_string(const char *name)
+{
+  const uint8_t *s = (const uint8_t *)name;
+  uint32_t hash = 2166136261u;
+
+  while (*s != 0)
+  {
+    hash ^= *s++;
+    hash *= 16777619u;
+  }
+
+  return hash;
+}
+
+// Mix an extra key (scope number, etc) into a string hash.
+static inline uint32_t hash_mix(uint32_t hash, uint32_t key)
+{
+  hash ^= key * 0x9e3779b1u;
+  hash ^= hash >> 16;
+
+  return hash;
+}
+
+// 128 bit hash of file contents and command line options used to name
+// the files in naken_asm -cache_dir.  Two 64 bit lanes (FNV-1a and a
+// rotate / multiply) so a collision in one doesn't give a false hit.
+struct Hash128
+{
+  Hash128() : a (14695981039346656037ull), b (0x6a09e667f3bcc909ull) { }
+
+  void update(const void *data, int length)
+  {
+    const uint8_t *s = (const uint8_t *)data;
+
+    for (int n = 0; n < length; n++)
+    {
+      a = (a ^ s[n]) * 1099511628211ull;
+      b = ((b ^ s[n]) << 5 | (b ^ s[n]) >> 59) * 0x9e3779b97f4a7c15ull;
+    }
+  }
+
+  // The 0 at the end is included so "ab" + "c" isn't "a" + "bc".
+  void update(const char *text) { update(text, strlen(text) + 1); }
+
+  void update(int value) { update(&value, sizeof(value)); }
+
+  void update(const Hash128 &hash)
+  {
+    update(&hash.a, sizeof(hash.a));
+    update(&hash.b, sizeof(hash.b));
+  }
+
+  uint64_t a;
+  uint64_t b;
+};
+
+#endif
+
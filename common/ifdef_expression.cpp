@@ -125,6 +125,8 @@ static int parse_defined(AsmContext *asm_context)
     else
   {
     ret = 0;
+
+    if (asm_context->single_pass) { asm_context->fixups.add_undefined(token); }
   }
 
   tokens_get(asm_context, token, TOKENLEN);
@@ -12,11 +12,19 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <unistd.h>
 
+#ifdef PTHREADS
+#include <pthread.h>
+#endif
+
 #include "common/assembler.h"
 #include "common/directives_include.h"
+#include "common/hash.h"
 #include "common/Macros.h"
+#include "common/output_cache.h"
+#include "common/server.h"
 #include "common/tokens.h"
 #include "common/version.h"
 #include "fileio/file.h"
@@ -49,58 +57,821 @@ static void new_extension(char *filename, const char *ext, int len)
       break;
     }
 
-    i--;
-  }
+    i--;
+  }
+
+  if (i == 0)
+  {
+    strcat(filename, ".");
+    strcat(filename, ext);
+  }
+}
+
+static void output_hex_text(FILE *fp, char *s, int ptr)
+{
+  if (ptr == 0) { return; }
+  s[ptr] = 0;
+  int n;
+  for (n = 0; n < ((16 - ptr) * 3) + 2; n++) { putc(' ', fp); }
+  fprintf(fp, "%s", s);
+}
+
+// Send an AsmContext's messages to a temp file so they can be thrown away.
+static FILE *capture_start(AsmContext *asm_context)
+{
+  FILE *messages = asm_context->messages;
+  FILE *capture = tmpfile();
+
+  if (capture != NULL) { asm_context->messages = capture; }
+
+  return messages;
+}
+
+static void capture_end(AsmContext *asm_context, FILE *messages, bool keep)
+{
+  FILE *capture = asm_context->messages;
+
+  if (capture == messages) { return; }
+
+  asm_context->messages = messages;
+
+  if (keep)
+  {
+    char buffer[4096];
+    size_t length;
+
+    rewind(capture);
+
+    while ((length = fread(buffer, 1, sizeof(buffer), capture)) > 0)
+    {
+      fwrite(buffer, 1, length, messages);
+    }
+  }
+
+  fclose(capture);
+}
+
+// Anything printed during a -single_pass attempt (errors from the
+// placeholder values for example, and the Single pass... line itself)
+// is only shown if it worked.  Otherwise
+// it's thrown away and the normal two passes print their own messages.
+static int assemble_one_pass(AsmContext *asm_context)
+{
+  FILE *messages = capture_start(asm_context);
+
+  if (asm_context->quiet_output == 0) { fprintf(asm_context->messages, "\nSingle pass...\n"); }
+
+  int ret = assemble_single_pass(asm_context);
+
+  capture_end(asm_context, messages, ret == 0);
+
+  return ret;
+}
+
+// Same as assemble_one_pass() for pass 2 with -threads.  If it doesn't
+// work pass 2 is done again the normal way.
+static int assemble_pass_2(AsmContext *asm_context, int threads)
+{
+  if (threads > 1)
+  {
+    FILE *messages = capture_start(asm_context);
+
+    int ret = assemble_parallel(asm_context, threads);
+
+    capture_end(asm_context, messages, ret == 0);
+
+    if (ret == 0) { return 0; }
+
+    asm_context->error_count = 0;
+    asm_context->fixups.reset();
+    asm_context->symbols.scope_reset();
+    asm_context->init();
+  }
+
+  return assemble(asm_context);
+}
+
+// Every -o after the first is written from the same memory as the first.
+#define MAX_OUTPUT_FILES 8
+
+struct OutputFile
+{
+  char filename[1024];
+  int file_type;
+};
+
+struct OutputWrite
+{
+  AsmContext *asm_context;
+  const char *filename;
+  int file_type;
+  int result;
+};
+
+static void *write_output_thread(void *arg)
+{
+  OutputWrite *output = (OutputWrite *)arg;
+
+  output->result = file_write(
+    output->filename,
+    output->asm_context,
+    output->file_type);
+
+  return NULL;
+}
+
+// Write the output file and any other -o files.  The writers only read
+// memory and the symbols, so with more than one file they are written
+// on threads at the same time.  Returns -1 if any of them couldn't be
+// opened.
+static int write_outputs(
+  AsmContext *asm_context,
+  const char *outfile,
+  int file_type,
+  const OutputFile *outputs,
+  int output_count)
+{
+  OutputWrite writes[MAX_OUTPUT_FILES];
+  const int count = output_count + 1;
+  int error_flag = 0;
+  int n;
+
+  for (n = 0; n < count; n++)
+  {
+    writes[n].asm_context = asm_context;
+    writes[n].filename = n == 0 ? outfile : outputs[n - 1].filename;
+    writes[n].file_type = n == 0 ? file_type : outputs[n - 1].file_type;
+    writes[n].result = 0;
+  }
+
+#ifdef PTHREADS
+  pthread_t ids[MAX_OUTPUT_FILES];
+  int started = 0;
+
+  for (n = 1; n < count; n++)
+  {
+    if (pthread_create(&ids[n], NULL, write_output_thread, &writes[n]) != 0)
+    {
+      break;
+    }
+
+    started = n;
+  }
+
+  write_output_thread(&writes[0]);
+
+  for (n = 1; n <= started; n++)
+  {
+    pthread_join(ids[n], NULL);
+  }
+
+  for (n = started + 1; n < count; n++)
+  {
+    write_output_thread(&writes[n]);
+  }
+#else
+  for (n = 0; n < count; n++)
+  {
+    write_output_thread(&writes[n]);
+  }
+#endif
+
+  for (n = 0; n < count; n++)
+  {
+    if (writes[n].result == -1)
+    {
+      fprintf(asm_context->messages, "\nError: Couldn't open %s for writing.\n\n", writes[n].filename);
+      error_flag = -1;
+    }
+  }
+
+  return error_flag;
+}
+
+static void unlink_outputs(
+  const char *outfile,
+  const OutputFile *outputs,
+  int output_count)
+{
+  unlink(outfile);
+
+  for (int n = 0; n < output_count; n++)
+  {
+    unlink(outputs[n].filename);
+  }
+}
+
+static int assemble_file(
+  AsmContext *asm_context,
+  const char *infile,
+  const char *outfile,
+  int file_type,
+  const OutputFile *outputs,
+  int output_count,
+  int create_list,
+  int single_pass,
+  int threads)
+{
+  int error_flag = 0;
+
+  if (tokens_open_file(asm_context, infile) != 0)
+  {
+    fprintf(asm_context->messages, "Error: Couldn't open %s for reading.\n\n", infile);
+    return EXIT_FAILURE;
+  }
+
+  if (asm_context->quiet_output == 0)
+  {
+    fprintf(asm_context->messages, " Input file: %s\n", infile);
+    fprintf(asm_context->messages, "Output file: %s\n", outfile);
+
+    for (int n = 0; n < output_count; n++)
+    {
+      fprintf(asm_context->messages, "Output file: %s\n", outputs[n].filename);
+    }
+  }
+
+  if (create_list == 1)
+  {
+    char filename[1024];
+    strcpy(filename, outfile);
+
+    new_extension(filename, "lst", 1024);
+
+    asm_context->list = fopen(filename, "wb");
+    if (asm_context->list == NULL)
+    {
+      fprintf(asm_context->messages, "\nError: Couldn't open %s for writing.\n\n", filename);
+      tokens_close(asm_context);
+      return EXIT_FAILURE;
+    }
+
+    if (asm_context->quiet_output == 0)
+    {
+      fprintf(asm_context->messages, "  List file: %s\n", filename);
+    }
+
+    asm_context->memory.keep_debug_lines();
+  }
+
+  // The listing is written on pass 2 and linking needs pass 1 to find
+  // the undefined symbols, so those always take two passes.
+  if (create_list == 1 || asm_context->linker != NULL)
+  {
+    single_pass = 0;
+    threads = 1;
+  }
+
+  if (single_pass == 1)
+  {
+    if (assemble_one_pass(asm_context) != 0)
+    {
+      single_pass = 0;
+
+      if (asm_context->quiet_output == 0)
+      {
+        fprintf(asm_context->messages, "\nSingle pass can't be used, assembling in two passes.\n");
+      }
+    }
+  }
+
+  if (single_pass == 0)
+  {
+    if (asm_context->quiet_output == 0)
+    {
+      fprintf(asm_context->messages, "\nPass 1...\n");
+    }
+
+    //macros_init(&asm_context->macros);
+
+    asm_context->init();
+    asm_context->record_line_map = threads > 1;
+
+    error_flag = assemble(asm_context);
+  }
+
+  do
+  {
+    if (single_pass == 1)
+    {
+      if (assembler_link(asm_context) != 0)
+      {
+        error_flag = 1;
+        break;
+      }
+
+      if (write_outputs(
+            asm_context,
+            outfile,
+            file_type,
+            outputs,
+            output_count) != 0)
+      {
+        error_flag = 1;
+      }
+
+      break;
+    }
+
+    if (error_flag == 0 && assembler_link(asm_context) != 0)
+    {
+      error_flag = 1;
+    }
+
+    if (error_flag != 0)
+    {
+      fprintf(asm_context->messages, "** Errors... bailing out\n");
+      unlink_outputs(outfile, outputs, output_count);
+      break;
+    }
+
+    asm_context->symbols.lock();
+    asm_context->symbols.scope_reset();
+    // asm_context->macros.lock(&asm_context->defines_heap);
+
+    if (asm_context->quiet_output == 0) { fprintf(asm_context->messages, "Pass 2...\n"); }
+    asm_context->pass = 2;
+    asm_context->init();
+
+    if (create_list == 1) { asm_context->write_list_file = 1; }
+
+    error_flag = assemble_pass_2(asm_context, threads);
+
+    if (error_flag != 0) { break; }
+
+    if (assembler_link(asm_context) != 0)
+    {
+      error_flag = 1;
+      break;
+    }
+
+    if (write_outputs(
+          asm_context,
+          outfile,
+          file_type,
+          outputs,
+          output_count) != 0)
+    {
+      error_flag = 1;
+    }
+  } while (0);
+
+  if (create_list == 1)
+  {
+    int ch = 0;
+    char str[17];
+    int ptr = 0;
+    uint32_t i;
+
+    fprintf(asm_context->list, "data sections:");
+
+    for (i = asm_context->memory.low_address; i <= asm_context->memory.high_address; i++)
+    {
+      if (asm_context->read_debug(i) == -2)
+      {
+        if (ch == 0)
+        {
+          if (ptr != 0)
+          {
+            output_hex_text(asm_context->list, str, ptr);
+          }
+          fprintf(asm_context->list, "\n%04x:", i/asm_context->bytes_per_address);
+          ptr = 0;
+        }
+
+        uint8_t data = asm_context->memory_read(i);
+        fprintf(asm_context->list, " %02x", data);
+
+        if (data >= ' ' && data <= 120)
+        { str[ptr++] = data; }
+          else
+        { str[ptr++] = '.'; }
+
+        ch++;
+        if (ch == 16) { ch = 0; }
+      }
+        else
+      {
+        output_hex_text(asm_context->list, str, ptr);
+        ch = 0;
+        ptr = 0;
+      }
+    }
+    output_hex_text(asm_context->list, str, ptr);
+    fprintf(asm_context->list, "\n\n");
+
+    asm_context->print_info(asm_context->list);
+  }
+
+  asm_context->print_info(asm_context->messages);
+
+  if (asm_context->list != NULL) { fclose(asm_context->list); }
+  tokens_close(asm_context);
+
+  if (error_flag != 0)
+  {
+    fprintf(asm_context->messages, "*** Failed ***\n\n");
+    unlink_outputs(outfile, outputs, output_count);
+  }
+
+  return error_flag == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+struct Options
+{
+  const char *outfile;
+  OutputFile outputs[MAX_OUTPUT_FILES];
+  int output_count;
+  const char **infiles;
+  int infile_count;
+  int file_type;
+  int create_list;
+  int single_pass;
+  int threads;
+  int jobs;
+  bool batch_mode;
+  bool write_dependencies;
+  const char *dependency_file;
+  const char *cache_dir;
+};
+
+// -MD writes a make rule for the output file listing the input file and
+// every file it included.
+static int write_dependencies(
+  AsmContext *asm_context,
+  const char *infile,
+  const char *outfile,
+  const Options *options)
+{
+  char filename[1024];
+
+  if (options->dependency_file != NULL)
+  {
+    snprintf(filename, sizeof(filename), "%s", options->dependency_file);
+  }
+    else
+  {
+    snprintf(filename, sizeof(filename), "%s", outfile);
+    new_extension(filename, "d", sizeof(filename));
+  }
+
+  FILE *out = fopen(filename, "wb");
+
+  if (out == NULL)
+  {
+    fprintf(asm_context->messages, "Error: Couldn't open %s for writing.\n", filename);
+    return -1;
+  }
+
+  fprintf(out, "%s", outfile);
+
+  for (int n = 1; n < options->output_count; n++)
+  {
+    fprintf(out, " %s", options->outputs[n].filename);
+  }
+
+  fprintf(out, ": %s", infile);
+
+  for (auto name : asm_context->dependencies)
+  {
+    fprintf(out, " \\\n  %s", name);
+  }
+
+  fprintf(out, "\n");
+  fclose(out);
+
+  return 0;
+}
+
+// Everything that changes the output file or the messages goes into the
+// key for -cache_dir.  The CPU comes from the source so it's covered by
+// the hash of the input file.  Returns -1 if the input file can't be read.
+static int cache_key(
+  AsmContext *asm_context,
+  const char *infile,
+  const char *outfile,
+  const Options *options,
+  Hash128 *key)
+{
+  key->update(VERSION);
+  key->update(infile);
+
+  // The output file's name is only in the messages.
+  if (!asm_context->quiet_output) { key->update(outfile); }
+
+  key->update(options->file_type);
+  key->update(options->single_pass);
+  key->update(asm_context->quiet_output);
+  key->update(asm_context->dump_symbols);
+  key->update(asm_context->dump_macros);
+  key->update(asm_context->optimize);
+  key->update(asm_context->verbose);
+  key->update(asm_context->include_path, INCLUDE_PATH_LEN);
+
+  return output_cache_hash_file(key, infile);
+}
+
+// assemble_file() plus -MD and -cache_dir.  Listing files, linking and
+// more than one output file aren't cached.
+static int assemble_output(
+  AsmContext *asm_context,
+  const char *infile,
+  const char *outfile,
+  const Options *options)
+{
+  const int output_count =
+    options->output_count > 1 ? options->output_count - 1 : 0;
+  const bool use_cache =
+    options->cache_dir != NULL &&
+    options->create_list == 0 &&
+    output_count == 0 &&
+    asm_context->linker == NULL;
+  Hash128 key;
+
+  if (use_cache && cache_key(asm_context, infile, outfile, options, &key) == 0)
+  {
+    if (output_cache_lookup(
+          options->cache_dir,
+          key,
+          outfile,
+          asm_context->messages,
+          &asm_context->dependencies) == 0)
+    {
+      if (options->write_dependencies)
+      {
+        if (write_dependencies(asm_context, infile, outfile, options) != 0)
+        {
+          return EXIT_FAILURE;
+        }
+      }
+
+      return EXIT_SUCCESS;
+    }
+  }
+
+  // The messages are kept so they can be printed again on a cache hit.
+  FILE *messages = use_cache ? capture_start(asm_context) : NULL;
+
+  int error_flag = assemble_file(
+    asm_context,
+    infile,
+    outfile,
+    options->file_type,
+    options->outputs + 1,
+    output_count,
+    options->create_list,
+    options->single_pass,
+    options->threads);
+
+  if (use_cache)
+  {
+    if (error_flag == EXIT_SUCCESS)
+    {
+      output_cache_store(
+        options->cache_dir,
+        key,
+        outfile,
+        asm_context->messages,
+        &asm_context->dependencies);
+    }
+
+    capture_end(asm_context, messages, true);
+  }
+
+  if (error_flag == EXIT_SUCCESS && options->write_dependencies)
+  {
+    if (write_dependencies(asm_context, infile, outfile, options) != 0)
+    {
+      error_flag = EXIT_FAILURE;
+    }
+  }
+
+  return error_flag;
+}
+
+// With -j each input file gets its own AsmContext and is assembled on
+// one of the threads.  The messages for each file are kept in a temp file
+// and printed in the order the files were given once they are all done.
+struct Batch
+{
+  AsmContext *asm_context;
+  const Options *options;
+  const char **infiles;
+  const char *outfile;
+  FILE **messages;
+  int *results;
+  int count;
+  int next;
+};
+
+static void batch_options(AsmContext *asm_context, AsmContext *options)
+{
+  asm_context->quiet_output = options->quiet_output;
+  asm_context->dump_symbols = options->dump_symbols;
+  asm_context->dump_macros = options->dump_macros;
+  asm_context->optimize = options->optimize;
+  asm_context->no_instruction_cache = options->no_instruction_cache;
+  asm_context->verbose = options->verbose;
+  asm_context->cache_dir = options->cache_dir;
+
+  memcpy(asm_context->include_path, options->include_path, INCLUDE_PATH_LEN);
+}
+
+// The output file is the input file with the extension of the default
+// output file (out.hex, out.bin, etc).
+static void batch_outfile(
+  char *filename,
+  const char *infile,
+  const char *outfile,
+  int len)
+{
+  const char *ext = strrchr(outfile, '.');
+  const char *slash = strrchr(infile, '/');
+  const char *dot = strrchr(infile, '.');
+  int length = strlen(infile);
+
+  if (dot != NULL && (slash == NULL || dot > slash)) { length = dot - infile; }
+  if (ext == NULL) { ext = ""; }
+
+  snprintf(filename, len, "%.*s%s", length, infile, ext);
+}
+
+static void *batch_thread(void *arg)
+{
+  Batch *batch = (Batch *)arg;
+
+  while (true)
+  {
+    const int n = __atomic_fetch_add(&batch->next, 1, __ATOMIC_RELAXED);
+
+    if (n >= batch->count) { break; }
+
+    AsmContext *asm_context = new AsmContext();
+    char outfile[1024];
+
+    batch_options(asm_context, batch->asm_context);
+    batch_outfile(outfile, batch->infiles[n], batch->outfile, sizeof(outfile));
+
+    batch->messages[n] = tmpfile();
+
+    if (batch->messages[n] != NULL)
+    {
+      asm_context->messages = batch->messages[n];
+    }
+
+    batch->results[n] = assemble_output(
+      asm_context,
+      batch->infiles[n],
+      outfile,
+      batch->options);
+
+    delete asm_context;
+  }
+
+  return NULL;
+}
+
+static int assemble_batch(Batch *batch, int jobs)
+{
+  int error_flag = 0;
+  int n;
+
+  batch->messages = (FILE **)malloc(sizeof(FILE *) * batch->count);
+  batch->results = (int *)malloc(sizeof(int) * batch->count);
+  batch->next = 0;
+
+  if (jobs > batch->count) { jobs = batch->count; }
+
+#ifdef PTHREADS
+  pthread_t *ids = (pthread_t *)malloc(sizeof(pthread_t) * jobs);
+  int started = 0;
+
+  for (n = 1; n < jobs; n++)
+  {
+    if (pthread_create(&ids[n], NULL, batch_thread, batch) != 0) { break; }
+
+    started = n;
+  }
+
+  batch_thread(batch);
+
+  for (n = 1; n <= started; n++)
+  {
+    pthread_join(ids[n], NULL);
+  }
+
+  free(ids);
+#else
+  batch_thread(batch);
+#endif
+
+  for (n = 0; n < batch->count; n++)
+  {
+    FILE *messages = batch->messages[n];
+
+    if (messages != NULL)
+    {
+      char buffer[4096];
+      size_t length;
+
+      rewind(messages);
+
+      while ((length = fread(buffer, 1, sizeof(buffer), messages)) > 0)
+      {
+        fwrite(buffer, 1, length, stdout);
+      }
+
+      fclose(messages);
+    }
+
+    if (batch->results[n] != 0)
+    {
+      printf("Error: %s failed.\n", batch->infiles[n]);
+      error_flag = 1;
+    }
+  }
+
+  free(batch->messages);
+  free(batch->results);
+
+  return error_flag == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static int get_file_type(const char *name)
+{
+  if (strcmp(name, "amiga") == 0) { return FILE_TYPE_AMIGA; }
+  if (strcmp(name, "bin") == 0)   { return FILE_TYPE_BIN; }
+  if (strcmp(name, "elf") == 0)   { return FILE_TYPE_ELF; }
+  if (strcmp(name, "hex") == 0)   { return FILE_TYPE_HEX; }
+  if (strcmp(name, "srec") == 0)  { return FILE_TYPE_SREC; }
+  if (strcmp(name, "wdc") == 0)   { return FILE_TYPE_WDC; }
+  if (strcmp(name, "macho") == 0) { return FILE_TYPE_MACHO; }
+  if (strcmp(name, "uf2") == 0)   { return FILE_TYPE_UF2; }
+
+  return FILE_TYPE_AUTO;
+}
+
+// -o file or -o file:type.  Without a type the file gets the -type
+// option.  A : that isn't a drive letter (C:\out.hex) has to be followed
+// by a type.  Returns -1 if the name is too long or -2 if the type isn't
+// known.
+static int parse_output(OutputFile *output, const char *arg)
+{
+  if (strlen(arg) >= sizeof(output->filename)) { return -1; }
 
-  if (i == 0)
+  strcpy(output->filename, arg);
+  output->file_type = FILE_TYPE_AUTO;
+
+  char *colon = strrchr(output->filename, ':');
+
+  if (colon == NULL) { return 0; }
+
+  if (colon == output->filename + 1 && isalpha(output->filename[0]))
   {
-    strcat(filename, ".");
-    strcat(filename, ext);
+    return 0;
   }
-}
 
-static void output_hex_text(FILE *fp, char *s, int ptr)
-{
-  if (ptr == 0) { return; }
-  s[ptr] = 0;
-  int n;
-  for (n = 0; n < ((16 - ptr) * 3) + 2; n++) { putc(' ', fp); }
-  fprintf(fp, "%s", s);
+  output->file_type = get_file_type(colon + 1);
+
+  if (output->file_type == FILE_TYPE_AUTO) { return -2; }
+
+  *colon = 0;
+
+  return 0;
 }
 
-int main(int argc, char *argv[])
+// Errors go to asm_context->messages.  Returns 0 if there is something
+// to assemble, 1 if there's nothing else to do (-cpu_list) or -1 on an
+// error.  options->infiles has to be freed by the caller.
+static int parse_options(
+  AsmContext *asm_context,
+  Options *options,
+  int argc,
+  char *argv[])
 {
   int i;
-  int file_type = FILE_TYPE_HEX;
-  int create_list = 0;
-  const char *infile = NULL;
-  const char *outfile = NULL;
-  AsmContext asm_context;
   int error_flag = 0;
 
-  puts(credits);
-
-  if (argc < 2)
-  {
-    printf("Usage: naken_asm [options] <infile>\n"
-           "   -o <outfile>\n"
-           "   -type <hex, elf, bin, macho, srec, amiga, wdc, uf2>\n"
-           "   -l             [create .lst listing file]\n"
-           "   -I             [add to include path]\n"
-           "   -q             Quiet (only output errors)\n"
-           "   -dump_symbols  Dump all symbols at end of assembly\n"
-           "   -dump_macros   Dump all macros at end of assembly\n"
-           "   -optimize      Optimize instructions (see docs for info)\n"
-           "   -cpu_list      List supported CPUs\n"
-           "\n");
-    exit(0);
-  }
+  options->outfile = NULL;
+  options->output_count = 0;
+  options->infiles = (const char **)malloc(sizeof(char *) * argc);
+  options->infile_count = 0;
+  options->file_type = FILE_TYPE_HEX;
+  options->create_list = 0;
+  options->single_pass = 0;
+  options->threads = 1;
+  options->jobs = 0;
+  options->batch_mode = false;
+  options->write_dependencies = false;
+  options->dependency_file = NULL;
+  options->cache_dir = NULL;
 
   for (i = 1; i < argc; i++)
   {
     if (strcmp(argv[i], "-cpu_list") == 0)
     {
-      printf(
+      fprintf(asm_context->messages,
         " Supported CPUs:\n"
         "    1802, 4004, 6502, 65C816, 68HC08, 6809, 68000, 8008, 8048, 8051,\n"
         "    86000, ARM, AVR8, Cell BE, Copper, CP1610, dsPIC, Epiphany,\n"
@@ -109,103 +880,91 @@ int main(int argc, char *argv[])
         "    Playstation 2 EE, PowerPC, Propeller, Propeller 2, PSoC, M8C,\n"
         "    RV32EM, RISC-V, SH-4, STM8, SuperFX, SWEET16, unSP, THUMB, TMS1000,\n"
         "    TMS1100, TMS340, TMS9900, WebAssembly, Xtensa, Z80\n");
-      exit(0);
+      return 1;
     }
 
     if (strcmp(argv[i], "-o") == 0)
     {
-      outfile = argv[++i];
+      if (i + 1 >= argc)
+      {
+        fprintf(asm_context->messages, "Error: -o takes a filename\n");
+        return -1;
+      }
+
+      if (options->output_count == MAX_OUTPUT_FILES)
+      {
+        fprintf(asm_context->messages, "Error: No more than %d output files.\n", MAX_OUTPUT_FILES);
+        return -1;
+      }
+
+      const int ret =
+        parse_output(&options->outputs[options->output_count++], argv[++i]);
+
+      if (ret == -1)
+      {
+        fprintf(asm_context->messages, "Error: Output filename too long %s\n", argv[i]);
+        return -1;
+      }
+
+      if (ret == -2)
+      {
+        fprintf(asm_context->messages, "Error: Unknown output type in %s\n", argv[i]);
+        return -1;
+      }
     }
       else
     if (strcmp(argv[i], "-h") == 0)
     {
-      file_type = FILE_TYPE_HEX;
+      options->file_type = FILE_TYPE_HEX;
     }
       else
     if (strcmp(argv[i], "-bin") == 0 || strcmp(argv[i], "-b") == 0)
     {
-      file_type = FILE_TYPE_BIN;
+      options->file_type = FILE_TYPE_BIN;
     }
       else
     if (strcmp(argv[i], "-srec") == 0 || strcmp(argv[i], "-s") == 0)
     {
-      file_type = FILE_TYPE_SREC;
+      options->file_type = FILE_TYPE_SREC;
     }
       else
     if (strcmp(argv[i], "-elf") == 0 || strcmp(argv[i], "-e") == 0)
     {
-      file_type = FILE_TYPE_ELF;
+      options->file_type = FILE_TYPE_ELF;
     }
       else
     if (strcmp(argv[i], "-wdc") == 0)
     {
-      file_type = FILE_TYPE_WDC;
+      options->file_type = FILE_TYPE_WDC;
     }
       else
     if (strcmp(argv[i], "-amiga") == 0)
     {
-      file_type = FILE_TYPE_AMIGA;
+      options->file_type = FILE_TYPE_AMIGA;
     }
       else
     if (strcmp(argv[i], "-type") == 0)
     {
       if (i + 1 >= argc)
       {
-        printf("Error: -type takes an option\n");
-        exit(1);
+        fprintf(asm_context->messages, "Error: -type takes an option\n");
+        return -1;
       }
 
       i++;
 
-      if (strcmp(argv[i], "amiga") == 0)
-      {
-        file_type = FILE_TYPE_AMIGA;
-      }
-        else
-      if (strcmp(argv[i], "bin") == 0)
-      {
-        file_type = FILE_TYPE_BIN;
-      }
-        else
-      if (strcmp(argv[i], "elf") == 0)
-      {
-        file_type = FILE_TYPE_ELF;
-      }
-        else
-      if (strcmp(argv[i], "hex") == 0)
-      {
-        file_type = FILE_TYPE_HEX;
-      }
-        else
-      if (strcmp(argv[i], "srec") == 0)
-      {
-        file_type = FILE_TYPE_SREC;
-      }
-        else
-      if (strcmp(argv[i], "wdc") == 0)
-      {
-        file_type = FILE_TYPE_WDC;
-      }
-        else
-      if (strcmp(argv[i], "macho") == 0)
-      {
-        file_type = FILE_TYPE_MACHO;
-      }
-        else
-      if (strcmp(argv[i], "uf2") == 0)
-      {
-        file_type = FILE_TYPE_UF2;
-      }
-        else
+      options->file_type = get_file_type(argv[i]);
+
+      if (options->file_type == FILE_TYPE_AUTO)
       {
-        printf("Error: Unknown output type %s\n", argv[i]);
-        exit(1);
+        fprintf(asm_context->messages, "Error: Unknown output type %s\n", argv[i]);
+        return -1;
       }
     }
       else
     if (strcmp(argv[i], "-l") == 0)
     {
-      create_list = 1;
+      options->create_list = 1;
     }
       else
     if (strncmp(argv[i], "-I", 2) == 0)
@@ -216,54 +975,122 @@ int main(int argc, char *argv[])
       {
         if (i + 1 >= argc)
         {
-          printf("Error: -I takes an option\n");
-          exit(1);
+          fprintf(asm_context->messages, "Error: -I takes an option\n");
+          return -1;
         }
 
-        if (include_add_path(&asm_context, argv[++i]) != 0)
+        if (include_add_path(asm_context, argv[++i]) != 0)
         {
-          printf("Internal Error:  Too many include paths\n");
-          exit(1);
+          fprintf(asm_context->messages, "Internal Error:  Too many include paths\n");
+          return -1;
         }
       }
         else
       {
-        if (include_add_path(&asm_context, s+2) != 0)
+        if (include_add_path(asm_context, s+2) != 0)
         {
-          printf("Internal Error:  Too many include paths\n");
-          exit(1);
+          fprintf(asm_context->messages, "Internal Error:  Too many include paths\n");
+          return -1;
         }
       }
     }
       else
     if (strcmp(argv[i], "-q") == 0)
     {
-      asm_context.quiet_output = 1;
+      asm_context->quiet_output = 1;
     }
       else
     if (strcmp(argv[i], "-dump_symbols") == 0)
     {
-      asm_context.dump_symbols = 1;
+      asm_context->dump_symbols = 1;
     }
       else
     if (strcmp(argv[i], "-dump_macros") == 0)
     {
-      asm_context.dump_macros = 1;
+      asm_context->dump_macros = 1;
     }
       else
     if (strcmp(argv[i], "-optimize") == 0)
     {
-      asm_context.optimize = 1;
+      asm_context->optimize = 1;
+    }
+      else
+    if (strcmp(argv[i], "-verbose") == 0)
+    {
+      asm_context->verbose = 1;
+    }
+      else
+    if (strcmp(argv[i], "-no_instr_cache") == 0)
+    {
+      asm_context->no_instruction_cache = 1;
+    }
+      else
+    if (strcmp(argv[i], "-single_pass") == 0)
+    {
+      options->single_pass = 1;
+    }
+      else
+    if (strcmp(argv[i], "-threads") == 0)
+    {
+      if (i + 1 >= argc)
+      {
+        fprintf(asm_context->messages, "Error: -threads needs a number\n");
+        return -1;
+      }
+
+      options->threads = atoi(argv[++i]);
+    }
+      else
+    if (strcmp(argv[i], "-MD") == 0)
+    {
+      options->write_dependencies = true;
+    }
+      else
+    if (strcmp(argv[i], "-MF") == 0)
+    {
+      if (i + 1 >= argc)
+      {
+        fprintf(asm_context->messages, "Error: -MF takes a filename\n");
+        return -1;
+      }
+
+      options->write_dependencies = true;
+      options->dependency_file = argv[++i];
+    }
+      else
+    if (strcmp(argv[i], "-cache_dir") == 0)
+    {
+      if (i + 1 >= argc)
+      {
+        fprintf(asm_context->messages, "Error: -cache_dir takes a directory\n");
+        return -1;
+      }
+
+      options->cache_dir = argv[++i];
+      asm_context->cache_dir = options->cache_dir;
+    }
+      else
+    if (strcmp(argv[i], "-j") == 0)
+    {
+      if (i + 1 >= argc)
+      {
+        fprintf(asm_context->messages, "Error: -j needs a number\n");
+        return -1;
+      }
+
+      options->jobs = atoi(argv[++i]);
+
+      if (options->jobs < 1) { options->jobs = 1; }
     }
       else
     {
       if (argv[i][0] == '-')
       {
-        printf("Error: Unknown command line argument '%s'\n", argv[i]);
-        exit(1);
+        fprintf(asm_context->messages, "Error: Unknown command line argument '%s'\n", argv[i]);
+        return -1;
       }
 
-      int n = assembler_link_file(&asm_context, argv[i]);
+      int n = assembler_link_file(asm_context, argv[i]);
 
       if (n == 0) { continue; }
 
@@ -273,201 +1100,325 @@ int main(int argc, char *argv[])
         continue;
       }
 
-      if (infile != NULL)
+      options->infiles[options->infile_count++] = argv[i];
+    }
+  }
+
+  if (error_flag != 0) { return -1; }
+
+  // The first -o is the output file the messages, listing and -MD are
+  // named after.
+  for (i = 0; i < options->output_count; i++)
+  {
+    if (options->outputs[i].file_type == FILE_TYPE_AUTO)
+    {
+      options->outputs[i].file_type = options->file_type;
+    }
+  }
+
+  // Two threads writing the same file at once would leave a mess.
+  for (i = 1; i < options->output_count; i++)
+  {
+    for (int n = 0; n < i; n++)
+    {
+      if (strcmp(options->outputs[i].filename, options->outputs[n].filename) == 0)
       {
-        printf("Error: Cannot use %s as input file since %s was already chosen.\n", argv[i], infile);
-        exit(1);
+        fprintf(asm_context->messages,
+          "Error: %s is given as an output file more than once.\n",
+          options->outputs[i].filename);
+        return -1;
       }
-
-      infile = argv[i];
     }
   }
 
-  if (error_flag != 0)
+  if (options->output_count > 0)
   {
-    exit(1);
+    options->outfile = options->outputs[0].filename;
+    options->file_type = options->outputs[0].file_type;
   }
 
-  if (infile == NULL)
+  if (options->infile_count == 0)
   {
-    printf("No input file specified.\n");
-    exit(1);
+    fprintf(asm_context->messages, "No input file specified.\n");
+    return -1;
+  }
+
+  if (options->jobs == 0 && options->infile_count > 1)
+  {
+    fprintf(asm_context->messages, "Error: Cannot use %s as input file since %s was already chosen.\n", options->infiles[1], options->infiles[0]);
+    return -1;
+  }
+
+  if (options->jobs > 0 && asm_context->linker != NULL)
+  {
+    fprintf(asm_context->messages, "Error: Object files can't be linked with -j.\n");
+    return -1;
+  }
+
+  if (options->jobs > 0 && options->infile_count > 1 && options->outfile != NULL)
+  {
+    fprintf(asm_context->messages, "Error: -o can't be used with -j and more than one input file.\n");
+    return -1;
+  }
+
+  if (options->jobs > 0 && options->infile_count > 1 &&
+      options->dependency_file != NULL)
+  {
+    fprintf(asm_context->messages, "Error: -MF can't be used with -j and more than one input file.\n");
+    return -1;
   }
 
-  if (outfile == NULL)
+  // With -j the output files are named after the input files.
+  options->batch_mode = options->jobs > 0 && options->outfile == NULL;
+
+  if (options->outfile == NULL)
   {
-    switch (file_type)
+    switch (options->file_type)
     {
-      case FILE_TYPE_HEX:   outfile = "out.hex";   break;
-      case FILE_TYPE_BIN:   outfile = "out.bin";   break;
-      case FILE_TYPE_ELF:   outfile = "out.elf";   break;
-      case FILE_TYPE_SREC:  outfile = "out.srec";  break;
-      case FILE_TYPE_WDC:   outfile = "out.wdc";   break;
-      case FILE_TYPE_AMIGA: outfile = "out";       break;
-      case FILE_TYPE_MACHO: outfile = "out.macho"; break;
-      case FILE_TYPE_UF2:   outfile = "out.uf2";   break;
-      default:              outfile = "out.err";   break;
+      case FILE_TYPE_HEX:   options->outfile = "out.hex";   break;
+      case FILE_TYPE_BIN:   options->outfile = "out.bin";   break;
+      case FILE_TYPE_ELF:   options->outfile = "out.elf";   break;
+      case FILE_TYPE_SREC:  options->outfile = "out.srec";  break;
+      case FILE_TYPE_WDC:   options->outfile = "out.wdc";   break;
+      case FILE_TYPE_AMIGA: options->outfile = "out";       break;
+      case FILE_TYPE_MACHO: options->outfile = "out.macho"; break;
+      case FILE_TYPE_UF2:   options->outfile = "out.uf2";   break;
+      default:              options->outfile = "out.err";   break;
     }
   }
 
 #ifdef INCLUDE_PATH
-  if (include_add_path(&asm_context, INCLUDE_PATH) != 0)
+  if (include_add_path(asm_context, INCLUDE_PATH) != 0)
   {
-    printf("Internal Error:  Too many include paths\n");
-    exit(1);
+    fprintf(asm_context->messages, "Internal Error:  Too many include paths\n");
+    return -1;
   }
 #endif
 
-  if (include_add_path(&asm_context, "include") != 0)
+  if (include_add_path(asm_context, "include") != 0)
   {
-    printf("Internal Error:  Too many include paths\n");
-    exit(1);
+    fprintf(asm_context->messages, "Internal Error:  Too many include paths\n");
+    return -1;
   }
 
-  if (tokens_open_file(&asm_context, infile) != 0)
+
+  return 0;
+}
+
+static int assemble_options(AsmContext *asm_context, Options *options)
+{
+  if (options->batch_mode)
   {
-    printf("Error: Couldn't open %s for reading.\n\n", infile);
-    exit(1);
+    Batch batch;
+
+    batch.asm_context = asm_context;
+    batch.options = options;
+    batch.infiles = options->infiles;
+    batch.outfile = options->outfile;
+    batch.count = options->infile_count;
+
+    return assemble_batch(&batch, options->jobs);
   }
 
-  if (asm_context.quiet_output == 0)
+  return assemble_output(
+    asm_context,
+    options->infiles[0],
+    options->outfile,
+    options);
+}
+
+// One request to -server.  The same AsmContext is used for every
+// request and reset() in between, so the source files read by the last
+// request (and the tokens lexed from them) are kept if they didn't
+// change.  With "-o -" the output file is sent back instead of written
+// and *output is set to it.
+static int serve_request(
+  AsmContext *asm_context,
+  ServerRequest *request,
+  FILE *messages,
+  FILE **output)
+{
+  Options options;
+  char filename[64] = { 0 };
+  int status = EXIT_FAILURE;
+
+  // reset() reads the source files again so this has to be first.
+  if (chdir(request->cwd) != 0)
   {
-    printf(" Input file: %s\n", infile);
-    printf("Output file: %s\n", outfile);
+    fprintf(messages, "Error: Couldn't change directory to %s.\n", request->cwd);
+    return status;
   }
 
-  if (create_list == 1)
-  {
-    char filename[1024];
-    strcpy(filename, outfile);
+  asm_context->reset();
+  asm_context->messages = messages;
 
-    new_extension(filename, "lst", 1024);
+  const int ret =
+    parse_options(asm_context, &options, request->argc, request->argv);
+
+  if (ret == 1) { status = EXIT_SUCCESS; }
 
-    asm_context.list = fopen(filename, "wb");
-    if (asm_context.list == NULL)
+  if (ret == 0 && options.jobs != 0)
+  {
+    fprintf(messages, "Error: -j can't be used with -server.\n");
+  }
+    else
+  if (ret == 0 && options.create_list == 1 &&
+      strcmp(options.outfile, "-") == 0)
+  {
+    fprintf(messages, "Error: -l can't be used with -o -.\n");
+  }
+    else
+  if (ret == 0)
+  {
+    if (strcmp(options.outfile, "-") == 0)
     {
-      printf("\nError: Couldn't open %s for writing.\n\n", filename);
-      exit(1);
+      strcpy(filename, "/tmp/naken_asm_XXXXXX");
+
+      const int fd = mkstemp(filename);
+
+      if (fd >= 0) { close(fd); }
+      options.outfile = filename;
     }
 
-    if (asm_context.quiet_output == 0)
+    status = assemble_options(asm_context, &options);
+
+    if (filename[0] != 0)
     {
-      printf("  List file: %s\n", filename);
+      if (status == EXIT_SUCCESS) { *output = fopen(filename, "rb"); }
+      unlink(filename);
     }
   }
 
-  if (asm_context.quiet_output == 0)
+  asm_context->messages = stdout;
+  free(options.infiles);
+
+  return status;
+}
+
+// naken_asm -server <socket> answers requests one at a time until one
+// of them is just -stop.
+static int serve(const char *path)
+{
+  AsmContext asm_context;
+  ServerRequest *request = new ServerRequest;
+  const int server = server_open(path);
+
+  if (server < 0)
   {
-    printf("\nPass 1...\n");
+    delete request;
+    return EXIT_FAILURE;
   }
 
-  //macros_init(&asm_context.macros);
+  printf("Listening on %s\n", path);
+  fflush(stdout);
+
+  while (true)
+  {
+    const int connection = server_accept(server, request);
 
-  asm_context.init();
+    if (connection < 0) { break; }
 
-  error_flag = assemble(&asm_context);
+    const bool stop =
+      request->argc == 2 && strcmp(request->argv[1], "-stop") == 0;
+    FILE *messages = tmpfile();
+    FILE *output = NULL;
+    int status = EXIT_FAILURE;
 
-  do
-  {
-    if (error_flag == 0 && assembler_link(&asm_context) != 0)
+    if (messages == NULL)
     {
-      error_flag = 1;
+      close(connection);
+      continue;
     }
 
-    if (error_flag != 0)
+    if (stop)
     {
-      printf("** Errors... bailing out\n");
-      unlink(outfile);
-      break;
+      status = EXIT_SUCCESS;
+    }
+      else
+    {
+      status = serve_request(&asm_context, request, messages, &output);
     }
 
-    asm_context.symbols.lock();
-    asm_context.symbols.scope_reset();
-    // asm_context->macros.lock(&asm_context.defines_heap);
-
-    if (asm_context.quiet_output == 0) { printf("Pass 2...\n"); }
-    asm_context.pass = 2;
-    asm_context.init();
-
-    if (create_list == 1) { asm_context.write_list_file = 1; }
+    server_reply(connection, status, messages, output);
 
-    error_flag = assemble(&asm_context);
+    fclose(messages);
+    if (output != NULL) { fclose(output); }
 
-    if (error_flag != 0) { break; }
+    if (stop) { break; }
+  }
 
-    if (assembler_link(&asm_context) != 0)
-    {
-      error_flag = 1;
-      break;
-    }
+  server_close(server, path);
+  delete request;
 
-    int retcode = file_write(outfile, &asm_context, file_type);
+  return EXIT_SUCCESS;
+}
 
-    if (retcode == -1)
-    {
-      printf("\nError: Couldn't open %s for writing.\n\n", outfile);
-      exit(1);
-    }
-  } while (0);
+int main(int argc, char *argv[])
+{
+  Options options;
+  AsmContext asm_context;
 
-  if (create_list == 1)
+  // The reply from the server is printed as is (and may be the output
+  // file) so the credits aren't.
+  if (argc >= 3 && strcmp(argv[1], "-client") == 0)
   {
-    int ch = 0;
-    char str[17];
-    int ptr = 0;
-    uint32_t i;
+    const int status = server_send(argv[2], argc - 3, argv + 3);
 
-    fprintf(asm_context.list, "data sections:");
-
-    for (i = asm_context.memory.low_address; i <= asm_context.memory.high_address; i++)
-    {
-      if (asm_context.read_debug(i) == -2)
-      {
-        if (ch == 0)
-        {
-          if (ptr != 0)
-          {
-            output_hex_text(asm_context.list, str, ptr);
-          }
-          fprintf(asm_context.list, "\n%04x:", i/asm_context.bytes_per_address);
-          ptr = 0;
-        }
+    return status < 0 ? EXIT_FAILURE : status;
+  }
 
-        uint8_t data = asm_context.memory_read(i);
-        fprintf(asm_context.list, " %02x", data);
+  puts(credits);
 
-        if (data >= ' ' && data <= 120)
-        { str[ptr++] = data; }
-          else
-        { str[ptr++] = '.'; }
+  if (argc < 2)
+  {
+    printf("Usage: naken_asm [options] <infile>\n"
+           "       naken_asm -j <n> [options] <infile> <infile> ...\n"
+           "       naken_asm -server <socket>\n"
+           "       naken_asm -client <socket> [options] <infile>\n"
+           "   -o <outfile[:type]> [can be used more than once]\n"
+           "   -type <hex, elf, bin, macho, srec, amiga, wdc, uf2>\n"
+           "   -l             [create .lst listing file]\n"
+           "   -I             [add to include path]\n"
+           "   -q             Quiet (only output errors)\n"
+           "   -dump_symbols  Dump all symbols at end of assembly\n"
+           "   -dump_macros   Dump all macros at end of assembly\n"
+           "   -optimize      Optimize instructions (see docs for info)\n"
+           "   -verbose       Show source file and token cache use\n"
+           "   -no_instr_cache Don't reuse instructions from macros\n"
+           "   -single_pass   Try to assemble in one pass (see docs for info)\n"
+           "   -threads <n>   Use n threads for pass 2 (see docs for info)\n"
+           "   -j <n>         Assemble all the input files, n at a time\n"
+           "   -MD            Write a .d make dependency file for the output\n"
+           "   -MF <file>     Write the dependency file to file (implies -MD)\n"
+           "   -cache_dir <d> Reuse output from earlier runs kept in d\n"
+           "   -cpu_list      List supported CPUs\n"
+           "\n");
+    exit(0);
+  }
 
-        ch++;
-        if (ch == 16) { ch = 0; }
-      }
-        else
-      {
-        output_hex_text(asm_context.list, str, ptr);
-        ch = 0;
-        ptr = 0;
-      }
+  if (strcmp(argv[1], "-server") == 0)
+  {
+    if (argc != 3)
+    {
+      printf("Error: -server takes the name of a socket\n");
+      exit(1);
     }
-    output_hex_text(asm_context.list, str, ptr);
-    fprintf(asm_context.list, "\n\n");
 
-    asm_context.print_info(asm_context.list);
+    return serve(argv[2]);
   }
 
-  asm_context.print_info(stdout);
-
-  if (asm_context.list != NULL) { fclose(asm_context.list); }
-  fclose(asm_context.tokens.in);
+  const int ret = parse_options(&asm_context, &options, argc, argv);
 
-  if (error_flag != 0)
+  if (ret != 0)
   {
-    printf("*** Failed ***\n\n");
-    unlink(outfile);
+    free(options.infiles);
+    exit(ret == 1 ? 0 : 1);
   }
 
-  return error_flag == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+  const int error_flag = assemble_options(&asm_context, &options);
+
+  free(options.infiles);
+
+  return error_flag;
 }
 
@@ -0,0 +1,264 @@
+/**
+ *  naken_asm assembler.
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: https://www.mikekohn.net/
+ * License: GPLv3
+ *
+ * Copyright 2010-2025 by Michael Kohn
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "common/output_cache.h"
+
+static void cache_filename(
+  char *filename,
+  int len,
+  const char *dir,
+  const Hash128 &hash,
+  const char *ext)
+{
+  snprintf(filename, len, "%s/%016" PRIx64 "%016" PRIx64 ".%s",
+    dir, hash.a, hash.b, ext);
+}
+
+// Copy the whole file in to out.  Returns -1 if either can't be opened.
+static int copy_file(const char *out, const char *in)
+{
+  FILE *fp_in = fopen(in, "rb");
+
+  if (fp_in == NULL) { return -1; }
+
+  FILE *fp_out = fopen(out, "wb");
+
+  if (fp_out == NULL)
+  {
+    fclose(fp_in);
+    return -1;
+  }
+
+  char buffer[4096];
+  size_t length;
+  int ret = 0;
+
+  while ((length = fread(buffer, 1, sizeof(buffer), fp_in)) > 0)
+  {
+    if (fwrite(buffer, 1, length, fp_out) != length) { ret = -1; break; }
+  }
+
+  fclose(fp_in);
+  if (fclose(fp_out) != 0) { ret = -1; }
+
+  return ret;
+}
+
+// Files in the cache are written under a temp name and then renamed so
+// another naken_asm (or another -j thread) never sees half of one.
+static int store_file(const char *filename, const char *in, FILE *fp_in)
+{
+  static int count = 0;
+  char temp[1024];
+  int ret = 0;
+
+  snprintf(temp, sizeof(temp), "%s.%d.%d",
+    filename, (int)getpid(), __atomic_fetch_add(&count, 1, __ATOMIC_RELAXED));
+
+  if (in != NULL)
+  {
+    ret = copy_file(temp, in);
+  }
+    else
+  {
+    FILE *out = fopen(temp, "wb");
+
+    if (out == NULL) { return -1; }
+
+    char buffer[4096];
+    size_t length;
+
+    rewind(fp_in);
+
+    while ((length = fread(buffer, 1, sizeof(buffer), fp_in)) > 0)
+    {
+      if (fwrite(buffer, 1, length, out) != length) { ret = -1; break; }
+    }
+
+    if (fclose(out) != 0) { ret = -1; }
+  }
+
+  if (ret == 0) { ret = rename(temp, filename); }
+  if (ret != 0) { unlink(temp); }
+
+  return ret == 0 ? 0 : -1;
+}
+
+int output_cache_hash_file(Hash128 *hash, const char *filename)
+{
+  FILE *in = fopen(filename, "rb");
+
+  if (in == NULL) { return -1; }
+
+  char buffer[4096];
+  int length;
+
+  while ((length = fread(buffer, 1, sizeof(buffer), in)) > 0)
+  {
+    hash->update(buffer, length);
+  }
+
+  fclose(in);
+
+  return 0;
+}
+
+// Returns 0 if the output for key was found and written to outfile.  The
+// messages from when it was assembled are printed again and the files it
+// included are added to dependencies.
+int output_cache_lookup(
+  const char *dir,
+  const Hash128 &key,
+  const char *outfile,
+  FILE *messages,
+  StringHeap *dependencies)
+{
+  char filename[1024];
+  char line[1024];
+  Hash128 result = key;
+
+  cache_filename(filename, sizeof(filename), dir, key, "manifest");
+
+  FILE *in = fopen(filename, "rb");
+
+  if (in == NULL) { return -1; }
+
+  StringHeap names;
+  int ret = 0;
+
+  while (fgets(line, sizeof(line), in) != NULL)
+  {
+    char *name = line + 33;
+    Hash128 expected;
+    Hash128 hash;
+
+    line[strcspn(line, "\n")] = 0;
+
+    if (strlen(line) < 34 ||
+        sscanf(line, "%16" SCNx64 "%16" SCNx64, &expected.a, &expected.b) != 2 ||
+        output_cache_hash_file(&hash, name) != 0 ||
+        hash.a != expected.a ||
+        hash.b != expected.b)
+    {
+      ret = -1;
+      break;
+    }
+
+    result.update(hash);
+    names.append(name);
+  }
+
+  fclose(in);
+
+  if (ret != 0) { return -1; }
+
+  cache_filename(filename, sizeof(filename), dir, result, "out");
+
+  if (copy_file(outfile, filename) != 0) { return -1; }
+
+  cache_filename(filename, sizeof(filename), dir, result, "msg");
+
+  in = fopen(filename, "rb");
+
+  if (in != NULL)
+  {
+    size_t length;
+
+    while ((length = fread(line, 1, sizeof(line), in)) > 0)
+    {
+      fwrite(line, 1, length, messages);
+    }
+
+    fclose(in);
+  }
+
+  for (auto name : names)
+  {
+    if (dependencies->find(name) == -1) { dependencies->append(name); }
+  }
+
+  return 0;
+}
+
+// Save outfile and the messages (all of them, from the start of the
+// file) under key after a run that worked.
+int output_cache_store(
+  const char *dir,
+  const Hash128 &key,
+  const char *outfile,
+  FILE *messages,
+  StringHeap *dependencies)
+{
+  char filename[1024];
+  Hash128 result = key;
+
+#ifdef WINDOWS
+  mkdir(dir);
+#else
+  mkdir(dir, 0777);
+#endif
+
+  FILE *manifest = tmpfile();
+
+  if (manifest == NULL) { return -1; }
+
+  int ret = 0;
+
+  for (auto name : *dependencies)
+  {
+    Hash128 hash;
+
+    if (output_cache_hash_file(&hash, name) != 0 || strchr(name, '\n') != NULL)
+    {
+      ret = -1;
+      break;
+    }
+
+    fprintf(manifest, "%016" PRIx64 "%016" PRIx64 " %s\n",
+      hash.a, hash.b, name);
+
+    result.update(hash);
+  }
+
+  // The output goes in first so a manifest never points at something
+  // that isn't there.
+  if (ret == 0)
+  {
+    cache_filename(filename, sizeof(filename), dir, result, "out");
+    ret = store_file(filename, outfile, NULL);
+  }
+
+  if (ret == 0)
+  {
+    cache_filename(filename, sizeof(filename), dir, result, "msg");
+    ret = store_file(filename, NULL, messages);
+  }
+
+  if (ret == 0)
+  {
+    cache_filename(filename, sizeof(filename), dir, key, "manifest");
+    ret = store_file(filename, NULL, manifest);
+  }
+
+  fclose(manifest);
+
+  return ret;
+}
+
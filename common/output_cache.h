@@ -0,0 +1,44 @@
+/**
+ *  naken_asm assembler.
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: https://www.mikekohn.net/
+ * License: GPLv3
+ *
+ * Copyright 2010-2025 by Michael Kohn
+ *
+ */
+
+#ifndef NAKEN_ASM_OUTPUT_CACHE_H
+#define NAKEN_ASM_OUTPUT_CACHE_H
+
+#include <stdio.h>
+
+#include "common/hash.h"
+#include "common/StringHeap.h"
+
+// naken_asm -cache_dir keeps the output file and messages of each run
+// that worked.  key is a hash of the command line options and the input
+// file.  The files it included can't be known without assembling, so
+// <key>.manifest lists them with a hash of each.  If they all still
+// match, the hash of key and the included files names <hash>.out and
+// <hash>.msg.
+
+int output_cache_hash_file(Hash128 *hash, const char *filename);
+
+int output_cache_lookup(
+  const char *dir,
+  const Hash128 &key,
+  const char *outfile,
+  FILE *messages,
+  StringHeap *dependencies);
+
+int output_cache_store(
+  const char *dir,
+  const Hash128 &key,
+  const char *outfile,
+  FILE *messages,
+  StringHeap *dependencies);
+
+#endif
+
@@ -18,21 +18,23 @@
 
 void print_error(AsmContext *asm_context, const char *s)
 {
-  printf("Error: %s at %s:%d\n", s,
+  fprintf(asm_context->messages, "Error: %s at %s:%d\n", s,
     asm_context->tokens.filename,
     asm_context->tokens.line);
 }
 
 void print_warning(AsmContext *asm_context, const char *s)
 {
-  printf("Warning: %s at %s:%d\n", s,
+  asm_context->warning_count++;
+
+  fprintf(asm_context->messages, "Warning: %s at %s:%d\n", s,
     asm_context->tokens.filename,
     asm_context->tokens.line);
 }
 
 void print_error_unexp(AsmContext *asm_context, const char *s)
 {
-  printf("Error: Unexpected token '%s' at %s:%d\n", *s == '\n' ? "<EOL>" : s,
+  fprintf(asm_context->messages, "Error: Unexpected token '%s' at %s:%d\n", *s == '\n' ? "<EOL>" : s,
     asm_context->tokens.filename,
     asm_context->tokens.line);
 }
@@ -42,7 +44,7 @@ void print_error_expecting(
   const char *wanted,
   const char *got)
 {
-  printf("Error: Expecting '%s' but got '%s' at %s:%d\n",
+  fprintf(asm_context->messages, "Error: Expecting '%s' but got '%s' at %s:%d\n",
     wanted,
     *got == '\n' ? "<EOL>" : got,
     asm_context->tokens.filename,
@@ -51,35 +53,35 @@ void print_error_expecting(
 
 void print_error_unknown_instr(AsmContext *asm_context, const char *instr)
 {
-  printf("Error: Unknown instruction '%s' at %s:%d\n", instr,
+  fprintf(asm_context->messages, "Error: Unknown instruction '%s' at %s:%d\n", instr,
     asm_context->tokens.filename,
     asm_context->tokens.line);
 }
 
 void print_error_opcount(AsmContext *asm_context, const char *instr)
 {
-  printf("Error: Wrong number of operands for '%s' at %s:%d\n", instr,
+  fprintf(asm_context->messages, "Error: Wrong number of operands for '%s' at %s:%d\n", instr,
     asm_context->tokens.filename,
     asm_context->tokens.line);
 }
 
 void print_error_illegal_operands(AsmContext *asm_context, const char *instr)
 {
-  printf("Error: Illegal operands for '%s' at %s:%d\n", instr,
+  fprintf(asm_context->messages, "Error: Illegal operands for '%s' at %s:%d\n", instr,
     asm_context->tokens.filename,
     asm_context->tokens.line);
 }
 
 void print_error_illegal_expression(AsmContext *asm_context, const char *instr)
 {
-  printf("Error: Illegal expression for '%s' at %s:%d\n", instr,
+  fprintf(asm_context->messages, "Error: Illegal expression for '%s' at %s:%d\n", instr,
     asm_context->tokens.filename,
     asm_context->tokens.line);
 }
 
 void print_error_illegal_register(AsmContext *asm_context, const char *instr)
 {
-  printf("Error: Illegal register for '%s' at %s:%d\n", instr,
+  fprintf(asm_context->messages, "Error: Illegal register for '%s' at %s:%d\n", instr,
     asm_context->tokens.filename,
     asm_context->tokens.line);
 }
@@ -90,7 +92,7 @@ void print_error_range(
   int64_t r1,
   int64_t r2)
 {
-  printf("Error: %s out of range (%" PRId64 ",%" PRId64 ") at %s:%d\n",
+  fprintf(asm_context->messages, "Error: %s out of range (%" PRId64 ",%" PRId64 ") at %s:%d\n",
     s, r1, r2,
     asm_context->tokens.filename,
     asm_context->tokens.line);
@@ -100,7 +102,7 @@ void print_error_unknown_operand_combo(
   AsmContext *asm_context,
   const char *instr)
 {
-  printf("Error: Unknown operands combo for '%s' at %s:%d.\n", instr,
+  fprintf(asm_context->messages, "Error: Unknown operands combo for '%s' at %s:%d.\n", instr,
     asm_context->tokens.filename,
     asm_context->tokens.line);
 }
@@ -113,7 +115,7 @@ void print_error_internal(AsmContext *asm_context, const char *filename, int lin
   }
     else
   {
-    printf("Internal Error: At %s:%d from line %s:%d.\n", filename, line,
+    fprintf(asm_context->messages, "Internal Error: At %s:%d from line %s:%d.\n", filename, line,
       asm_context->tokens.filename,
       asm_context->tokens.line);
   }
@@ -121,23 +123,34 @@ void print_error_internal(AsmContext *asm_context, const char *filename, int lin
 
 void print_already_defined(AsmContext *asm_context, char *name)
 {
-  printf("Error: '%s' already defined at %s:%d.\n", name,
+  fprintf(asm_context->messages, "Error: '%s' already defined at %s:%d.\n", name,
     asm_context->tokens.filename,
     asm_context->tokens.line);
 }
 
 void print_not_defined(AsmContext *asm_context, char *name)
 {
-  printf("Error: '%s' not defined at %s:%d.\n", name,
+  fprintf(asm_context->messages, "Error: '%s' not defined at %s:%d.\n", name,
     asm_context->tokens.filename,
     asm_context->tokens.line);
 }
 
 void print_error_align(AsmContext *asm_context, int align)
 {
-  printf("Error: %d byte misalignment at %s:%d.\n",
+  fprintf(asm_context->messages, "Error: %d byte misalignment at %s:%d.\n",
     align,
     asm_context->tokens.filename,
     asm_context->tokens.line);
 }
 
+void print_error_label(AsmContext *asm_context, const char *name, int error)
+{
+  if (error == -2)
+  {
+    fprintf(asm_context->messages, "Error: Label '%s' is too big.\n", name);
+  }
+    else
+  {
+    fprintf(asm_context->messages, "Error: Label '%s' already defined.\n", name);
+  }
+}
@@ -46,5 +46,8 @@ void print_already_defined(AsmContext *asm_context, char *name);
 void print_not_defined(AsmContext *asm_context, char *name);
 void print_error_align(AsmContext *asm_context, int align);
 
+// error is what Symbols::append() returned.
+void print_error_label(AsmContext *asm_context, const char *name, int error);
+
 #endif
 
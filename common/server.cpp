@@ -0,0 +1,423 @@
+/**
+ *  naken_asm assembler.
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: https://www.mikekohn.net/
+ * License: GPLv3
+ *
+ * Copyright 2010-2025 by Michael Kohn
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#ifdef UNIX_SOCKETS
+#include <errno.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#endif
+
+#include "common/server.h"
+
+#ifdef UNIX_SOCKETS
+static int server_address(struct sockaddr_un *address, const char *path)
+{
+  memset(address, 0, sizeof(struct sockaddr_un));
+  address->sun_family = AF_UNIX;
+
+  if (strlen(path) >= sizeof(address->sun_path))
+  {
+    printf("Error: Socket name %s is too long.\n", path);
+    return -1;
+  }
+
+  strcpy(address->sun_path, path);
+
+  return 0;
+}
+
+// Only a socket left behind at path is removed.  Anything else there
+// (like a source file given by mistake) is an error and left alone.
+static int remove_socket(const char *path)
+{
+  struct stat file_stat;
+
+  if (lstat(path, &file_stat) != 0) { return 0; }
+
+  if (!S_ISSOCK(file_stat.st_mode))
+  {
+    printf("Error: %s exists and isn't a socket.\n", path);
+    return -1;
+  }
+
+  unlink(path);
+
+  return 0;
+}
+
+static int write_all(int fd, const void *data, int length)
+{
+  const char *ptr = (const char *)data;
+
+  while (length > 0)
+  {
+    const int n = write(fd, ptr, length);
+
+    if (n < 0 && errno == EINTR) { continue; }
+    if (n <= 0) { return -1; }
+
+    ptr += n;
+    length -= n;
+  }
+
+  return 0;
+}
+
+// Send what's in fp (from the start) to fd.
+static int write_file(int fd, FILE *fp)
+{
+  char buffer[4096];
+  size_t length;
+
+  rewind(fp);
+
+  while ((length = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+  {
+    if (write_all(fd, buffer, length) != 0) { return -1; }
+  }
+
+  return 0;
+}
+
+// Copy length bytes from fd to fp.
+static int read_file(int fd, FILE *fp, long length)
+{
+  char buffer[4096];
+
+  while (length > 0)
+  {
+    const int n = read(fd, buffer,
+      length < (long)sizeof(buffer) ? length : sizeof(buffer));
+
+    if (n < 0 && errno == EINTR) { continue; }
+    if (n <= 0) { return -1; }
+
+    fwrite(buffer, 1, n, fp);
+    length -= n;
+  }
+
+  return 0;
+}
+
+static int read_all(int fd, void *data, int length)
+{
+  char *ptr = (char *)data;
+
+  while (length > 0)
+  {
+    const int n = read(fd, ptr, length);
+
+    if (n < 0 && errno == EINTR) { continue; }
+    if (n <= 0) { return -1; }
+
+    ptr += n;
+    length -= n;
+  }
+
+  return 0;
+}
+
+// The header line is read a byte at a time so nothing after it is lost.
+static int read_line(int fd, char *line, int size)
+{
+  int length = 0;
+
+  while (length < size - 1)
+  {
+    if (read_all(fd, line + length, 1) != 0) { return -1; }
+    if (line[length++] == '\n') { break; }
+  }
+
+  line[length] = 0;
+
+  return 0;
+}
+
+// Answer a request that can't be run with an error message.
+static void server_reject(int connection, const char *message)
+{
+  char header[128];
+
+  snprintf(header, sizeof(header), "naken_asm %d %d 0\n",
+    EXIT_FAILURE, (int)strlen(message));
+
+  if (write_all(connection, header, strlen(header)) == 0)
+  {
+    write_all(connection, message, strlen(message));
+  }
+
+  close(connection);
+}
+#endif
+
+// Returns the socket to pass to server_accept() or -1 if it couldn't be
+// created.  An old socket left at path is removed first.
+int server_open(const char *path)
+{
+#ifdef UNIX_SOCKETS
+  struct sockaddr_un address;
+
+  if (server_address(&address, path) != 0) { return -1; }
+  if (remove_socket(path) != 0) { return -1; }
+
+  int server = socket(AF_UNIX, SOCK_STREAM, 0);
+
+  if (server < 0)
+  {
+    printf("Error: Couldn't create socket.\n");
+    return -1;
+  }
+
+  if (bind(server, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+      listen(server, 16) != 0)
+  {
+    printf("Error: Couldn't listen on %s.\n", path);
+    close(server);
+    return -1;
+  }
+
+  // A client that goes away shouldn't take the server with it.
+  signal(SIGPIPE, SIG_IGN);
+
+  return server;
+#else
+  printf("Error: This platform doesn't support -server.\n");
+  return -1;
+#endif
+}
+
+// Wait for the next request.  Returns the connection to send the reply
+// on.  A connection that doesn't send a valid request gets an error back
+// and is skipped.
+int server_accept(int server, ServerRequest *request)
+{
+#ifdef UNIX_SOCKETS
+  while (true)
+  {
+    const int connection = accept(server, NULL, NULL);
+
+    if (connection < 0)
+    {
+      if (errno == EINTR) { continue; }
+      return -1;
+    }
+
+    // Requests are answered one at a time, so a client that stops
+    // sending (or reading the reply) can't hold up the others for long.
+    struct timeval timeout = { SERVER_TIMEOUT, 0 };
+
+    setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(connection, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    char header[128];
+    int argc;
+    int length;
+
+    if (read_line(connection, header, sizeof(header)) != 0 ||
+        sscanf(header, "naken_asm %d %d", &argc, &length) != 2 ||
+        argc < 0 || length < 1)
+    {
+      server_reject(connection, "Error: Bad request.\n");
+      continue;
+    }
+
+    // argv[0] is the program name and the list ends with NULL.
+    if (argc > SERVER_MAX_ARGS - 2)
+    {
+      server_reject(connection, "Error: Too many arguments.\n");
+      continue;
+    }
+
+    if (length > SERVER_MAX_REQUEST)
+    {
+      server_reject(connection, "Error: Request is too long.\n");
+      continue;
+    }
+
+    if (read_all(connection, request->data, length) != 0 ||
+        request->data[length - 1] != 0)
+    {
+      server_reject(connection, "Error: Bad request.\n");
+      continue;
+    }
+
+    // The last byte is 0, so none of the strings run off the end.
+    char *s = request->data;
+    char *end = request->data + length;
+
+    request->cwd = s;
+    request->argv[0] = (char *)"naken_asm";
+    request->argc = 1;
+
+    s += strlen(s) + 1;
+
+    while (s < end && request->argc <= argc)
+    {
+      request->argv[request->argc++] = s;
+      s += strlen(s) + 1;
+    }
+
+    request->argv[request->argc] = NULL;
+
+    if (s != end || request->argc != argc + 1)
+    {
+      server_reject(connection, "Error: Bad request.\n");
+      continue;
+    }
+
+    return connection;
+  }
+#else
+  return -1;
+#endif
+}
+
+// Send the exit status, messages and (if not NULL) the output file back
+// and close the connection.
+int server_reply(int connection, int status, FILE *messages, FILE *output)
+{
+#ifdef UNIX_SOCKETS
+  char header[128];
+
+  fseek(messages, 0, SEEK_END);
+  const long messages_length = ftell(messages);
+  long output_length = 0;
+
+  if (output != NULL)
+  {
+    fseek(output, 0, SEEK_END);
+    output_length = ftell(output);
+  }
+
+  snprintf(header, sizeof(header), "naken_asm %d %ld %ld\n",
+    status, messages_length, output_length);
+
+  int ret = write_all(connection, header, strlen(header));
+
+  if (ret == 0) { ret = write_file(connection, messages); }
+  if (ret == 0 && output != NULL) { ret = write_file(connection, output); }
+
+  close(connection);
+
+  return ret;
+#else
+  return -1;
+#endif
+}
+
+void server_close(int server, const char *path)
+{
+#ifdef UNIX_SOCKETS
+  close(server);
+  remove_socket(path);
+#endif
+}
+
+// Client side of -server.  The messages are printed to stdout, or to
+// stderr if the output file came back so it can go to stdout by itself.
+// Returns the exit status from the server, or -1 if it couldn't be
+// reached.
+int server_send(const char *path, int argc, char *argv[])
+{
+#ifdef UNIX_SOCKETS
+  struct sockaddr_un address;
+  char cwd[4096];
+
+  if (server_address(&address, path) != 0) { return -1; }
+
+  if (getcwd(cwd, sizeof(cwd)) == NULL)
+  {
+    printf("Error: Couldn't get current directory.\n");
+    return -1;
+  }
+
+  int connection = socket(AF_UNIX, SOCK_STREAM, 0);
+
+  if (connection < 0 ||
+      connect(connection, (struct sockaddr *)&address, sizeof(address)) != 0)
+  {
+    printf("Error: Couldn't connect to %s.\n", path);
+    if (connection >= 0) { close(connection); }
+    return -1;
+  }
+
+  signal(SIGPIPE, SIG_IGN);
+
+  char header[128];
+  int length = strlen(cwd) + 1;
+
+  for (int n = 0; n < argc; n++) { length += strlen(argv[n]) + 1; }
+
+  if (argc > SERVER_MAX_ARGS - 2 || length > SERVER_MAX_REQUEST)
+  {
+    printf("Error: Command line is too long for %s.\n", path);
+    close(connection);
+    return -1;
+  }
+
+  snprintf(header, sizeof(header), "naken_asm %d %d\n", argc, length);
+
+  int ret = write_all(connection, header, strlen(header));
+
+  if (ret == 0) { ret = write_all(connection, cwd, strlen(cwd) + 1); }
+
+  for (int n = 0; n < argc && ret == 0; n++)
+  {
+    ret = write_all(connection, argv[n], strlen(argv[n]) + 1);
+  }
+
+  // A server that turned the request down may have stopped reading, but
+  // its reply says why.
+  ret = read_line(connection, header, sizeof(header));
+
+  int status;
+  long messages_length;
+  long output_length;
+
+  if (ret != 0 ||
+      sscanf(header, "naken_asm %d %ld %ld",
+        &status, &messages_length, &output_length) != 3)
+  {
+    printf("Error: Bad reply from %s.\n", path);
+    close(connection);
+    return -1;
+  }
+
+  FILE *messages = output_length == 0 ? stdout : stderr;
+
+  ret = read_file(connection, messages, messages_length);
+
+  if (ret == 0) { ret = read_file(connection, stdout, output_length); }
+
+  close(connection);
+
+  if (ret != 0)
+  {
+    printf("Error: Bad reply from %s.\n", path);
+    return -1;
+  }
+
+  return status;
+#else
+  printf("Error: This platform doesn't support -server.\n");
+  return -1;
+#endif
+}
+
@@ -0,0 +1,52 @@
+/**
+ *  naken_asm assembler.
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: https://www.mikekohn.net/
+ * License: GPLv3
+ *
+ * Copyright 2010-2025 by Michael Kohn
+ *
+ */
+
+#ifndef NAKEN_ASM_SERVER_H
+#define NAKEN_ASM_SERVER_H
+
+#include <stdio.h>
+
+// naken_asm -server listens on a Unix socket for requests to assemble.
+//
+// A request is one line of text with the number of arguments and the
+// length of the rest of the request, then the working directory and the
+// command line arguments (without the program name), each ending with a
+// 0 byte:
+//
+//   naken_asm 5 43\n/home/user/project\0-type\0bin\0-o\0-\0main.asm\0
+//
+// The reply is one line of text followed by the messages naken_asm
+// printed and then the output file if it was "-o -":
+//
+//   naken_asm <exit status> <messages length> <output length>\n
+
+#define SERVER_MAX_REQUEST 65536
+#define SERVER_MAX_ARGS 1024
+
+// Seconds a client has to send its request or read a piece of the reply.
+#define SERVER_TIMEOUT 5
+
+struct ServerRequest
+{
+  char data[SERVER_MAX_REQUEST];
+  char *argv[SERVER_MAX_ARGS];
+  const char *cwd;
+  int argc;
+};
+
+int server_open(const char *path);
+int server_accept(int server, ServerRequest *request);
+int server_reply(int connection, int status, FILE *messages, FILE *output);
+void server_close(int server, const char *path);
+int server_send(const char *path, int argc, char *argv[]);
+
+#endif
+
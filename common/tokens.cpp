@@ -25,14 +25,21 @@
 
 int tokens_open_file(AsmContext *asm_context, const char *filename)
 {
-  asm_context->tokens.in = fopen(filename, "rb");
+  const int source = asm_context->token_cache.open(filename);
 
-  if (asm_context->tokens.in == NULL)
+  if (source == 0)
   {
     return -1;
   }
 
+  asm_context->tokens.token_buffer.code =
+    asm_context->token_cache.get_code(source);
+  asm_context->tokens.token_buffer.ptr = 0;
   asm_context->tokens.filename = filename;
+  asm_context->tokens.last_char = EOF;
+  asm_context->tokens.cache_source = source;
+  asm_context->tokens.cache_cursor.memory_pool = NULL;
+  asm_context->tokens.cache_cursor.ptr = 0;
 
   return 0;
 }
@@ -41,24 +48,28 @@ void tokens_open_buffer(AsmContext *asm_context, const char *buffer)
 {
   asm_context->tokens.token_buffer.code = buffer;
   asm_context->tokens.token_buffer.ptr = 0;
+  asm_context->tokens.cache_source = 0;
 }
 
 void tokens_close(AsmContext *asm_context)
 {
-  if (asm_context->tokens.in != NULL)
+  // Files are owned by asm_context->token_cache so they can be reused
+  // on pass 2 and by other includes.
+  if (asm_context->tokens.cache_source != 0)
   {
-    fclose(asm_context->tokens.in);
+    asm_context->tokens.token_buffer.code = NULL;
+    asm_context->tokens.cache_source = 0;
   }
 }
 
 void tokens_reset(AsmContext *asm_context)
 {
-  if (asm_context->tokens.in != NULL)
-  {
-    fseek(asm_context->tokens.in, 0, SEEK_SET);
-  }
-
   asm_context->tokens.token_buffer.ptr = 0;
+  asm_context->tokens.last_char = EOF;
+  asm_context->tokens.cache_cursor.memory_pool = NULL;
+  asm_context->tokens.cache_cursor.ptr = 0;
+  asm_context->tokens.replay_ptr = NULL;
+  asm_context->tokens.replay_end = NULL;
 
   asm_context->tokens.line = 1;
   asm_context->tokens.pushback[0] = 0;
@@ -215,21 +226,20 @@ int tokens_get_char(AsmContext *asm_context)
 //printf("debug> tokens_get_char(FILE)='%c'\n", ch);
 #endif
 
+    TokenBuffer &token_buffer = asm_context->tokens.token_buffer;
+
+    // Files have \r taken out when they are loaded, but a buffer passed
+    // to tokens_open_buffer() might still have them.
     // Why do people still use DOS :(
     do
     {
-      if (asm_context->tokens.token_buffer.code != NULL)
-      {
-        ch = asm_context->tokens.token_buffer.code[asm_context->tokens.token_buffer.ptr];
-        if (ch == 0) { ch = EOF; }
-        else { asm_context->tokens.token_buffer.ptr++; }
-      }
-        else
-      {
-        ch = getc(asm_context->tokens.in);
-      }
+      ch = (uint8_t)token_buffer.code[token_buffer.ptr];
+      if (ch == 0) { ch = EOF; }
+      else { token_buffer.ptr++; }
     } while (ch == '\r');
 
+    asm_context->tokens.last_char = ch;
+
     if (asm_context->list != NULL && asm_context->write_list_file == 1)
     {
       if (ch != EOF) { putc(ch, asm_context->list); }
@@ -251,32 +261,108 @@ int tokens_unget_char(AsmContext *asm_context, int ch)
   return 0;
 }
 
-int tokens_get(AsmContext *asm_context, char *token, int len)
+static int tokens_next(
+  AsmContext *asm_context,
+  char *token,
+  int len,
+  Token &result);
+
+// Write value as a decimal string.  Used instead of snprintf() when the
+// char * version of tokens_get() has to hand back a resolved number.
+static void tokens_int_to_string(char *token, int len, int64_t value)
 {
-  int token_type = TOKEN_EOF;
-  int ch;
+  char digits[24];
+  uint64_t n = value < 0 ? -(uint64_t)value : value;
+  int count = 0;
   int ptr = 0;
 
-#ifdef DEBUG
-//printf("Enter tokens_get()\n");
-#endif
+  do
+  {
+    digits[count++] = '0' + (n % 10);
+    n = n / 10;
+  } while (n != 0);
 
-  token[0] = 0;
+  if (count + 2 > len)
+  {
+    snprintf(token, len, "%" PRId64, value);
+    return;
+  }
+
+  if (value < 0) { token[ptr++] = '-'; }
+
+  while (count > 0) { token[ptr++] = digits[--count]; }
+
+  token[ptr] = 0;
+}
+
+// Move the source forward count bytes without reading them.
+static void tokens_skip(AsmContext *asm_context, uint32_t count)
+{
+  asm_context->tokens.token_buffer.ptr += count;
+}
+
+// The settings the CPU can change that affect how text is split into
+// tokens.  A cached token is only replayed if these match.
+int tokens_lex_flags(AsmContext *asm_context)
+{
+  return
+    (asm_context->is_dollar_hex << 0) |
+    (asm_context->strings_have_dots << 1) |
+    (asm_context->strings_have_slashes << 2) |
+    (asm_context->can_tick_end_string << 3) |
+    (asm_context->numbers_dont_have_dots << 4);
+}
+
+// Where in the source file the next character will come from or -1 if
+// it's coming from a macro.  The lexer usually ungets the character after
+// a token, which is the same as not having read it from the file.
+int64_t tokens_source_offset(AsmContext *asm_context)
+{
+  Tokens &tokens = asm_context->tokens;
 
-  if (asm_context->tokens.pushback2[0] != 0)
+  if (tokens.cache_source == 0 ||
+      tokens.unget_stack_ptr != 0 ||
+      asm_context->macros.get_stack_ptr() != 0)
   {
-    strcpy(token, asm_context->tokens.pushback2);
-    asm_context->tokens.pushback2[0] = 0;
-    return asm_context->tokens.pushback2_type;
+    return -1;
   }
 
-  if (asm_context->tokens.pushback[0] != 0)
+  const int offset = tokens.token_buffer.ptr;
+
+  if (tokens.unget_ptr == 0) { return offset; }
+
+  if (tokens.unget_ptr == 1 &&
+      tokens.last_char != EOF &&
+      tokens.unget[0] == (char)tokens.last_char)
   {
-    strcpy(token, asm_context->tokens.pushback);
-    asm_context->tokens.pushback[0] = 0;
-    return asm_context->tokens.pushback_type;
+    return offset - 1;
   }
 
+  return -1;
+}
+
+// Continue reading the source file at offset, which is past the text
+// the lexer is at now and has lines newlines in it.  Used for text
+// that's already been dealt with (see expression_cache).
+void tokens_seek(AsmContext *asm_context, int64_t offset, int lines)
+{
+  Tokens &tokens = asm_context->tokens;
+
+  tokens.line += lines;
+  tokens.unget_ptr = 0;
+  tokens_skip(asm_context, offset - tokens.token_buffer.ptr);
+}
+
+// Split the next token out of the input.  ptr is set to the length.
+static int tokens_lex(
+  AsmContext *asm_context,
+  char *token,
+  int len,
+  int &ptr)
+{
+  int token_type = TOKEN_EOF;
+  int ch;
+
   while (true)
   {
 #ifdef DEBUG
@@ -324,6 +410,7 @@ int tokens_get(AsmContext *asm_context, char *token, int len)
       assert(ptr == 0);
       token[0] = '\n';
       token[1] = 0;
+      ptr = 1;
       return TOKEN_EOL;
     }
 
@@ -417,6 +504,7 @@ int tokens_get(AsmContext *asm_context, char *token, int len)
         {
           token[0] = '\n';
           token[1] = 0;
+          ptr = 1;
           return TOKEN_EOL;
         }
           else
@@ -564,6 +652,7 @@ int tokens_get(AsmContext *asm_context, char *token, int len)
 
               token[0] = '\n';
               token[1] = 0;
+              ptr = 1;
               return TOKEN_EOL;
             }
               else
@@ -640,17 +729,33 @@ int tokens_get(AsmContext *asm_context, char *token, int len)
     exit(1);
   }
 
+  return token_type;
+}
+
+// Turn symbols, $, character constants and numbers written in other
+// bases into values and expand macros.
+static int tokens_resolve(
+  AsmContext *asm_context,
+  char *token,
+  int len,
+  int ptr,
+  int token_type,
+  Token &result)
+{
+  int ch;
+
   if (token_type == TOKEN_TICKED && ptr == 1)
   {
     ch = token[0];
-    snprintf(token, len, "%d", ch);
+    result.value = ch;
+    result.has_value = true;
     token_type = TOKEN_NUMBER;
   }
 
   if (IS_TOKEN(token, '$'))
   {
-    snprintf(token, len, "%d",
-      asm_context->address / asm_context->bytes_per_address);
+    result.value = asm_context->address / asm_context->bytes_per_address;
+    result.has_value = true;
     token_type = TOKEN_NUMBER;
   }
 
@@ -685,7 +790,9 @@ int tokens_get(AsmContext *asm_context, char *token, int len)
 
     if (ret == 0 && asm_context->parsing_ifdef == 0)
     {
-      snprintf(token, len, "%d", address);
+      result.value = (int32_t)address;
+      result.has_value = true;
+      result.is_symbol = true;
       token_type = TOKEN_NUMBER;
     }
       else
@@ -694,15 +801,17 @@ int tokens_get(AsmContext *asm_context, char *token, int len)
 #ifdef DEBUG
 printf("debug> '%s' is a macro.  param_count=%d\n", token, param_count);
 #endif
+      asm_context->include_cache.not_cacheable();
+
       if (param_count == 0)
       {
-        macros_push_define(&asm_context->macros, macro);
+        macros_push_define(asm_context, macro);
       }
         else
       {
         char *expanded = macros_expand_params(asm_context, macro, param_count);
         if (expanded == NULL) { return TOKEN_EOF; }
-        macros_push_define(&asm_context->macros, expanded);
+        macros_push_define(asm_context, expanded);
       }
 
       asm_context->tokens.unget_stack[++asm_context->tokens.unget_stack_ptr] = asm_context->tokens.unget_ptr;
@@ -713,7 +822,7 @@ printf("debug> '%s' is a macro.  param_count=%d\n", token, param_count);
 //  asm_context->tokens.unget_ptr);
 #endif
 
-      token_type = tokens_get(asm_context, token, len);
+      token_type = tokens_next(asm_context, token, len, result);
 #ifdef DEBUG
 //printf("debug> expanding.. '%s'\n", token);
 #endif
@@ -724,7 +833,8 @@ printf("debug> '%s' is a macro.  param_count=%d\n", token, param_count);
       // If token starts with 0x it's probably hex.
       uint64_t num;
       if (tokens_hex_string_to_int(token + 2, &num, true) != 0) { return token_type; }
-      snprintf(token, len, "%" PRId64, num);
+      result.value = num;
+      result.has_value = true;
       token_type = TOKEN_NUMBER;
     }
       else
@@ -733,7 +843,8 @@ printf("debug> '%s' is a macro.  param_count=%d\n", token, param_count);
       // If token starts with 0b it's probably binary.
       uint64_t num;
       if (tokens_binary_string_to_int(token + 2, &num, true) != 0) { return token_type; }
-      snprintf(token, len, "%" PRId64, num);
+      result.value = num;
+      result.has_value = true;
       token_type = TOKEN_NUMBER;
     }
       else
@@ -744,7 +855,8 @@ printf("debug> '%s' is a macro.  param_count=%d\n", token, param_count);
       // If token starts with a number and ends with a h it's probably hex
       uint64_t num;
       if (tokens_hex_string_to_int(token, &num, false) != 0) { return token_type; }
-      snprintf(token, len, "%" PRId64, num);
+      result.value = num;
+      result.has_value = true;
       token_type = TOKEN_NUMBER;
     }
       else
@@ -755,7 +867,8 @@ printf("debug> '%s' is a macro.  param_count=%d\n", token, param_count);
       // If token starts with a number and ends with a q it's octal
       uint64_t num;
       if (tokens_octal_string_to_int(token, &num) != 0) { return token_type; }
-      snprintf(token, len, "%" PRId64, num);
+      result.value = num;
+      result.has_value = true;
       token_type = TOKEN_NUMBER;
     }
       else
@@ -764,17 +877,20 @@ printf("debug> '%s' is a macro.  param_count=%d\n", token, param_count);
       // If token starts with a number and ends with a b it's probably binary.
       uint64_t num;
       if (tokens_binary_string_to_int(token, &num, false) != 0) { return token_type; }
-      snprintf(token, len, "%" PRId64, num);
+      result.value = num;
+      result.has_value = true;
       token_type = TOKEN_NUMBER;
     }
   }
 
-  if (token_type == TOKEN_NUMBER && token[0] == '0' && token[1] != 0)
+  if (token_type == TOKEN_NUMBER && token[0] == '0' && token[1] != 0 &&
+      result.has_value == false)
   {
     // If token is a number and starts with a 0 it's octal
     uint64_t num;
     if (tokens_octal_string_to_int(token, &num) != 0) { return token_type; }
-    snprintf(token, len, "%" PRId64, num);
+    result.value = num;
+    result.has_value = true;
     token_type = TOKEN_NUMBER;
   }
 
@@ -783,17 +899,254 @@ printf("debug> '%s' is a macro.  param_count=%d\n", token, param_count);
   return token_type;
 }
 
-void tokens_push(AsmContext *asm_context, const char *token, int token_type)
+// Read the next token into token[].  If the token resolves to an integer
+// (symbol, $, 'c', 0x.., 0b.., ..h, ..q, ..b, 0..) the value is returned
+// in result.value with result.has_value set and token[] is left with the
+// original spelling.
+//
+// On pass 1 what the lexer splits out of a source file is recorded in
+// asm_context->token_cache so pass 2 can skip over the same text without
+// reading it a character at a time.  Only tokens read straight from the
+// file (not from a macro) are recorded.
+static int tokens_next(
+  AsmContext *asm_context,
+  char *token,
+  int len,
+  Token &result)
+{
+  Tokens &tokens = asm_context->tokens;
+  int token_type;
+  int ptr = 0;
+
+#ifdef DEBUG
+//printf("Enter tokens_next()\n");
+#endif
+
+  token[0] = 0;
+  result.has_value = false;
+  result.value = 0;
+
+  const int64_t offset = tokens_source_offset(asm_context);
+
+  // The list file is written as characters are read, so don't skip
+  // over them if it's being written.  Files left from an earlier run of
+  // naken_asm -server that didn't change can be used on pass 1 too.
+  if (offset != -1 && !asm_context->single_pass &&
+      (asm_context->pass == 2 ||
+       asm_context->token_cache.is_warm(tokens.cache_source)) &&
+      (asm_context->list == NULL || asm_context->write_list_file == 0))
+  {
+    const TokenCacheEntry *entry = asm_context->token_cache.find(
+      tokens.cache_source,
+      tokens.cache_cursor,
+      offset);
+
+    if (entry != NULL &&
+        entry->flags == tokens_lex_flags(asm_context) &&
+        entry->length < len &&
+        offset + entry->consumed >= tokens.token_buffer.ptr)
+    {
+      memcpy(token, entry->text, entry->length + 1);
+      tokens.line += entry->lines;
+      tokens.unget_ptr = 0;
+      tokens_skip(
+        asm_context,
+        offset + entry->consumed - tokens.token_buffer.ptr);
+
+      return tokens_resolve(
+        asm_context, token, len, entry->length, entry->type, result);
+    }
+  }
+
+  const int line = tokens.line;
+  const int error_count = asm_context->error_count;
+
+  token_type = tokens_lex(asm_context, token, len, ptr);
+
+  if (offset != -1 && asm_context->pass == 1 &&
+      asm_context->error_count == error_count)
+  {
+    const int64_t end = tokens_source_offset(asm_context);
+
+    if (end != -1)
+    {
+      asm_context->token_cache.record(
+        tokens.cache_source,
+        offset,
+        end - offset,
+        tokens.line - line,
+        token_type,
+        tokens_lex_flags(asm_context),
+        token,
+        ptr);
+    }
+  }
+
+  return tokens_resolve(asm_context, token, len, ptr, token_type, result);
+}
+
+// Hand back a token recorded for a -single_pass fixup.  Symbols that
+// weren't defined when the statement was first read are looked up again.
+static int tokens_replay(
+  AsmContext *asm_context,
+  char *token,
+  int len,
+  Token &result)
 {
-  if (asm_context->tokens.pushback[0] == 0)
+  Tokens &tokens = asm_context->tokens;
+  const FixupToken *entry =
+    Fixups::next_token(tokens.replay_ptr, tokens.replay_end);
+
+  if (entry == NULL || entry->length >= len)
+  {
+    token[0] = '\n';
+    token[1] = 0;
+    return TOKEN_EOL;
+  }
+
+  memcpy(token, entry->text, entry->length + 1);
+  result.has_value = entry->has_value;
+  result.value = entry->value;
+
+  if (entry->type == TOKEN_STRING &&
+      asm_context->ignore_symbols == 0 &&
+      asm_context->parsing_ifdef == 0)
   {
-    strcpy(asm_context->tokens.pushback, token);
-    asm_context->tokens.pushback_type = token_type;
+    uint32_t address;
+
+    if (asm_context->symbols.lookup(token, &address) == 0)
+    {
+      result.value = (int32_t)address;
+      result.has_value = true;
+      return TOKEN_NUMBER;
+    }
+  }
+
+  return entry->type;
+}
+
+static int tokens_read(
+  AsmContext *asm_context,
+  char *token,
+  int len,
+  Token &result)
+{
+  Tokens &tokens = asm_context->tokens;
+
+  result.is_symbol = false;
+
+  if (tokens.pushback2[0] != 0)
+  {
+    memcpy(token, tokens.pushback2, tokens.pushback2_length + 1);
+    result.has_value = tokens.pushback2_has_value;
+    result.value = tokens.pushback2_value;
+    tokens.pushback2[0] = 0;
+    return tokens.pushback2_type;
+  }
+
+  if (tokens.pushback[0] != 0)
+  {
+    memcpy(token, tokens.pushback, tokens.pushback_length + 1);
+    result.has_value = tokens.pushback_has_value;
+    result.value = tokens.pushback_value;
+    tokens.pushback[0] = 0;
+    return tokens.pushback_type;
+  }
+
+  if (tokens.replay_ptr != NULL)
+  {
+    result.has_value = false;
+    result.value = 0;
+
+    return tokens_replay(asm_context, token, len, result);
+  }
+
+  const int token_type = tokens_next(asm_context, token, len, result);
+
+  if (asm_context->fixups.is_recording())
+  {
+    asm_context->fixups.record(
+      token_type,
+      token,
+      strlen(token),
+      result.has_value,
+      result.value);
+  }
+
+  return token_type;
+}
+
+int tokens_get(AsmContext *asm_context, char *token, int len)
+{
+  Token result;
+
+  int token_type = tokens_read(asm_context, token, len, result);
+
+  // Callers that only look at the text get resolved numbers as decimal.
+  if (result.has_value)
+  {
+    tokens_int_to_string(token, len, result.value);
+  }
+
+  return token_type;
+}
+
+int tokens_get(AsmContext *asm_context, Token &token, char *buffer, int len)
+{
+  token.type = tokens_read(asm_context, buffer, len, token);
+  token.text = buffer;
+  token.length = strlen(buffer);
+
+  if (token.type == TOKEN_NUMBER && token.has_value == false)
+  {
+    token.value = atoll(buffer);
+    token.has_value = true;
+  }
+
+  return token.type;
+}
+
+static void tokens_push(
+  AsmContext *asm_context,
+  const char *text,
+  int length,
+  int token_type,
+  bool has_value,
+  int64_t value)
+{
+  Tokens &tokens = asm_context->tokens;
+
+  if (tokens.pushback[0] == 0)
+  {
+    memcpy(tokens.pushback, text, length + 1);
+    tokens.pushback_length = length;
+    tokens.pushback_type = token_type;
+    tokens.pushback_has_value = has_value;
+    tokens.pushback_value = value;
     return;
   }
 
-  strcpy(asm_context->tokens.pushback2, token);
-  asm_context->tokens.pushback2_type = token_type;
+  memcpy(tokens.pushback2, text, length + 1);
+  tokens.pushback2_length = length;
+  tokens.pushback2_type = token_type;
+  tokens.pushback2_has_value = has_value;
+  tokens.pushback2_value = value;
+}
+
+void tokens_push(AsmContext *asm_context, const char *token, int token_type)
+{
+  tokens_push(asm_context, token, strlen(token), token_type, false, 0);
+}
+
+void tokens_push(AsmContext *asm_context, const Token &token)
+{
+  tokens_push(
+    asm_context,
+    token.text,
+    token.length,
+    token.type,
+    token.has_value,
+    token.value);
 }
 
 // Returns the number of chars eaten by this function or 0 for error
@@ -821,7 +1174,7 @@ int tokens_escape_char(AsmContext *asm_context, uint8_t *s)
     case 'x':
       // FIXME - probably need to add this...
     default:
-      printf("Unknown escape char '\\%c' on line %s:%d.\n", s[ptr], asm_context->tokens.filename, asm_context->tokens.line);
+      fprintf(asm_context->messages, "Unknown escape char '\\%c' on line %s:%d.\n", s[ptr], asm_context->tokens.filename, asm_context->tokens.line);
       return 0;
   }
 
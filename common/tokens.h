@@ -5,7 +5,7 @@
  *     Web: https://www.mikekohn.net/
  * License: GPLv3
  *
- * Copyright 2010-2023 by Michael Kohn
+ * Copyright 2010-2025 by Michael Kohn
  *
  */
 
@@ -28,14 +28,39 @@ typedef struct _token_buffer
   int ptr;
 } TokenBuffer;
 
+// A token with its type and, for anything that resolved to an integer
+// (numbers in any base, symbols, $ and character constants), the value.
+// text points at the buffer the caller passed to tokens_get() and keeps
+// the spelling from the source so 0x10 is still "0x10".  is_symbol is
+// set if the value came from a label.
+struct Token
+{
+  int type;
+  const char *text;
+  int length;
+  bool has_value;
+  bool is_symbol;
+  int64_t value;
+};
+
 typedef struct _tokens
 {
-  FILE *in;
   int line;
   const char *filename;
   TokenBuffer token_buffer;
+  int last_char;
+  int cache_source;
+  TokenCacheCursor cache_cursor;
+  const uint8_t *replay_ptr;
+  const uint8_t *replay_end;
   int pushback_type;
   int pushback2_type;
+  int pushback_length;
+  int pushback2_length;
+  bool pushback_has_value;
+  bool pushback2_has_value;
+  int64_t pushback_value;
+  int64_t pushback2_value;
   int unget_ptr;
   int unget_stack_ptr;
   int unget_stack[MAX_NESTED_MACROS + 1];
@@ -51,8 +76,13 @@ void tokens_reset(AsmContext *asm_context);
 int tokens_get_char(AsmContext *asm_context);
 int tokens_unget_char(AsmContext *asm_context, int ch);
 int tokens_get(AsmContext *asm_context, char *token, int len);
+int tokens_get(AsmContext *asm_context, Token &token, char *buffer, int len);
 void tokens_push(AsmContext *asm_context, const char *token, int token_type);
+void tokens_push(AsmContext *asm_context, const Token &token);
 int tokens_escape_char(AsmContext *asm_context, uint8_t *s);
+int tokens_lex_flags(AsmContext *asm_context);
+int64_t tokens_source_offset(AsmContext *asm_context);
+void tokens_seek(AsmContext *asm_context, int64_t offset, int lines);
 
 enum
 {
@@ -5,19 +5,33 @@
  *     Web: https://www.mikekohn.net/
  * License: GPLv3
  *
- * Copyright 2010-2024 by Michael Kohn
+ * Copyright 2010-2025 by Michael Kohn
  *
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
+#ifndef WINDOWS
+#include <sys/mman.h>
+#endif
 
 #include "FileIo.h"
 
-FileIo::FileIo() : fp(NULL)
+FileIo::FileIo() :
+  fp          (NULL),
+  buffer      (NULL),
+  length      (0),
+  ptr         (0),
+  alloc       (0),
+  big_endian  (false),
+  writing     (false),
+  close_fp    (false),
+  owns_buffer (false),
+  mapped      (false),
+  error       (false)
 {
-  set_endian(false);
 }
 
 FileIo::~FileIo()
@@ -27,238 +41,241 @@ FileIo::~FileIo()
 
 int FileIo::open_for_writing(const char *filename)
 {
+  close_file();
+
   fp = fopen(filename, "wb");
   if (fp == NULL) { return -1; }
 
+  error = false;
+  writing = true;
+  close_fp = true;
+
   return 0;
 }
 
 int FileIo::open_for_reading(const char *filename)
 {
-  fp = fopen(filename, "rb");
-  if (fp == NULL) { return -1; }
+  close_file();
 
-  return 0;
-}
+  FILE *in = fopen(filename, "rb");
+  if (in == NULL) { return -1; }
 
-void FileIo::close_file()
-{
-  if (fp != NULL) { fclose(fp); }
-  fp = NULL;
-}
+  fseek(in, 0, SEEK_END);
+  const long size = ftell(in);
+  fseek(in, 0, SEEK_SET);
 
-void FileIo::set_endian(int value)
-{
-  if (value == FILE_ENDIAN_BIG)
+#ifndef WINDOWS
+  // The pages are only read in as they are used.  If the file can't be
+  // mapped (a pipe or an empty file) it's read in below instead.
+  if (size > 0)
   {
-    get_int16_func = get_int16_be;
-    get_int32_func = get_int32_be;
-    get_int64_func = get_int64_be;
+    void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileno(in), 0);
+
+    if (data != MAP_FAILED)
+    {
+      fclose(in);
+
+      buffer = (uint8_t *)data;
+      length = size;
+      mapped = true;
+      error = false;
 
-    write_int16_func = write_int16_be;
-    write_int32_func = write_int32_be;
-    write_int64_func = write_int64_be;
+      return 0;
+    }
   }
-    else
+#endif
+
+  // A pipe has no size, so this reads until the end of the file.
+  if (grow(size < 0 ? 0 : size + 1) != 0)
   {
-    get_int16_func = get_int16_le;
-    get_int32_func = get_int32_le;
-    get_int64_func = get_int64_le;
+    fclose(in);
+    return -1;
+  }
 
-    write_int16_func = write_int16_le;
-    write_int32_func = write_int32_le;
-    write_int64_func = write_int64_le;
+  while (true)
+  {
+    if (length == alloc && grow(alloc + 1) != 0)
+    {
+      close_file();
+      fclose(in);
+      return -1;
+    }
+
+    const long count = fread(buffer + length, 1, alloc - length, in);
+    if (count <= 0) { break; }
+
+    length += count;
   }
+
+  error = false;
+
+  fclose(in);
+
+  return 0;
 }
 
-int FileIo::get_file_length()
+int FileIo::open_for_writing(uint8_t *data, int size)
 {
-  fseek(fp, 0, SEEK_END);
-  int length = ftell(fp);
-  fseek(fp, 0, SEEK_SET);
+  close_file();
 
-  return length;
+  buffer = data;
+  alloc = size;
+  error = false;
+  writing = true;
+
+  return 0;
 }
 
-void FileIo::write_int32_at_offset(int32_t n, long offset)
+int FileIo::open_for_reading(const uint8_t *data, int length)
 {
-  long marker = tell();
-  set(offset);
-  write_int32(n);
-  set(marker);
+  close_file();
+
+  buffer = (uint8_t *)data;
+  this->length = length;
+  error = false;
+
+  return 0;
 }
 
-int FileIo::get_string_at_offset(char *data, int length, uint64_t offset)
+void FileIo::set_fp(FILE *fp)
 {
-  long marker = ftell(fp);
-  int ptr = 0;
+  close_file();
 
-  fseek(fp, offset, SEEK_SET);
+  this->fp = fp;
+  error = false;
+  writing = true;
+}
 
-  while (true)
+void FileIo::close_file()
+{
+  if (fp != NULL && writing && length != 0)
   {
-    int ch = getc(fp);
-    if (ch == 0) { break; }
-    data[ptr++] = ch;
-    if (ptr == length - 1) { break; }
+    if ((long)fwrite(buffer, 1, length, fp) != length) { error = true; }
   }
 
-  data[ptr] = 0;
+  if (fp != NULL && close_fp) { fclose(fp); }
 
-  fseek(fp, marker, SEEK_SET);
-
-  return 0;
-} 
+  reset();
+}
 
-int FileIo::get_bytes_at_offset(uint8_t *data, int length, uint64_t offset)
+// error is left alone so it can still be checked after close_file().
+void FileIo::reset()
 {
-  long marker = ftell(fp);
+  if (owns_buffer) { free(buffer); }
 
-  fseek(fp, offset, SEEK_SET);
-  int n = fread(data, 1, length, fp);
-  fseek(fp, marker, SEEK_SET);
+#ifndef WINDOWS
+  if (mapped) { munmap(buffer, length); }
+#endif
 
-  return n == length ? 0 : 1;
-} 
+  fp = NULL;
+  buffer = NULL;
+  length = 0;
+  ptr = 0;
+  alloc = 0;
+  writing = false;
+  close_fp = false;
+  owns_buffer = false;
+  mapped = false;
+}
 
-int FileIo::write_string(const char *data, bool null_terminate)
+// A buffer from the caller or a mapped file can't be made bigger.  With
+// alloc left at 0 this is also what stops writes to a file being read.
+int FileIo::grow(long size)
 {
-  while (*data != 0)
+  if (buffer != NULL && !owns_buffer)
   {
-    putc(*data, fp);
-    data++;
+    error = true;
+    return -1;
   }
 
-  if (null_terminate) { putc(0, fp); }
+  long new_alloc = alloc == 0 ? 65536 : alloc;
 
-  return 0;
-}
+  while (new_alloc < size) { new_alloc *= 2; }
 
-uint32_t FileIo::get_int16_le(FILE *in)
-{
-  uint32_t i;
+  uint8_t *new_buffer = (uint8_t *)realloc(buffer, new_alloc);
+
+  if (new_buffer == NULL)
+  {
+    error = true;
+    return -1;
+  }
 
-  i  = getc(in);
-  i |= (getc(in) << 8);
+  buffer = new_buffer;
+  alloc = new_alloc;
+  owns_buffer = true;
 
-  return i;
+  return 0;
 }
 
-uint32_t FileIo::get_int32_le(FILE *in)
+void FileIo::seek(long offset, int whence)
 {
-  uint32_t i;
+  if (whence == SEEK_CUR) { offset += ptr; }
+  if (whence == SEEK_END) { offset += length; }
 
-  i  =  getc(in);
-  i |= (getc(in) << 8);
-  i |= (getc(in) << 16);
-  i |= (getc(in) << 24);
-
-  return i;
+  set(offset);
 }
 
-uint64_t FileIo::get_int64_le(FILE *in)
+void FileIo::write_int32_at_offset(int32_t n, long offset)
 {
-  uint64_t i;
-
-  i  =  (uint64_t)getc(in);
-  i |= ((uint64_t)getc(in) << 8);
-  i |= ((uint64_t)getc(in) << 16);
-  i |= ((uint64_t)getc(in) << 24);
-  i |= ((uint64_t)getc(in) << 32);
-  i |= ((uint64_t)getc(in) << 40);
-  i |= ((uint64_t)getc(in) << 48);
-  i |= ((uint64_t)getc(in) << 56);
-
-  return i;
+  long marker = tell();
+  set(offset);
+  write_int32(n);
+  set(marker);
 }
 
-uint32_t FileIo::get_int16_be(FILE *in)
+int FileIo::get_bytes(uint8_t *data, int length)
 {
-  uint32_t i;
+  long count = this->length - ptr;
+
+  if (count > length) { count = length; }
+  if (count <= 0) { return 0; }
 
-  i = (getc(in) << 8);
-  i |= getc(in);
+  memcpy(data, buffer + ptr, count);
+  ptr += count;
 
-  return i;
+  return count;
 }
 
-uint32_t FileIo::get_int32_be(FILE *in)
+int FileIo::write_bytes(const uint8_t *data, int length)
 {
-  uint32_t i;
+  if (length <= 0) { return 0; }
 
-  i =  (getc(in) << 24);
-  i |= (getc(in) << 16);
-  i |= (getc(in) << 8);
-  i |=  getc(in);
+  if (ptr + length > alloc && grow(ptr + length) != 0) { return 0; }
 
-  return i;
-}
+  memcpy(put(length), data, length);
 
-uint64_t FileIo::get_int64_be(FILE *in)
-{
-  uint32_t i;
-
-  i =  ((uint64_t)getc(in) << 56);
-  i |= ((uint64_t)getc(in) << 48);
-  i |= ((uint64_t)getc(in) << 40);
-  i |= ((uint64_t)getc(in) << 32);
-  i |= ((uint64_t)getc(in) << 24);
-  i |= ((uint64_t)getc(in) << 16);
-  i |= ((uint64_t)getc(in) << 8);
-  i |=  (uint64_t)getc(in);
-
-  return i;
+  return length;
 }
 
-void FileIo::write_int16_le(FILE *out, uint32_t n)
+int FileIo::get_string_at_offset(char *data, int length, uint64_t offset)
 {
-  putc(n & 0xff, out);
-  putc((n >> 8) & 0xff, out);
-}
+  int n = 0;
 
-void FileIo::write_int32_le(FILE *out, uint32_t n)
-{
-  putc(n & 0xff, out);
-  putc((n >> 8) & 0xff, out);
-  putc((n >> 16) & 0xff, out);
-  putc((n >> 24) & 0xff, out);
-}
+  while (n < length - 1 && offset + n < (uint64_t)this->length)
+  {
+    const char ch = buffer[offset + n];
+    if (ch == 0) { break; }
+    data[n++] = ch;
+  }
 
-void FileIo::write_int64_le(FILE *out, uint64_t n)
-{
-  putc(n & 0xff, out);
-  putc((n >> 8) & 0xff, out);
-  putc((n >> 16) & 0xff, out);
-  putc((n >> 24) & 0xff, out);
-  putc((n >> 32) & 0xff, out);
-  putc((n >> 40) & 0xff, out);
-  putc((n >> 48) & 0xff, out);
-  putc((n >> 56) & 0xff, out);
-}
+  data[n] = 0;
 
-void FileIo::write_int16_be(FILE *out, uint32_t n)
-{
-  putc((n >> 8) & 0xff, out);
-  putc(n & 0xff, out);
+  return 0;
 }
 
-void FileIo::write_int32_be(FILE *out, uint32_t n)
+int FileIo::get_bytes_at_offset(uint8_t *data, int length, uint64_t offset)
 {
-  putc((n >> 24) & 0xff, out);
-  putc((n >> 16) & 0xff, out);
-  putc((n >> 8) & 0xff, out);
-  putc(n & 0xff, out);
+  if (offset + length > (uint64_t)this->length) { return 1; }
+
+  memcpy(data, buffer + offset, length);
+
+  return 0;
 }
 
-void FileIo::write_int64_be(FILE *out, uint64_t n)
+int FileIo::write_string(const char *data, bool null_terminate)
 {
-  putc((n >> 56) & 0xff, out);
-  putc((n >> 48) & 0xff, out);
-  putc((n >> 40) & 0xff, out);
-  putc((n >> 32) & 0xff, out);
-  putc((n >> 24) & 0xff, out);
-  putc((n >> 16) & 0xff, out);
-  putc((n >> 8) & 0xff, out);
-  putc(n & 0xff, out);
+  write_bytes((const uint8_t *)data, strlen(data) + (null_terminate ? 1 : 0));
+
+  return 0;
 }
 
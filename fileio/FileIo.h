@@ -5,7 +5,7 @@
  *     Web: https://www.mikekohn.net/
  * License: GPLv3
  *
- * Copyright 2010-2024 by Michael Kohn
+ * Copyright 2010-2025 by Michael Kohn
  *
  */
 
@@ -15,7 +15,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 
+// Reads and writes are done in a memory buffer.  A file opened for
+// reading is mapped into memory (or read in all at once where that can't
+// be done), and a file being written is written out with one fwrite() by
+// close_file().  Instead of a file, a buffer from the caller can be read,
+// or written to as long as it has room (get_error() says if it ran out).
 class FileIo
 {
 public:
@@ -24,50 +30,127 @@ public:
 
   int open_for_writing(const char *filename);
   int open_for_reading(const char *filename);
+  int open_for_writing(uint8_t *data, int size);
+  int open_for_reading(const uint8_t *data, int length);
 
-  void set_fp(FILE *fp) { this->fp = fp; }
+  // Write to a FILE * that belongs to the caller.  close_file() writes the
+  // buffer to it but leaves closing it to the caller.
+  void set_fp(FILE *fp);
   void close_file();
 
-  void set_endian(int value);
+  void set_endian(int value) { big_endian = value == FILE_ENDIAN_BIG; }
 
-  int get_file_length();
+  int get_file_length() { return length; }
+  const uint8_t *get_buffer() { return buffer; }
+  bool get_error() { return error; }
 
-  int get_int8() { return getc(fp); }
-  uint32_t get_int16() { return get_int16_func(fp); }
-  uint32_t get_int32() { return get_int32_func(fp); }
-  uint64_t get_int64() { return get_int64_func(fp); }
+  int get_int8()
+  {
+    if (ptr >= length) { return EOF; }
+    return buffer[ptr++];
+  }
 
-  void write_int8(uint32_t n)  { putc(n, fp); }
-  void write_int16(uint32_t n) { write_int16_func(fp, n); }
-  void write_int32(uint32_t n) { write_int32_func(fp, n); }
-  void write_int64(uint64_t n) { write_int64_func(fp, n); }
+  uint32_t get_int16()
+  {
+    const uint8_t *s = get(2);
 
-  void write_int32_at_offset(int32_t n, long offset);
+    if (big_endian) { return (s[0] << 8) | s[1]; }
+
+    return s[0] | (s[1] << 8);
+  }
+
+  uint32_t get_int32()
+  {
+    const uint8_t *s = get(4);
 
-  int get_bytes(uint8_t *data, int length)
+    if (big_endian)
+    {
+      return ((uint32_t)s[0] << 24) | (s[1] << 16) | (s[2] << 8) | s[3];
+    }
+
+    return s[0] | (s[1] << 8) | (s[2] << 16) | ((uint32_t)s[3] << 24);
+  }
+
+  uint64_t get_int64()
   {
-    return fread(data, 1, length, fp);
+    const uint64_t a = get_int32();
+    const uint64_t b = get_int32();
+
+    return big_endian ? (a << 32) | b : (b << 32) | a;
   }
 
-  int get_chars(char *data, int length)
+  void write_int8(uint32_t n) { *put(1) = n; }
+
+  void write_int16(uint32_t n)
+  {
+    uint8_t *s = put(2);
+
+    if (big_endian)
+    {
+      s[0] = n >> 8;
+      s[1] = n;
+    }
+      else
+    {
+      s[0] = n;
+      s[1] = n >> 8;
+    }
+  }
+
+  void write_int32(uint32_t n)
+  {
+    uint8_t *s = put(4);
+
+    if (big_endian)
+    {
+      s[0] = n >> 24;
+      s[1] = n >> 16;
+      s[2] = n >> 8;
+      s[3] = n;
+    }
+      else
+    {
+      s[0] = n;
+      s[1] = n >> 8;
+      s[2] = n >> 16;
+      s[3] = n >> 24;
+    }
+  }
+
+  void write_int64(uint64_t n)
   {
-    return fread(data, 1, length, fp);
+    if (big_endian)
+    {
+      write_int32(n >> 32);
+      write_int32(n);
+    }
+      else
+    {
+      write_int32(n);
+      write_int32(n >> 32);
+    }
   }
 
-  int write_bytes(const uint8_t *data, int length)
+  void write_int32_at_offset(int32_t n, long offset);
+
+  int get_bytes(uint8_t *data, int length);
+
+  int get_chars(char *data, int length)
   {
-    return fwrite(data, 1, length, fp);
+    return get_bytes((uint8_t *)data, length);
   }
 
+  int write_bytes(const uint8_t *data, int length);
+
   int write_chars(const char *data, int length)
   {
-    return fwrite(data, 1, length, fp);
+    return write_bytes((const uint8_t *)data, length);
   }
 
-  long tell() { return ftell(fp); }
-  void set(long offset) { fseek(fp, offset, SEEK_SET); }
-  void seek(long offset, int whence) { fseek(fp, offset, whence); }
-  void skip(long offset) { fseek(fp, offset, SEEK_CUR); }
+  long tell() { return ptr; }
+  void set(long offset) { ptr = offset < 0 ? 0 : offset; }
+  void seek(long offset, int whence);
+  void skip(long offset) { set(ptr + offset); }
 
   int get_string_at_offset(char *data, int length, uint64_t offset);
   int get_bytes_at_offset(uint8_t *data, int length, uint64_t offset);
@@ -88,39 +171,61 @@ public:
   };
 
 private:
-  FILE *fp;
-
-  typedef uint32_t (*get_int16_t)(FILE *);
-  typedef uint32_t (*get_int32_t)(FILE *);
-  typedef uint64_t (*get_int64_t)(FILE *);
+  // Bytes past the end of the buffer read as 0xff like getc() EOF did.
+  const uint8_t *get(int count)
+  {
+    if (ptr + count <= length)
+    {
+      const uint8_t *s = buffer + ptr;
+      ptr += count;
+      return s;
+    }
+
+    memset(scratch, 0xff, sizeof(scratch));
+
+    if (ptr < length)
+    {
+      memcpy(scratch, buffer + ptr, length - ptr);
+      ptr = length;
+    }
+
+    return scratch;
+  }
 
-  typedef void (*write_int16_t)(FILE *, uint32_t);
-  typedef void (*write_int32_t)(FILE *, uint32_t);
-  typedef void (*write_int64_t)(FILE *, uint64_t);
+  // Where the next count bytes go.  Writing past the end fills the
+  // bytes in between with 0 like fseek() and fwrite() would.
+  uint8_t *put(int count)
+  {
+    if (ptr + count > alloc && grow(ptr + count) != 0)
+    {
+      return scratch;
+    }
 
-  get_int16_t get_int16_func;
-  get_int32_t get_int32_func;
-  get_int64_t get_int64_func;
+    if (ptr > length) { memset(buffer + length, 0, ptr - length); }
 
-  write_int16_t write_int16_func;
-  write_int32_t write_int32_func;
-  write_int64_t write_int64_func;
+    uint8_t *s = buffer + ptr;
 
-  static uint32_t get_int16_le(FILE *in);
-  static uint32_t get_int32_le(FILE *in);
-  static uint64_t get_int64_le(FILE *in);
+    ptr += count;
+    if (ptr > length) { length = ptr; }
 
-  static uint32_t get_int16_be(FILE *in);
-  static uint32_t get_int32_be(FILE *in);
-  static uint64_t get_int64_be(FILE *in);
+    return s;
+  }
 
-  static void write_int16_le(FILE *out, uint32_t n);
-  static void write_int32_le(FILE *out, uint32_t n);
-  static void write_int64_le(FILE *out, uint64_t n);
+  int grow(long size);
+  void reset();
 
-  static void write_int16_be(FILE *out, uint32_t n);
-  static void write_int32_be(FILE *out, uint32_t n);
-  static void write_int64_be(FILE *out, uint64_t n);
+  FILE *fp;
+  uint8_t *buffer;
+  long length;
+  long ptr;
+  long alloc;
+  bool big_endian : 1;
+  bool writing : 1;
+  bool close_fp : 1;
+  bool owns_buffer : 1;
+  bool mapped : 1;
+  bool error : 1;
+  uint8_t scratch[8];
 };
 
 #endif
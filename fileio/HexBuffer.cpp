@@ -0,0 +1,24 @@
+/**
+ *  naken_asm assembler.
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: https://www.mikekohn.net/
+ * License: GPLv3
+ *
+ * Copyright 2010-2025 by Michael Kohn
+ *
+ */
+
+#include "fileio/HexBuffer.h"
+
+#define HEX_ROW(a) \
+  #a "0" #a "1" #a "2" #a "3" #a "4" #a "5" #a "6" #a "7" \
+  #a "8" #a "9" #a "A" #a "B" #a "C" #a "D" #a "E" #a "F"
+
+// Two upper case hex digits for every byte value.
+const char HexBuffer::hex_table[] =
+  HEX_ROW(0) HEX_ROW(1) HEX_ROW(2) HEX_ROW(3)
+  HEX_ROW(4) HEX_ROW(5) HEX_ROW(6) HEX_ROW(7)
+  HEX_ROW(8) HEX_ROW(9) HEX_ROW(A) HEX_ROW(B)
+  HEX_ROW(C) HEX_ROW(D) HEX_ROW(E) HEX_ROW(F);
+
@@ -0,0 +1,86 @@
+/**
+ *  naken_asm assembler.
+ *  Author: Michael Kohn
+ *   Email: mike@mikekohn.net
+ *     Web: https://www.mikekohn.net/
+ * License: GPLv3
+ *
+ * Copyright 2010-2025 by Michael Kohn
+ *
+ */
+
+#ifndef NAKEN_ASM_HEX_BUFFER_H
+#define NAKEN_ASM_HEX_BUFFER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#define HEX_BUFFER_SIZE 65536
+
+// Text output files (hex, srec) are built up in a buffer with the hex
+// digits for each byte from a table and written with one fwrite() each
+// time the buffer fills up.  A line has to be reserved before it's
+// appended so the append functions don't need to check for room.
+class HexBuffer
+{
+public:
+  HexBuffer(FILE *out) : out (out), ptr (0) { }
+  ~HexBuffer() { flush(); }
+
+  void reserve(int length)
+  {
+    if (ptr + length > HEX_BUFFER_SIZE) { flush(); }
+  }
+
+  void append_char(char c) { buffer[ptr++] = c; }
+
+  void append_string(const char *s)
+  {
+    const int length = strlen(s);
+
+    reserve(length);
+    memcpy(buffer + ptr, s, length);
+    ptr += length;
+  }
+
+  void append_hex8(uint8_t value)
+  {
+    memcpy(buffer + ptr, hex_table + value * 2, 2);
+    ptr += 2;
+  }
+
+  void append_hex16(uint32_t value)
+  {
+    append_hex8(value >> 8);
+    append_hex8(value);
+  }
+
+  void append_hex24(uint32_t value)
+  {
+    append_hex8(value >> 16);
+    append_hex16(value);
+  }
+
+  void append_hex32(uint32_t value)
+  {
+    append_hex16(value >> 16);
+    append_hex16(value);
+  }
+
+  void flush()
+  {
+    if (ptr != 0) { fwrite(buffer, 1, ptr, out); }
+    ptr = 0;
+  }
+
+private:
+  static const char hex_table[];
+
+  FILE *out;
+  int ptr;
+  char buffer[HEX_BUFFER_SIZE];
+};
+
+#endif
+
@@ -5,7 +5,7 @@
  *     Web: https://www.mikekohn.net/
  * License: GPLv3
  *
- * Copyright 2010-2024 by Michael Kohn
+ * Copyright 2010-2025 by Michael Kohn
  *
  */
 
@@ -15,6 +15,7 @@
 
 #include "common/assembler.h"
 #include "common/UtilContext.h"
+#include "fileio/FileIo.h"
 #include "fileio/file.h"
 #include "fileio/read_amiga.h"
 #include "fileio/read_bin.h"
@@ -118,55 +119,39 @@ const char *file_get_file_type_name(int file_type)
   return "???";
 }
 
-static int check_magic(const char *filename, const char *magic)
+static int check_magic(FileIo &file, const char *magic)
 {
-  int value = 0;
-  FILE *fp = fopen(filename, "rb");
-  if (fp == NULL) { return 0; }
+  if (file.get_file_length() < 4) { return 0; }
 
-  char buffer[4];
-  int length = fread(buffer, 1, sizeof(buffer), fp);
-
-  if (length == sizeof(buffer))
-  {
-    if (memcmp(buffer, magic, sizeof(buffer)) == 0) { value = 1; }
-  }
-
-  fclose(fp);
-  return value;
+  return memcmp(file.get_buffer(), magic, 4) == 0 ? 1 : 0;
 }
 
-static int is_elf(const char *filename)
+static int is_elf(FileIo &file)
 {
-  return check_magic(filename, "\x7f" "ELF");
+  return check_magic(file, "\x7f" "ELF");
 }
 
-static int is_amiga(const char *filename)
+static int is_amiga(FileIo &file)
 {
-  return check_magic(filename, "\x00" "\x00" "\x03" "\xf3");
+  return check_magic(file, "\x00" "\x00" "\x03" "\xf3");
 }
 
-static int is_macho(const char *filename)
+static int is_macho(FileIo &file)
 {
-  return check_magic(filename, "\xce" "\xfa" "\xed" "\xfe") ||
-         check_magic(filename, "\xcf" "\xfa" "\xed" "\xfe");
+  return check_magic(file, "\xce" "\xfa" "\xed" "\xfe") ||
+         check_magic(file, "\xcf" "\xfa" "\xed" "\xfe");
 }
 
-static int is_uf2(const char *filename)
+static int is_uf2(FileIo &file)
 {
-  return check_magic(filename, "UF2\n");
+  return check_magic(file, "UF2\n");
 }
 
-static int is_hex(const char *filename)
+static int is_hex(FileIo &file)
 {
-  int value = 0;
-  FILE *fp = fopen(filename, "rb");
-  if (fp == NULL) { return 0; }
+  if (file.get_file_length() < 1) { return 0; }
 
-  if (getc(fp) == ':') { value = 1; }
-  fclose(fp);
-
-  return value;
+  return file.get_buffer()[0] == ':' ? 1 : 0;
 }
 
 static const char *get_extension(const char *filename)
@@ -187,7 +172,7 @@ static const char *get_extension(const char *filename)
   return extension;
 }
 
-static int get_file_type(const char *filename)
+static int get_file_type(const char *filename, FileIo &file)
 {
   const char *extension = get_extension(filename);
 
@@ -197,11 +182,11 @@ static int get_file_type(const char *filename)
   if (strcasecmp(extension, "txt")  == 0) { return FILE_TYPE_TI_TXT; }
   if (strcasecmp(extension, "uf2")  == 0) { return FILE_TYPE_UF2; }
 
-  if (is_elf(filename)   == 1) { return FILE_TYPE_ELF; }
-  if (is_macho(filename) == 1) { return FILE_TYPE_MACHO; }
-  if (is_amiga(filename) == 1) { return FILE_TYPE_AMIGA; }
-  if (is_hex(filename)   == 1) { return FILE_TYPE_HEX; }
-  if (is_uf2(filename)   == 1) { return FILE_TYPE_UF2; }
+  if (is_elf(file)   == 1) { return FILE_TYPE_ELF; }
+  if (is_macho(file) == 1) { return FILE_TYPE_MACHO; }
+  if (is_amiga(file) == 1) { return FILE_TYPE_AMIGA; }
+  if (is_hex(file)   == 1) { return FILE_TYPE_HEX; }
+  if (is_uf2(file)   == 1) { return FILE_TYPE_UF2; }
 
   if (strcasecmp(extension, "bin") == 0)  { return FILE_TYPE_BIN; }
 
@@ -220,9 +205,15 @@ int file_read(
   Memory *memory = &util_context->memory;
   Symbols *symbols = &util_context->symbols;
 
+  // The file is mapped into memory once here and each reader works on
+  // that instead of opening the file itself.
+  FileIo file;
+
+  if (file.open_for_reading(filename) != 0) { return -1; }
+
   if (*file_type == FILE_TYPE_AUTO)
   {
-    *file_type = get_file_type(filename);
+    *file_type = get_file_type(filename, file);
   }
 
   int ret = -2;
@@ -230,16 +221,16 @@ int file_read(
   switch (*file_type)
   {
     case FILE_TYPE_HEX:
-      ret = read_hex(filename, memory);
+      ret = read_hex(file, memory);
       break;
     case FILE_TYPE_BIN:
-      ret = read_bin(filename, memory, start_address);
+      ret = read_bin(file, memory, start_address);
       break;
     case FILE_TYPE_ELF:
-      ret = read_elf(filename, memory, &cpu_type, symbols);
+      ret = read_elf(file, memory, &cpu_type, symbols);
       break;
     case FILE_TYPE_SREC:
-      ret = read_srec(filename, memory);
+      ret = read_srec(file, memory);
       break;
     case FILE_TYPE_WDC:
       ret = read_wdc(filename, memory);
@@ -249,13 +240,13 @@ int file_read(
       cpu_type = CPU_TYPE_68000;
       break;
     case FILE_TYPE_TI_TXT:
-      ret = read_ti_txt(filename, memory);
+      ret = read_ti_txt(file, memory);
       break;
     case FILE_TYPE_MACHO:
-      ret = read_macho(filename, memory, &cpu_type, symbols);
+      ret = read_macho(file, memory, &cpu_type, symbols);
       break;
     case FILE_TYPE_UF2:
-      ret = read_uf2(filename, memory);
+      ret = read_uf2(file, memory);
       break;
     default:
       break;
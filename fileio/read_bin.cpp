@@ -5,7 +5,7 @@
  *     Web: https://www.mikekohn.net/
  * License: GPLv3
  *
- * Copyright 2010-2023 by Michael Kohn
+ * Copyright 2010-2025 by Michael Kohn
  *
  */
 
@@ -13,36 +13,22 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "fileio/FileIo.h"
 #include "fileio/read_bin.h"
 
-int read_bin(const char *filename, Memory *memory, uint32_t start_address)
+int read_bin(FileIo &file, Memory *memory, uint32_t start_address)
 {
-  FILE *in;
-  int ch;
-  uint32_t address = start_address;
+  const int length = file.get_file_length();
 
   memory->clear();
 
-  in = fopen(filename, "rb");
-
-  if (in == NULL)
+  if (length > 0)
   {
-    return -1;
+    memory->write_block(start_address, file.get_buffer(), length);
   }
 
-  while(1)
-  {
-    ch = getc(in);
-    if (ch == EOF) break;
-
-    memory->write8(address++, ch);
-  }
-
-  fclose(in);
-
   memory->low_address = start_address;
-  memory->high_address = address - 1;
+  memory->high_address = start_address + length - 1;
 
   return start_address;
 }
-
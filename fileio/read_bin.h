@@ -5,7 +5,7 @@
  *     Web: https://www.mikekohn.net/
  * License: GPLv3
  *
- * Copyright 2010-2023 by Michael Kohn
+ * Copyright 2010-2025 by Michael Kohn
  *
  */
 
@@ -15,8 +15,9 @@
 #include <stdint.h>
 
 #include "common/Memory.h"
+#include "fileio/FileIo.h"
 
-int read_bin(const char *filename, Memory *memory, uint32_t start_address);
+int read_bin(FileIo &file, Memory *memory, uint32_t start_address);
 
 #endif
 
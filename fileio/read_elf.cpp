@@ -5,7 +5,7 @@
  *     Web: https://www.mikekohn.net/
  * License: GPLv3
  *
- * Copyright 2010-2024 by Michael Kohn
+ * Copyright 2010-2025 by Michael Kohn
  *
  */
 
@@ -95,12 +95,11 @@ static int read_shdr_64(FileIo &file, _elf_shdr *elf_shdr)
 }
 
 int read_elf(
-  const char *filename,
+  FileIo &file,
   Memory *memory,
   uint8_t *cpu_type,
   Symbols *symbols)
 {
-  FileIo file;
   uint8_t e_ident[16];
   uint64_t e_shoff;
   int e_shentsize;
@@ -117,11 +116,6 @@ int read_elf(
   start = 0xffffffff;
   end = 0xffffffff; 
 
-  if (file.open_for_reading(filename) != 0)
-  {
-    return -1;
-  }
-
   memset(e_ident, 0, 16);
   n = file.get_bytes(e_ident, 16);
 
@@ -129,7 +123,6 @@ int read_elf(
       e_ident[2] != 'L'  || e_ident[3] != 'F')
   {
     //printf("Not an ELF file.\n");
-    file.close_file();
     return -2;
   }
 
@@ -157,7 +150,6 @@ int read_elf(
     else
   {
     printf("ELF Error: EI_DATA incorrect data encoding\n");
-    file.close_file();
     return -1;
   }
 
@@ -221,7 +213,6 @@ int read_elf(
       if (*cpu_type == CPU_TYPE_IGNORE)
       {
         printf("ELF Error: e_machine unknown\n");
-        file.close_file();
         return -1;
       }
 
@@ -357,16 +348,41 @@ int read_elf(
         }
       }
 
-      long marker = file.tell();
-      file.set(elf_shdr.sh_offset);
+      const uint64_t file_length = file.get_file_length();
+      uint32_t i = 0;
 
-      uint32_t i;
-      for (i = 0; i < elf_shdr.sh_size; i++)
+      // The section is copied straight out of the file's buffer.
+      if (elf_shdr.sh_offset < file_length)
       {
-        memory->write8(elf_shdr.sh_addr + i, file.get_int8());
+        i = elf_shdr.sh_size;
+
+        if (elf_shdr.sh_offset + i > file_length)
+        {
+          i = file_length - elf_shdr.sh_offset;
+        }
+
+        memory->write_block(
+          elf_shdr.sh_addr,
+          file.get_buffer() + elf_shdr.sh_offset,
+          i);
       }
 
-      file.set(marker);
+      // Past the end of the file reads as 0xff like getc() EOF did.
+      uint8_t buffer[4096];
+      memset(buffer, 0xff, sizeof(buffer));
+
+      while (i < elf_shdr.sh_size)
+      {
+        int length = sizeof(buffer);
+
+        if (elf_shdr.sh_size - i < sizeof(buffer))
+        {
+          length = elf_shdr.sh_size - i;
+        }
+
+        memory->write_block(elf_shdr.sh_addr + i, buffer, length);
+        i += length;
+      }
 
       printf("Loaded %d %s bytes from 0x%04" PRIx64 "\n",
         i, name, elf_shdr.sh_addr);
@@ -426,8 +442,6 @@ int read_elf(
   memory->low_address = start;
   memory->high_address = end;
 
-  file.close_file();
-
   return start;
 }
 
@@ -5,7 +5,7 @@
  *     Web: https://www.mikekohn.net/
  * License: GPLv3
  *
- * Copyright 2010-2023 by Michael Kohn
+ * Copyright 2010-2025 by Michael Kohn
  *
  */
 
@@ -13,16 +13,17 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "fileio/FileIo.h"
 #include "fileio/read_hex.h"
 
-static int get_hex(FILE *in, int len)
+static int get_hex(FileIo &file, int len)
 {
   int ch;
   int n = 0;
 
   while (len > 0)
   {
-    ch = getc(in);
+    ch = file.get_int8();
     if (ch == EOF) return -1;
     if (ch >= '0' && ch <= '9') ch -= '0';
       else
@@ -39,9 +40,8 @@ static int get_hex(FILE *in, int len)
   return n;
 }
 
-int read_hex(const char *filename, Memory *memory)
+int read_hex(FileIo &file, Memory *memory)
 {
-  FILE *in;
   int ch;
   int byte_count;
   int address;
@@ -53,35 +53,30 @@ int read_hex(const char *filename, Memory *memory)
   int line = 0;
   int start, end;
   int segment = 0;
+  uint8_t data[256];
 
   memory->clear();
 
   start = -1;
   end = -1;
 
-  in = fopen(filename, "rb");
-  if (in == 0)
-  {
-    return -1;
-  }
-
   /* It's a state machine.. it's a state machine... */
   while (true)
   {
     line++;
-    ch = getc(in);
+    ch = file.get_int8();
     if (ch == EOF) break;
 
     if (ch != ':')
     {
       /* Line is a junkie piece of shit because ch says so */
-      while (1) { if (ch == '\n' || ch == EOF) break; ch = getc(in); }
+      while (1) { if (ch == '\n' || ch == EOF) break; ch = file.get_int8(); }
       continue;
     }
 
-    byte_count = get_hex(in,2);
-    address = get_hex(in,4);
-    record_type = get_hex(in,2);
+    byte_count = get_hex(file, 2);
+    address = get_hex(file, 4);
+    record_type = get_hex(file, 2);
     checksum_calc = byte_count + (address&0xff) + (address>>8) + record_type;
 
 #ifdef DEBUG1
@@ -107,26 +102,31 @@ int read_hex(const char *filename, Memory *memory)
           if (address + byte_count > end) end = address + byte_count - 1;
         }
 
-        for (n = 0; n < byte_count; n++)
+        for (n = 0; n < byte_count && n < (int)sizeof(data); n++)
         {
-          ch = get_hex(in, 2);
+          ch = get_hex(file, 2);
           //dirty[address]=1;
-          memory->write8(address++, ch);
+          data[n] = ch;
           checksum_calc += ch;
 #ifdef DEBUG1
           printf(" %02x",ch);
 #endif
         }
+
+        if (byte_count > 0)
+        {
+          memory->write_block(address, data, byte_count);
+        }
         break;
 
       /* End Of File */
       case 0x01:
-        start_address = get_hex(in, byte_count<<1);
+        start_address = get_hex(file, byte_count<<1);
         break;
 
       /* Extended Segment Address Record */
       case 0x02:
-        ch = get_hex(in, 4);
+        ch = get_hex(file, 4);
         segment = (ch << 4);
         checksum_calc += (ch&0xff) + (ch>>8);
         #ifdef DEBUG1
@@ -136,7 +136,7 @@ int read_hex(const char *filename, Memory *memory)
 
       /* Extended Linear Address Record */
       case 0x04:
-        ch = get_hex(in, 4);
+        ch = get_hex(file, 4);
         checksum_calc += (ch&0xff) + (ch>>8);
         segment = (ch<<16);
         break;
@@ -150,7 +150,7 @@ int read_hex(const char *filename, Memory *memory)
       default:
         for (n = 0; n < byte_count; n++)
         {
-          ch = get_hex(in, 2);
+          ch = get_hex(file, 2);
           checksum_calc += ch;
 #ifdef DEBUG1
           printf(" %02x", ch);
@@ -164,7 +164,7 @@ int read_hex(const char *filename, Memory *memory)
     printf("\n");
     #endif
 
-    checksum = get_hex(in, 2);
+    checksum = get_hex(file, 2);
     checksum_calc = (((checksum_calc & 0xff) ^ 0xff) + 1) & 0xff;
 
     #ifdef DEBUG1
@@ -174,8 +174,6 @@ int read_hex(const char *filename, Memory *memory)
     if (checksum != checksum_calc)
     {
       printf("read_hex: Checksum failure on line %d!\n", line);
-      fclose(in);
-      in = NULL;
       start_address = -4;
       break;
     }
@@ -183,17 +181,11 @@ int read_hex(const char *filename, Memory *memory)
     /* All tied up to a state machine */
     while (1)
     {
-      ch = getc(in);
+      ch = file.get_int8();
       if (ch == '\n' || ch == EOF) break;
     }
   }
 
-  /* We're all slaves to a state machine */
-  if (in != NULL)
-  {
-    fclose(in);
-  }
-
   memory->low_address = start;
   memory->high_address = end;
 
@@ -5,7 +5,7 @@
  *     Web: https://www.mikekohn.net/
  * License: GPLv3
  *
- * Copyright 2010-2024 by Michael Kohn
+ * Copyright 2010-2025 by Michael Kohn
  *
  */
 
@@ -175,12 +175,11 @@ static int macho_read_symbol(MachoSymbol &macho_symbol, FileIo &file, int bits)
 }
 
 int read_macho(
-  const char *filename,
+  FileIo &file,
   Memory *memory,
   uint8_t *cpu_type,
   Symbols *symbols)
 {
-  FileIo file;
   MachoHeader macho_header;
   MachoLoadCommand macho_load_command;
   MachoSegmentLoad macho_segment_load;
@@ -193,11 +192,6 @@ int read_macho(
   uint32_t start = 0xffffffff;
   uint32_t end   = 0xffffffff;
 
-  if (file.open_for_reading(filename) != 0)
-  {
-    return -1;
-  }
-
   macho_header.magic_number = file.get_int32();
 
   if (macho_header.magic_number != 0xfeedface &&
@@ -258,18 +252,28 @@ int read_macho(
 
           if (strcmp(macho_section.section_name, "__text") == 0)
           {
-            long marker = file.tell();
-            file.set(macho_section.offset);
+            const uint32_t file_length = file.get_file_length();
+            uint32_t count = 0;
 
-            for (uint32_t t = 0; t < macho_section.size; t++)
+            if (macho_section.offset < file_length)
             {
-              memory->write8(macho_section.address + t, file.get_int8());
+              count = file_length - macho_section.offset;
+              if (count > macho_section.size) { count = macho_section.size; }
+
+              memory->write_block(
+                macho_section.address,
+                file.get_buffer() + macho_section.offset,
+                count);
+            }
+
+            // Past the end of the file reads as 0xff like getc() EOF did.
+            for (uint32_t t = count; t < macho_section.size; t++)
+            {
+              memory->write8(macho_section.address + t, 0xff);
             }
 
             start = macho_section.address;
             end = macho_section.address + macho_section.size - 1;
-
-            file.set(marker);
           }
         }
         break;
@@ -314,8 +318,6 @@ int read_macho(
     }
   }
 
-  file.close_file();
-
   memory->low_address  = start;
   memory->high_address = end;
 
@@ -5,7 +5,7 @@
  *     Web: https://www.mikekohn.net/
  * License: GPLv3
  *
- * Copyright 2010-2024 by Michael Kohn
+ * Copyright 2010-2025 by Michael Kohn
  *
  */
 
@@ -14,9 +14,10 @@
 
 #include "common/Memory.h"
 #include "common/Symbols.h"
+#include "fileio/FileIo.h"
 
 int read_macho(
-  const char *filename,
+  FileIo &file,
   Memory *memory,
   uint8_t *cpu_type,
   Symbols *symbols);
@@ -5,7 +5,7 @@
  *     Web: https://www.mikekohn.net/
  * License: GPLv3
  *
- * Copyright 2010-2023 by Michael Kohn
+ * Copyright 2010-2025 by Michael Kohn
  *
  */
 
@@ -13,17 +13,18 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "fileio/FileIo.h"
 #include "fileio/read_srec.h"
 
 // FIXME: Redundant with read_hex.c
-static int get_hex(FILE *in, int len)
+static int get_hex(FileIo &file, int len)
 {
   int ch;
   int n = 0;
 
   while (len > 0)
   {
-    ch = getc(in);
+    ch = file.get_int8();
     if (ch == EOF) return -1;
 
     if (ch >= '0' && ch <= '9') { ch -= '0'; }
@@ -41,20 +42,19 @@ static int get_hex(FILE *in, int len)
   return n;
 }
 
-static void ignore_line(FILE *in)
+static void ignore_line(FileIo &file)
 {
   int ch;
 
   while (1)
   {
-    ch = getc(in);
+    ch = file.get_int8();
     if (ch == '\n' || ch == EOF) { break; }
   }
 }
 
-int read_srec(const char *filename, Memory *memory)
+int read_srec(FileIo &file, Memory *memory)
 {
-  FILE *in;
   int ch;
   int byte_count;
   int address;
@@ -65,33 +65,27 @@ int read_srec(const char *filename, Memory *memory)
   int start_address = 0;
   int line = 0;
   int start, end;
+  uint8_t data[256];
 
   memory->clear();
 
   start = -1;
   end = -1;
 
-  in = fopen(filename, "rb");
-
-  if (in == 0)
-  {
-    return -1;
-  }
-
   while (1)
   {
     line++;
-    ch = getc(in);
+    ch = file.get_int8();
     if (ch == EOF) { break; }
 
     // If line doesn't start with S, ignore the line (this is a bad file maybe).
     if (ch != 'S')
     {
-      ignore_line(in);
+      ignore_line(file);
       continue;
     }
 
-    record_type = getc(in);
+    record_type = file.get_int8();
 
     if (record_type >= '0' && record_type <= '9')
     {
@@ -105,30 +99,30 @@ int read_srec(const char *filename, Memory *memory)
     // SREC's header has no data and ignore any headers with no data
     if (record_type == 0 || record_type > 3)
     {
-      ignore_line(in);
+      ignore_line(file);
       continue;
     }
 
-    byte_count = get_hex(in, 2);
+    byte_count = get_hex(file, 2);
 
     checksum_calc = byte_count;
 
     if (record_type == 1)
     {
-      address = get_hex(in, 4);
+      address = get_hex(file, 4);
       checksum_calc = byte_count + (address >> 8) + (address & 0xff);
       byte_count -= 3;
     }
       else
     if (record_type == 2)
     {
-      address = get_hex(in, 6);
+      address = get_hex(file, 6);
       checksum_calc = byte_count + (address >> 16) + ((address >> 8) & 0xff) + (address & 0xff);
       byte_count -= 4;
     }
       else
     {
-      address = get_hex(in, 8);
+      address = get_hex(file, 8);
       checksum_calc = byte_count + (address >> 24) + ((address >> 16) & 0xff) + ((address >> 8) & 0xff) + (address & 0xff);
       byte_count -= 5;
     }
@@ -150,10 +144,10 @@ int read_srec(const char *filename, Memory *memory)
       if (address + byte_count > end) { end = address + byte_count - 1; }
     }
 
-    for (n = 0; n < byte_count; n++)
+    for (n = 0; n < byte_count && n < (int)sizeof(data); n++)
     {
-      ch = get_hex(in, 2);
-      memory->write8(address++, ch);
+      ch = get_hex(file, 2);
+      data[n] = ch;
       checksum_calc += ch;
 #ifdef DEBUG1
       printf(" %02x",ch);
@@ -164,7 +158,12 @@ int read_srec(const char *filename, Memory *memory)
     printf("\n");
 #endif
 
-    checksum = get_hex(in, 2);
+    if (byte_count > 0)
+    {
+      memory->write_block(address, data, byte_count);
+    }
+
+    checksum = get_hex(file, 2);
     checksum_calc = ((checksum_calc & 0xff) ^ 0xff) & 0xff;
 
 #ifdef DEBUG1
@@ -179,11 +178,9 @@ int read_srec(const char *filename, Memory *memory)
     }
 
     // Remove anything at the end of the line.
-    ignore_line(in);
+    ignore_line(file);
   }
 
-  if (in != NULL)  { fclose(in); }
-
   memory->low_address = start;
   memory->high_address = end;
 
@@ -5,7 +5,7 @@
  *     Web: https://www.mikekohn.net/
  * License: GPLv3
  *
- * Copyright 2010-2023 by Michael Kohn
+ * Copyright 2010-2025 by Michael Kohn
  *
  */
 
@@ -13,8 +13,9 @@
 #define NAKEN_ASM_READ_SREC_H
 
 #include "common/Memory.h"
+#include "fileio/FileIo.h"
 
-int read_srec(const char *filename, Memory *memory);
+int read_srec(FileIo &file, Memory *memory);
 
 #endif
 
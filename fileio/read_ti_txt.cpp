@@ -5,7 +5,7 @@
  *     Web: https://www.mikekohn.net/
  * License: GPLv3
  *
- * Copyright 2010-2023 by Michael Kohn
+ * Copyright 2010-2025 by Michael Kohn
  *
  */
 
@@ -13,6 +13,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "fileio/FileIo.h"
 #include "fileio/read_ti_txt.h"
 
 enum
@@ -23,9 +24,8 @@ enum
   TYPE_EOF,
 };
 
-int read_ti_txt(const char *filename, Memory *memory)
+int read_ti_txt(FileIo &file, Memory *memory)
 {
-  FILE *in;
   int ch;
   int line = 1;
   uint32_t address = 0;
@@ -39,12 +39,6 @@ int read_ti_txt(const char *filename, Memory *memory)
   start = 0xffffffff;
   end = 0;
 
-  in = fopen(filename, "rb");
-  if (in == 0)
-  {
-    return -1;
-  }
-
   /* It's a state machine.. it's a state machine... */
   while(1)
   {
@@ -54,7 +48,7 @@ int read_ti_txt(const char *filename, Memory *memory)
 
     while(1)
     {
-      ch = getc(in);
+      ch = file.get_int8();
       if (ch == '\r') { continue; }
       if (ch == '\n' || ch == ' ')
       {
@@ -111,8 +105,6 @@ printf("%d) 0x%02x\n", type, value);
     }
   }
 
-  fclose(in);
-
   memory->low_address = start;
   memory->high_address = end;
 
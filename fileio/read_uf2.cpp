@@ -5,7 +5,7 @@
  *     Web: https://www.mikekohn.net/
  * License: GPLv3
  *
- * Copyright 2010-2024 by Michael Kohn
+ * Copyright 2010-2025 by Michael Kohn
  *
  */
 
@@ -59,16 +59,10 @@ static void print_block(Uf2Block &uf2_block, int offset)
   printf("board_family: 0x%08x\n", uf2_block.board_family);
 }
 
-int read_uf2(const char *filename, Memory *memory)
+int read_uf2(FileIo &file, Memory *memory)
 {
-  FileIo file;
   Uf2Block uf2_block;
 
-  if (file.open_for_reading(filename) != 0)
-  {       
-    return -1;
-  }
-
   file.set_endian(FileIo::FILE_ENDIAN_LITTLE);
 
   const int length = file.get_file_length();
@@ -138,11 +132,13 @@ int read_uf2(const char *filename, Memory *memory)
       //printf("extension tags present\n");
     }
 
-    for (uint32_t n = 0; n < uf2_block.byte_count; n++)
+    if (uf2_block.byte_count > sizeof(uf2_block.data))
     {
-      memory->write8(address++, uf2_block.data[n]);
+      uf2_block.byte_count = sizeof(uf2_block.data);
     }
 
+    memory->write_block(address, uf2_block.data, uf2_block.byte_count);
+
     block += 1;
   }
 
@@ -155,8 +151,6 @@ int read_uf2(const char *filename, Memory *memory)
   }
 #endif
 
-  file.close_file();
-
   return 0;
 }
 
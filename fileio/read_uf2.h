@@ -5,7 +5,7 @@
  *     Web: https://www.mikekohn.net/
  * License: GPLv3
  *
- * Copyright 2010-2024 by Michael Kohn
+ * Copyright 2010-2025 by Michael Kohn
  *
  */
 
@@ -15,8 +15,9 @@
 #include <stdint.h>
 
 #include "common/Memory.h"
+#include "fileio/FileIo.h"
 
-int read_uf2(const char *filename, Memory *memory);
+int read_uf2(FileIo &file, Memory *memory);
 
 #endif
 
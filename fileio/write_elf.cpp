@@ -15,13 +15,31 @@
 
 #include "common/assembler.h"
 #include "common/Symbols.h"
+#include "common/Vector.h"
 #include "fileio/FileIo.h"
 #include "fileio/write_elf.h"
 
+// Runs of used memory closer together than this are put in the same
+// section with the bytes in between set to 0.
+#define ELF_GAP_MIN 4096
+
+// After this many sections the rest of memory goes in the last one.
+#define ELF_SECTIONS_MAX 1024
+
 typedef void(*write_int64_t)(FILE *, uint64_t);
 typedef void(*write_int32_t)(FILE *, uint32_t);
 typedef void(*write_int16_t)(FILE *, uint32_t);
 
+// One .text section (and LOAD program header) for each run of used
+// memory.
+struct ElfSection
+{
+  uint32_t address;
+  uint32_t length;
+  long offset;
+  int size;
+};
+
 typedef struct _elf
 {
   struct _sections_offset sections_offset;
@@ -39,7 +57,6 @@ typedef struct _elf
   //int text_count;
   //int data_count;
   int cpu_type;
-  int text_addr;
   int data_addr;
   char string_table[32768];
   long shnum_offset;
@@ -80,7 +97,8 @@ static void write_elf_header(
   FileIo &file,
   Elf *elf,
   Memory *memory,
-  int alignment)
+  int alignment,
+  int section_count)
 {
   #define EI_CLASS 4   // 1=32 bit, 2=64 bit
   #define EI_DATA  5   // 1=little endian, 2=big endian
@@ -99,14 +117,6 @@ static void write_elf_header(
     file.set_endian(FileIo::FILE_ENDIAN_BIG);
   }
 
-  if (memory->entry_point != 0xffffffff)
-  {
-    elf->e_entry = memory->entry_point;
-    elf->e_phoff = 0x34;
-    elf->e_phentsize = 32;
-    elf->e_phnum = 1;
-  }
-
   // This probably should be 0 for Raspberry Pi, etc.
   elf->e_ident[EI_OSABI] = 255;
 
@@ -210,6 +220,14 @@ static void write_elf_header(
   // Null section to start...
   elf->e_shnum++;
 
+  if (memory->entry_point != 0xffffffff)
+  {
+    elf->e_entry = memory->entry_point;
+    elf->e_phoff = elf->e_ident[EI_CLASS] == 1 ? 0x34 : 0x40;
+    elf->e_phentsize = elf->e_ident[EI_CLASS] == 1 ? 32 : 56;
+    elf->e_phnum = section_count;
+  }
+
   // Write Ehdr;
   file.write_bytes(elf->e_ident, 16);
 
@@ -241,7 +259,7 @@ static void write_elf_header(
     elf->shoff_offset = file.tell();
     file.write_int64(0);              // e_shoff (section header offset)
     file.write_int32(elf->e_flags);   // e_flags (set to CPU model)
-    file.write_int16(0x34);           // e_ehsize (size of this struct)
+    file.write_int16(0x40);           // e_ehsize (size of this struct)
     file.write_int16(elf->e_phentsize); // e_phentsize (pheader size)
     file.write_int16(elf->e_phnum);   // e_phnum (program headers count)
     file.write_int16(64);             // e_shentsize (section header size)
@@ -273,39 +291,143 @@ static void string_table_append(Elf *elf, const char *name)
   *string_table = 0;
 }
 
-static void write_elf_text_and_data(
-  FileIo &file,
-  Elf *elf,
-  Memory *memory,
-  int alignment)
+// Find the runs of used memory that each get a section.  An empty
+// memory still gets an empty .text section.
+static void find_sections(Memory *memory, Vector<ElfSection> &sections)
 {
-  const char *name = ".text";
-  uint32_t i;
+  MemorySpan span;
+  ElfSection section;
+
+  memset(&section, 0, sizeof(section));
+
+  while (memory->next_span(&span) != -1)
+  {
+    if (sections.count() != 0)
+    {
+      ElfSection &last = sections[sections.count() - 1];
+      const uint64_t end = (uint64_t)last.address + last.length;
+
+      if (span.address - end < ELF_GAP_MIN ||
+          sections.count() == ELF_SECTIONS_MAX)
+      {
+        last.length = span.address + span.length - last.address;
+        continue;
+      }
+    }
 
-  elf->text_addr = memory->low_address;
-  string_table_append(elf, name);
-  elf->sections_offset.text = file.tell();
+    section.address = span.address;
+    section.length = span.length;
+    sections.append(section);
+  }
 
-  for (i = memory->low_address; i <= memory->high_address; i++)
+  if (sections.count() == 0)
   {
-    file.write_int8(memory->read8(i));
+    section.address = memory->low_address;
+    sections.append(section);
   }
+}
+
+static int get_section_size(ElfSection &section, int alignment)
+{
+  int size = section.length;
 
   if (alignment > 1)
   {
-    int count = memory->high_address - memory->low_address + 1;
     int mask = alignment - 1;
+    size += (alignment - size) & mask;
+  }
+
+  return size;
+}
+
+// With program headers each section is placed in the file at the same
+// offset into a 4096 byte page as its address (Playstation 2 needs this
+// and so does anything that maps the file), so the offsets have to be
+// known before anything is written.
+static void layout_sections(
+  Elf *elf,
+  Vector<ElfSection> &sections,
+  int alignment)
+{
+  long offset = elf->e_phoff + elf->e_phnum * elf->e_phentsize;
+
+  for (int n = 0; n < sections.count(); n++)
+  {
+    offset = ((offset + 4095) & ~4095L) + (sections[n].address & 4095);
+    sections[n].offset = offset;
+    offset += get_section_size(sections[n], alignment);
+  }
+}
+
+static int find_section_index(Vector<ElfSection> &sections, uint32_t address)
+{
+  for (int n = 0; n < sections.count(); n++)
+  {
+    if (address - sections[n].address < sections[n].length) { return n + 1; }
+  }
+
+  return 1;
+}
+
+static void write_elf_text(
+  FileIo &file,
+  Elf *elf,
+  Memory *memory,
+  Vector<ElfSection> &sections,
+  int alignment)
+{
+  uint8_t buffer[65536];
+  char name[32];
+
+  for (int n = 0; n < sections.count(); n++)
+  {
+    ElfSection &section = sections[n];
+
+    if (n == 0)
+    {
+      strcpy(name, ".text");
+    }
+      else
+    {
+      snprintf(name, sizeof(name), ".text.%d", n);
+    }
+
+    string_table_append(elf, name);
+
+    if (elf->e_phnum > 0)
+    {
+      long marker = file.tell();
+      while (marker < section.offset) { file.write_int8(0); marker++; }
+    }
+
+    section.offset = file.tell();
+
+    uint32_t address = section.address;
+    uint32_t length = section.length;
+
+    while (length > 0)
+    {
+      uint32_t count = length < sizeof(buffer) ? length : sizeof(buffer);
+
+      memory->read_block(address, buffer, count);
+      file.write_bytes(buffer, count);
+
+      address += count;
+      length -= count;
+    }
 
-    while ((count & mask) != 0)
+    int padding = get_section_size(section, alignment) - section.length;
+
+    while (padding > 0)
     {
       file.write_int8(0);
-      count++;
+      padding--;
     }
-  }
 
-  elf->sections_size.text = file.tell() - elf->sections_offset.text;
+    section.size = file.tell() - section.offset;
 
-  elf->e_shnum++;
+    elf->e_shnum++;
+  }
 }
 
 static void write_arm_attribute(FileIo &file, Elf *elf)
@@ -344,13 +466,14 @@ static void write_arm_attribute(FileIo &file, Elf *elf)
 static void write_phdr(
   FileIo &file,
   Elf *elf,
+  uint32_t offset,
   uint32_t address,
   uint32_t filesz)
 {
   if (elf->e_ident[EI_CLASS] == 1)
   {
     file.write_int32(1);          // p_type: 1 (LOAD)
-    file.write_int32(0x1000);     // p_offset
+    file.write_int32(offset);     // p_offset
     file.write_int32(address);    // p_vaddr
     file.write_int32(address);    // p_paddr
     file.write_int32(filesz);     // p_filesz
@@ -362,7 +485,7 @@ static void write_phdr(
   {
     file.write_int32(1);          // p_type: 1 (LOAD)
     file.write_int32(7);          // p_flags: 7 RWX
-    file.write_int64(0x1000);     // p_offset
+    file.write_int64(offset);     // p_offset
     file.write_int64(address);    // p_vaddr
     file.write_int64(address);    // p_paddr
     file.write_int64(filesz);     // p_filesz
@@ -453,7 +576,8 @@ int write_elf(
   struct _symtab symtab;
   Elf elf;
   FileIo file;
-  //int i;
+  Vector<ElfSection> sections;
+  int n;
 
   file.set_fp(out_);
 
@@ -465,22 +589,29 @@ int write_elf(
 
   memcpy(elf.string_table, string_table_default, sizeof(string_table_default));
 
-  write_elf_header(file, &elf, memory, alignment);
+  find_sections(memory, sections);
+
+  write_elf_header(file, &elf, memory, alignment, sections.count());
 
-  // For Playstaiton 2 ELF to be executable, need this LOAD program header
+  // For Playstaiton 2 ELF to be executable, need a LOAD program header
+  // for each section.
   if (elf.e_phnum > 0)
   {
-    uint32_t filesz = memory->high_address - memory->low_address + 1;
-
-    write_phdr(file, &elf, memory->low_address, filesz);
+    layout_sections(&elf, sections, alignment);
 
-    // Align 4096 for Playstation 2.
-    long marker = file.tell();
-    while (marker < 4096) { file.write_int8(0); marker++; }
+    for (n = 0; n < sections.count(); n++)
+    {
+      write_phdr(
+        file,
+        &elf,
+        sections[n].offset,
+        sections[n].address,
+        get_section_size(sections[n], alignment));
+    }
   }
 
-  // .text and .data sections
-  write_elf_text_and_data(file, &elf, memory, alignment);
+  // .text sections
+  write_elf_text(file, &elf, memory, sections, alignment);
 
   // string index should be next
   //elf.e_shstrndx = elf.e_shnum;
@@ -498,12 +629,15 @@ int write_elf(
   elf.sections_size.shstrtab = file.tell() - elf.sections_offset.shstrtab;
 
   int symbol_count = 0;
-  const int strtab_extras = 2;
+
+  // The null symbol, the filename, one for each section and one for
+  // .ARM.attributes are local.  The exported symbols come after them.
+  const int local_count =
+    2 + sections.count() + (elf.cpu_type == CPU_TYPE_ARM ? 1 : 0);
 
   {
     SymbolsIter iter;
     int sym_offset;
-    int n;
 
     symbol_count = symbols->export_count();
 
@@ -548,10 +682,13 @@ int write_elf(
     write_symtab(file, &symtab, &elf);
 
     // symtab text
-    memset(&symtab, 0, sizeof(symtab));
-    symtab.st_info = 3;
-    symtab.st_shndx = 1;
-    write_symtab(file, &symtab, &elf);
+    for (n = 0; n < sections.count(); n++)
+    {
+      memset(&symtab, 0, sizeof(symtab));
+      symtab.st_info = 3;
+      symtab.st_shndx = n + 1;
+      write_symtab(file, &symtab, &elf);
+    }
 
     // symtab ARM.attribute
     if (elf.cpu_type == CPU_TYPE_ARM)
@@ -576,7 +713,7 @@ int write_elf(
       symtab.st_value = iter.address;
       symtab.st_size = 0;
       symtab.st_info = 18;
-      symtab.st_shndx = 1;
+      symtab.st_shndx = find_section_index(sections, iter.address);
       write_symtab(file, &symtab, &elf);
     }
 
@@ -618,24 +755,24 @@ int write_elf(
   char name[32];
 
   // SHT .text
-  if (elf.sections_offset.text != 0)
+  for (n = 0; n < sections.count(); n++)
   {
-    int size = elf.sections_size.text;
-
-    if (alignment != 1)
+    if (n == 0)
     {
-      int mask = alignment - 1;
-      size += (alignment - size) & mask;
+      strcpy(name, ".text");
+    }
+      else
+    {
+      snprintf(name, sizeof(name), ".text.%d", n);
     }
 
-    strcpy(name, ".text");
-
+    memset(&shdr, 0, sizeof(shdr));
     shdr.sh_name = find_section(elf.string_table, name, sizeof(elf.string_table));
     shdr.sh_type = 1;
     shdr.sh_flags = 6;
-    shdr.sh_addr = elf.text_addr; //asm_context->memory.low_address;
-    shdr.sh_offset = elf.sections_offset.text;
-    shdr.sh_size = elf.sections_size.text;
+    shdr.sh_addr = sections[n].address;
+    shdr.sh_offset = sections[n].offset;
+    shdr.sh_size = sections[n].size;
     shdr.sh_addralign = alignment;
     write_shdr(file, &shdr, &elf);
 
@@ -683,8 +820,8 @@ int write_elf(
   shdr.sh_type = 2;
   shdr.sh_offset = elf.sections_offset.symtab;
   shdr.sh_size = elf.sections_size.symtab;
-  shdr.sh_link = 4;
-  shdr.sh_info = symbol_count + strtab_extras;
+  shdr.sh_link = sections.count() + 3;
+  shdr.sh_info = local_count;
   shdr.sh_addralign = 4;
   shdr.sh_entsize = elf.e_ident[EI_CLASS] == 1 ? 16 : 24;
   write_shdr(file, &shdr, &elf);
@@ -734,10 +871,8 @@ int write_elf(
   file.write_int16(elf.e_shstrndx); // e_shstrndx (string_table index)
   file.set(marker);
 
-  // FIXME: naken_asm shouldn't be controlling the FILE *.
-  file.set_fp(NULL);
   file.close_file();
 
-  return 0;
+  return file.get_error() ? -1 : 0;
 }
 
@@ -15,111 +15,86 @@
 #include <stdint.h>
 
 #include "common/Memory.h"
+#include "fileio/HexBuffer.h"
 #include "fileio/write_hex.h"
 
 static void write_hex_line(
-  FILE *out,
+  HexBuffer &buffer,
   uint32_t address,
-  uint8_t *data,
+  const uint8_t *data,
   int len,
   uint32_t *segment)
 {
   int checksum;
   int n;
 
-#if 0
-  // This was using sections of type 2.. let's change to type 4 (linear)
-
-  if (address < (*segment) || address > (*segment + 0xffff))
-  {
-    *segment = address & 0xffff0;
-    checksum = 2 + (((*segment)>>12)&0xff) + (((*segment)>>4)&0xff) + 2;
-    fprintf(out, ":02000002%02X%02X%02X\n", ((*segment)>>12)&0xff, ((*segment)>>4)&0xff, (((checksum&0xff)^0xff)+1)&0xff);
-  }
-
-  address = address - (*segment);
-#endif
+  // Room for the linear address record and the data record.
+  buffer.reserve(64);
 
   // Check if we should change the linear address (upper 16 bits of a possible
   // 32 bit address.
   if ((address & 0xffff0000) != *segment)
   {
     *segment = address & 0xffff0000;
-//printf("address=%x segment=%x %02x %02x\n", address, *segment, (((*segment)>>24)&0xff),(((*segment)>>16)&0xff));
     checksum = 4 + (((*segment) >> 24) & 0xff) + (((*segment) >> 16) & 0xff) + 2;
 
-    fprintf(out, ":02000004%04X%02X\n",
-      ((*segment) >> 16) & 0xffff,
-      (((checksum & 0xff) ^ 0xff) + 1) & 0xff);
+    buffer.append_char(':');
+    buffer.append_hex24(0x020000);
+    buffer.append_hex8(0x04);
+    buffer.append_hex16(((*segment) >> 16) & 0xffff);
+    buffer.append_hex8(((checksum & 0xff) ^ 0xff) + 1);
+    buffer.append_char('\n');
   }
 
   address = address & 0xffff;
 
   // Ready to write data
-  fprintf(out, ":%02X%04X00", len, address);
+  buffer.append_char(':');
+  buffer.append_hex8(len);
+  buffer.append_hex16(address);
+  buffer.append_hex8(0x00);
   checksum = len + (address >> 8) + (address & 255);
 
   for (n = 0; n < len; n++)
   {
-    fprintf(out, "%02X", data[n]);
+    buffer.append_hex8(data[n]);
     checksum = checksum + data[n];
   }
 
-  fprintf(out,"%02X\n", (((checksum & 0xff) ^ 0xff) + 1) & 0xff);
+  buffer.append_hex8(((checksum & 0xff) ^ 0xff) + 1);
+  buffer.append_char('\n');
 }
 
-// NOTE: (to self) - This is kind of slowish.  I wonder if it would be
-// better to request pages from the memory module and just dump the memory
-// pages instead of treating it as one big memory thing.
+// Each run of used bytes is written 16 bytes to a line, starting a new
+// line at every 64k boundary so a line never needs two linear addresses.
 int write_hex(Memory *memory, FILE *out)
 {
+  HexBuffer buffer(out);
+  MemorySpan span;
   uint8_t data[16];
-  int len;
-  uint32_t n;
-  uint32_t address = 0,segment = 0;
+  uint32_t segment = 0;
 
-  len = -1;
-
-  for (n = memory->low_address; n <= memory->high_address; n++)
+  while (memory->next_span(&span) != -1)
   {
-    if (memory->read_debug(n) == DL_EMPTY)
-    {
-      if (len > 0)
-      {
-        write_hex_line(out, address, data, len, &segment);
-        len = -1;
-      }
-
-      continue;
-    }
+    uint32_t address = span.address;
+    uint32_t remaining = span.length;
 
-    if ((n & 0x0ffff) == 0 && len > 0)
+    while (remaining > 0)
     {
-      write_hex_line(out, address, data, len, &segment);
-      len = -1;
-    }
+      uint32_t len = 0x10000 - (address & 0xffff);
 
-    if (len == -1)
-    {
-      address = n;
-      len = 0;
-    }
+      if (len > sizeof(data)) { len = sizeof(data); }
+      if (len > remaining) { len = remaining; }
 
-    data[len++] = memory->read8(n);
+      memory->read_block(address, data, len);
+      write_hex_line(buffer, address, data, len, &segment);
 
-    if (len == 16)
-    {
-      write_hex_line(out, address, data, len, &segment);
-      len = -1;
+      address += len;
+      remaining -= len;
     }
   }
 
-  if (len > 0)
-  {
-    write_hex_line(out, address, data, len, &segment);
-  }
-
-  fputs(":00000001FF\n", out);
+  buffer.append_string(":00000001FF\n");
 
   return 0;
 }
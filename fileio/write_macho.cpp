@@ -287,10 +287,8 @@ int write_macho(
   //int string_table_length = file.tell() - markers.symbol_table;
   file.write_int32_at_offset(markers.symbol_table, markers.tables + 0);
 
-  // FIXME: naken_asm shouldn't be controlling the FILE *.
-  file.set_fp(NULL);
   file.close_file();
 
-  return 0;
+  return file.get_error() ? -1 : 0;
 }
 
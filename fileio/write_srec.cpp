@@ -17,15 +17,16 @@
 
 #include "common/Memory.h"
 #include "common/cpu_list.h"
+#include "fileio/HexBuffer.h"
 #include "fileio/write_srec.h"
 
 #define LINE_LENGTH 16
 
 static void write_srec_line(
-  FILE *out,
+  HexBuffer &buffer,
   int type,
   uint32_t address,
-  uint8_t *data,
+  const uint8_t *data,
   int len)
 {
   int checksum = 0;
@@ -48,10 +49,16 @@ static void write_srec_line(
     }
   }
 
+  buffer.reserve(16 + len * 2);
+
+  buffer.append_char('S');
+
   if (type <= 1)
   {
     address &= 0xffff;
-    fprintf(out, "S%c%02X%04X", '0' + type, len + 3, address);
+    buffer.append_char('0' + type);
+    buffer.append_hex8(len + 3);
+    buffer.append_hex16(address);
 
     checksum = (len + 3) + (address >> 8) + (address & 0xff);
   }
@@ -59,7 +66,9 @@ static void write_srec_line(
   if (type == 2)
   {
     address &= 0xffffff;
-    fprintf(out, "S%c%02X%06X", '0' + type, len + 4, address);
+    buffer.append_char('0' + type);
+    buffer.append_hex8(len + 4);
+    buffer.append_hex24(address);
 
     checksum = (len + 4) + (address >> 16) + ((address >> 24) & 0xff) +
       (address & 0xff);
@@ -67,7 +76,9 @@ static void write_srec_line(
     else
   if (type == 3)
   {
-    fprintf(out, "S%c%02X%08X", '0' + type, len + 5, address);
+    buffer.append_char('0' + type);
+    buffer.append_hex8(len + 5);
+    buffer.append_hex32(address);
 
     checksum = (len + 5) + (address >> 24) + ((address >> 16) & 0xff) +
       ((address >> 8) & 0xff) + (address & 0xff);
@@ -75,12 +86,13 @@ static void write_srec_line(
 
   for (n = 0; n < len; n++)
   {
-    fprintf(out, "%02X", data[n]);
+    buffer.append_hex8(data[n]);
 
     checksum += data[n];
   }
 
-  fprintf(out, "%02X\n", (((checksum & 0xff) ^ 0xff)));
+  buffer.append_hex8((checksum & 0xff) ^ 0xff);
+  buffer.append_char('\n');
 }
 
 // Encode an int so the hex value looks like the original int.
@@ -90,14 +102,15 @@ static uint8_t int_as_hex(int num)
   return ((((num / 10) << 4) + (num % 10)) & 0xff);
 }
 
-static void write_srec_header(FILE *out)
+static void write_srec_header(HexBuffer &buffer)
 {
   time_t timestamp_sec;
-  struct tm *timestamp;
+  struct tm timestamp_local;
+  struct tm *timestamp = &timestamp_local;
   uint8_t data[7];
 
   timestamp_sec= time(NULL);
-  timestamp = localtime(&timestamp_sec);
+  localtime_r(&timestamp_sec, timestamp);
 
   timestamp->tm_year += 1900;
 
@@ -109,15 +122,17 @@ static void write_srec_header(FILE *out)
   data[5] = int_as_hex(timestamp->tm_min);
   data[6] = int_as_hex(timestamp->tm_sec);
 
-  write_srec_line(out, 0, 0, data, 7);
+  write_srec_line(buffer, 0, 0, data, 7);
 }
 
+// Each run of used bytes is written LINE_LENGTH bytes to a line, starting
+// a new line at every 64k boundary.
 int write_srec(Memory *memory, FILE *out, int srec_size)
 {
+  HexBuffer buffer(out);
+  MemorySpan span;
   uint8_t data[LINE_LENGTH];
-  uint32_t address = 0;
-  uint32_t n;
-  int len, type;
+  int type;
 
   if (srec_size == SREC_24)
   {
@@ -133,57 +148,38 @@ int write_srec(Memory *memory, FILE *out, int srec_size)
     type = -1;
   }
 
-  write_srec_header(out);
+  write_srec_header(buffer);
 
-  len = -1;
-
-  for (n = memory->low_address; n <= memory->high_address; n++)
+  while (memory->next_span(&span) != -1)
   {
-    if (memory->read_debug(n) == DL_EMPTY)
-    {
-      if (len > 0)
-      {
-        write_srec_line(out, type, address, data, len);
-        len = -1;
-      }
+    uint32_t address = span.address;
+    uint32_t remaining = span.length;
 
-      continue;
-    }
-
-    if ((n & 0xffff) == 0 && len > 0)
+    while (remaining > 0)
     {
-      write_srec_line(out, type, address, data, len);
-      len = -1;
-    }
+      uint32_t len = 0x10000 - (address & 0xffff);
 
-    if (len == -1)
-    {
-      address = n;
-      len = 0;
-    }
+      if (len > LINE_LENGTH) { len = LINE_LENGTH; }
+      if (len > remaining) { len = remaining; }
 
-    data[len++] = memory->read8(n);
+      memory->read_block(address, data, len);
+      write_srec_line(buffer, type, address, data, len);
 
-    if (len == LINE_LENGTH)
-    {
-      write_srec_line(out, type, address, data, len);
-      len = -1;
+      address += len;
+      remaining -= len;
     }
   }
 
-  if (len > 0)
-  {
-    write_srec_line(out, type, address, data, len);
-  }
-
   if (memory->entry_point != 0xffffffff)
   {
     int checksum = 3 + ((memory->entry_point >> 8) & 0xff) +
                         (memory->entry_point & 0xff);
+    char line[32];
 
     checksum = (checksum & 0xff) ^ 0xff;
 
-    fprintf(out, "S903%04x%02x\n", memory->entry_point, checksum);
+    snprintf(line, sizeof(line), "S903%04x%02x\n", memory->entry_point, checksum);
+    buffer.append_string(line);
   }
 
   return 0;
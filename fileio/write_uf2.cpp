@@ -121,10 +121,8 @@ int write_uf2(Memory *memory, FILE *out)
     uf2_write_block_footer(file);
   }
 
-  // FIXME: naken_asm shouldn't be controlling the FILE *.
-  file.set_fp(NULL); 
   file.close_file();
 
-  return 0;
+  return file.get_error() ? -1 : 0;
 }
 
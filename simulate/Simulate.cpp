@@ -16,7 +16,7 @@
 
 #include "Simulate.h"
 
-bool Simulate::stop_running = false;
+Simulate *Simulate::signal_simulate = NULL;
 
 int Simulate::dump_ram(int start, int end)
 {
@@ -37,12 +37,13 @@ int Simulate::dump_ram(int start, int end)
 
 void Simulate::handle_signal(int sig)
 {
-  stop_running = true;
+  if (signal_simulate != NULL) { signal_simulate->stop_running = true; }
   signal(SIGINT, SIG_DFL);
 }
 
 void Simulate::enable_signal_handler()
 {
+  signal_simulate = this;
   signal(SIGINT, handle_signal);
 }
 
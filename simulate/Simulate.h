@@ -28,6 +28,7 @@ public:
     usec              (1000000),
     break_point       (0xffffffff),
     break_io          (0),
+    stop_running      (false),
     step_mode         (false),
     show              (true),
     auto_run          (true)
@@ -38,6 +39,7 @@ public:
   virtual ~Simulate()
   {
     disable_signal_handler();
+    if (signal_simulate == this) { signal_simulate = NULL; }
   }
 
   //static Simulate *init(Memory *memory);
@@ -87,8 +89,6 @@ public:
   }
 
 protected:
-  static bool stop_running;
-
   static void handle_signal(int sig);
   void enable_signal_handler();
   void disable_signal_handler();
@@ -100,9 +100,14 @@ protected:
   useconds_t usec;
   int break_point;
   int break_io;
+  volatile bool stop_running;
   bool step_mode : 1;
   bool show : 1;
   bool auto_run : 1;
+
+private:
+  // Ctrl-C stops whichever simulator last turned on the signal handler.
+  static Simulate *signal_simulate;
 };
 
 #endif
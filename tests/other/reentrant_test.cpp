@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef PTHREADS
+#include <pthread.h>
+#endif
+
+#include "common/assembler.h"
+
+#define THREADS 8
+#define LOOPS 50
+
+static const char *good_code =
+  ".riscv\n"
+  "start:\n"
+  "  addi x1, x2, 5\n"
+  "  beq x1, x2, done\n"
+  "  li x5, done\n"
+  "done:\n"
+  "  jal x1, start\n";
+
+static const char *bad_code =
+  ".riscv\n"
+  "start:\n"
+  "  addi x1, x2, 5\n"
+  "  blah x1, x2\n";
+
+struct Test
+{
+  const char *code;
+  int errors;
+};
+
+static int assemble_code(const char *code, char *messages, int length)
+{
+  AsmContext *asm_context = new AsmContext();
+  FILE *out = tmpfile();
+  int error_flag;
+
+  asm_context->messages = out;
+
+  tokens_open_buffer(asm_context, code);
+  asm_context->tokens.filename = "test.asm";
+  asm_context->init();
+
+  error_flag = assemble(asm_context);
+
+  if (error_flag == 0)
+  {
+    asm_context->symbols.lock();
+    asm_context->pass = 2;
+    asm_context->init();
+
+    error_flag = assemble(asm_context);
+  }
+
+  rewind(out);
+  length = fread(messages, 1, length - 1, out);
+  messages[length] = 0;
+  fclose(out);
+
+  delete asm_context;
+
+  return error_flag;
+}
+
+static void *run_test(void *arg)
+{
+  Test *test = (Test *)arg;
+  char messages[1024];
+
+  for (int n = 0; n < LOOPS; n++)
+  {
+    int error_flag = assemble_code(test->code, messages, sizeof(messages));
+
+    if (test->code == good_code)
+    {
+      if (error_flag != 0 || messages[0] != 0) { test->errors++; }
+    }
+      else
+    {
+      if (error_flag == 0 ||
+          strcmp(messages, "Error: Unknown instruction 'blah' at test.asm:4\n") != 0)
+      {
+        test->errors++;
+      }
+    }
+  }
+
+  return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+  Test tests[THREADS];
+  int errors = 0;
+  int n;
+
+  printf("Reentrant AsmContext ... ");
+
+  for (n = 0; n < THREADS; n++)
+  {
+    tests[n].code = (n & 1) == 0 ? good_code : bad_code;
+    tests[n].errors = 0;
+  }
+
+#ifdef PTHREADS
+  pthread_t ids[THREADS];
+
+  for (n = 0; n < THREADS; n++)
+  {
+    pthread_create(&ids[n], NULL, run_test, &tests[n]);
+  }
+
+  for (n = 0; n < THREADS; n++)
+  {
+    pthread_join(ids[n], NULL);
+  }
+#else
+  for (n = 0; n < THREADS; n++) { run_test(&tests[n]); }
+#endif
+
+  for (n = 0; n < THREADS; n++) { errors += tests[n].errors; }
+
+  if (errors != 0)
+  {
+    printf("FAILED (%d).\n", errors);
+    return -1;
+  }
+
+  printf("PASSED.\n");
+
+  return 0;
+}
@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "common/ExpressionCache.h"
+#include "test_checks.h"
+
+int test_find()
+{
+  int errors = 0;
+  ExpressionCache expression_cache;
+  const uint8_t code[] = { 1, 2, 3, 4 };
+  const uint8_t key[] = { 9, 9 };
+
+  expression_cache.add(1, 10, 5, 0, 0, NULL, 0, code, sizeof(code));
+  expression_cache.add(1, 20, 3, 1, 0, key, sizeof(key), code, 2);
+
+  const ExpressionCacheEntry *entry = expression_cache.find(1, 10, NULL, 0);
+  TEST_BOOL((entry != NULL), true);
+
+  if (entry != NULL)
+  {
+    TEST_INT(entry->consumed, 5);
+    TEST_INT(entry->length, 4);
+    TEST_INT(memcmp(entry->get_code(), code, 4), 0);
+  }
+
+  // The key has to match.
+  TEST_PTR(expression_cache.find(1, 20, NULL, 0),
+    (const ExpressionCacheEntry *)NULL);
+
+  entry = expression_cache.find(1, 20, key, sizeof(key));
+  TEST_BOOL((entry != NULL), true);
+  if (entry != NULL) { TEST_INT(entry->lines, 1); }
+
+  // Another source or offset isn't found.
+  TEST_PTR(expression_cache.find(2, 10, NULL, 0),
+    (const ExpressionCacheEntry *)NULL);
+  TEST_PTR(expression_cache.find(1, 11, NULL, 0),
+    (const ExpressionCacheEntry *)NULL);
+
+  TEST_INT(expression_cache.get_count(), 2);
+  TEST_INT(expression_cache.get_hits(), 2);
+
+  expression_cache.reset();
+  TEST_PTR(expression_cache.find(1, 10, NULL, 0),
+    (const ExpressionCacheEntry *)NULL);
+  TEST_INT(expression_cache.get_count(), 0);
+
+  return errors;
+}
+
+int test_grow()
+{
+  int errors = 0;
+  ExpressionCache expression_cache;
+  const uint8_t code[] = { 1 };
+
+  for (int n = 0; n < 20000; n++)
+  {
+    expression_cache.add(n & 3, n * 4, 2, 0, 0, NULL, 0, code, 1);
+  }
+
+  int found = 0;
+
+  for (int n = 19999; n >= 0; n--)
+  {
+    if (expression_cache.find(n & 3, n * 4, NULL, 0) != NULL) { found++; }
+  }
+
+  TEST_INT(found, 20000);
+
+  return errors;
+}
+
+int main(int argc, char *argv[])
+{
+  int errors = 0;
+
+  printf("Testing ExpressionCache.h\n");
+
+  errors += test_find();
+  errors += test_grow();
+
+  if (errors != 0) { printf("ExpressionCache.h ... FAILED.\n"); return -1; }
+
+  printf("ExpressionCache.h ... PASSED.\n");
+
+  return 0;
+}
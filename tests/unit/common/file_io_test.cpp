@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "fileio/FileIo.h"
+#include "test_checks.h"
+
+int test_endian()
+{
+  int errors = 0;
+  uint8_t data[32];
+
+  FileIo file;
+
+  file.open_for_writing(data, sizeof(data));
+  file.write_int16(0x1234);
+  file.write_int32(0x12345678);
+  file.set_endian(FileIo::FILE_ENDIAN_BIG);
+  file.write_int16(0x1234);
+  file.write_int32(0x12345678);
+  file.write_int64(0x0102030405060708ULL);
+
+  TEST_INT((int)file.tell(), 20);
+  TEST_INT(file.get_file_length(), 20);
+  TEST_INT(data[0], 0x34);
+  TEST_INT(data[2], 0x78);
+  TEST_INT(data[5], 0x12);
+  TEST_INT(data[6], 0x12);
+  TEST_INT(data[8], 0x12);
+  TEST_INT(data[12], 0x01);
+  TEST_INT(data[19], 0x08);
+
+  file.close_file();
+
+  file.open_for_reading(data, 20);
+  file.set_endian(FileIo::FILE_ENDIAN_LITTLE);
+  TEST_INT(file.get_int16(), 0x1234u);
+  TEST_INT(file.get_int32(), 0x12345678u);
+  file.set_endian(FileIo::FILE_ENDIAN_BIG);
+  TEST_INT(file.get_int16(), 0x1234u);
+  TEST_INT(file.get_int32(), 0x12345678u);
+  TEST_BOOL((file.get_int64() == 0x0102030405060708ULL), true);
+  TEST_INT(file.get_int8(), EOF);
+  TEST_INT(file.get_int32(), 0xffffffffu);
+  file.close_file();
+
+  return errors;
+}
+
+int test_offsets()
+{
+  int errors = 0;
+  uint8_t data[16];
+  char text[8];
+
+  FileIo file;
+
+  file.open_for_writing(data, sizeof(data));
+  file.write_int32(0);
+  file.write_string("abc");
+  file.write_int32_at_offset(0xaabbccdd, 0);
+  TEST_INT((int)file.tell(), 8);
+  TEST_INT(data[0], 0xdd);
+  TEST_INT(data[3], 0xaa);
+
+  // Skipping past the end fills the gap with 0.
+  file.skip(2);
+  file.write_int8(0x55);
+  TEST_INT(file.get_file_length(), 11);
+  TEST_INT(data[8], 0);
+  TEST_INT(data[9], 0);
+  TEST_INT(data[10], 0x55);
+
+  file.get_string_at_offset(text, sizeof(text), 4);
+  TEST_TEXT(text, "abc");
+  TEST_INT((int)file.tell(), 11);
+
+  file.align(8);
+  TEST_INT(file.get_file_length(), 16);
+  TEST_BOOL(file.get_error(), false);
+
+  // The caller's buffer can't grow.
+  file.write_int8(0);
+  TEST_BOOL(file.get_error(), true);
+  TEST_INT(file.get_file_length(), 16);
+
+  file.close_file();
+
+  return errors;
+}
+
+int test_file()
+{
+  int errors = 0;
+  const char *filename = "file_io_test.bin";
+  uint8_t data[4];
+
+  FileIo file;
+
+  TEST_INT(file.open_for_writing(filename), 0);
+
+  // Bigger than the first buffer so it has to grow.
+  for (int n = 0; n < 40000; n++) { file.write_int32(n); }
+
+  file.write_int32_at_offset(0x11223344, 4);
+  file.close_file();
+  TEST_BOOL(file.get_error(), false);
+
+  TEST_INT(file.open_for_reading(filename), 0);
+  TEST_INT(file.get_file_length(), 160000);
+  TEST_INT(file.get_int32(), 0u);
+  TEST_INT(file.get_int32(), 0x11223344u);
+  file.set(39999 * 4);
+  TEST_INT(file.get_int32(), 39999u);
+  TEST_INT(file.get_bytes_at_offset(data, 4, 8), 0);
+  TEST_INT(data[0], 2);
+  TEST_INT(file.get_bytes_at_offset(data, 4, 159998), 1);
+
+  // A file opened for reading can't be written to.
+  file.set(0);
+  file.write_int32(0xffffffff);
+  TEST_BOOL(file.get_error(), true);
+  TEST_INT(file.get_file_length(), 160000);
+  TEST_INT(file.get_buffer()[0], 0);
+  TEST_INT(file.get_buffer()[4], 0x44);
+  file.close_file();
+
+  unlink(filename);
+
+  TEST_INT(file.open_for_reading(filename), -1);
+
+  return errors;
+}
+
+int main(int argc, char *argv[])
+{
+  int errors = 0;
+
+  printf("Testing FileIo.h\n");
+
+  errors += test_endian();
+  errors += test_offsets();
+  errors += test_file();
+
+  if (errors != 0) { printf("FileIo.h ... FAILED.\n"); return -1; }
+
+  printf("FileIo.h ... PASSED.\n");
+
+  return 0;
+}
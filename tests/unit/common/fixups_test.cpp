@@ -0,0 +1,191 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "common/Fixups.h"
+#include "test_checks.h"
+
+static int record_statement(
+  Fixups &fixups,
+  uint32_t address,
+  const char *filename,
+  const char *instr,
+  const char *label)
+{
+  Fixup fixup;
+
+  memset(&fixup, 0, sizeof(fixup));
+  fixup.address = address;
+
+  int mark = fixups.begin(fixup, filename);
+
+  fixups.record(6, instr, strlen(instr), false, 0);
+  fixups.record(6, label, strlen(label), false, 0);
+  fixups.record(1, "100", 3, true, 100);
+
+  return mark;
+}
+
+int test_keep()
+{
+  int errors = 0;
+  Fixups fixups;
+
+  int mark = record_statement(fixups, 0x100, "test.asm", "jal", "later");
+  TEST_BOOL(fixups.is_recording(), true);
+  TEST_BOOL(fixups.is_current(mark), true);
+  TEST_INT(fixups.end(mark, true, FIXUP_INSTRUCTION, 0x104), 0);
+  TEST_BOOL(fixups.is_recording(), false);
+
+  // Statements that didn't use an undefined label are thrown away.
+  mark = record_statement(fixups, 0x104, "test.asm", "add", "start");
+  TEST_INT(fixups.end(mark, false, FIXUP_INSTRUCTION, 0x108), 0);
+
+  mark = record_statement(fixups, 0x108, "other.asm", "beq", "done");
+  TEST_INT(fixups.end(mark, true, FIXUP_INSTRUCTION, 0x10c), 0);
+
+  TEST_INT(fixups.count(), 2);
+
+  const Fixup *fixup = fixups.get(0);
+  TEST_INT(fixup->address, 0x100);
+  TEST_INT(fixup->end_address, 0x104);
+  TEST_INT(fixup->kind, FIXUP_INSTRUCTION);
+  TEST_TEXT(Fixups::get_filename(fixup), "test.asm");
+
+  const char *expected[] = { "jal", "later", "100" };
+  const int expected_type[] = { 6, 6, 1 };
+  const bool expected_value[] = { false, false, true };
+  const uint8_t *ptr = Fixups::get_tokens(fixup);
+  const uint8_t *end = (const uint8_t *)fixup + fixup->size;
+  const FixupToken *token;
+  int count = 0;
+
+  while ((token = Fixups::next_token(ptr, end)) != NULL)
+  {
+    TEST_TEXT(token->text, expected[count]);
+    TEST_INT(token->type, expected_type[count]);
+    TEST_BOOL(token->has_value, expected_value[count]);
+    count++;
+  }
+
+  TEST_INT(count, 3);
+
+  fixup = fixups.get(fixup->size);
+  TEST_INT(fixup->address, 0x108);
+  TEST_TEXT(Fixups::get_filename(fixup), "other.asm");
+
+  ptr = Fixups::get_tokens(fixup);
+  end = (const uint8_t *)fixup + fixup->size;
+  token = Fixups::next_token(ptr, end);
+  TEST_INT(token->length, 3);
+
+  TEST_PTR(fixups.get(fixups.get(0)->size + fixup->size), (const Fixup *)NULL);
+
+  return errors;
+}
+
+int test_nested()
+{
+  int errors = 0;
+  Fixups fixups;
+
+  // A statement started inside another one (an .include for example)
+  // takes the outer statement's place so the outer one can't be kept.
+  int outer = record_statement(fixups, 0, "test.asm", "include", "x");
+  int inner = record_statement(fixups, 0, "x.asm", "jal", "later");
+
+  TEST_INT(inner, outer);
+  TEST_INT(fixups.end(inner, true, FIXUP_INSTRUCTION, 4), 0);
+  TEST_INT(fixups.end(outer, true, FIXUP_DIRECTIVE, 4), -1);
+  TEST_INT(fixups.end(outer, false, FIXUP_DIRECTIVE, 4), 0);
+
+  TEST_INT(fixups.count(), 1);
+  TEST_TEXT(Fixups::get_filename(fixups.get(0)), "x.asm");
+
+  fixups.reset();
+
+  TEST_INT(fixups.count(), 0);
+  TEST_PTR(fixups.get(0), (const Fixup *)NULL);
+
+  return errors;
+}
+
+int test_grow()
+{
+  int errors = 0;
+  Fixups fixups;
+  char label[32];
+
+  for (int n = 0; n < 10000; n++)
+  {
+    snprintf(label, sizeof(label), "label_%d", n);
+
+    int mark = record_statement(fixups, n * 4, "test.asm", "jal", label);
+    fixups.end(mark, true, FIXUP_INSTRUCTION, n * 4 + 4);
+  }
+
+  TEST_INT(fixups.count(), 10000);
+
+  const Fixup *fixup;
+  int offset = 0;
+  int count = 0;
+
+  while ((fixup = fixups.get(offset)) != NULL)
+  {
+    const uint8_t *ptr = Fixups::get_tokens(fixup);
+    const uint8_t *end = (const uint8_t *)fixup + fixup->size;
+
+    Fixups::next_token(ptr, end);
+    const FixupToken *token = Fixups::next_token(ptr, end);
+
+    snprintf(label, sizeof(label), "label_%d", count);
+    TEST_TEXT(token->text, label);
+    TEST_INT((int)fixup->address, count * 4);
+
+    offset += fixup->size;
+    count++;
+  }
+
+  TEST_INT(count, 10000);
+
+  return errors;
+}
+
+int test_undefined()
+{
+  int errors = 0;
+  Fixups fixups;
+
+  fixups.add_undefined("DEBUG");
+  fixups.add_undefined("TEST");
+  fixups.add_undefined("DEBUG");
+
+  TEST_INT(fixups.undefined.find("DEBUG"), 0);
+  TEST_INT(fixups.undefined.find("TEST"), 1);
+  TEST_INT(fixups.undefined.find("OTHER"), -1);
+
+  fixups.reset();
+
+  TEST_INT(fixups.undefined.find("DEBUG"), -1);
+
+  return errors;
+}
+
+int main(int argc, char *argv[])
+{
+  int errors = 0;
+
+  printf("Testing Fixups.h\n");
+
+  errors += test_keep();
+  errors += test_nested();
+  errors += test_grow();
+  errors += test_undefined();
+
+  if (errors != 0) { printf("Fixups.h ... FAILED.\n"); return -1; }
+
+  printf("Fixups.h ... PASSED.\n");
+
+  return 0;
+}
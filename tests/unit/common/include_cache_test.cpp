@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "common/IncludeCache.h"
+#include "test_checks.h"
+
+static const char *cache_dir = "include_cache_test.dir";
+
+static int check_recording(const uint8_t *data, int length)
+{
+  int errors = 0;
+  const char *name;
+  const char *value;
+  int param_count;
+  int ptr = 0;
+
+  TEST_INT(IncludeCache::get_macro(data, length, &ptr, &name, &value, &param_count), 0);
+  TEST_TEXT(name, "P1DIR");
+  TEST_TEXT(value, "0x0022");
+  TEST_INT(param_count, 0);
+
+  TEST_INT(IncludeCache::get_macro(data, length, &ptr, &name, &value, &param_count), 0);
+  TEST_TEXT(name, "BIT");
+  TEST_TEXT(value, "(1 << a)");
+  TEST_INT(param_count, 1);
+
+  TEST_INT(ptr, length);
+  TEST_INT(IncludeCache::get_macro(data, length, &ptr, &name, &value, &param_count), -1);
+
+  // A recording that's cut short is bad.
+  ptr = 0;
+  TEST_INT(IncludeCache::get_macro(data, 8, &ptr, &name, &value, &param_count), -1);
+
+  return errors;
+}
+
+int test_record()
+{
+  int errors = 0;
+  IncludeCache include_cache;
+  const uint8_t *data;
+  int length;
+  Hash128 key;
+  Hash128 other;
+
+  key.update("P1DIR equ 0x0022\n");
+  other.update("main:\n");
+
+  TEST_INT(include_cache.find(key, NULL, &data, &length), -1);
+
+  include_cache.begin();
+  TEST_BOOL(include_cache.is_recording(), true);
+  include_cache.record("P1DIR", "0x0022", 0);
+  include_cache.record("BIT", "(1 << a)", 1);
+  include_cache.end(key, cache_dir, true);
+  TEST_BOOL(include_cache.is_recording(), false);
+
+  TEST_INT(include_cache.find(key, NULL, &data, &length), 0);
+  errors += check_recording(data, length);
+
+  // A file that does more than define macros is remembered as one that
+  // can't be cached.
+  include_cache.begin();
+  include_cache.record("X", "1", 0);
+  include_cache.not_cacheable();
+  include_cache.end(other, cache_dir, true);
+
+  TEST_INT(include_cache.find(other, NULL, &data, &length), 1);
+
+  TEST_INT(include_cache.get_hits(), 1);
+  TEST_INT(include_cache.get_misses(), 1);
+
+  // A new run finds the recording in the cache directory.
+  include_cache.reset();
+  TEST_INT(include_cache.find(key, NULL, &data, &length), -1);
+  TEST_INT(include_cache.find(key, cache_dir, &data, &length), 0);
+  errors += check_recording(data, length);
+  TEST_INT(include_cache.find(other, cache_dir, &data, &length), -1);
+
+  system("rm -rf include_cache_test.dir");
+
+  return errors;
+}
+
+int main(int argc, char *argv[])
+{
+  int errors = 0;
+
+  printf("Testing IncludeCache.h\n");
+
+  errors += test_record();
+
+  if (errors != 0) { printf("IncludeCache.h ... FAILED.\n"); return -1; }
+
+  printf("IncludeCache.h ... PASSED.\n");
+
+  return 0;
+}
@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "common/assembler.h"
+#include "common/InstructionCache.h"
+#include "test_checks.h"
+
+static void record_add(
+  InstructionCache &instruction_cache,
+  int cpu_list_index,
+  const char *instr,
+  int64_t value)
+{
+  InstructionCacheMode mode;
+
+  memset(&mode, 0, sizeof(mode));
+  mode.cpu_list_index = cpu_list_index;
+
+  instruction_cache.begin(mode, instr);
+  instruction_cache.record(TOKEN_STRING, "r1", 2, false, 0);
+  instruction_cache.record(TOKEN_NUMBER, "5", 1, true, value);
+  instruction_cache.record(TOKEN_EOL, "", 0, false, 0);
+}
+
+int test_find()
+{
+  int errors = 0;
+  InstructionCache instruction_cache;
+  const uint8_t bytes[] = { 0x13, 0x01, 0x50, 0x00 };
+
+  record_add(instruction_cache, 1, "addi", 5);
+  TEST_PTR(instruction_cache.find(), (InstructionCacheEntry *)NULL);
+  instruction_cache.add(0x1000, bytes, sizeof(bytes), 4);
+
+  record_add(instruction_cache, 1, "addi", 5);
+  InstructionCacheEntry *entry = instruction_cache.find();
+  TEST_BOOL((entry != NULL), true);
+
+  if (entry != NULL)
+  {
+    TEST_INT(entry->state, INSTRUCTION_CACHE_NEW);
+    TEST_INT(entry->address, 0x1000);
+    TEST_INT(entry->length, 4);
+    TEST_INT(entry->ret, 4);
+    TEST_INT(memcmp(entry->get_bytes(), bytes, 4), 0);
+  }
+
+  // Another value, instruction or CPU isn't the same key.
+  record_add(instruction_cache, 1, "addi", 6);
+  TEST_PTR(instruction_cache.find(), (InstructionCacheEntry *)NULL);
+  record_add(instruction_cache, 1, "ori", 5);
+  TEST_PTR(instruction_cache.find(), (InstructionCacheEntry *)NULL);
+  record_add(instruction_cache, 2, "addi", 5);
+  TEST_PTR(instruction_cache.find(), (InstructionCacheEntry *)NULL);
+
+  // The operands start after the instruction name.
+  record_add(instruction_cache, 1, "addi", 5);
+  TEST_BOOL((instruction_cache.get_tokens() < instruction_cache.get_end()),
+    true);
+
+  instruction_cache.clear();
+  record_add(instruction_cache, 1, "addi", 5);
+  TEST_PTR(instruction_cache.find(), (InstructionCacheEntry *)NULL);
+
+  return errors;
+}
+
+int test_grow()
+{
+  int errors = 0;
+  InstructionCache instruction_cache;
+  const uint8_t bytes[] = { 1, 2, 3, 4 };
+
+  for (int n = 0; n < 20000; n++)
+  {
+    record_add(instruction_cache, 1, "addi", n);
+    instruction_cache.find();
+    instruction_cache.add(n * 4, bytes, sizeof(bytes), 4);
+  }
+
+  int found = 0;
+
+  for (int n = 19999; n >= 0; n--)
+  {
+    record_add(instruction_cache, 1, "addi", n);
+    InstructionCacheEntry *entry = instruction_cache.find();
+    if (entry != NULL && entry->address == (uint32_t)n * 4) { found++; }
+  }
+
+  TEST_INT(found, 20000);
+
+  // Too long to keep.
+  uint8_t big[INSTRUCTION_CACHE_MAX_BYTES + 1];
+  memset(big, 0, sizeof(big));
+
+  record_add(instruction_cache, 3, "nop", 0);
+  instruction_cache.find();
+  instruction_cache.add(0, big, sizeof(big), 4);
+  TEST_PTR(instruction_cache.find(), (InstructionCacheEntry *)NULL);
+
+  return errors;
+}
+
+int main(int argc, char *argv[])
+{
+  int errors = 0;
+
+  printf("Testing InstructionCache.h\n");
+
+  errors += test_find();
+  errors += test_grow();
+
+  if (errors != 0) { printf("InstructionCache.h ... FAILED.\n"); return -1; }
+
+  printf("InstructionCache.h ... PASSED.\n");
+
+  return 0;
+}
@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "common/output_cache.h"
+#include "test_checks.h"
+
+static const char *cache_dir = "output_cache_test.dir";
+
+static void write_file(const char *filename, const char *text)
+{
+  FILE *out = fopen(filename, "wb");
+  fputs(text, out);
+  fclose(out);
+}
+
+static int compare_file(const char *filename, const char *text)
+{
+  char buffer[256];
+  FILE *in = fopen(filename, "rb");
+
+  if (in == NULL) { return -1; }
+
+  int length = fread(buffer, 1, sizeof(buffer) - 1, in);
+  buffer[length] = 0;
+  fclose(in);
+
+  return strcmp(buffer, text);
+}
+
+int test_store()
+{
+  int errors = 0;
+  StringHeap dependencies;
+  StringHeap found;
+  Hash128 key;
+
+  key.update("main.asm");
+  key.update(1);
+
+  write_file("output_cache_test.inc", ".define VALUE 1\n");
+  write_file("output_cache_test.hex", ":00000001FF\n");
+  dependencies.append("output_cache_test.inc");
+
+  FILE *messages = tmpfile();
+  fprintf(messages, "Pass 1...\n");
+
+  FILE *replay = tmpfile();
+
+  TEST_INT(output_cache_lookup(cache_dir, key, "output_cache_test.out", replay, &found), -1);
+  TEST_INT(output_cache_store(cache_dir, key, "output_cache_test.hex", messages, &dependencies), 0);
+
+  TEST_INT(output_cache_lookup(cache_dir, key, "output_cache_test.out", replay, &found), 0);
+  TEST_INT(compare_file("output_cache_test.out", ":00000001FF\n"), 0);
+  TEST_INT((int)ftell(replay), 10);
+  TEST_INT(found.count(), 1);
+  TEST_INT(found.find("output_cache_test.inc"), 0);
+
+  // A different key or a changed include is a miss.
+  Hash128 other;
+  other.update("other.asm");
+  TEST_INT(output_cache_lookup(cache_dir, other, "output_cache_test.out", replay, &found), -1);
+
+  write_file("output_cache_test.inc", ".define VALUE 2\n");
+  TEST_INT(output_cache_lookup(cache_dir, key, "output_cache_test.out", replay, &found), -1);
+
+  // Changing it back finds the first output again.
+  write_file("output_cache_test.inc", ".define VALUE 1\n");
+  TEST_INT(output_cache_lookup(cache_dir, key, "output_cache_test.out", replay, &found), 0);
+
+  fclose(messages);
+  fclose(replay);
+
+  unlink("output_cache_test.inc");
+  unlink("output_cache_test.hex");
+  unlink("output_cache_test.out");
+  system("rm -rf output_cache_test.dir");
+
+  return errors;
+}
+
+int main(int argc, char *argv[])
+{
+  int errors = 0;
+
+  printf("Testing output_cache.h\n");
+
+  errors += test_store();
+
+  if (errors != 0) { printf("output_cache.h ... FAILED.\n"); return -1; }
+
+  printf("output_cache.h ... PASSED.\n");
+
+  return 0;
+}
+
@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "common/TableIndex.h"
+#include "test_checks.h"
+
+struct TestInstr
+{
+  const char *instr;
+  int opcode;
+};
+
+static TestInstr table[] =
+{
+  { "add",  0 },
+  { "sub",  1 },
+  { "add",  2 },
+  { "mov",  3 },
+  { "add",  4 },
+  { "nop",  5 },
+  { NULL,   0 }
+};
+
+int test_find()
+{
+  int errors = 0;
+
+  TableIndex index;
+
+  TEST_INT(index.find(table, &TestInstr::instr, "sub"), 1);
+  TEST_INT(index.find(table, &TestInstr::instr, "mov"), 3);
+  TEST_INT(index.find(table, &TestInstr::instr, "nop"), 5);
+  TEST_INT(index.find(table, &TestInstr::instr, "xor"), -1);
+  TEST_INT(index.find(table, &TestInstr::instr, ""), -1);
+  TEST_INT(index.find(table, &TestInstr::instr, "ADD"), -1);
+
+  return errors;
+}
+
+int test_duplicates()
+{
+  int errors = 0;
+  int count = 0;
+  int n;
+
+  TableIndex index;
+
+  // Rows with the same name come back in table order.
+  for (n = index.find(table, &TestInstr::instr, "add");
+       n != -1;
+       n = index.next(n))
+  {
+    TEST_INT(table[n].opcode, count * 2);
+    count++;
+  }
+
+  TEST_INT(count, 3);
+
+  n = index.find(table, &TestInstr::instr, "sub");
+  TEST_INT(index.next(n), -1);
+
+  return errors;
+}
+
+int test_large()
+{
+  int errors = 0;
+  char names[1000][8];
+  TestInstr *big = (TestInstr *)malloc(sizeof(TestInstr) * 1001);
+
+  for (int n = 0; n < 1000; n++)
+  {
+    snprintf(names[n], sizeof(names[n]), "i%d", n);
+    big[n].instr = names[n];
+    big[n].opcode = n;
+  }
+
+  big[1000].instr = NULL;
+
+  TableIndex index;
+
+  for (int n = 0; n < 1000; n++)
+  {
+    TEST_INT(index.find(big, &TestInstr::instr, names[n]), n);
+  }
+
+  TEST_INT(index.find(big, &TestInstr::instr, "i1000"), -1);
+
+  free(big);
+
+  return errors;
+}
+
+int main(int argc, char *argv[])
+{
+  int errors = 0;
+
+  printf("Testing TableIndex.h\n");
+
+  errors += test_find();
+  errors += test_duplicates();
+  errors += test_large();
+
+  if (errors != 0) { printf("TableIndex.h ... FAILED.\n"); return -1; }
+
+  printf("TableIndex.h ... PASSED.\n");
+
+  return 0;
+}
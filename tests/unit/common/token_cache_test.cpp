@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "common/TokenCache.h"
+#include "test_checks.h"
+
+static const char *filename = "token_cache_test.asm";
+
+static void write_file(const char *text)
+{
+  FILE *out = fopen(filename, "wb");
+  fputs(text, out);
+  fclose(out);
+}
+
+static void record_tokens(TokenCache &token_cache, int source)
+{
+  token_cache.record(source, 0, 4, 0, 1, 0, "addi", 4);
+  token_cache.record(source, 5, 2, 0, 1, 0, "x1", 2);
+}
+
+int test_refresh()
+{
+  int errors = 0;
+  TokenCache token_cache;
+  TokenCacheCursor cursor = { NULL, 0 };
+
+  write_file("addi x1\r\n");
+
+  int source = token_cache.open(filename);
+  TEST_INT(source, 1);
+  TEST_TEXT(token_cache.get_code(source), "addi x1\n");
+  TEST_BOOL(token_cache.is_warm(source), false);
+
+  record_tokens(token_cache, source);
+
+  // Nothing changed so the tokens are kept.
+  token_cache.refresh();
+  TEST_BOOL(token_cache.is_warm(source), true);
+  TEST_INT(token_cache.get_file_reads(), 0);
+  TEST_INT(token_cache.open(filename), source);
+  TEST_INT(token_cache.get_file_hits(), 1);
+
+  const TokenCacheEntry *entry = token_cache.find(source, cursor, 5);
+  TEST_BOOL((entry != NULL), true);
+  if (entry != NULL) { TEST_TEXT(entry->text, "x1"); }
+
+  // The file changed so it's read again and the tokens are gone.
+  write_file("addi x2\n");
+  token_cache.refresh();
+  TEST_BOOL(token_cache.is_warm(source), false);
+  TEST_TEXT(token_cache.get_code(source), "addi x2\n");
+
+  cursor.memory_pool = NULL;
+  cursor.ptr = 0;
+  TEST_PTR(token_cache.find(source, cursor, 0), (const TokenCacheEntry *)NULL);
+
+  // A file that was missing can show up later.
+  unlink(filename);
+  token_cache.refresh();
+  TEST_INT(token_cache.open(filename), 0);
+
+  write_file("nop\n");
+  token_cache.refresh();
+  TEST_INT(token_cache.open(filename), source);
+  TEST_TEXT(token_cache.get_code(source), "nop\n");
+
+  unlink(filename);
+
+  return errors;
+}
+
+int main(int argc, char *argv[])
+{
+  int errors = 0;
+
+  printf("Testing TokenCache.h\n");
+
+  errors += test_refresh();
+
+  if (errors != 0) { printf("TokenCache.h ... FAILED.\n"); return -1; }
+
+  printf("TokenCache.h ... PASSED.\n");
+
+  return 0;
+}
+
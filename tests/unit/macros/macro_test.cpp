@@ -151,6 +151,108 @@ void test_define(const char *macro, uint8_t answer)
   tokens_close(&asm_context);
 }
 
+void test_many_defines()
+{
+  AsmContext asm_context;
+  char name[32];
+  char value[32];
+  int param_count;
+  int n;
+
+  printf("Testing: many defines ... ");
+
+  // Enough defines to span several MemoryPool's and grow the hash index.
+  for (n = 0; n < 10000; n++)
+  {
+    snprintf(name, sizeof(name), "DEFINE_%d", n);
+    snprintf(value, sizeof(value), "%d ", n * 3);
+
+    if (macros_append(&asm_context, name, value, 0) != 0)
+    {
+      printf("FAIL append %s\n", name);
+      errors++;
+      return;
+    }
+  }
+
+  if (macros_append(&asm_context, (char *)"DEFINE_77", (char *)"1 ", 0) != -1)
+  {
+    printf("FAIL duplicate not detected\n");
+    errors++;
+    return;
+  }
+
+  for (n = 0; n < 10000; n += 37)
+  {
+    snprintf(name, sizeof(name), "DEFINE_%d", n);
+    snprintf(value, sizeof(value), "%d ", n * 3);
+
+    char *define = macros_lookup(&asm_context.macros, name, &param_count);
+
+    if (define == NULL || strcmp(define, value) != 0 || param_count != 0)
+    {
+      printf("FAIL lookup %s\n", name);
+      errors++;
+      return;
+    }
+  }
+
+  if (macros_lookup(&asm_context.macros, (char *)"DEFINE_", &param_count) != NULL)
+  {
+    printf("FAIL lookup of missing define\n");
+    errors++;
+    return;
+  }
+
+  // Iteration order is the order the defines were added.
+  MacrosIter iter(asm_context.macros);
+  n = 0;
+
+  while (iter.next() != -1)
+  {
+    snprintf(name, sizeof(name), "DEFINE_%d", n);
+
+    if (strcmp(iter.name, name) != 0)
+    {
+      printf("FAIL iterate %s != %s\n", iter.name, name);
+      errors++;
+      return;
+    }
+
+    n++;
+  }
+
+  if (n != 10000)
+  {
+    printf("FAIL iterate count %d\n", n);
+    errors++;
+    return;
+  }
+
+  printf("PASS\n");
+}
+
+void test_long_define()
+{
+  // Both the macro and the param are longer than the 1024 bytes the
+  // parser used to allow.
+  char *code = (char *)malloc(8192);
+  int ptr = 0;
+
+  ptr += sprintf(code + ptr, ".define sum(a) (a");
+  for (int n = 0; n < 400; n++) { ptr += sprintf(code + ptr, " + 0"); }
+  ptr += sprintf(code + ptr, ")\n.define twice(a) (sum(a) + sum(a))\n");
+
+  ptr += sprintf(code + ptr, ".db twice(0");
+  for (int n = 0; n < 150; n++) { ptr += sprintf(code + ptr, " + 1"); }
+  for (int n = 0; n < 100; n++) { ptr += sprintf(code + ptr, " - 1"); }
+  ptr += sprintf(code + ptr, ")\n");
+
+  test_define(code, 100);
+
+  free(code);
+}
+
 int main(int argc, char *argv[])
 {
   printf("macros.o test\n");
@@ -206,6 +308,9 @@ int main(int argc, char *argv[])
   test_define(".define blah\n.ifdef blah\n.define value 6\n.else\n.define value 5\n.endif\n.db value\n", 6);
   test_define(".ifdef blah\n.define value 6\n.else\n.define value 5\n.endif\n.db value\n", 5);
 
+  test_long_define();
+  test_many_defines();
+
   printf("Total errors: %d\n", errors);
   printf("%s\n", errors == 0 ? "PASSED." : "FAILED.");
 
@@ -51,6 +51,170 @@ int test_Memory()
   return errors;
 }
 
+int test_Memory_pages()
+{
+  Memory memory;
+  int errors = 0;
+
+  memory.endian = ENDIAN_LITTLE;
+
+  // Top of the address space and a value that straddles two pages.
+  memory.write32(0xfffffffc, 0xaabbccdd);
+  memory.write32(PAGE_SIZE - 2, 0x11223344);
+
+  if (memory.read32(0xfffffffc) != 0xaabbccdd) { errors++; }
+  if (memory.read8(0xffffffff) != 0xaa) { errors++; }
+  if (memory.read32(PAGE_SIZE - 2) != 0x11223344) { errors++; }
+  if (memory.read16(PAGE_SIZE - 1) != 0x2233) { errors++; }
+  if (memory.read8(PAGE_SIZE) != 0x22) { errors++; }
+
+  if (!memory.in_use(PAGE_SIZE * 2 - 1)) { errors++; }
+  if (memory.in_use(PAGE_SIZE * 2)) { errors++; }
+  if (memory.read32(0x80000000) != 0) { errors++; }
+
+  if (memory.low_address != PAGE_SIZE - 2) { errors++; }
+  if (memory.high_address != 0xffffffff) { errors++; }
+
+  if (memory.get_page_address_min(PAGE_SIZE + 5) != PAGE_SIZE) { errors++; }
+  if (memory.get_page_address_max(PAGE_SIZE + 5) != PAGE_SIZE + 1) { errors++; }
+  if (memory.get_page_address_min(0) != PAGE_SIZE - 2) { errors++; }
+
+  if (errors != 0)
+  {
+    fprintf(stderr, "Error: test_Memory_pages() %s:%d\n", __FILE__, __LINE__);
+  }
+
+  return errors;
+}
+
+int test_Memory_debug()
+{
+  Memory memory;
+  int expected[4096];
+  int errors = 0;
+  int n;
+
+  memory.keep_debug_lines();
+
+  for (n = 0; n < 4096; n++) { expected[n] = DL_EMPTY; }
+
+  // Write in order like pass 1, then overwrite everything at random
+  // like pass 2 so runs get split and merged.
+  for (n = 0; n < 4096; n++)
+  {
+    int line = (n / 7) % 3 == 0 ? DL_DATA : DL_NO_CG;
+    memory.write(n, 0, line);
+    expected[n] = line;
+  }
+
+  srand(1234);
+
+  for (n = 0; n < 20000; n++)
+  {
+    int address = rand() % 4096;
+    int line = rand() % 4 + 1;
+
+    if ((rand() % 8) == 0) { line = DL_DATA; }
+
+    memory.write(address, 0, line);
+    expected[address] = line;
+  }
+
+  for (n = 0; n < 4096; n++)
+  {
+    if (memory.read_debug(n) != expected[n])
+    {
+      fprintf(stderr, "Error: read_debug(%d) %d != %d %s:%d\n",
+        n, memory.read_debug(n), expected[n], __FILE__, __LINE__);
+      errors++;
+      break;
+    }
+  }
+
+  if (memory.read_debug(4096) != DL_EMPTY) { errors++; }
+  if (memory.read_debug(0x12345678) != DL_EMPTY) { errors++; }
+
+  // Without keep_debug_lines() only used / unused is tracked.
+  Memory memory_no_lines;
+
+  memory_no_lines.write(100, 5, 10);
+  memory_no_lines.write8(101, 5);
+
+  if (memory_no_lines.read_debug(100) != DL_NO_CG) { errors++; }
+  if (memory_no_lines.read_debug(101) != DL_EMPTY) { errors++; }
+  if (memory_no_lines.read8(101) != 5) { errors++; }
+
+  return errors;
+}
+
+int test_Memory_blocks()
+{
+  Memory memory;
+  MemorySpan span;
+  uint8_t data[256];
+  uint8_t check[256];
+  int errors = 0;
+  int n;
+
+  for (n = 0; n < 256; n++) { data[n] = n; }
+
+  // Block that crosses a page, one at the top of memory, a fill and
+  // a write that doesn't mark anything used.
+  memory.write_block(PAGE_SIZE - 100, data, 256, DL_DATA);
+  memory.write_block(0xffffff00, data, 256, 5);
+  memory.fill(0x1000, 0xaa, 16, DL_DATA);
+  memory.write_block(0x2000, data, 16);
+
+  memory.read_block(PAGE_SIZE - 100, check, 256);
+  if (memcmp(data, check, 256) != 0) { errors++; }
+
+  memory.read_block(0xffffff00, check, 256);
+  if (memcmp(data, check, 256) != 0) { errors++; }
+
+  if (memory.read8(0x100f) != 0xaa || memory.read8(0x1010) != 0) { errors++; }
+  if (memory.read8(0x2003) != 3) { errors++; }
+
+  if (memory.low_address != 0x1000) { errors++; }
+  if (memory.high_address != 0xffffffff) { errors++; }
+
+  // Unwritten memory reads back as 0.
+  memory.read_block(0x7ffffff0, check, 32);
+  for (n = 0; n < 32; n++) { if (check[n] != 0) { errors++; break; } }
+
+  const uint32_t expected[][2] =
+  {
+    { 0x1000, 16 },
+    { PAGE_SIZE - 100, 256 },
+    { 0xffffff00, 256 },
+  };
+
+  n = 0;
+
+  while (memory.next_span(&span) != -1)
+  {
+    if (n >= 3 ||
+        span.address != expected[n][0] ||
+        span.length != expected[n][1])
+    {
+      fprintf(stderr, "Error: span 0x%08x %d %s:%d\n",
+        span.address, span.length, __FILE__, __LINE__);
+      errors++;
+      break;
+    }
+
+    n++;
+  }
+
+  if (n != 3) { errors++; }
+
+  if (errors != 0)
+  {
+    fprintf(stderr, "Error: test_Memory_blocks() %s:%d\n", __FILE__, __LINE__);
+  }
+
+  return errors;
+}
+
 int test_MemoryPage()
 {
   MemoryPage memory_page(PAGE_SIZE + 100);
@@ -86,6 +250,9 @@ int main(int argc, char *argv[])
   int errors = 0;
 
   errors += test_Memory();
+  errors += test_Memory_pages();
+  errors += test_Memory_debug();
+  errors += test_Memory_blocks();
   errors += test_MemoryPage();
 
   printf("Total errors: %d\n", errors);
@@ -63,6 +63,68 @@ void check_export(Symbols &symbols, const char *name, int expected)
   }
 }
 
+void test_many_symbols()
+{
+  Symbols symbols;
+  SymbolsIter iter;
+  char name[32];
+  int n;
+
+  // Enough labels to span several MemoryPool's and force the hash index
+  // to grow a few times.
+  for (n = 0; n < 20000; n++)
+  {
+    snprintf(name, sizeof(name), "label_%d", n);
+    append(symbols, name, n);
+  }
+
+  symbols.scope_start();
+  append(symbols, "label_5", 5555);
+  check_lookup(symbols, "label_5", 5555, 0);
+  check_lookup(symbols, "label_6", 6, 0);
+  symbols.scope_end();
+
+  check_lookup(symbols, "label_5", 5, 0);
+  check_lookup(symbols, "label_19999", 19999, 0);
+  check_lookup(symbols, "label_20000", 0, -1);
+
+  if (symbols.append("label_100", 0) != -1)
+  {
+    printf("Error: duplicate label not detected %s:%d\n", __FILE__, __LINE__);
+    errors++;
+  }
+
+  check_symbols_count(symbols, 20001);
+
+  // Iteration must still follow the layout of the MemoryPool's.  A short
+  // name can land in the unused tail of an earlier pool, so the scoped
+  // label is skipped here.
+  n = 0;
+
+  while (symbols.iterate(&iter) != -1)
+  {
+    if (iter.scope == 1) { continue; }
+
+    snprintf(name, sizeof(name), "label_%d", n);
+
+    if (strcmp(iter.name, name) != 0 || iter.address != (uint32_t)n)
+    {
+      printf("Error: iterate %s != %s  %s:%d\n",
+        iter.name, name, __FILE__, __LINE__);
+      errors++;
+      break;
+    }
+
+    n++;
+  }
+
+  if (iter.count != 20001)
+  {
+    printf("Error: iterate count %d  %s:%d\n", iter.count, __FILE__, __LINE__);
+    errors++;
+  }
+}
+
 int main(int argc, char *argv[])
 {
   Symbols symbols;
@@ -131,6 +193,8 @@ int main(int argc, char *argv[])
     symbols.print(stdout);
   }
 
+  test_many_symbols();
+
   printf("Total errors: %d\n", errors);
   printf("%s\n", errors == 0 ? "PASSED." : "FAILED.");
 
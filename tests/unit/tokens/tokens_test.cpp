@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <inttypes.h>
 
 #include "common/assembler.h"
 #include "common/tokens.h"
@@ -117,6 +118,165 @@ void test_1()
   tokens_close(&asm_context);
 }
 
+void test_typed_constants()
+{
+  AsmContext asm_context;
+  char token[TOKENLEN];
+  Token next;
+  int i;
+  const char *test = { "1234 012 0x12 0b11001001 0100b 20h 'A' -1 0xffffffffffffffff" };
+  const char *text[] = { "1234", "012", "0x12", "0b11001001", "0100b", "20h", "A" };
+  int64_t answer[] = { 1234, 10, 18, 201, 4, 32, 65 };
+
+  printf(" - test_typed_constants - \n");
+
+  tokens_open_buffer(&asm_context, test);
+  tokens_reset(&asm_context);
+
+  for (i = 0; i < 7; i++)
+  {
+    tokens_get(&asm_context, next, token, TOKENLEN);
+
+    if (next.type != TOKEN_NUMBER ||
+        next.has_value == false ||
+        next.value != answer[i] ||
+        strcmp(next.text, text[i]) != 0 ||
+        next.length != (int)strlen(text[i]))
+    {
+      printf("FAIL: Expected '%s'=%" PRId64 " and got '%s'=%" PRId64 "\n",
+        text[i], answer[i], next.text, next.value);
+      errors++;
+    }
+  }
+
+  // Pushing a typed token back keeps the value and the spelling.
+  tokens_get(&asm_context, next, token, TOKENLEN);
+
+  if (next.type != TOKEN_SYMBOL || next.has_value)
+  {
+    printf("FAIL: Expected '-' symbol\n");
+    errors++;
+  }
+
+  tokens_get(&asm_context, next, token, TOKENLEN);
+  tokens_push(&asm_context, next);
+  next.value = 0;
+  tokens_get(&asm_context, next, token, TOKENLEN);
+
+  if (next.value != 1 || strcmp(token, "1") != 0)
+  {
+    printf("FAIL: Expected pushed back 1\n");
+    errors++;
+  }
+
+  tokens_get(&asm_context, next, token, TOKENLEN);
+  tokens_push(&asm_context, next);
+
+  if (tokens_get(&asm_context, token, TOKENLEN) != TOKEN_NUMBER ||
+      strcmp(token, "-1") != 0)
+  {
+    printf("FAIL: Expected '-1' and got '%s'\n", token);
+    errors++;
+  }
+
+  tokens_close(&asm_context);
+}
+
+void test_token_cache()
+{
+  AsmContext asm_context;
+  char token[TOKENLEN];
+  char pass_1[64][TOKENLEN];
+  int types[64];
+  int lines[64];
+  int count = 0;
+  int i;
+  const char *filename = "/tmp/naken_tokens_test.asm";
+  const char *code =
+    "start:\r\n"
+    "  mov.w #0x1234, r5 ; comment\n"
+    "  /* multi\n line */ add 'a', 1.5\n"
+    "  .db \"string\\n\", label+1\n"
+    "label: // another comment\n"
+    "  jmp $";
+
+  printf(" - test_token_cache - \n");
+
+  FILE *out = fopen(filename, "wb");
+  fputs(code, out);
+  fclose(out);
+
+  if (tokens_open_file(&asm_context, filename) != 0)
+  {
+    printf("FAIL: Couldn't open %s\n", filename);
+    errors++;
+    return;
+  }
+
+  asm_context.pass = 1;
+  tokens_reset(&asm_context);
+
+  while (count < 64)
+  {
+    types[count] = tokens_get(&asm_context, pass_1[count], TOKENLEN);
+    lines[count] = asm_context.tokens.line;
+    if (types[count] == TOKEN_EOL) { asm_context.tokens.line++; }
+    if (types[count++] == TOKEN_EOF) { break; }
+  }
+
+  asm_context.pass = 2;
+  tokens_reset(&asm_context);
+
+  for (i = 0; i < count; i++)
+  {
+    int token_type = tokens_get(&asm_context, token, TOKENLEN);
+
+    if (token_type != types[i] ||
+        strcmp(token, pass_1[i]) != 0 ||
+        asm_context.tokens.line != lines[i])
+    {
+      printf("FAIL: Expected '%s' %d and got '%s' %d on pass 2\n",
+        pass_1[i], types[i], token, token_type);
+      errors++;
+    }
+
+    if (token_type == TOKEN_EOL) { asm_context.tokens.line++; }
+  }
+
+  if (asm_context.token_cache.get_hits() < count / 2)
+  {
+    printf("FAIL: Only %d of %d tokens came from the cache\n",
+      asm_context.token_cache.get_hits(), count);
+    errors++;
+  }
+
+  // Opening the file again or a file that doesn't exist a second time
+  // shouldn't touch the disk.
+  tokens_close(&asm_context);
+  remove(filename);
+
+  if (tokens_open_file(&asm_context, filename) != 0 ||
+      tokens_open_file(&asm_context, "/tmp/naken_tokens_missing.asm") == 0 ||
+      tokens_open_file(&asm_context, "/tmp/naken_tokens_missing.asm") == 0)
+  {
+    printf("FAIL: Source file cache\n");
+    errors++;
+  }
+
+  if (asm_context.token_cache.get_file_reads() != 1 ||
+      asm_context.token_cache.get_file_hits() != 2 ||
+      asm_context.token_cache.get_file_missing() != 1)
+  {
+    printf("FAIL: Source file cache reads=%d hits=%d missing=%d\n",
+      asm_context.token_cache.get_file_reads(),
+      asm_context.token_cache.get_file_hits(),
+      asm_context.token_cache.get_file_missing());
+    errors++;
+  }
+
+  tokens_close(&asm_context);
+}
+
 void test_pushback()
 {
   AsmContext asm_context;
@@ -425,12 +585,58 @@ void test_code_tick_error()
   }
 }
 
+void test_ifdef_ignore()
+{
+  AsmContext asm_context;
+  const char *code =
+    ".ifdef NOT_DEFINED\n"
+    "  .db undefined_symbol ; .endif\n"
+    "  .ifndef ALSO_NOT_DEFINED\n"
+    "  .db 1\n"
+    "  .endif\n"
+    "  .db \".endif\", '\"', 2 /* .else\n"
+    ".endif */\n"
+    "  // .else\n"
+    ".else\n"
+    "  .db 3\n"
+    ".endif\n"
+    "  .db 4\n";
+
+  printf(" - test_ifdef_ignore - \n");
+
+  asm_context.pass = 1;
+  asm_context.init();
+  tokens_open_buffer(&asm_context, code);
+  tokens_reset(&asm_context);
+
+  if (assemble(&asm_context) != 0)
+  {
+    printf("FAIL: assemble()\n");
+    errors++;
+  }
+
+  if (asm_context.address != 2 ||
+      asm_context.memory.read8(0) != 3 ||
+      asm_context.memory.read8(1) != 4 ||
+      asm_context.tokens.line != 13)
+  {
+    printf("FAIL: Expected 03 04 on line 13 and got %d bytes %02x %02x %d\n",
+      asm_context.address,
+      asm_context.memory.read8(0),
+      asm_context.memory.read8(1),
+      asm_context.tokens.line);
+    errors++;
+  }
+}
+
 int main(int argc, char *argv[])
 {
   printf("tokens.o test\n");
 
   test_1();
   test_constants();
+  test_typed_constants();
+  test_token_cache();
   test_pushback();
   test_strings_with_dots();
 
@@ -443,6 +649,7 @@ int main(int argc, char *argv[])
   test_db_quote_error();
   test_db_tick_error();
   test_code_tick_error();
+  test_ifdef_ignore();
 
   printf("Testing: tokens.o ... ");
 